@@ -0,0 +1,198 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Model.h"
+#include "JobSystem.h"
+
+struct AssetLoaderStats {
+    unsigned int models = 0;
+    unsigned int materialFiles = 0;
+    unsigned int textures = 0;
+    unsigned int sharedReferences = 0; // references to a file another model already loads
+    size_t bytesRead = 0;
+    size_t peakBytesInFlight = 0;
+};
+
+class AssetLoader;
+
+// Which reads go first while the read budget holds loads back
+enum class AssetPriority { Low, Normal, High };
+
+// A model or image on its way, from AssetLoader::LoadModelAsync or LoadImageAsync. co_await it
+// in a Task to get the asset, the coroutine resumes on the main thread in AssetLoader::Update.
+// Code that isn't a coroutine polls IsReady and calls Take. Copies refer to the same load.
+template <typename T>
+class AssetTask {
+public:
+    AssetTask() = default;
+
+    bool IsReady() const;
+    // 0 to 1, by the stages done so far
+    float GetProgress() const { return state ? state->progress.load(std::memory_order_relaxed) : 0.0f; }
+    // The load stops at its next stage and completes with an empty result, files it shares with
+    // other loads still finish for them
+    void Cancel() { state->cancelled.store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const { return state && state->cancelled.load(std::memory_order_relaxed); }
+    // Once ready, moves the result out
+    T Take();
+
+    bool await_ready() const { return IsReady(); }
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    T await_resume() { return Take(); }
+
+private:
+    friend class AssetLoader;
+    struct State {
+        AssetLoader* loader;
+        std::mutex mutex;
+        bool ready = false;
+        T value{};
+        std::coroutine_handle<> continuation;
+        std::atomic<float> progress{ 0.0f };
+        std::atomic<bool> cancelled{ false };
+    };
+
+    explicit AssetTask(AssetLoader* loader) : state(std::make_shared<State>()) { state->loader = loader; }
+    void SetProgress(float progress) const { state->progress.store(progress, std::memory_order_relaxed); }
+    // Any thread, the first result counts
+    void Complete(T value) const;
+
+    std::shared_ptr<State> state;
+};
+
+// Loads models and what they reference on the JobSystem. Every file is a node of a dependency
+// graph, OBJ -> MTL -> textures: the OBJ is read and scanned for its mtllib lines, the MTL files
+// are read and parsed meanwhile and start their textures, the OBJ is parsed once its materials
+// are known and the model is done once its textures are decoded. MTL files and textures are
+// shared by name, a texture used by several models is read and decoded once.
+//
+// Reading, parsing and decoding run on the workers. Files are only read while the bytes read
+// but not parsed or decoded yet stay below a budget, a single larger file is still read alone.
+// MTL files are the exception, they are small and a model holding its bytes waits for them.
+//
+// Loads return an AssetTask, the coroutines awaiting them resume in Update on the main thread,
+// between frames, and never in the middle of a JobSystem::Wait. The frame only pays for what
+// the coroutines do with the assets, the loading itself stays on the workers.
+class AssetLoader {
+public:
+    // Runs on a worker once the model and its textures are in, for the expensive work on it
+    using PrepareFn = std::function<void(Model&)>;
+
+    explicit AssetLoader(size_t maxBytesInFlight = 64u << 20);
+    // Waits for what is still loading, coroutines still waiting aren't resumed anymore
+    ~AssetLoader();
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Any thread. OBJ files go through the graph, other formats load in a single job. The
+    // result is null when the model didn't load or the load was cancelled.
+    AssetTask<std::unique_ptr<Model>> LoadModelAsync(const std::string& path, PrepareFn prepare = nullptr, AssetPriority priority = AssetPriority::Normal);
+    // Any thread. Shared with the model textures of the same name, the result refers to the same
+    // pixels. Empty when the file didn't load or the load was cancelled.
+    AssetTask<Image> LoadImageAsync(const std::string& name, AssetPriority priority = AssetPriority::Normal);
+
+    // Main thread, once per frame. Resumes the coroutines whose assets arrived so far, returns
+    // how many.
+    size_t Update();
+
+    AssetLoaderStats GetStats() const;
+
+private:
+    template <typename T>
+    friend class AssetTask;
+    enum NodeKind { ModelNode, MaterialNode, TextureNode };
+    struct Node;
+
+    // Callers hold nodesMutex, model nodes are owned by their load and freed when it completes
+    Node* CreateNode(NodeKind kind, const std::string& name, AssetPriority priority);
+    // MTL files and textures, shared by name, started when first asked for. Asking with a higher
+    // priority moves a queued read up.
+    Node* GetShared(NodeKind kind, const std::string& name, AssetPriority priority);
+    void Spawn(std::function<void()> job);
+    // Any thread, for Update
+    void QueueContinuation(std::coroutine_handle<> continuation);
+
+    // Reads the file then runs the next stage, once the budget allows. Higher priorities go
+    // first, in request order within one.
+    void QueueRead(Node* node, std::function<void()> next);
+    // Caller holds readMutex
+    void InsertRead(Node* node, std::function<void()> next);
+    void StartReads();
+    void ReleaseBytes(Node* node);
+
+    // node waits for prerequisite, only while node is held, see Then
+    void DependOn(Node* node, Node* prerequisite);
+    // Runs stage as a job once the prerequisites added since the last stage are finished
+    void Then(Node* node, std::function<void()> stage);
+    void Release(Node* node);
+    void Finish(Node* node);
+
+    void ScanModel(Node* node);
+    void ParseModel(Node* node);
+    void CompleteModel(Node* node);
+    void ParseMaterials(Node* node);
+    void DecodeTexture(Node* node);
+
+    // File name to path, enumerated once instead of per file
+    std::unordered_map<std::string, std::string> assetPaths;
+
+    mutable std::mutex nodesMutex;
+    std::vector<std::unique_ptr<Node>> nodes; // the shared ones
+    std::unordered_map<std::string, Node*> sharedMaterials;
+    std::unordered_map<std::string, Node*> sharedTextures;
+    AssetLoaderStats stats;
+
+    mutable std::mutex readMutex;
+    std::deque<std::pair<Node*, std::function<void()>>> readQueue;
+    size_t maxBytesInFlight;
+    size_t bytesInFlight = 0;
+
+    std::mutex continuationMutex;
+    std::vector<std::coroutine_handle<>> continuations;
+    // Every job of the loader, the destructor waits for them
+    JobCounter jobs;
+};
+
+template <typename T>
+bool AssetTask<T>::IsReady() const {
+    if (!state) return false;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->ready;
+}
+
+template <typename T>
+T AssetTask<T>::Take() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return std::move(state->value);
+}
+
+template <typename T>
+bool AssetTask<T>::await_suspend(std::coroutine_handle<> awaiting) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->ready) return false;
+    state->continuation = awaiting;
+    return true;
+}
+
+template <typename T>
+void AssetTask<T>::Complete(T value) const {
+    std::coroutine_handle<> continuation;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->ready) return;
+        state->value = std::move(value);
+        state->ready = true;
+        continuation = std::exchange(state->continuation, {});
+    }
+    state->progress.store(1.0f, std::memory_order_relaxed);
+    if (continuation) state->loader->QueueContinuation(continuation);
+}
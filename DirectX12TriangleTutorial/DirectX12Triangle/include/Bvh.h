@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <cfloat>
+#include <DirectXMath.h>
+#include "Primitives.h"
+
+class Model;
+
+struct RayHit {
+    Model* model = nullptr;              // set by SceneBvh::Raycast
+    unsigned int triangle = 0xFFFFFFFFu; // face index, its corners are indices[3 * triangle + 0..2]
+    float distance = FLT_MAX;
+    float u = 0.0f, v = 0.0f;            // barycentrics of corners 1 and 2
+};
+
+// Node of a 4-wide BVH. The bounds of the four children are stored per axis so one SSE
+// register tests all of them against a ray. A child >= 0 is a node, < 0 is the leaf ~child.
+struct alignas(16) Bvh4Node {
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    int children[4];
+};
+
+// Primitives [first, first + count) of the build order, at most Bvh4::MaxLeafSize of them
+struct BvhLeaf {
+    unsigned int first;
+    unsigned int count;
+};
+
+// Binned SAH build over arbitrary boxes, collapsed from a binary tree into Bvh4Nodes.
+// Large inputs split their top levels serially and build the subtrees in parallel.
+struct Bvh4 {
+    static constexpr unsigned int MaxLeafSize = 4;
+
+    std::vector<Bvh4Node> nodes; // root first, empty when there is nothing to build over
+    std::vector<BvhLeaf> leaves;
+    std::vector<unsigned int> order; // primitive index per leaf slot
+
+    void Build(const std::vector<DirectX::XMFLOAT3>& boxMin, const std::vector<DirectX::XMFLOAT3>& boxMax);
+    void Clear();
+};
+
+// Four triangles of a leaf as origin + two edges, padded with degenerate triangles that never hit
+struct alignas(16) TrianglePacket {
+    float v0x[4], v0y[4], v0z[4];
+    float e1x[4], e1y[4], e1z[4];
+    float e2x[4], e2y[4], e2z[4];
+    unsigned int faces[4];
+};
+
+// Triangles of one mesh in its model space. Rays are two sided, the distance is measured
+// in multiples of the direction, so a ray transformed into model space keeps its distances.
+class TriangleBvh {
+public:
+    void Build(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    void Clear();
+    bool IsEmpty() const { return bvh.nodes.empty(); }
+
+    // Closest hit with 0 < distance < maxDistance, hit.model is left untouched
+    bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const;
+    // Any hit with 0 < distance < maxDistance, stops at the first one found
+    bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance) const;
+    // Appends the faces whose bounds overlap the box, for narrow phase tests of moving shapes
+    void Overlap(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, std::vector<unsigned int>& outFaces) const;
+
+    size_t GetNodeCount() const { return bvh.nodes.size(); }
+    size_t GetTriangleCount() const { return bvh.order.size(); }
+
+private:
+    Bvh4 bvh;
+    std::vector<TrianglePacket> packets; // one per leaf
+};
+
+// Instances of models with a TriangleBvh, placed with their world matrices. Moving a model only
+// needs Build again, which is cheap: it only sees one box per model.
+class SceneBvh {
+public:
+    void Build(const std::vector<Model*>& models);
+    void Clear();
+
+    // Closest model hit in world space, the direction doesn't have to be normalized but the
+    // distances are in world units either way
+    bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const;
+    // True when anything but ignore is hit closer than maxDistance
+    bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, const Model* ignore = nullptr) const;
+
+    size_t GetInstanceCount() const { return instances.size(); }
+
+private:
+    struct Instance {
+        Model* model;
+        DirectX::XMFLOAT4X4 worldToModel;
+    };
+
+    std::vector<Instance> instances;
+    Bvh4 bvh;
+};
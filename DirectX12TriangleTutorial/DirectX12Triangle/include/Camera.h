@@ -5,6 +5,16 @@
 #include <d3dcompiler.h>
 #include <vector>
 #include <Model.h>
+#include "SpatialHash.h"
+#include "EntityStore.h"
+#include "CharacterController.h"
+
+// What the renderer looks from, blended between two simulation steps
+struct CameraView {
+    DirectX::XMFLOAT3 position;
+    DirectX::XMFLOAT3 forward;
+    DirectX::XMFLOAT3 up;
+};
 
 class Camera
 {
@@ -12,13 +22,26 @@ public:
     Camera();
     ~Camera();
 
+    // True when the model's center is within the view cone given by threshold (cosine of the
+    // angle to the forward vector) and not hidden behind other models, or when the forward ray
+    // hits the model. Without a scene only the cone is checked.
     bool IsLookingAtModel(Model* model, float threshold);
 
     void PanForward(float dir);
     void PanRight(float dir);
+    // Walks at moveSpeed for one simulation step, forward and right are -1 to 1 (held keys).
+    // Diagonals are no faster than straight walking.
+    void Move(float forward, float right, float deltaTime);
+    // Gravity while the controller is off the ground, once per simulation step
+    void Update(float deltaTime);
     void MouseMovement(float dx, float dy);
     void UpdateCameraVectors();
 
+    // At the start of every simulation step, keeps the state GetView blends from
+    void BeginStep();
+    // Between the state before the last step (alpha 0) and the current one (alpha 1)
+    CameraView GetView(float alpha) const;
+
     // Set in constructor
     DirectX::XMFLOAT3 cameraPos = { 0.0f, 0.0f, 0.0f };  // Further right, higher, and further back
     DirectX::XMFLOAT3 cameraForward = { 0.0f, 0.0f, 0.0f };
@@ -27,17 +50,34 @@ public:
 
     float yaw = 0.0f;    // Rotation around Y axis
     float pitch = 0.0f;  // Rotation around X axis
-    float moveSpeed = 0.5f;
+    float moveSpeed = 30.0f; // units per second
 
     float mouseSensitivity = 0.05f;
 
-    // Collision detection
-    //void SetModels(const std::vector<Model*>* models) { this->models = models; }
-    bool CheckCollision(const DirectX::XMFLOAT3& newPosition);
+    // Walks the camera through the world, cameraPos sits eyeHeight above its feet
+    CharacterController controller;
+    float eyeHeight = 5.0f;
+    float gravity = 60.0f;
+    float fallSpeed = 0.0f;
+
+    // Models the camera picks up, owned by the Engine
+    SpatialHash* broadphase = nullptr;
+    const EntityStore* entities = nullptr;
+    // Ray casts for gaze checks, owned by the Engine
+    SceneBvh* scene = nullptr;
+    float gazeDistance = 1000.0f;
+
+    std::vector<EntityHandle> collectedDiamonds;
+
+private:
+    void Walk(const DirectX::XMFLOAT3& displacement);
+    // Removable models the capsule touches go to collectedDiamonds
+    void CollectPickups();
 
-    std::vector<Model*>* models = nullptr;
-    float collisionRadius = 2.0f;
+    std::vector<unsigned int> nearbyProxies; // scratch for CollectPickups
 
-    std::vector<Model*> collectedDiamonds;
+    DirectX::XMFLOAT3 previousPos = { 0.0f, 0.0f, 0.0f };
+    float previousYaw = 0.0f;
+    float previousPitch = 0.0f;
 };
 
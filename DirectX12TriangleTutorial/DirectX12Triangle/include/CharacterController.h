@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include "Model.h"
+#include "SpatialHash.h"
+#include "EntityStore.h"
+
+// Sides of the capsule that touched something during the last Move
+enum CollisionFlags : unsigned int {
+    CollisionNone = 0,
+    CollisionSides = 1 << 0,
+    CollisionAbove = 1 << 1,
+    CollisionBelow = 1 << 2,
+};
+
+struct CapsuleHit {
+    float fraction = 1.0f;                     // of the swept displacement, the capsule stops there
+    DirectX::XMFLOAT3 normal = { 0.0f, 0.0f, 0.0f }; // from the surface towards the capsule
+    Model* model = nullptr;
+};
+
+// Upright capsule moved through the world with swept tests, so no step is long enough to tunnel
+// through thin geometry. A move is split into an up pass (stepping onto ledges), a side pass that
+// slides along whatever it hits and a down pass that snaps back onto the ground.
+//
+// Models with collision hulls are swept against their hulls, all others against the triangles of
+// their BVH. The time of impact comes from conservative advancement on the exact segment-shape
+// distance, which stays valid for any convex shape under translation.
+class CharacterController {
+public:
+    // Feet of the capsule, it spans [position.y, position.y + height]
+    DirectX::XMFLOAT3 position = { 0.0f, 0.0f, 0.0f };
+    float radius = 2.0f;
+    float height = 6.0f;
+    float stepOffset = 1.5f;   // ledges up to this high are walked onto
+    float slopeLimit = 0.64f;  // cosine of the steepest walkable slope, about 50 degrees
+    float skinWidth = 0.02f;   // gap kept to every surface
+    float snapDistance = 1.0f; // the ground is followed down slopes and steps this far
+
+    SpatialHash* broadphase = nullptr; // solid models, removable ones are skipped
+    const EntityStore* entities = nullptr; // flags of the broadphase models, EntityRemovable
+    std::vector<Model*> terrain;       // tested by every move without the broadphase (the ground)
+    Model* self = nullptr;             // never collided with, for NPCs that are in the broadphase
+
+    // Returns the CollisionFlags of the move. The vertical part of displacement is gravity or a
+    // jump, walking only needs the horizontal part.
+    unsigned int Move(const DirectX::XMFLOAT3& displacement);
+    // Sweeps the capsule from its current position, without moving it
+    bool Sweep(const DirectX::XMFLOAT3& displacement, CapsuleHit& hit);
+
+    bool IsGrounded() const { return grounded; }
+    const DirectX::XMFLOAT3& GetGroundNormal() const { return groundNormal; }
+
+private:
+    // Convex pieces near the move, gathered once per Move
+    struct HullShape {
+        const ConvexHull* hull;
+        DirectX::XMFLOAT4X4 world;
+        BoundingBox bounds;
+        Model* model;
+    };
+    struct TriangleShape {
+        DirectX::XMFLOAT3 corners[3];
+        BoundingBox bounds;
+        Model* model;
+    };
+
+    void Gather(const BoundingBox& region);
+    void GatherTriangles(Model* model, const BoundingBox& region);
+    bool SweepGathered(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& displacement, CapsuleHit& hit) const;
+    // Moves along displacement and returns the part of it that was blocked
+    DirectX::XMFLOAT3 SweepAndMove(const DirectX::XMFLOAT3& displacement, CapsuleHit& hit, bool& blocked);
+    void Depenetrate();
+    BoundingBox CapsuleBounds(const DirectX::XMFLOAT3& feet) const;
+
+    bool grounded = false;
+    DirectX::XMFLOAT3 groundNormal = { 0.0f, 1.0f, 0.0f };
+
+    std::vector<HullShape> hulls;
+    std::vector<TriangleShape> triangles;
+    std::vector<unsigned int> proxies; // scratch
+    std::vector<unsigned int> faces;   // scratch
+};
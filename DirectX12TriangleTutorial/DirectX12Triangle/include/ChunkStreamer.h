@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <DirectXMath.h>
+#include "EntityStore.h"
+#include "GpuScene.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "SpatialHash.h"
+
+// One kind of instance scattered over every chunk, e.g. trees
+struct ChunkLayer {
+    // Every instance draws this mesh (Model::CreateInstance), starting with its rotation and scale
+    std::shared_ptr<Model> source;
+    float y = 0.0f;                // height of the instances
+    unsigned int perChunk = 0;     // at most this many per chunk, spread evenly
+    uint32_t flags = EntityStatic;
+};
+
+struct ChunkStreamerOptions {
+    float chunkSize = 100.0f;
+    // Chunks closer than loadRadius to the camera in XZ load, they unload beyond unloadRadius,
+    // the gap keeps a camera walking along a chunk border from loading and dropping it again
+    float loadRadius = 400.0f;
+    float unloadRadius = 500.0f;
+    // Chunks read at the same time, and made resident per frame
+    unsigned int maxLoadsInFlight = 4;
+    unsigned int maxAppliedPerFrame = 2;
+    // Memory of the resident chunks, the farthest make room for nearer ones. A layer's mesh and
+    // textures count once, on the CPU and on the GPU, while any of its instances is resident;
+    // every instance adds its Model and its constant buffer entry.
+    size_t maxResidentBytes = 256u << 20;
+};
+
+struct ChunkStreamerStats {
+    unsigned int chunks = 0;        // of the whole world
+    unsigned int bakedInstances = 0;
+    bool loadedFromCache = false;
+
+    unsigned int resident = 0;
+    unsigned int loading = 0;
+    size_t residentBytes = 0;
+    size_t meshBytes = 0;           // the shared meshes part of residentBytes
+    size_t peakResidentBytes = 0;
+    unsigned int loads = 0;
+    unsigned int unloads = 0;
+    // Frames that waited for the chunk under the camera, it had not arrived in time. The first
+    // chunk after Build doesn't count.
+    unsigned int stalls = 0;
+    float stallMs = 0.0f;
+    float worstStallMs = 0.0f;
+};
+
+// Streams a large world in square chunks around the camera. Build scatters the layers over every
+// chunk, each with its own seed and inset by the instance footprint so neighbours never overlap,
+// and bakes the placement into cache/<cacheName> next to the executable: a manifest of where each
+// chunk's instances start, then the instances. Only the manifest stays in memory.
+//
+// Update makes the chunks within loadRadius of the camera resident, nearest first. A chunk is
+// read and its instances are created on the JobSystem, the main thread only adds them to the
+// entity store and the broadphase. Instances share their layer's mesh, on the CPU and in the
+// Renderer's GpuScene, so one costs a transform. Resident memory depends on the radii, not on
+// the size of the world. The chunk under the camera is needed right away for the ground, when it isn't
+// resident Update waits for it and counts a stall.
+class ChunkStreamer {
+public:
+    ChunkStreamer() = default;
+    // Waits for the reads in flight
+    ~ChunkStreamer();
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    // Drops what is resident, then loads the baked placement when it was baked from the same
+    // world, layers and obstacles, otherwise bakes it (chunks in parallel) and writes it.
+    // Instances keep clear of the XZ rectangles of the obstacles. ground, if given, is copied
+    // once and scaled to cover a chunk, every resident chunk gets an instance of it.
+    ChunkStreamerStats Build(float minX, float minZ, float maxX, float maxZ, uint32_t seed,
+        const std::vector<ChunkLayer>& layers, const std::vector<BoundingBox>& obstacles, const Model* ground,
+        const std::string& cacheName, const ChunkStreamerOptions& options = {});
+    // Unloads every chunk
+    void Clear();
+
+    // Once per frame on the main thread, true when entities were added or removed
+    bool Update(const DirectX::XMFLOAT3& cameraPos);
+
+    ChunkStreamerStats GetStats() const { return stats; }
+    // Chunk containing the XZ position of p, -1 outside the world
+    int GetChunk(const DirectX::XMFLOAT3& p) const;
+
+    // Where the instances go, owned by the Engine. The ground instances go to terrain instead
+    // of the broadphase.
+    EntityStore* entities = nullptr;
+    SpatialHash* broadphase = nullptr;
+    std::vector<Model*>* terrain = nullptr;
+
+private:
+    struct Instance {
+        uint32_t layer;
+        float x, z;
+    };
+    struct ChunkRange {
+        uint32_t first;
+        uint32_t count;
+    };
+    // A read in flight, the job fills in the models and their flags
+    struct PendingLoad {
+        int chunk;
+        JobCounter counter;
+        std::vector<std::pair<Model*, uint32_t>> models;
+        std::vector<uint32_t> layerCounts; // instances per layer
+        Model* ground = nullptr;
+    };
+    enum ChunkState : uint8_t { ChunkUnloaded, ChunkLoading, ChunkResident };
+    struct Resident {
+        std::vector<EntityHandle> entities; // the ground instance too
+        std::vector<uint32_t> layerCounts;
+        Model* ground = nullptr;
+        size_t bytes = 0; // of the instances, the shared meshes are counted apart
+    };
+
+    // Fills ranges too
+    void Bake(uint32_t seed, const std::vector<BoundingBox>& obstacles, std::vector<Instance>& outInstances);
+    bool Save(const std::string& path, uint64_t key, const std::vector<Instance>& instances);
+    bool Load(const std::string& path, uint64_t key);
+
+    void StartLoad(int chunk);
+    void ReadChunk(PendingLoad& load) const;
+    // Adds the models of a finished read to the scene
+    void Apply(std::unique_ptr<PendingLoad> load);
+    void Unload(int chunk);
+    // Counts the shared meshes of a chunk's instances in or out of residentBytes
+    void AddMeshUsers(const std::vector<uint32_t>& layerCounts, bool withGround);
+    void RemoveMeshUsers(const std::vector<uint32_t>& layerCounts, bool withGround);
+    // Memory the chunk adds before it is read, from the manifest. Every layer that has nothing
+    // resident yet counts with its mesh, the chunk may need it.
+    size_t EstimateBytes(int chunk) const;
+    // Of the XZ distance from p to the chunk's square
+    float DistanceSq(int chunk, const DirectX::XMFLOAT3& p) const;
+
+    float minX = 0.0f, minZ = 0.0f;
+    int chunksX = 0, chunksZ = 0;
+    ChunkStreamerOptions options;
+    std::vector<ChunkLayer> layers;
+    std::vector<size_t> layerMeshBytes;  // CPU and GPU copy of the shared mesh
+    std::vector<uint32_t> layerUsers;    // resident instances per layer
+    std::shared_ptr<Model> ground;       // scaled to a chunk
+    size_t groundMeshBytes = 0;
+    uint32_t groundUsers = 0;
+
+    // The manifest, the instances stay in the file. Only when it couldn't be written they are
+    // kept in memory instead.
+    std::string path;
+    uint64_t dataOffset = 0;
+    std::vector<ChunkRange> ranges;
+    std::vector<Instance> unsavedInstances;
+
+    std::vector<ChunkState> states; // per chunk of the world, one byte each
+    std::unordered_map<int, Resident> residents;
+    std::vector<std::unique_ptr<PendingLoad>> loads;
+    std::vector<int> wanted; // scratch of Update
+    ChunkStreamerStats stats;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <DirectXMath.h>
+#include "ConvexDecomposition.h"
+
+// Narrow phase tests against a model space ConvexHull placed in the world by a row-vector matrix.
+// Non-uniform scale is fine, the hull is never transformed, only its support points.
+
+// GJK distance from a world space point to the hull, 0 when the point is inside
+float DistanceToHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& point);
+
+// GJK distance between a world space segment (the core of a capsule) and the hull, 0 when they
+// overlap. normal is the unit direction from the hull towards the segment, zero when they overlap.
+float DistanceSegmentToHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, DirectX::XMFLOAT3& normal);
+
+// GJK with an early out as soon as the sphere is provably separated or touching
+bool SphereIntersectsHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& center, float radius);
+
+// SAT over the box axes and the hull face normals. Edge/edge axes are skipped, so the test may
+// report a touch near crossing edges but never misses a real overlap.
+bool BoxIntersectsHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax);
+
+// Closest points of the segment [a, b] and the triangle p0 p1 p2, returns their distance
+float ClosestPointsSegmentTriangle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b,
+    const DirectX::XMFLOAT3& p0, const DirectX::XMFLOAT3& p1, const DirectX::XMFLOAT3& p2,
+    DirectX::XMFLOAT3& onSegment, DirectX::XMFLOAT3& onTriangle);
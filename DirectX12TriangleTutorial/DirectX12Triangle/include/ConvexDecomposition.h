@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "Primitives.h"
+
+// Convex polytope in model space. A point p is inside when dot(plane.xyz, p) + plane.w <= 0 for every plane.
+struct ConvexHull {
+    std::vector<DirectX::XMFLOAT3> points;
+    std::vector<unsigned int> indices;       // outward facing triangles over points
+    std::vector<DirectX::XMFLOAT4> planes;   // one per face, coplanar triangles merged
+    DirectX::XMFLOAT3 boundsMin = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 boundsMax = { 0.0f, 0.0f, 0.0f };
+    float volume = 0.0f;
+
+    bool IsEmpty() const { return points.empty(); }
+};
+
+// Quickhull. Fails (returns false) when the points are all coplanar.
+bool ComputeConvexHull(const std::vector<DirectX::XMFLOAT3>& points, ConvexHull& out);
+
+struct ConvexDecompositionOptions {
+    // Voxels along the longest side of the mesh bounds
+    unsigned int resolution = 40;
+    // A part is split while (hull volume - voxel volume) / volume of the whole mesh hull exceeds this
+    float concavityThreshold = 0.02f;
+    unsigned int maxDepth = 10;
+    // Hulls are merged back together, cheapest first, until at most this many are left. Hulls
+    // that merge with none of the others are kept, even past the limit.
+    unsigned int maxHulls = 24;
+    // Cut planes tried per axis and part
+    unsigned int planesPerAxis = 6;
+    // Closed meshes are filled, open ones (planes, leaf cards) only keep their surface voxels
+    bool fillInterior = true;
+};
+
+struct ConvexDecompositionStats {
+    unsigned int solidVoxels = 0;
+    unsigned int partsBeforeMerge = 0;
+    unsigned int hulls = 0;
+    bool loadedFromCache = false; // set by Model::BuildCollisionHulls, the other counts are 0 then
+};
+
+// V-HACD style approximate convex decomposition: the mesh is voxelized, parts are recursively cut
+// along the axis aligned plane that minimizes the concavity of both halves, and the resulting
+// hulls are merged back while the merge stays close to convex.
+std::vector<ConvexHull> DecomposeConvex(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    const ConvexDecompositionOptions& options = {}, ConvexDecompositionStats* stats = nullptr);
+
+// Hull cache files. The key (e.g. a hash of the mesh and the options) is stored with the hulls,
+// a file written for a different key fails to load.
+bool SaveConvexHulls(const std::string& path, uint64_t key, const std::vector<ConvexHull>& hulls);
+bool LoadConvexHulls(const std::string& path, uint64_t key, std::vector<ConvexHull>& hulls);
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <utility>
+#include <DirectXMath.h>
+#include "Model.h"
+#include "GeometryKernels.h"
+
+// View frustum as six planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+    enum { Left, Right, Bottom, Top, Near, Far, Count };
+    DirectX::XMFLOAT4 planes[Count];
+
+    // Extract the planes of a row-vector view * projection matrix (D3D clip space, z in [0, 1])
+    void ExtractPlanes(DirectX::FXMMATRIX viewProj);
+};
+
+struct ClusterCullStats {
+    unsigned int tested = 0;
+    unsigned int groupsCulled = 0; // whole groups rejected by their bounding sphere
+    unsigned int frustumCulled = 0;
+    unsigned int backfaceCulled = 0;
+    unsigned int occlusionCulled = 0;
+    unsigned int visible = 0;
+};
+
+struct SceneCullStats {
+    unsigned int tested = 0;
+    unsigned int visible = 0;
+};
+
+// Whole model culling ahead of the meshlet pass. The world boxes of the models are kept as SoA
+// arrays and tested against the frustum planes in batches (see GeometryKernels::CullBoxes), so a
+// model off screen costs a few vector ops instead of a draw and a walk over its meshlets.
+class SceneCuller
+{
+public:
+    // Copies the world boxes (Model::b) of the models, call it again once models moved.
+    // Null entries are skipped and never visible.
+    void UpdateBounds(const std::vector<Model*>& models);
+    // Copies the packed boxes at the given indices (see EntityStore::GetBounds), Cull returns
+    // those indices
+    void UpdateBounds(const std::vector<BoundingBox>& bounds, const std::vector<unsigned int>& indices);
+
+    // Fills outVisible with the indices (into the models given to UpdateBounds) of the models
+    // that may be visible, in ascending order
+    void Cull(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos,
+        const DirectX::XMFLOAT3& cameraForward, std::vector<unsigned int>& outVisible);
+
+    const SceneCullStats& GetStats() const { return stats; }
+
+    // Models entirely farther ahead of the camera than this are dropped, 0 disables it. Only
+    // invisible when the fog has fully covered them and the fog color matches the background.
+    float fogDistance = 0.0f;
+
+private:
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<unsigned int> modelIndices; // SoA slot -> index into the models
+    SceneCullStats stats;
+};
+
+// CPU meshlet culling: frustum, normal cone backface and an optional occlusion test.
+// Visible meshlets are emitted as compacted index ranges ready for DrawIndexedInstanced.
+class ClusterCuller
+{
+public:
+    // Call once per frame before culling any model
+    void BeginFrame(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos);
+
+    // Fills outRanges with the visible index ranges of model, adjacent meshlets are merged
+    void Cull(const Model& model, DirectX::FXMMATRIX modelMatrix, std::vector<DrawRange>& outRanges);
+
+    const ClusterCullStats& GetStats() const { return stats; }
+
+    // Optional, returns true when the world space sphere is fully hidden
+    std::function<bool(const DirectX::XMFLOAT3& center, float radius)> occlusionTest;
+
+    bool enableBackfaceCulling = true;
+
+private:
+    Frustum frustum = {};
+    DirectX::XMFLOAT3 cameraPos = { 0.0f, 0.0f, 0.0f };
+    ClusterCullStats stats;
+    std::vector<std::pair<unsigned int, unsigned int>> meshletRanges; // scratch, [begin, end)
+};
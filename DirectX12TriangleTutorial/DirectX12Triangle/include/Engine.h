@@ -6,7 +6,17 @@
 #include "Model.h"
 #include "Audio.h"
 #include "File.h"
+#include "SpatialHash.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "Task.h"
+#include "Scatter.h"
+#include "ChunkStreamer.h"
+#include "FrameClock.h"
+#include "Input.h"
 #include <filesystem>
+#include <chrono>
+#include <random>
 
 class Engine
 {
@@ -17,7 +27,8 @@ public:
     void Init();
     void Run();
     void Cleanup();
-    void RemoveModel(Model* model);
+    // Takes it out of the broadphase and deletes it, the caller rebuilds scene and renderer
+    void RemoveEntity(EntityHandle entity);
 
     Renderer* renderer;
 
@@ -28,8 +39,15 @@ public:
 
     bool toggleClickCamera = false; // Toggle for click to rotate camera
 
+    // Filled by the window messages, read by the simulation steps
+    InputState input;
+
 private:
     void InitWindow();
+    // Places the models as they arrive, then bakes the visibility which needs all static ones
+    Task<> LoadScene();
+    // One fixed step of the camera and the gameplay, the same for every display rate
+    void Simulate(float deltaTime);
 
     HINSTANCE hInstance;
     HWND hwnd;
@@ -38,10 +56,45 @@ private:
     AudioPlayer* audioPlayer;
 
 
-	std::vector<Model*> models;
+    // Owns every model of the scene
+    EntityStore entities;
+
+    // World boxes of everything the camera can bump into or pick up
+    SpatialHash broadphase;
+    // Instances of the model BVHs, for gaze ray casts
+    SceneBvh scene;
+    // Per cell of the walkable area, the static models that can be seen from it
+    PotentiallyVisibleSet pvs;
 
     std::vector<std::vector<float>> modelPos;
 
-	Model* herobrineModel = nullptr;
+    // The hand placed part of the world around the origin: the cabin, the diamonds and the PVS
+    // cover this square, the streamed chunks reach out to worldHalfSize
+    float clearingHalfSize = 200.0f;
+    // Diamond layout in the clearing, tree chunks derive their seeds from it. The same seed
+    // always places them the same way.
+    uint32_t scatterSeed = 1;
+    PoissonScatter scatter;
+    // Where in the world Herobrine teleports to, seeded so the same input plays out the same way
+    std::mt19937 gameplayRandom{ scatterSeed };
+
+    // 60 simulation steps per second, rendering runs as fast as it can in between
+    FrameClock frameClock;
+
+    // Streams the scene in while the first frames already render
+    AssetLoader loader;
+    Task<> sceneLoad;
+    std::chrono::steady_clock::time_point startTime;
+    bool firstFrameShown = false;
+
+    // The trees and the ground of the world around the clearing, streamed around the camera.
+    // The world is 100 times the area of the old fixed square.
+    float worldHalfSize = 2000.0f;
+    // Every streamed tree is an instance of treeTemplate. The streamer copies the ground once.
+    std::shared_ptr<Model> treeTemplate;
+    std::unique_ptr<Model> groundTemplate;
+    ChunkStreamer chunks;
+
+    EntityHandle herobrineEntity;
 };
 
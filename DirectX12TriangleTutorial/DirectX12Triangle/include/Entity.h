@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+// Names an entity of an EntityStore. The generation tells a destroyed entity apart from a newer
+// one that reuses its slot, so a stale handle simply finds nothing.
+struct EntityHandle {
+    uint32_t index = 0xFFFFFFFFu;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return index != 0xFFFFFFFFu; }
+    bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+enum EntityFlags : uint32_t {
+    EntityRemovable = 1u << 0, // picked up when the camera walks into it, never collided with
+    EntityStatic = 1u << 1,    // never moves, e.g. baked into the PVS
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "Entity.h"
+#include "Model.h"
+#include "TransformGraph.h"
+
+// What happened to the entities since the last EntityStore::TakeChanges. A handle can be in
+// created and destroyed both, it is dead then.
+struct EntityChanges {
+    std::vector<EntityHandle> created;
+    std::vector<EntityHandle> destroyed;
+    std::vector<EntityHandle> moved;
+
+    bool IsEmpty() const { return created.empty() && destroyed.empty() && moved.empty(); }
+};
+
+// Trigger volume of an entity that is picked up (EntityRemovable), as margins around its world
+// bounds. Kept apart from the bounds, so culling never sees it and a Sync can't lose it.
+struct PickupExtent {
+    float horizontal = 0.0f; // added on every side in X and Z
+    float below = 0.0f;
+    float above = 0.0f;
+};
+
+// Owns the models of the scene and keeps their per-frame components in packed arrays: the mesh
+// (the Model), its world and normal matrix, world bounds and flags, all at the same dense index.
+// Systems walk those arrays instead of chasing a pointer per model.
+//
+// An entity can hang below another one (a prop carried by a character). The model's own
+// transform is then relative to the parent, the TransformGraph places it in the world when
+// UpdateTransforms runs.
+//
+// Entities are named by generational handles. Destroying one moves the last entity into its
+// place, so removal is O(1) and the arrays stay packed. Iteration order only changes by those
+// moves and is the same for the same sequence of creates and destroys.
+class EntityStore {
+public:
+    static constexpr uint32_t InvalidIndex = 0xFFFFFFFFu;
+
+    EntityStore() = default;
+    ~EntityStore();
+    EntityStore(const EntityStore&) = delete;
+    EntityStore& operator=(const EntityStore&) = delete;
+
+    // Takes ownership of the model, its transform and world bounds b should be set already.
+    // Below a parent, the model's transform is relative to the parent's world matrix.
+    EntityHandle Create(Model* model, uint32_t flags = 0, EntityHandle parent = EntityHandle());
+    // Deletes the model and the entities below it, false for stale handles
+    bool Destroy(EntityHandle entity);
+    void Clear();
+
+    bool IsAlive(EntityHandle entity) const { return IndexOf(entity) != InvalidIndex; }
+    // Dense index of a live entity, InvalidIndex otherwise. Changes when another entity is destroyed.
+    uint32_t IndexOf(EntityHandle entity) const;
+    // Null for stale handles
+    Model* GetModel(EntityHandle entity) const;
+    bool HasFlags(EntityHandle entity, uint32_t flags) const;
+
+    // World bounds widened by the pickup extent, empty for stale handles
+    void SetPickupExtent(EntityHandle entity, const PickupExtent& extent);
+    BoundingBox GetPickupBounds(EntityHandle entity) const;
+
+    // Moves the model and refreshes its packed world matrix and bounds. Entities below it
+    // follow with the next UpdateTransforms.
+    void SetPosition(EntityHandle entity, const DirectX::XMFLOAT3& position);
+    // Copies the world matrix and bounds of the model, after it was changed directly
+    void Sync(EntityHandle entity);
+    // Propagates the moves since the last call down the hierarchy and refreshes the packed
+    // normal matrices, once per frame before anything reads them
+    void UpdateTransforms();
+    const TransformGraph& GetTransforms() const { return transforms; }
+
+    // Packed components, index i of each belongs to the same entity
+    size_t Size() const { return models.size(); }
+    const std::vector<Model*>& GetModels() const { return models; }
+    const std::vector<DirectX::XMFLOAT4X4>& GetWorlds() const { return worlds; }
+    // Inverse transpose of the world matrices, current as of the last UpdateTransforms
+    const std::vector<DirectX::XMFLOAT4X4>& GetNormalMatrices() const { return normalMatrices; }
+    const std::vector<BoundingBox>& GetBounds() const { return bounds; }
+    const std::vector<uint32_t>& GetFlags() const { return flags; }
+    const std::vector<EntityHandle>& GetHandles() const { return handles; }
+
+    // Hands the recorded changes to whoever mirrors the store (the renderer) and starts over
+    EntityChanges TakeChanges();
+
+private:
+    void SyncAt(uint32_t index);
+    void DestroyAt(uint32_t index);
+
+    // Dense, one entry per live entity
+    std::vector<Model*> models;
+    std::vector<DirectX::XMFLOAT4X4> worlds;
+    std::vector<DirectX::XMFLOAT4X4> normalMatrices;
+    std::vector<uint32_t> nodes; // in transforms
+    std::vector<BoundingBox> bounds;
+    std::vector<uint32_t> flags;
+    std::vector<PickupExtent> pickupExtents;
+    std::vector<EntityHandle> handles;
+
+    // Sparse, per slot of a handle
+    std::vector<uint32_t> denseIndices; // InvalidIndex while the slot is free
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeSlots;
+
+    TransformGraph transforms;
+    std::vector<EntityHandle> nodeEntities; // per transform node
+    std::vector<uint32_t> removedNodes;     // scratch of Destroy
+
+    EntityChanges changes;
+};
@@ -63,4 +63,66 @@ inline std::ifstream OpenAssetFile(const std::string& assetName) { //TODO: deal
 		std::cerr << "Failed to open asset file: " << path << std::endl;
 	}
 	return file;
-}
\ No newline at end of file
+}
+
+// Read-only memory mapping of a whole file. The view stays valid as long as the object lives.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path) {
+		Close();
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			Close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			Close();
+			return false;
+		}
+		view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			Close();
+			return false;
+		}
+		size = static_cast<size_t>(fileSize.QuadPart);
+		return true;
+	}
+
+	void Close() {
+		if (view) UnmapViewOfFile(view);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		view = nullptr;
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+		size = 0;
+	}
+
+	bool IsOpen() const { return view != nullptr; }
+	const unsigned char* Data() const { return static_cast<const unsigned char*>(view); }
+	size_t Size() const { return size; }
+
+private:
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	const void* view = nullptr;
+	size_t size = 0;
+};
+
+inline bool MapAssetFile(const std::string& assetName, MappedFile& outFile) {
+	std::string path = GetAssetPath(assetName);
+	if (!outFile.Open(path)) {
+		std::cerr << "Failed to map asset file: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
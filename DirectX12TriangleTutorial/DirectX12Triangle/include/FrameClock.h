@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+struct FrameClockStats {
+    unsigned int frames = 0;
+    unsigned int steps = 0;
+    // Steps the clock skipped because a frame took longer than maxStepsPerFrame steps
+    unsigned int droppedSteps = 0;
+    // Real time between the starts of two frames
+    float frameMs = 0.0f;      // average
+    float worstFrameMs = 0.0f;
+    // What one simulation step cost
+    float stepMs = 0.0f;       // average
+    float worstStepMs = 0.0f;
+};
+
+// Drives a fixed-step simulation from a high resolution clock. Every frame Advance adds the real
+// time since the last frame to an accumulator and returns how many whole steps it holds, the
+// simulation then runs that many steps of GetStep seconds each. What it does per step doesn't
+// depend on the display rate, a 30 Hz and a 240 Hz display step it the same way.
+//
+// The accumulator counts integer nanoseconds times the step rate, so frames that add up to the
+// same time always add up to the same steps. Seconds in a double didn't: 144 frames of 1/144 s
+// left the accumulator just short of the 60th step.
+//
+// What is left in the accumulator, as a fraction of a step, is GetAlpha: rendering blends the
+// last two simulation states by it, so motion stays smooth when frames and steps don't line up.
+// Only std::chrono, no window or platform calls.
+class FrameClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameClock(unsigned int stepsPerSecond = 60, unsigned int maxStepsPerFrame = 5);
+
+    // Starts over from now, with an empty accumulator
+    void Reset();
+    // Once per frame, the steps to simulate. A frame longer than maxStepsPerFrame steps (a window
+    // drag, a breakpoint) drops the rest, simulating it would make the next frame longer still.
+    unsigned int Advance();
+    // The same for a given frame time, for replays that have to step exactly like a recording
+    unsigned int Advance(std::chrono::nanoseconds frameTime);
+    // Once per step, what it cost, for the stats
+    void AddStepTime(double seconds);
+
+    double GetStep() const { return 1.0 / stepsPerSecond; }
+    // Fraction of a step accumulated but not simulated yet, 0 to 1
+    float GetAlpha() const { return static_cast<float>(static_cast<double>(accumulator) / StepTicks); }
+    // Steps simulated since Reset
+    uint64_t GetStepCount() const { return stepCount; }
+    // Simulation time rendering sees, between the last two steps by GetAlpha
+    double GetTime() const { return stepCount > 0 ? (static_cast<double>(stepCount - 1) + GetAlpha()) * GetStep() : 0.0; }
+
+    // Since the last call
+    FrameClockStats TakeStats();
+
+private:
+    // One step in accumulator ticks, a nanosecond is stepsPerSecond ticks
+    static constexpr uint64_t StepTicks = 1000000000ull;
+
+    unsigned int stepsPerSecond;
+    unsigned int maxStepsPerFrame;
+    uint64_t accumulator = 0;
+    uint64_t stepCount = 0;
+    Clock::time_point lastFrame;
+    bool started = false;
+
+    FrameClockStats stats;
+    double frameSeconds = 0.0;
+    double stepSeconds = 0.0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <DirectXMath.h>
+
+// Strided view over float3 data, e.g. the positions or normals inside an interleaved Vertex array
+struct Float3Span {
+    float* data = nullptr;  // x of the first element
+    size_t count = 0;
+    size_t stride = sizeof(DirectX::XMFLOAT3); // bytes between consecutive elements
+
+    float* At(size_t i) const { return reinterpret_cast<float*>(reinterpret_cast<char*>(data) + i * stride); }
+    Float3Span Subspan(size_t offset) const { return { At(offset), count - offset, stride }; }
+};
+
+// Axis aligned boxes stored as six separate arrays, the layout the box kernels work on
+struct BoxSoA {
+    const float* minX = nullptr;
+    const float* minY = nullptr;
+    const float* minZ = nullptr;
+    const float* maxX = nullptr;
+    const float* maxY = nullptr;
+    const float* maxZ = nullptr;
+    size_t count = 0;
+};
+
+// Batch geometry kernels over position/normal spans.
+// Every kernel has a scalar, SSE4.1, AVX2 and AVX-512 variant; the widest one the CPU and OS
+// support is picked at startup. Results match the scalar path up to float rounding (FMA).
+namespace GeometryKernels {
+
+enum class Isa { Scalar, SSE41, AVX2, AVX512 };
+
+Isa GetSupportedIsa();
+Isa GetIsa();
+// Forces a narrower variant (clamped to what is supported), for comparisons and benchmarks.
+// Not thread safe, call it while no kernels are running.
+void SetIsa(Isa isa);
+const char* GetIsaName(Isa isa);
+
+// p = p * matrix (affine, w = 1)
+void TransformPoints(Float3Span points, const DirectX::XMFLOAT4X4& matrix);
+
+// n = normalize(n * matrix), only the upper 3x3 is used so pass the inverse transpose
+void TransformNormals(Float3Span normals, const DirectX::XMFLOAT4X4& matrix);
+
+// Axis aligned bounds, an empty span yields min = +FLT_MAX and max = -FLT_MAX
+void ComputeBounds(Float3Span points, DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax);
+
+// p = p * scale + offset
+void ScaleTranslate(Float3Span points, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT3& offset);
+
+// Adds cross(p1 - p0, p2 - p0) of every triangle to the normals of its three corners.
+// The unnormalized cross product weights each face by its area.
+void AccumulateFaceNormals(Float3Span positions, const unsigned int* indices, size_t indexCount, Float3Span normals);
+
+// v = normalize(v), zero length vectors are left untouched
+void Normalize(Float3Span vectors);
+
+// Writes the positions of the boxes overlapping [queryMin, queryMax] to outIndices in ascending
+// order and returns how many there are. Touching boxes overlap. outIndices needs boxes.count entries.
+size_t OverlapBoxes(const BoxSoA& boxes, const DirectX::XMFLOAT3& queryMin, const DirectX::XMFLOAT3& queryMax, unsigned int* outIndices);
+
+// Frustum test: writes the positions of the boxes that are not fully behind any of the planes
+// (dot(plane.xyz, p) + plane.w < 0) to outIndices in ascending order and returns how many there
+// are. Conservative, a box near a frustum corner can pass. outIndices needs boxes.count entries.
+size_t CullBoxes(const BoxSoA& boxes, const DirectX::XMFLOAT4* planes, size_t planeCount, unsigned int* outIndices);
+
+// out[i] = a[i] * b[i] for count 4x4 matrices, row vector convention like XMMatrixMultiply.
+// out may be a or b.
+void MultiplyMatrices(const DirectX::XMFLOAT4X4* a, const DirectX::XMFLOAT4X4* b, DirectX::XMFLOAT4X4* out, size_t count);
+
+}
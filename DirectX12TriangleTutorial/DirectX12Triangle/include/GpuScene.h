@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "EntityStore.h"
+#include "Primitives.h"
+
+// GPU work done by the last GpuScene::ApplyChanges
+struct SceneUploadStats {
+    unsigned int created = 0;
+    unsigned int destroyed = 0;
+    unsigned int moved = 0;     // only the per-instance constants of the next frame change
+    unsigned int meshesCreated = 0;
+    unsigned int meshesReleased = 0;
+    uint64_t bufferBytes = 0;   // vertex and index data staged for upload
+    uint64_t textureBytes = 0;  // texture data staged for upload, rows padded to the copy pitch
+};
+
+// Creates and frees the GPU copy of a mesh: its buffers, textures and texture views. The
+// Renderer does this with D3D12, the tests only count the bytes.
+class GpuMeshAllocator {
+public:
+    virtual ~GpuMeshAllocator() = default;
+    // Stages the buffers and textures of model for upload at slot and adds their bytes to stats
+    virtual void CreateMesh(uint32_t slot, const Model& model, SceneUploadStats& stats) = 0;
+    virtual void ReleaseMesh(uint32_t slot) = 0;
+};
+
+// Per-instance MVP constants, a constant buffer view must start on 256 bytes
+constexpr uint64_t InstanceConstantsSize = (sizeof(MVPConstants) + 255) & ~255ull;
+
+// Which GPU mesh every entity of an EntityStore draws with. Entities drawing the same mesh, the
+// same Model or instances of it (Model::CreateInstance), share one mesh slot, it is created
+// with the first of them and released with the last. Only created
+// entities can cost an upload, destroyed ones drop a reference and moved ones cost nothing:
+// their world matrices are read from the store every frame.
+class GpuScene {
+public:
+    static constexpr uint32_t NoMesh = 0xFFFFFFFFu;
+
+    explicit GpuScene(GpuMeshAllocator& allocator) : allocator(allocator) {}
+
+    // Mirrors what changed in the store (EntityStore::TakeChanges). Call between frames.
+    void ApplyChanges(const EntityStore& entities, const EntityChanges& changes);
+
+    // Mesh slot the entity draws with, NoMesh until its creation was applied
+    uint32_t GetMesh(EntityHandle entity) const;
+    // Mesh slots in use or free, the highest slot is below this
+    size_t GetMeshSlotCount() const { return meshes.size(); }
+    // Entity slots seen so far, the highest handle index is below this
+    size_t GetEntitySlotCount() const { return entityMeshes.size(); }
+    const SceneUploadStats& GetStats() const { return stats; }
+
+private:
+    void ReleaseEntity(uint32_t index);
+
+    struct EntityMesh {
+        EntityHandle handle;
+        uint32_t mesh = NoMesh;
+    };
+
+    struct MeshSlot {
+        const Model* model = nullptr; // only the address is used, the model may be gone
+        uint32_t users = 0;
+    };
+
+    GpuMeshAllocator& allocator;
+    std::vector<EntityMesh> entityMeshes; // per slot of a handle
+    std::vector<MeshSlot> meshes;
+    std::vector<uint32_t> freeMeshes;
+    std::unordered_map<const Model*, uint32_t> meshOfModel;
+    SceneUploadStats stats;
+};
@@ -18,6 +18,8 @@ public:
 	void GetDimensions(int& outWidth, int& outHeight) const;
 	void GetPixels(std::vector<Pixel>& outPixels) const;
 	void LoadFromImage(const std::string& filename);
+	// Decodes an encoded image (PNG, JPEG, ...) already in memory, e.g. a texture embedded in a GLB
+	bool LoadFromMemory(const unsigned char* encoded, size_t size);
 	Pixel GetPixel(int x, int y) const;
 	int GetWidth() const { return width; }
 	int GetHeight() const { return height; }
@@ -0,0 +1,31 @@
+#pragma once
+#include <bitset>
+#include <DirectXMath.h>
+
+// Keyboard and mouse as the simulation sees them. The window messages only record into it, the
+// simulation reads it once per step. How far the camera walks then depends on how long a key is
+// held, not on the keyboard repeat rate or on how many messages arrive per frame.
+class InputState {
+public:
+    // Virtual key codes, auto-repeats of a held key change nothing
+    void KeyDown(unsigned int key) { if (key < keys.size()) keys.set(key); }
+    void KeyUp(unsigned int key) { if (key < keys.size()) keys.reset(key); }
+    bool IsDown(unsigned int key) const { return key < keys.size() && keys.test(key); }
+    // When the window loses focus, the keys released elsewhere never send key up
+    void ReleaseAll() { keys.reset(); }
+
+    // Adds up until the simulation takes it, no movement gets lost between steps
+    void MouseMove(float dx, float dy) {
+        mouseDelta.x += dx;
+        mouseDelta.y += dy;
+    }
+    DirectX::XMFLOAT2 TakeMouseDelta() {
+        const DirectX::XMFLOAT2 delta = mouseDelta;
+        mouseDelta = { 0.0f, 0.0f };
+        return delta;
+    }
+
+private:
+    std::bitset<256> keys;
+    DirectX::XMFLOAT2 mouseDelta = { 0.0f, 0.0f };
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// Counts the unfinished jobs started with it. JobSystem::Wait returns once it is zero and jobs
+// that depend on it start then. Destroy it only after Wait returned, IsDone alone doesn't mean
+// the last job let go of it.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> pending{ 0 };
+    mutable std::mutex waitersMutex;
+    std::vector<Job*> waiters; // jobs depending on this counter
+};
+
+// Chase-Lev deque (Le, Pop, Cohen, Zappa Nardelli 2013). Its owner pushes and pops at the
+// bottom, other threads steal from the top. The ring grows, old rings are kept until the deque
+// goes away since a thief may still read from one.
+class WorkStealingDeque {
+public:
+    WorkStealingDeque();
+    ~WorkStealingDeque();
+
+    // Owner only
+    void Push(Job* job);
+    Job* Pop();
+    // Any thread, null when empty or when another thread won the race
+    Job* Steal();
+
+    bool IsEmpty() const;
+
+private:
+    struct Ring {
+        explicit Ring(int64_t capacity) : capacity(capacity), items(new std::atomic<Job*>[capacity]) {}
+        std::atomic<Job*>& At(int64_t i) { return items[i & (capacity - 1)]; }
+        int64_t capacity; // power of two
+        std::unique_ptr<std::atomic<Job*>[]> items;
+    };
+
+    std::atomic<int64_t> top{ 0 };
+    std::atomic<int64_t> bottom{ 0 };
+    std::atomic<Ring*> ring;
+    std::vector<std::unique_ptr<Ring>> rings; // the current one last
+};
+
+// Work stealing job system on std::thread. Every worker and the thread that created the system
+// (the main thread) owns a deque: new jobs go to the bottom of the deque of the thread that
+// starts them and idle workers steal from the top of the others. Other threads hand their jobs
+// in through a shared queue. Jobs may start jobs and wait for them, a waiting thread runs jobs
+// meanwhile instead of blocking.
+//
+// Jobs must not throw.
+class JobSystem {
+public:
+    // Workers next to the calling thread, by default one less than there are hardware threads.
+    // Created on the main thread of another system, it takes that thread over until destroyed.
+    explicit JobSystem(unsigned int workers = DefaultWorkerCount());
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Shared by the engine, created by the first call which makes that thread the main thread
+    static JobSystem& Get();
+    static unsigned int DefaultWorkerCount();
+
+    // Starts job right away, or once dependency is done. counter, if given, counts it until it
+    // returned.
+    void Run(std::function<void()> job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    // Same, but the job only runs on the main thread, in Wait or PumpMainThread
+    void RunOnMainThread(std::function<void()> job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    // Runs other jobs until counter is done
+    void Wait(const JobCounter& counter);
+    // Runs the queued main thread jobs, call once per frame. Does nothing on other threads.
+    void PumpMainThread();
+
+    // Calls body(begin, end) on disjoint ranges covering [0, count) and returns when all are done.
+    // Ranges are only split off while other threads are out of work (lazy binary splitting), so
+    // a balanced loop costs about one job per thread and an unbalanced one still spreads out.
+    // No range is shorter than minGrain unless count is.
+    void ParallelFor(size_t count, const std::function<void(size_t, size_t)>& body, size_t minGrain = 1);
+
+    // Threads that run jobs, the workers plus the main thread
+    unsigned int GetThreadCount() const { return static_cast<unsigned int>(deques.size()); }
+    bool IsMainThread() const { return std::this_thread::get_id() == mainThread; }
+
+private:
+    void Schedule(Job* job);
+    void Enqueue(Job* job);
+    Job* FindJob();
+    Job* TakeMainThreadJob();
+    void Execute(Job* job);
+    void WorkerLoop(unsigned int index);
+    void ParallelForRange(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body, JobCounter& counter);
+    // Index of the calling thread's deque, -1 for threads the system doesn't know
+    int ThreadIndex() const;
+
+    std::thread::id mainThread;
+    // System the creating thread ran jobs for before, it does again once this one is gone
+    const JobSystem* outerSystem = nullptr;
+    int outerIndex = -1;
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques; // main thread first
+    std::vector<std::thread> workers;
+
+    std::mutex injectMutex;
+    std::vector<Job*> injected; // from threads without a deque
+
+    std::mutex mainMutex;
+    std::vector<Job*> mainJobs;
+
+    // Idle workers sleep until a job is queued
+    std::atomic<int64_t> queued{ 0 };
+    std::atomic<int> sleeping{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{ false };
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+
+// Minimal DOM style JSON reader, enough for glTF. Lookups of missing keys/indices
+// return a shared null value so chains like json["a"][0]["b"] never throw.
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    static bool Parse(const char* text, size_t length, JsonValue& out, std::string* error = nullptr);
+
+    Type GetType() const { return type; }
+    bool IsNull() const { return type == Type::Null; }
+    bool IsNumber() const { return type == Type::Number; }
+    bool IsString() const { return type == Type::String; }
+    bool IsArray() const { return type == Type::Array; }
+    bool IsObject() const { return type == Type::Object; }
+
+    bool Has(const std::string& key) const { return Find(key) != nullptr; }
+    const JsonValue* Find(const std::string& key) const;
+    const JsonValue& operator[](const std::string& key) const;
+    const JsonValue& operator[](size_t index) const;
+    size_t Size() const { return type == Type::Array ? array.size() : type == Type::Object ? members.size() : 0; }
+
+    bool AsBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+    double AsNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+    float AsFloat(float fallback = 0.0f) const { return type == Type::Number ? static_cast<float>(number) : fallback; }
+    int AsInt(int fallback = 0) const { return type == Type::Number ? static_cast<int>(number) : fallback; }
+    size_t AsSize(size_t fallback = 0) const { return type == Type::Number && number >= 0.0 ? static_cast<size_t>(number) : fallback; }
+    const std::string& AsString() const;
+
+    const std::vector<JsonValue>& Elements() const { return array; }
+    const std::vector<std::pair<std::string, JsonValue>>& Members() const { return members; }
+
+private:
+    friend class JsonParser;
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> members;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include "Primitives.h"
+
+struct MeshCleanupOptions {
+    // Positions closer than this are merged, 0 only merges bit identical positions
+    float weldTolerance = 1e-5f;
+    // Vertices on a UV or normal seam are kept apart, within these tolerances they still merge
+    float uvTolerance = 1e-5f;
+    float normalTolerance = 1e-3f; // 1 - cos(angle between the normals)
+
+    bool removeDegenerateTriangles = true;
+    bool removeDuplicateTriangles = true;
+};
+
+struct MeshCleanupStats {
+    unsigned int weldedVertices = 0;
+    unsigned int unusedVertices = 0;
+    unsigned int degenerateTriangles = 0;
+    unsigned int duplicateTriangles = 0;
+
+    unsigned int RemovedVertices() const { return weldedVertices + unusedVertices; }
+    unsigned int RemovedTriangles() const { return degenerateTriangles + duplicateTriangles; }
+};
+
+// Welds near-identical vertices with a grid hash, drops degenerate and duplicate triangles and
+// compacts the vertex buffer to the vertices still referenced (in first use order).
+// Every array in faceAttributes with one entry per triangle is compacted along with the triangles.
+MeshCleanupStats CleanupMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    const std::vector<std::vector<unsigned int>*>& faceAttributes, const MeshCleanupOptions& options = {});
@@ -8,8 +8,16 @@
 #include <sstream>
 #include <string>
 #include <map>
+#include <memory>
+#include <functional>
 #include "Primitives.h"
 #include "Image.h"
+#include "GeometryKernels.h"
+#include "NormalGenerator.h"
+#include "MeshCleanup.h"
+#include "ConvexDecomposition.h"
+#include "Bvh.h"
+#include "Entity.h"
 
 struct BoundingBox {
     float minX;
@@ -28,10 +36,18 @@ struct BoundingBox {
         maxY = max_Y;
     }
 
-    bool Intersects(BoundingBox one, BoundingBox two) {
-        return (one.minX <= two.minX && one.maxX >= two.maxX) &&
-            (one.minZ <= two.minZ && one.maxZ >= two.maxZ) &&
-            (one.minY <= two.minY && one.maxY >= two.maxY);
+    // Overlap test, boxes that only touch overlap too
+    bool Intersects(const BoundingBox& other) const {
+        return minX <= other.maxX && maxX >= other.minX &&
+            minZ <= other.maxZ && maxZ >= other.minZ &&
+            minY <= other.maxY && maxY >= other.minY;
+    }
+
+    // True when other lies completely inside this box
+    bool Contains(const BoundingBox& other) const {
+        return minX <= other.minX && maxX >= other.maxX &&
+            minZ <= other.minZ && maxZ >= other.maxZ &&
+            minY <= other.minY && maxY >= other.maxY;
     }
 };
 
@@ -41,67 +57,223 @@ struct Material {
 	DirectX::XMFLOAT3 specular = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);  // Ks
 	float shininess = 32.0f;             // Ns
 	std::string diffuseMap = "";      // map_Kd
+	bool alphaTested = false;         // map_d or a glTF alpha mode, the texture can have holes
 	bool initialized = false;
 	Image textureImage;
+	bool embeddedTexture = false; // decoded from the model file itself, e.g. a GLB buffer view
+
+	// glTF metallic-roughness parameters, the terms above are derived from them on import
+	DirectX::XMFLOAT4 baseColor = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	float metallic = 0.0f;
+	float roughness = 1.0f;
+	DirectX::XMFLOAT3 emissive = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+};
+
+// Materials of one MTL file. Parsing leaves the textures alone, they are only named by diffuseMap.
+struct MaterialLibrary {
+	std::vector<std::string> names; // per material
+	std::vector<Material> materials;
+
+	void Parse(std::istream& file);
+};
+
+// Contiguous run of indices drawn with a single material
+struct DrawRange {
+    unsigned int startIndex;
+    unsigned int indexCount;
+    unsigned int materialIndex;
+};
+
+// Index range of a single material within a group, see Model::SortByMaterial
+struct SubMesh {
+    unsigned int startIndex;
+    unsigned int indexCount;
+    unsigned int materialIndex;
+    unsigned int groupIndex;
+    BoundingBox bounds; // model space
+};
+
+// An OBJ object/group ("o"/"g"). Its faces are contiguous in the index buffer and
+// split into sub-meshes by material, all bounds are in model space.
+struct MeshGroup {
+    std::string name;
+    unsigned int startIndex;
+    unsigned int indexCount;
+    unsigned int firstSubMesh;
+    unsigned int subMeshCount;
+    unsigned int firstMeshlet;
+    unsigned int meshletCount;
+    BoundingBox bounds;
+    DirectX::XMFLOAT3 center;
+    float radius;
+};
+
+// Small cluster of triangles that is culled as a unit.
+// Its triangles are contiguous in the index buffer, so a meshlet is also a draw range.
+struct Meshlet {
+    unsigned int startIndex;
+    unsigned int indexCount;
+    unsigned int vertexCount;
+    unsigned int materialIndex;
+
+    // Bounding sphere (model space)
+    DirectX::XMFLOAT3 center;
+    float radius;
+
+    // Normal cone (model space), a cutoff >= 1 means the cone is too wide to cull
+    DirectX::XMFLOAT3 coneApex;
+    DirectX::XMFLOAT3 coneAxis;
+    float coneCutoff;
 };
 
 class Model {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<unsigned int> materialIndices;
+    std::vector<unsigned int> smoothingGroups; // per face, empty when the file has no "s" records
+    std::vector<unsigned int> groupIndices; // per face, into groupNames
+    std::vector<std::string> groupNames;
+    std::vector<MeshGroup> groups;
     std::map<std::string, unsigned int> materialMap;
     std::vector<Material> materials;
     std::vector<std::string> materialNames;
+    std::vector<SubMesh> subMeshes;
+    std::vector<Meshlet> meshlets;
+    std::vector<ConvexHull> collisionHulls; // model space
+    TriangleBvh bvh; // model space, cleared whenever the index buffer is rewritten
+    std::vector<unsigned int> occluderIndices; // opaque faces, cleared with the bvh
+    // Holds the geometry of an instance, whose own buffers above stay empty
+    std::shared_ptr<Model> meshSource;
 
     // Transformation properties
     DirectX::XMFLOAT3 position = { 0.0f, 0.0f, 0.0f };
     DirectX::XMFLOAT3 rotation = { 0.0f, 0.0f, 0.0f }; // Euler angles in radians
     DirectX::XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
 
-    
+    // Cached S * R * T, rebuilt by the setters so moving a model is O(1)
+    DirectX::XMFLOAT4X4 localMatrix = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f };
+    // World matrix of the entity the model hangs below, identity for the others
+    DirectX::XMFLOAT4X4 parentMatrix = localMatrix;
+    // localMatrix * parentMatrix
+    DirectX::XMFLOAT4X4 worldMatrix = localMatrix;
+
+    // Rest pose bounds, the vertices are never rewritten by a transform change
+    BoundingBox localBounds = {};
+
+    void UpdateWorldTransform();
+
+    // Strided views over the interleaved vertices for the GeometryKernels
+    Float3Span PositionSpan() { return vertices.empty() ? Float3Span{} : Float3Span{ &vertices[0].position.x, vertices.size(), sizeof(Vertex) }; }
+    Float3Span NormalSpan() { return vertices.empty() ? Float3Span{} : Float3Span{ &vertices[0].normal.x, vertices.size(), sizeof(Vertex) }; }
 
 public:
+    // A model drawing the mesh of source without copying it. Vertices, indices, materials,
+    // meshlets, hulls, occluder and BVH stay source's and are shared by all its instances, only
+    // the transform (copied from source) and the bounds are the instance's own. Loading or
+    // editing the mesh goes through source, UpdateTextures reloads the shared textures.
+    static std::unique_ptr<Model> CreateInstance(std::shared_ptr<Model> source);
+    // The model whose geometry this one draws, itself unless it is an instance
+    const Model& GetMesh() const { return meshSource ? *meshSource : *this; }
+    bool IsInstance() const { return meshSource != nullptr; }
+
     void UpdateTextures();
     bool LoadFromObj(const std::string& path);
+    // OBJ already in memory, loadMaterials is called for every mtllib line and is expected to
+    // AddMaterials before the faces using them come up
+    bool LoadFromObj(std::istream& file, const std::function<void(const std::string&)>& loadMaterials);
+    bool LoadFromGltf(const std::string& path); // .gltf with external or data: buffers, or .glb
+    bool LoadFrom3ds(const std::string& path);
+    // Picks the loader from the file extension
+    bool LoadFromFile(const std::string& path);
 	void LoadMTL(const std::string& path);
+	// Appends the materials of a parsed MTL file, as LoadMTL does after decoding its textures
+	void AddMaterials(const MaterialLibrary& library);
+	// Every material sampling diffuseMap gets the decoded image
+	void AssignTexture(const std::string& diffuseMap, const Image& image);
 	void MinMax(float& minX, float& minY, float& minZ, float& maxX, float& maxY, float& maxZ);
 	void Clear();
-	const std::vector<Vertex>& GetVertices() const { return vertices; }
-	const std::vector<unsigned int>& GetIndices() const { return indices; }
+	const std::vector<Vertex>& GetVertices() const { return GetMesh().vertices; }
+	const std::vector<unsigned int>& GetIndices() const { return GetMesh().indices; }
 	void GetPositions(std::vector<DirectX::XMFLOAT3>& outPositions) const;
 	void GetUVs(std::vector<DirectX::XMFLOAT2>& outUVs) const;
 	void GetNormals(std::vector<DirectX::XMFLOAT3>& outNormals) const;
 	unsigned int GetNumFaces() const;
 	unsigned int GetNumVertices() const;
 	unsigned int GetNumIndices() const;
-	void ComputeNormals();
+	void ComputeNormals(const NormalGeneratorOptions& options = {});
+	// Optional pass after loading: welds duplicate vertices and drops degenerate/duplicate faces
+	MeshCleanupStats Cleanup(const MeshCleanupOptions& options = {});
 	void Scale(float scaleFactor);
-	const std::vector<Material>& GetMaterials() const { return materials; }
-	const std::vector<unsigned int>& GetFaceMaterialIndices() const { return materialIndices; }
+	const std::vector<Material>& GetMaterials() const { return GetMesh().materials; }
+	const std::vector<unsigned int>& GetFaceMaterialIndices() const { return GetMesh().materialIndices; }
 
-    // Transformation methods
-    void SetPosition(float x, float y, float z) { position = { x, y, z }; }
-    void SetRotation(float x, float y, float z) { rotation = { x, y, z }; }
-    void SetScale(float x, float y, float z) { scale = { x, y, z }; }
+    // Transformation methods, these only update the world matrix and world bounds
+    void SetPosition(float x, float y, float z) { position = { x, y, z }; UpdateWorldTransform(); }
+    void SetRotation(float x, float y, float z) { rotation = { x, y, z }; UpdateWorldTransform(); }
+    void SetScale(float x, float y, float z) { scale = { x, y, z }; UpdateWorldTransform(); }
     
     DirectX::XMFLOAT3 GetPosition() const { return position; }
     DirectX::XMFLOAT3 GetRotation() const { return rotation; }
     DirectX::XMFLOAT3 GetScale() const { return scale; }
     
     // Get the model's transformation matrix
-    DirectX::XMMATRIX GetModelMatrix() const {
-        DirectX::XMMATRIX S = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
-        DirectX::XMMATRIX R = DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-        DirectX::XMMATRIX T = DirectX::XMMatrixTranslation(position.x, position.y, position.z);
-        return S * R * T;
-    }
-	
-	void ApplyTransformation();
+    DirectX::XMMATRIX GetModelMatrix() const { return DirectX::XMLoadFloat4x4(&worldMatrix); }
+    // Position, rotation and scale alone, relative to the parent
+    const DirectX::XMFLOAT4X4& GetLocalMatrix() const { return localMatrix; }
+    // Placed below a parent by the EntityStore's TransformGraph, world is local * parentWorld as
+    // the graph computed it. The setters keep using parentWorld until it is set again.
+    void SetWorldMatrix(const DirectX::XMFLOAT4X4& parentWorld, const DirectX::XMFLOAT4X4& world);
+
+    const BoundingBox& GetLocalBounds() const { return localBounds; }
+    // World space box around a model space box, e.g. the bounds of a group
+    BoundingBox TransformBounds(const BoundingBox& local) const;
+
+    // Permanently applies the current transform to the vertices and resets it to identity.
+    // Only needed when the rest pose itself should change, moving a model never requires it.
+    void BakeTransformation();
 	void SortByMaterial();
+	const std::vector<SubMesh>& GetSubMeshes() const { return GetMesh().subMeshes; }
+	const std::vector<MeshGroup>& GetGroups() const { return GetMesh().groups; }
+	const std::vector<unsigned int>& GetFaceGroupIndices() const { return GetMesh().groupIndices; }
 
     void ComputeBoundingBox();
 
-    BoundingBox b;
+    static constexpr unsigned int MaxMeshletVertices = 64;
+    static constexpr unsigned int MaxMeshletTriangles = 124;
+
+    // Partition the index buffer into meshlets, never mixing materials within one
+    void BuildMeshlets(unsigned int maxVertices = MaxMeshletVertices, unsigned int maxTriangles = MaxMeshletTriangles);
+    const std::vector<Meshlet>& GetMeshlets() const { return GetMesh().meshlets; }
+
+    // Convex decomposition used for collision. Loaded from cache/<cacheName> next to the executable
+    // when that file was built from the same mesh and options, otherwise built and written there.
+    ConvexDecompositionStats BuildCollisionHulls(const std::string& cacheName = "", const ConvexDecompositionOptions& options = {});
+    const std::vector<ConvexHull>& GetCollisionHulls() const { return GetMesh().collisionHulls; }
+    bool HasCollisionHulls() const { return !GetCollisionHulls().empty(); }
+    // World space sphere against the hulls, placed with the current world matrix
+    bool CollidesWithSphere(const DirectX::XMFLOAT3& center, float radius) const;
 
-	bool isRemovable = false;
+    // Triangle BVH for ray casts, instanced into the world by SceneBvh. Build it once the
+    // geometry is final, loading, Cleanup, Scale and BakeTransformation drop it again.
+    void BuildBvh() { bvh.Build(vertices, indices); }
+    const TriangleBvh& GetBvh() const { return GetMesh().bvh; }
+
+    // Triangles the OcclusionCuller may rasterize: every face of an opaque material and the faces
+    // of alpha tested ones whose texels all pass the shader's alpha cutoff, e.g. the trunk of a
+    // tree whose leaves share its material. Build it like the BVH, once the geometry is final.
+    void BuildOccluder(float alphaCutoff = 0.1f);
+    const std::vector<unsigned int>& GetOccluderIndices() const { return GetMesh().occluderIndices; }
+
+    // World space bounds, derived from the local bounds and the world matrix
+    BoundingBox b;
+    // Proxy of b in the scene broadphase, the owner of the SpatialHash keeps it up to date
+    unsigned int broadphaseProxy = 0xFFFFFFFFu;
+    // Slot in the baked PotentiallyVisibleSet, models that move around have none
+    unsigned int pvsIndex = 0xFFFFFFFFu;
+    // Set by the EntityStore that owns the model, its flags and packed components live there
+    EntityHandle entity;
 };
\ No newline at end of file
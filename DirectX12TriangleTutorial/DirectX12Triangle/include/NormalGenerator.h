@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include "Primitives.h"
+
+struct NormalGeneratorOptions {
+    enum class Weighting {
+        Area,   // large faces dominate, cheapest
+        Angle   // each face counts by the corner angle, independent of tessellation
+    };
+    Weighting weighting = Weighting::Angle;
+
+    // Faces whose normals differ by more than this (radians) get a hard edge between them.
+    // Anything >= pi smooths every face that shares a position.
+    float creaseAngle = DirectX::XM_PI / 3.0f;
+
+    // Only faces with the same non-zero smoothing group are smoothed together, group 0 is flat.
+    // Ignored when no per-face groups are passed in.
+    bool useSmoothingGroups = true;
+    // The groups are bitmasks of up to 32 groups per face (3DS) rather than ids (OBJ "s"),
+    // faces that share any bit are smoothed together
+    bool smoothingGroupMasks = false;
+};
+
+struct NormalGeneratorStats {
+    unsigned int uniquePositions = 0;
+    unsigned int splitVertices = 0; // vertices added to carry a hard edge
+};
+
+// Generates smooth vertex normals for an indexed triangle list.
+// Corners are smoothed across every vertex that shares a position (so UV seams don't show in the
+// lighting) and split into separate vertices only where a crease or smoothing group boundary needs it.
+// faceSmoothingGroups has one entry per triangle or is empty.
+NormalGeneratorStats GenerateNormals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    const std::vector<unsigned int>& faceSmoothingGroups, const NormalGeneratorOptions& options = {});
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "Model.h"
+
+struct OcclusionCullStats {
+    unsigned int occluders = 0;
+    unsigned int triangles = 0; // occluder triangles left after clipping and backface culling
+    unsigned int tested = 0;
+    unsigned int occluded = 0;
+};
+
+// Masked software occlusion culling (Hasselgren, Andersson, Akenine-Moller). A few large occluders
+// are rasterized on the CPU into a small depth buffer of 32x8 pixel tiles. Each tile holds eight
+// 8x4 subtiles, one per AVX2 lane, and a subtile keeps only two depths: a reference depth for all
+// of its pixels and a closer working depth with a coverage mask.
+//
+// Depth is conservative, a stored depth is never closer than the occluders at that pixel, and a
+// box is tested against every subtile its screen rectangle touches. Coverage is not: it is sampled
+// at the pixel centers of the coarse buffer, so an occluder sliver or a crack narrower than a
+// coarse pixel can hide a box that shows through between the samples. Rasterizing only pixels
+// fully inside a triangle would close that gap, but it leaves the shared edges of adjacent
+// triangles uncovered too and most subtiles would never fill up.
+//
+// Depths are 1 / w, larger is closer. Tile rows are rasterized in parallel.
+class OcclusionCuller
+{
+public:
+    static constexpr unsigned int TileWidth = 32;
+    static constexpr unsigned int TileHeight = 8;
+
+    OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+    // Needs AVX2, without it nothing is rasterized and every box is reported visible
+    static bool IsSupported();
+
+    // Rounded up to whole tiles
+    void SetResolution(unsigned int width, unsigned int height);
+
+    // Call once per frame, clears the depth buffer and the queued occluders
+    void BeginFrame(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos);
+    // Queues the occluder triangles of a model (Model::BuildOccluder), models without any are ignored
+    void AddOccluder(const Model& model);
+    // Rasterizes the maxOccluders queued models closest to the camera
+    void Rasterize();
+
+    // World space box or sphere against the occluders. Thread safe once Rasterize returned.
+    bool IsOccluded(const BoundingBox& box) const;
+    bool IsOccluded(const DirectX::XMFLOAT3& center, float radius) const;
+
+    // Drops the hidden models from visible, indices into models as SceneCuller::Cull returns them
+    void Cull(const std::vector<Model*>& models, std::vector<unsigned int>& visible);
+
+    const OcclusionCullStats& GetStats() const { return stats; }
+    unsigned int GetWidth() const { return width; }
+    unsigned int GetHeight() const { return height; }
+
+    // Occluders cost triangle setup and raster time, the nearest ones hide the most
+    unsigned int maxOccluders = 24;
+
+private:
+    struct Tile {
+        float zMin[2][8];  // reference and working layer per subtile
+        uint32_t mask[8];  // coverage of the working layer, one bit per pixel of the subtile
+    };
+
+    // Setup of a screen space triangle. On a pixel row y every edge either bounds the covered
+    // span from the left (x >= k * y + m), from the right (x <= k * y + m) or, when horizontal,
+    // keeps the whole row only if k * y + m >= 0.
+    enum EdgeSide { EdgeHorizontal, EdgeLeft, EdgeRight };
+    struct ScreenTriangle {
+        float k[3], m[3];
+        EdgeSide side[3];
+        float zx, zy, z0;  // 1 / w = zx * x + zy * y + z0
+        float zFarthest;   // smallest 1 / w of the corners
+        int tileMinX, tileMaxX, tileMinY, tileMaxY;
+    };
+
+    void SetupTriangle(const DirectX::XMFLOAT4& c0, const DirectX::XMFLOAT4& c1, const DirectX::XMFLOAT4& c2);
+    void ClipAndSetup(const DirectX::XMFLOAT4& c0, const DirectX::XMFLOAT4& c1, const DirectX::XMFLOAT4& c2);
+    void RasterizeTileRow(unsigned int row);
+    bool ProjectBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, float rect[4], float& zNearest) const;
+    bool IsRectOccluded(const float rect[4], float zNearest) const;
+
+    unsigned int width = 0, height = 0;
+    unsigned int tilesX = 0, tilesY = 0;
+    std::vector<Tile> tiles;
+
+    DirectX::XMFLOAT4X4 viewProj = {};
+    DirectX::XMFLOAT3 cameraPos = { 0.0f, 0.0f, 0.0f };
+    std::vector<const Model*> occluders;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<std::vector<unsigned int>> rowBins; // triangles touching each tile row
+    std::vector<DirectX::XMFLOAT4> clipVertices;    // scratch
+    OcclusionCullStats stats;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "Model.h"
+
+struct PvsOptions {
+    float cellSize = 10.0f;
+    unsigned int samplesPerAxis = 3;  // eye positions per cell along x and z, on the cell border and inside
+    float minEyeY = 2.0f;             // eye heights the camera reaches walking on the ground at y = 0
+    float maxEyeY = 8.0f;
+    unsigned int heightSamples = 2;
+    unsigned int resolution = 64;     // of each cube map face
+};
+
+struct PvsStats {
+    unsigned int cells = 0;
+    unsigned int objects = 0;
+    unsigned int uniqueRows = 0;    // distinct visibility bitsets, cells with the same one share it
+    float averageVisible = 0.0f;    // objects per cell
+    bool loadedFromCache = false;   // the other counts are still filled in
+};
+
+// Baked potentially visible sets over a grid of XZ cells. From eye positions sampled in every
+// cell, the occluders (models with occluder triangles, see Model::BuildOccluder) are rasterized
+// into a cube map with the OcclusionCuller and every object box is tested against it. A cell
+// keeps one bit per object that was seen from any of its eye positions.
+//
+// Only meant for models that stay where they are. Each baked model gets a pvsIndex, models without
+// one (Herobrine) are never rejected. Sampled, so a sliver seen only between the sample positions
+// can be missed, the object boxes are padded by half the sample spacing to make that rare.
+class PotentiallyVisibleSet {
+public:
+    // Loads cache/<cacheName> next to the executable when it was baked from the same layout and
+    // options, otherwise bakes (cells in parallel) and writes it there. Assigns Model::pvsIndex.
+    PvsStats Build(const std::vector<Model*>& models, float minX, float minZ, float maxX, float maxZ,
+        const std::string& cacheName = "", const PvsOptions& options = {});
+    void Clear();
+
+    // Cell containing the XZ position of p, -1 outside the grid
+    int GetCell(const DirectX::XMFLOAT3& p) const;
+    // True outside the grid and for models the set doesn't know
+    bool IsVisible(int cell, unsigned int pvsIndex) const;
+
+    bool IsEmpty() const { return cellRows.empty(); }
+    unsigned int GetCellCount() const { return static_cast<unsigned int>(cellRows.size()); }
+
+    static constexpr unsigned int NoIndex = 0xFFFFFFFFu;
+
+private:
+    void Bake(const std::vector<Model*>& models, const PvsOptions& options);
+    bool Save(const std::string& path, uint64_t key) const;
+    bool Load(const std::string& path, uint64_t key);
+    PvsStats GetStats() const;
+
+    float minX = 0.0f, minZ = 0.0f;
+    float cellSize = 1.0f;
+    int cellsX = 0, cellsZ = 0;
+    unsigned int objectCount = 0;
+    unsigned int wordsPerRow = 0;
+    std::vector<uint64_t> rows;      // wordsPerRow words per distinct bitset
+    std::vector<uint32_t> cellRows;  // per cell, index of its bitset
+};
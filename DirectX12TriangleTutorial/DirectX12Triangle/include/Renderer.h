@@ -8,10 +8,15 @@
 #include <vector>
 #include "Primitives.h"
 #include "Camera.h"
+#include "Culling.h"
+#include "OcclusionCuller.h"
+#include "Pvs.h"
+#include "EntityStore.h"
+#include "GpuScene.h"
 
 using Microsoft::WRL::ComPtr;
 
-class Renderer
+class Renderer : private GpuMeshAllocator
 {
 public:
     Renderer(HWND hwnd, int width, int height);
@@ -19,18 +24,30 @@ public:
 
     void Init();
     void Update();
-    void Render();
+    // Looks from the camera blended alpha of the way through the last simulation step, time is
+    // the simulation time in seconds and drives the flashlight
+    void Render(float alpha, double time);
 
     void HandleForward(float dir);
     void HandleX(float dir);
     void HandleMouseMove(float deltaX, float deltaY);
 
-    void BindModels(const std::vector<Model*>& models);
+    // The packed models, world matrices and bounds of the store are read every frame
+    void BindEntities(const EntityStore& entities);
+    // Mirrors what changed in the bound store (EntityStore::TakeChanges) on the GPU, see GpuScene.
+    // New meshes are staged here and copied at the start of the next Render. Call between frames.
+    void ApplyChanges(const EntityChanges& changes);
+    const SceneUploadStats& GetUploadStats() const { return gpuScene.GetStats(); }
     void RenderModel(Model* model, int modelIndex);
-    void CreateAssets();
-    void CreateTextureResources();
 
     Camera c;
+    // Baked visibility of the static models, owned by the engine
+    const PotentiallyVisibleSet* pvs = nullptr;
+
+    // Culling counters of the last rendered frame
+    const SceneCullStats& GetSceneCullStats() const { return sceneCuller.GetStats(); }
+    const OcclusionCullStats& GetOcclusionCullStats() const { return occlusionCuller.GetStats(); }
+    const ClusterCullStats& GetClusterCullStats() const { return clusterCuller.GetStats(); }
 
 private:
     void InitD3D();
@@ -43,6 +60,46 @@ private:
     void CreateConstBuffer();
     void CreatePipeline();
     void UpdateTextures();
+    void CreateDefaultTexture();
+
+    struct ModelMaterialRange {
+        UINT startIndex;
+        UINT count;
+    };
+
+    // GPU side of a mesh, at its GpuScene mesh slot
+    struct GpuMesh {
+        ComPtr<ID3D12Resource> vertexBuffer;
+        ComPtr<ID3D12Resource> indexBuffer;
+        ComPtr<ID3D12Resource> vertexUpload; // staging, kept until the copy ran
+        ComPtr<ID3D12Resource> indexUpload;
+        UINT vertexCount = 0;
+        UINT indexCount = 0;
+        ModelMaterialRange textureRange = { 0, 0 }; // views in srvHeap, one per material
+        std::vector<ComPtr<ID3D12Resource>> textures; // null for materials using the default texture
+        std::vector<ComPtr<ID3D12Resource>> textureUploads;
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> textureFootprints;
+        bool uploadQueued = false;
+    };
+
+    // GpuMeshAllocator
+    void CreateMesh(uint32_t slot, const Model& model, SceneUploadStats& stats) override;
+    void ReleaseMesh(uint32_t slot) override;
+
+    bool HasGpuData(EntityHandle entity) const;
+    void CreateMeshBuffers(GpuMesh& gpu, const Model& model, SceneUploadStats& stats);
+    void CreateMeshTextures(GpuMesh& gpu, const Model& model, SceneUploadStats& stats);
+    void ReleaseMeshTextures(GpuMesh& gpu);
+    void QueueUpload(uint32_t slot);
+    // Records the queued copies into the frame's command list
+    void RecordUploads();
+    // Drops the staging buffers of copies the GPU has finished
+    void ReleaseFinishedUploads();
+    ModelMaterialRange AllocateTextureRange(UINT count);
+    void GrowTextureHeap(UINT capacity);
+    void WriteTextureViews(const GpuMesh& gpu);
+    // One 256 byte aligned MVPConstants entry per entity slot, so no draw overwrites another's
+    void EnsureInstanceCapacity(size_t slots);
 
     HWND hwnd;
     int width, height;
@@ -83,29 +140,27 @@ private:
     UINT rtvDescriptorSize;
     UINT frameIndex;
 
-    std::vector<Model*> models;
     int currentModelIndex = 0;
 
     unsigned int triangle_angle = 10;
 
     bool running = true;
 
-    // shared mem = both cpu & gpu 
-    // want to move to buffs which only on gpu mem (vram?)
-    std::vector<ID3D12Resource*> vertex_buffers;
-    std::vector<ID3D12Resource*> vertex_buffers_upload;
-    std::vector<ID3D12Resource*> index_buffers;
-    std::vector<ID3D12Resource*> index_buffers_upload;
+    GpuScene gpuScene;
+    std::vector<GpuMesh> gpuMeshes;        // per mesh slot of gpuScene
+    std::vector<uint32_t> pendingUploads;  // mesh slots whose copies the next frame records
+    std::vector<uint32_t> uploadsInFlight; // mesh slots whose copies the current frame runs
+    size_t instanceCapacity = 0;
 
     ComPtr<ID3D12Resource> textureResource;
 
-    // Multi-material support
-    struct DrawRange { UINT startIndex; UINT indexCount; UINT materialIndex; };
-    std::vector<DrawRange> drawRanges; // Built after uploading indices
-    std::vector<ComPtr<ID3D12Resource>> materialTextures; // One per material
-    std::vector<ComPtr<ID3D12Resource>> materialUploadHeaps; // Keep alive until copies finish
-
+    // Multi-material support, per-material index ranges come from Model::GetSubMeshes.
+    // Texture views of removed models are reused, the heap only grows.
     ID3D12DescriptorHeap* srvHeap = nullptr;
+    std::vector<ModelMaterialRange> freeTextureRanges;
+    UINT srvCapacity = 0;
+    UINT srvUsed = 0;
+    UINT srvDescriptorSize = 0;
     ComPtr<ID3D12Resource> defaultTexture;  
     ComPtr<ID3D12Resource> defaultUploadHeap; 
 
@@ -113,10 +168,12 @@ private:
     D3D12_RECT scissorRect = {};
     UINT64 fenceValues[2] = {};  // Per frame fence values
 
-    struct ModelMaterialRange {
-        UINT startIndex;
-        UINT count;
-    };
-    std::vector<ModelMaterialRange> modelMaterialRanges;
+    const EntityStore* entities = nullptr;
+    std::vector<unsigned int> candidateModels; // indices of the models the PVS keeps
+    SceneCuller sceneCuller;
+    std::vector<unsigned int> visibleModels; // Indices into models, reused every frame
+    OcclusionCuller occlusionCuller;
+    ClusterCuller clusterCuller;
+    std::vector<DrawRange> visibleRanges; // Reused every draw to avoid reallocating
 };
 
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "Model.h"
+
+// One kind of scattered object, e.g. trees
+struct ScatterLayer {
+    // Footprint of one instance around its position (see PoissonScatter::FootprintRadius). Footprints of all layers
+    // and the obstacles never overlap.
+    float radius = 1.0f;
+    // Distance between two instances of this layer, at least 2 * radius. A full fill holds
+    // about 0.84 / minDistance^2 instances per unit of area.
+    float minDistance = 0.0f;
+    // At most this many are kept, picked at random from the full fill so they still cover the region
+    unsigned int maxCount = 0xFFFFFFFFu;
+    // Chance (0..1) to keep an instance at x, z. Empty means everywhere.
+    std::function<float(float x, float z)> density;
+};
+
+struct ScatterPoint {
+    float x;
+    float z;
+};
+
+// Bridson's Poisson-disk sampling over a rectangle of the XZ plane. Candidates are drawn around
+// the active points and checked against a background grid, so a candidate only looks at its
+// neighbours and a layer takes time linear in the instances it places. The generator is our
+// own, the same seed gives the same layout on every compiler, every layer gets its own stream.
+class PoissonScatter {
+public:
+    PoissonScatter(float minX, float minZ, float maxX, float maxZ, uint32_t seed);
+
+    // Radius around the model position that covers its world bounds in XZ
+    static float FootprintRadius(const Model& model);
+    // minDistance at which a full fill has about twice count instances, so picking count of them stays even
+    float SpacingForCount(unsigned int count) const;
+
+    // Nothing is placed over the XZ rectangle of the box, meant for a few large models
+    void AddObstacle(const BoundingBox& bounds);
+    // Appends the centers of the new instances. They are kept, later layers scatter around them.
+    void Scatter(const ScatterLayer& layer, std::vector<ScatterPoint>& outPoints);
+    void Clear();
+
+    size_t GetPointCount() const { return discs.size(); }
+
+private:
+    struct Disc {
+        float x, z;
+        float radius;
+        unsigned int layer;
+    };
+
+    struct Obstacle {
+        float minX, minZ, maxX, maxZ;
+    };
+
+    void RebuildGrid(float cellSize);
+    void Link(unsigned int disc);
+    bool IsFree(float x, float z, float radius, float minDistance, unsigned int layer, float reach) const;
+
+    float minX, minZ, maxX, maxZ;
+    uint32_t seed;
+    unsigned int layerCount = 0;
+
+    std::vector<Disc> discs;
+    std::vector<Obstacle> obstacles;
+    float maxRadius = 0.0f;
+
+    // Discs are chained per cell of the background grid
+    float cellSize = 1.0f;
+    float inverseCellSize = 1.0f;
+    int cellsX = 0, cellsZ = 0;
+    std::vector<int> cellHeads;
+    std::vector<int> next; // per disc
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "Model.h"
+#include "GeometryKernels.h"
+
+// Broadphase over world space AABBs. Space is cut into cubic cells that only exist while a box
+// touches them, every box is stored in each cell it covers. A query visits the cells under its
+// box and tests their boxes with GeometryKernels::OverlapBoxes, so its cost depends on the local
+// density and not on the number of objects in the scene.
+class SpatialHash {
+public:
+    static constexpr unsigned int InvalidProxy = 0xFFFFFFFFu;
+
+    // cellSize should be around the size of a typical object. Boxes that would cover more than
+    // maxCellsPerProxy cells (terrain, huge buildings) go to a list every query tests.
+    explicit SpatialHash(float cellSize = 32.0f, unsigned int maxCellsPerProxy = 64);
+
+    // Returns a proxy id for the box, ids of removed proxies are reused
+    unsigned int Insert(const BoundingBox& box, Model* model);
+    void Remove(unsigned int proxy);
+    // Only the stored copies are rewritten while the box stays within the same cells
+    void Move(unsigned int proxy, const BoundingBox& box);
+    void Clear();
+
+    // Appends every proxy whose box overlaps box (touching counts), each of them once.
+    // Queries use scratch state of the hash, run them from one thread at a time.
+    void Query(const BoundingBox& box, std::vector<unsigned int>& outProxies);
+    bool Overlaps(const BoundingBox& box);
+
+    Model* GetModel(unsigned int proxy) const { return proxies[proxy].model; }
+    const BoundingBox& GetBox(unsigned int proxy) const { return proxies[proxy].box; }
+    size_t GetProxyCount() const { return proxies.size() - freeProxies.size(); }
+    size_t GetCellCount() const { return cellLookup.size(); }
+
+private:
+    struct CellRange {
+        int lo[3];
+        int hi[3];
+
+        bool operator==(const CellRange& other) const;
+        uint64_t CellCount() const;
+    };
+
+    // Boxes in SoA form, the layout OverlapBoxes reads
+    struct Cell {
+        std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+        std::vector<unsigned int> proxies;
+
+        void Add(unsigned int proxy, const BoundingBox& box);
+        void Set(size_t slot, const BoundingBox& box);
+        void RemoveAt(size_t slot); // swaps the last box in
+        size_t Find(unsigned int proxy) const;
+        BoxSoA View() const { return { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), proxies.size() }; }
+    };
+
+    struct Proxy {
+        BoundingBox box;
+        Model* model;
+        CellRange range;
+        bool large;
+        bool alive;
+    };
+
+    CellRange RangeOf(const BoundingBox& box) const;
+    static uint64_t Key(int x, int y, int z);
+    Cell* FindCell(int x, int y, int z);
+    void Link(unsigned int proxy);
+    void Unlink(unsigned int proxy);
+    // Calls visit for every cell under range, or for all cells when that is cheaper
+    template <typename Visit> void ForEachCell(const CellRange& range, Visit&& visit);
+    void QueryCell(const Cell& cell, const BoundingBox& box, std::vector<unsigned int>& outProxies);
+
+    float inverseCellSize;
+    unsigned int maxCellsPerProxy;
+
+    std::unordered_map<uint64_t, unsigned int> cellLookup; // cell key -> index into cells
+    std::vector<Cell> cells;
+    std::vector<unsigned int> freeCells;
+    Cell largeProxies;
+
+    std::vector<Proxy> proxies;
+    std::vector<unsigned int> freeProxies;
+
+    // A proxy is reported once per query, the first cell that finds it stamps it
+    std::vector<unsigned int> queryStamps;
+    unsigned int queryStamp = 0;
+    std::vector<unsigned int> hits; // scratch for OverlapBoxes
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// Coroutine for gameplay code, e.g. one that co_awaits assets and places them. It starts right
+// away and runs until its first co_await. What it awaits decides where it resumes, assets and
+// other tasks resume it on the main thread.
+//
+// The Task object may go away before the coroutine is done, the coroutine then finishes on its
+// own and frees itself. Tasks are awaited and resumed on the main thread only.
+template <typename T = void>
+class Task;
+
+namespace TaskDetail {
+    struct PromiseBase {
+        std::coroutine_handle<> continuation; // the coroutine awaiting this one
+        std::atomic<int> references{ 2 };     // the Task object and the running coroutine
+        bool done = false;
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        void unhandled_exception() { std::terminate(); }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                PromiseBase& promise = handle.promise();
+                promise.done = true;
+                std::coroutine_handle<> next = promise.continuation ? promise.continuation : std::noop_coroutine();
+                if (promise.references.fetch_sub(1) == 1) handle.destroy();
+                return next;
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+    };
+
+    template <typename Promise>
+    class TaskBase {
+    public:
+        TaskBase() = default;
+        explicit TaskBase(std::coroutine_handle<Promise> handle) : handle(handle) {}
+        TaskBase(TaskBase&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+        TaskBase& operator=(TaskBase&& other) noexcept {
+            if (this != &other) {
+                Release();
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+        ~TaskBase() { Release(); }
+
+        // An empty Task counts as done
+        bool IsDone() const { return !handle || handle.promise().done; }
+
+        bool await_ready() const noexcept { return IsDone(); }
+        void await_suspend(std::coroutine_handle<> awaiting) { handle.promise().continuation = awaiting; }
+
+    protected:
+        void Release() {
+            if (handle && handle.promise().references.fetch_sub(1) == 1) handle.destroy();
+            handle = {};
+        }
+
+        std::coroutine_handle<Promise> handle;
+    };
+}
+
+template <typename T>
+struct TaskPromise : TaskDetail::PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value.emplace(std::move(result)); }
+};
+
+template <>
+struct TaskPromise<void> : TaskDetail::PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+template <typename T>
+class Task : public TaskDetail::TaskBase<TaskPromise<T>> {
+public:
+    using promise_type = TaskPromise<T>;
+    using TaskDetail::TaskBase<promise_type>::TaskBase;
+
+    // The result, moved out, once done
+    T await_resume() { return std::move(*this->handle.promise().value); }
+};
+
+template <>
+class Task<void> : public TaskDetail::TaskBase<TaskPromise<void>> {
+public:
+    using promise_type = TaskPromise<void>;
+    using TaskDetail::TaskBase<promise_type>::TaskBase;
+
+    void await_resume() {}
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <DirectXMath.h>
+
+struct TransformGraphStats {
+    unsigned int nodes = 0;
+    unsigned int levels = 0;
+    unsigned int updated = 0; // world matrices the last Update recomputed
+};
+
+// Transform hierarchy: every node has a local matrix relative to its parent and a world matrix
+// local * parent world. The nodes are stored as parallel arrays in breadth-first order, so every
+// parent comes before its children and the nodes of one depth are contiguous.
+//
+// SetLocal only marks a node dirty. Update walks the levels from the roots down and recomputes
+// the dirty nodes and everything below them, one batched matrix multiply per level. Nodes that
+// didn't change, like a prop hanging still on a static parent, cost nothing. The inverse
+// transpose of every world matrix, the normal matrix, is cached next to it.
+//
+// Node ids are stable, the dense position of a node changes when nodes are added or removed.
+// Remove only costs the size of the removed subtree: its nodes are left behind as tombstones,
+// which the next Update compacts away together with the reordering of added nodes.
+class TransformGraph {
+public:
+    static constexpr uint32_t NoNode = 0xFFFFFFFFu;
+
+    // World and normal matrix are valid right away, from the parent's current world matrix
+    uint32_t Add(const DirectX::XMFLOAT4X4& local, uint32_t parent = NoNode);
+    // Removes the node and everything below it, their ids are appended to removed
+    void Remove(uint32_t node, std::vector<uint32_t>* removed = nullptr);
+    void Clear();
+
+    void SetLocal(uint32_t node, const DirectX::XMFLOAT4X4& local);
+    // Recomputes the dirty subtrees, see GetUpdated for which nodes changed
+    void Update();
+    // Ids of the nodes the last Update recomputed, parents before children
+    const std::vector<uint32_t>& GetUpdated() const { return updated; }
+
+    bool IsAlive(uint32_t node) const { return node < denseOf.size() && denseOf[node] != NoNode; }
+    // NoNode for roots
+    uint32_t GetParent(uint32_t node) const;
+    const DirectX::XMFLOAT4X4& GetLocal(uint32_t node) const { return locals[denseOf[node]]; }
+    const DirectX::XMFLOAT4X4& GetWorld(uint32_t node) const { return worlds[denseOf[node]]; }
+    // Inverse transpose of the world matrix, for normals
+    const DirectX::XMFLOAT4X4& GetNormalMatrix(uint32_t node) const { return normals[denseOf[node]]; }
+
+    // Live nodes
+    size_t Size() const { return ids.size() - deadCount; }
+    const TransformGraphStats& GetStats() const { return stats; }
+
+private:
+    // Drops the tombstones and restores breadth-first order after nodes were added or removed
+    void Reorder();
+    static DirectX::XMFLOAT4X4 NormalMatrix(const DirectX::XMFLOAT4X4& world);
+
+    // Dense, breadth-first
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> parents; // dense index of the parent, NoNode for roots
+    std::vector<DirectX::XMFLOAT4X4> locals;
+    std::vector<DirectX::XMFLOAT4X4> worlds;
+    std::vector<DirectX::XMFLOAT4X4> normals;
+    std::vector<uint8_t> dirty;
+    std::vector<uint8_t> dead;         // removed, until Reorder compacts them away
+    std::vector<uint32_t> levelStarts; // first dense index of every depth, plus the end
+    bool orderDirty = false;           // appended nodes still keep parents first, only levels mix
+    size_t deadCount = 0;
+
+    // Sparse, per id. The children of a node are a linked list, so Remove finds a subtree
+    // without scanning the dense arrays.
+    std::vector<uint32_t> denseOf;
+    std::vector<uint32_t> freeIds;
+    std::vector<uint32_t> firstChild;
+    std::vector<uint32_t> nextSibling;
+    std::vector<uint32_t> previousSibling;
+
+    std::vector<uint32_t> updated;
+    TransformGraphStats stats;
+
+    // Scratch of Update and Reorder, kept to avoid reallocating
+    std::vector<uint32_t> batch;
+    std::vector<DirectX::XMFLOAT4X4> batchLocals;
+    std::vector<DirectX::XMFLOAT4X4> batchParents;
+    std::vector<uint32_t> remap;
+    std::vector<uint32_t> pending; // of Remove
+};
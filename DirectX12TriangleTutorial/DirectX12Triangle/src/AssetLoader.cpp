@@ -0,0 +1,401 @@
+#include "AssetLoader.h"
+#include "File.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+struct AssetLoader::Node {
+    NodeKind kind;
+    std::string name; // as referenced, e.g. the mtllib or map_Kd argument
+    std::string path;
+    std::atomic<AssetPriority> priority;
+    std::string bytes; // from the read until the parse or decode
+    size_t reserved = 0; // counted against the read budget
+
+    // Prerequisites of the next stage, plus one while the stage before still adds them
+    std::atomic<int> waiting{ 1 };
+    std::function<void()> next;
+
+    std::mutex mutex;
+    std::atomic<bool> finished{ false };
+    std::vector<Node*> dependents;
+
+    // ModelNode, model is null once it failed or was cancelled
+    std::unique_ptr<Model> model;
+    PrepareFn prepare;
+    std::vector<Node*> libraries;
+    AssetTask<std::unique_ptr<Model>> task;
+    // MaterialNode
+    MaterialLibrary library;
+    std::vector<Node*> textures;
+    // TextureNode
+    Image image;
+    std::vector<AssetTask<Image>> imageTasks; // under mutex, until finished
+};
+
+AssetLoader::AssetLoader(size_t maxBytesInFlight) : maxBytesInFlight(maxBytesInFlight) {
+    // The first file of a name wins, like GetAssetPath
+    for (const std::string& file : EnumerateAssetFiles()) {
+        assetPaths.emplace(std::filesystem::path(file).filename().string(), file);
+    }
+}
+
+AssetLoader::~AssetLoader() {
+    JobSystem::Get().Wait(jobs);
+}
+
+void AssetLoader::Spawn(std::function<void()> job) {
+    JobSystem::Get().Run(std::move(job), &jobs);
+}
+
+void AssetLoader::QueueContinuation(std::coroutine_handle<> continuation) {
+    std::lock_guard<std::mutex> lock(continuationMutex);
+    continuations.push_back(continuation);
+}
+
+AssetLoader::Node* AssetLoader::CreateNode(NodeKind kind, const std::string& name, AssetPriority priority) {
+    auto node = std::make_unique<Node>();
+    node->kind = kind;
+    node->name = name;
+    node->priority.store(priority, std::memory_order_relaxed);
+    auto found = assetPaths.find(name);
+    if (found != assetPaths.end()) node->path = found->second;
+    if (kind == ModelNode) return node.release();
+    nodes.push_back(std::move(node));
+    return nodes.back().get();
+}
+
+AssetLoader::Node* AssetLoader::GetShared(NodeKind kind, const std::string& name, AssetPriority priority) {
+    std::unordered_map<std::string, Node*>& byName = kind == MaterialNode ? sharedMaterials : sharedTextures;
+    Node* node;
+    bool created = false;
+    {
+        std::lock_guard<std::mutex> lock(nodesMutex);
+        auto found = byName.find(name);
+        if (found != byName.end()) {
+            stats.sharedReferences++;
+            node = found->second;
+        }
+        else {
+            node = CreateNode(kind, name, priority);
+            byName.emplace(name, node);
+            if (kind == MaterialNode) stats.materialFiles++;
+            else stats.textures++;
+            created = true;
+        }
+    }
+    if (created) {
+        if (kind == MaterialNode) QueueRead(node, [this, node]() { ParseMaterials(node); });
+        else QueueRead(node, [this, node]() { DecodeTexture(node); });
+        return node;
+    }
+
+    std::lock_guard<std::mutex> lock(readMutex);
+    if (priority <= node->priority.load(std::memory_order_relaxed)) return node;
+    node->priority.store(priority, std::memory_order_relaxed);
+    auto queued = std::find_if(readQueue.begin(), readQueue.end(), [node](const auto& read) { return read.first == node; });
+    if (queued != readQueue.end()) {
+        std::function<void()> next = std::move(queued->second);
+        readQueue.erase(queued);
+        InsertRead(node, std::move(next));
+    }
+    return node;
+}
+
+AssetTask<std::unique_ptr<Model>> AssetLoader::LoadModelAsync(const std::string& path, PrepareFn prepare, AssetPriority priority) {
+    AssetTask<std::unique_ptr<Model>> task(this);
+    Node* node;
+    {
+        std::lock_guard<std::mutex> lock(nodesMutex);
+        node = CreateNode(ModelNode, path, priority);
+        stats.models++;
+    }
+    node->model = std::make_unique<Model>();
+    node->prepare = std::move(prepare);
+    node->task = task;
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == "obj") {
+        QueueRead(node, [this, node]() { ScanModel(node); });
+    }
+    else {
+        // glTF and 3DS bring their own buffers and textures, one job does it all
+        Spawn([this, node]() {
+            if (node->task.IsCancelled() || !node->model->LoadFromFile(node->name)) node->model.reset();
+            CompleteModel(node);
+        });
+    }
+    return task;
+}
+
+AssetTask<Image> AssetLoader::LoadImageAsync(const std::string& name, AssetPriority priority) {
+    AssetTask<Image> task(this);
+    Node* node = GetShared(TextureNode, name, priority);
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        if (!node->finished.load(std::memory_order_relaxed)) {
+            node->imageTasks.push_back(task);
+            return task;
+        }
+    }
+    task.Complete(node->image);
+    return task;
+}
+
+size_t AssetLoader::Update() {
+    // Only what arrived so far, coroutines that start new loads are resumed next frame at the
+    // earliest
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::lock_guard<std::mutex> lock(continuationMutex);
+        ready.swap(continuations);
+    }
+    for (std::coroutine_handle<> continuation : ready) {
+        continuation.resume();
+    }
+    return ready.size();
+}
+
+AssetLoaderStats AssetLoader::GetStats() const {
+    std::lock_guard<std::mutex> nodesLock(nodesMutex);
+    std::lock_guard<std::mutex> readLock(readMutex);
+    return stats;
+}
+
+// ---------------------------------------------------------------------------
+// Reads under the budget
+// ---------------------------------------------------------------------------
+
+void AssetLoader::QueueRead(Node* node, std::function<void()> next) {
+    std::error_code error;
+    const uintmax_t size = node->path.empty() ? 0 : std::filesystem::file_size(node->path, error);
+    node->reserved = error ? 0 : static_cast<size_t>(size);
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        InsertRead(node, std::move(next));
+    }
+    StartReads();
+}
+
+void AssetLoader::InsertRead(Node* node, std::function<void()> next) {
+    // An OBJ waits for its MTL files with its own bytes read, they go first so it can't block
+    // them
+    if (node->kind == MaterialNode) {
+        readQueue.emplace_front(node, std::move(next));
+        return;
+    }
+    const AssetPriority priority = node->priority.load(std::memory_order_relaxed);
+    auto position = std::find_if(readQueue.begin(), readQueue.end(), [priority](const auto& read) {
+        return read.first->kind != MaterialNode && read.first->priority.load(std::memory_order_relaxed) < priority;
+    });
+    readQueue.emplace(position, node, std::move(next));
+}
+
+void AssetLoader::StartReads() {
+    std::vector<std::pair<Node*, std::function<void()>>> admitted;
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        while (!readQueue.empty()) {
+            const Node* node = readQueue.front().first;
+            const bool overBudget = bytesInFlight > 0 && bytesInFlight + node->reserved > maxBytesInFlight;
+            if (overBudget && node->kind != MaterialNode) break;
+            bytesInFlight += node->reserved;
+            stats.peakBytesInFlight = std::max(stats.peakBytesInFlight, bytesInFlight);
+            admitted.push_back(std::move(readQueue.front()));
+            readQueue.pop_front();
+        }
+    }
+
+    for (auto& read : admitted) {
+        Spawn([this, node = read.first, next = std::move(read.second)]() {
+            // A cancelled model skips its read, the next stage sees why the bytes are missing
+            if (node->kind == ModelNode && node->task.IsCancelled()) {
+                next();
+                return;
+            }
+            std::ifstream file(node->path, std::ios::in | std::ios::binary);
+            if (file.is_open()) {
+                node->bytes.resize(node->reserved);
+                file.read(node->bytes.data(), static_cast<std::streamsize>(node->bytes.size()));
+                node->bytes.resize(static_cast<size_t>(file.gcount()));
+            }
+            else {
+                std::cerr << "Failed to open asset file: " << node->name << std::endl;
+            }
+            {
+                std::lock_guard<std::mutex> lock(readMutex);
+                stats.bytesRead += node->bytes.size();
+            }
+            next();
+        });
+    }
+}
+
+void AssetLoader::ReleaseBytes(Node* node) {
+    std::string().swap(node->bytes);
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        bytesInFlight -= node->reserved;
+        node->reserved = 0;
+    }
+    StartReads();
+}
+
+// ---------------------------------------------------------------------------
+// Dependencies
+// ---------------------------------------------------------------------------
+
+void AssetLoader::DependOn(Node* node, Node* prerequisite) {
+    std::lock_guard<std::mutex> lock(prerequisite->mutex);
+    if (prerequisite->finished.load(std::memory_order_relaxed)) return;
+    node->waiting.fetch_add(1);
+    prerequisite->dependents.push_back(node);
+}
+
+void AssetLoader::Then(Node* node, std::function<void()> stage) {
+    node->next = std::move(stage);
+    Release(node);
+}
+
+void AssetLoader::Release(Node* node) {
+    if (node->waiting.fetch_sub(1) != 1) return;
+    // Held again for whatever the stage adds
+    std::function<void()> stage = std::move(node->next);
+    node->waiting.store(1);
+    Spawn(std::move(stage));
+}
+
+void AssetLoader::Finish(Node* node) {
+    std::vector<Node*> dependents;
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        node->finished.store(true, std::memory_order_release);
+        dependents.swap(node->dependents);
+    }
+    for (Node* dependent : dependents) {
+        Release(dependent);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Stages
+// ---------------------------------------------------------------------------
+
+void AssetLoader::ScanModel(Node* node) {
+    if (node->bytes.empty() || node->task.IsCancelled()) {
+        ReleaseBytes(node);
+        node->model.reset();
+        CompleteModel(node);
+        return;
+    }
+    node->task.SetProgress(0.25f);
+
+    // Only the mtllib lines, the MTL files load while the OBJ waits for its turn to be parsed
+    const std::string& text = node->bytes;
+    for (size_t lineStart = 0; lineStart < text.size();) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = text.size();
+        const size_t start = text.find_first_not_of(" \t", lineStart);
+        const bool isMtllib = start < lineEnd && text.compare(start, 6, "mtllib") == 0;
+        const size_t begin = lineStart;
+        lineStart = lineEnd + 1;
+        if (!isMtllib) continue;
+
+        std::istringstream iss(text.substr(begin, lineEnd - begin));
+        std::string prefix, mtlFile;
+        iss >> prefix >> mtlFile;
+        if (prefix != "mtllib" || mtlFile.empty()) continue;
+
+        Node* library = GetShared(MaterialNode, mtlFile, node->priority.load(std::memory_order_relaxed));
+        if (std::find(node->libraries.begin(), node->libraries.end(), library) != node->libraries.end()) continue;
+        node->libraries.push_back(library);
+        DependOn(node, library);
+    }
+    Then(node, [this, node]() { ParseModel(node); });
+}
+
+void AssetLoader::ParseModel(Node* node) {
+    if (node->task.IsCancelled()) {
+        ReleaseBytes(node);
+        node->model.reset();
+        CompleteModel(node);
+        return;
+    }
+    node->task.SetProgress(0.5f);
+    {
+        std::istringstream file(std::move(node->bytes));
+        node->model->LoadFromObj(file, [node](const std::string& mtlFile) {
+            for (Node* library : node->libraries) {
+                if (library->name == mtlFile) node->model->AddMaterials(library->library);
+            }
+        });
+    }
+    ReleaseBytes(node);
+    node->task.SetProgress(0.75f);
+
+    for (Node* library : node->libraries) {
+        for (Node* texture : library->textures) {
+            DependOn(node, texture);
+        }
+    }
+    Then(node, [this, node]() { CompleteModel(node); });
+}
+
+void AssetLoader::CompleteModel(Node* node) {
+    if (node->task.IsCancelled()) node->model.reset();
+    if (node->model) {
+        for (Node* library : node->libraries) {
+            for (Node* texture : library->textures) {
+                node->model->AssignTexture(texture->name, texture->image);
+            }
+        }
+        if (node->prepare) node->prepare(*node->model);
+    }
+    // Nothing depends on a model, its node goes with the load
+    node->task.Complete(std::move(node->model));
+    delete node;
+}
+
+void AssetLoader::ParseMaterials(Node* node) {
+    {
+        std::istringstream file(std::move(node->bytes));
+        node->library.Parse(file);
+    }
+    ReleaseBytes(node);
+
+    // The textures start now, the models using this file wait for them after parsing
+    for (const Material& material : node->library.materials) {
+        if (material.diffuseMap.empty()) continue;
+        Node* texture = GetShared(TextureNode, material.diffuseMap, node->priority.load(std::memory_order_relaxed));
+        if (std::find(node->textures.begin(), node->textures.end(), texture) == node->textures.end()) {
+            node->textures.push_back(texture);
+        }
+    }
+    Finish(node);
+}
+
+void AssetLoader::DecodeTexture(Node* node) {
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        for (const AssetTask<Image>& task : node->imageTasks) task.SetProgress(0.5f);
+    }
+    if (!node->bytes.empty()) {
+        node->image.LoadFromMemory(reinterpret_cast<const unsigned char*>(node->bytes.data()), node->bytes.size());
+    }
+    ReleaseBytes(node);
+    Finish(node);
+
+    // Finish took the lock too, later requests see the image finished and complete themselves
+    std::vector<AssetTask<Image>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        tasks.swap(node->imageTasks);
+    }
+    for (const AssetTask<Image>& task : tasks) {
+        task.Complete(task.IsCancelled() ? Image() : node->image);
+    }
+}
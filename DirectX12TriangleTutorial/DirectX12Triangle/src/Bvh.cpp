@@ -0,0 +1,680 @@
+#include "Bvh.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <climits>
+#include <xmmintrin.h>
+
+namespace {
+
+constexpr unsigned int BinCount = 16;
+// Subtrees below this many primitives are built by a single thread
+constexpr unsigned int ParallelSubtreeSize = 4096;
+// Deeper nodes split at the object median instead, which bounds the depth and so the traversal stack
+constexpr unsigned int MaxSahDepth = 48;
+constexpr int TraversalStackSize = 256;
+
+struct Box {
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    void Grow(const Box& b) {
+        for (int k = 0; k < 3; ++k) {
+            min[k] = std::min(min[k], b.min[k]);
+            max[k] = std::max(max[k], b.max[k]);
+        }
+    }
+
+    void Grow(const DirectX::XMFLOAT3& p) {
+        const float* v = &p.x;
+        for (int k = 0; k < 3; ++k) {
+            min[k] = std::min(min[k], v[k]);
+            max[k] = std::max(max[k], v[k]);
+        }
+    }
+
+    float HalfArea() const {
+        if (min[0] > max[0]) return 0.0f;
+        float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+struct BinaryNode {
+    Box bounds;
+    Box centroidBounds;
+    unsigned int left = 0, right = 0;  // inner nodes
+    unsigned int first = 0, count = 0; // leaves, count is 0 for inner nodes
+};
+
+// Primitives are partitioned by value, so every pass over a node reads contiguous memory
+struct BuildPrimitive {
+    Box box;
+    DirectX::XMFLOAT3 centroid;
+    unsigned int index;
+
+    float Centroid(int axis) const { return (&centroid.x)[axis]; }
+};
+
+struct BinaryBuilder {
+    std::vector<BuildPrimitive>& primitives;
+
+    BinaryNode MakeNode(unsigned int first, unsigned int count) const {
+        BinaryNode node;
+        node.first = first;
+        node.count = count;
+        for (unsigned int i = first; i < first + count; ++i) {
+            node.bounds.Grow(primitives[i].box);
+            node.centroidBounds.Grow(primitives[i].centroid);
+        }
+        return node;
+    }
+
+    // Gives nodes[index] two children, or returns false when it stays a leaf
+    bool Split(std::vector<BinaryNode>& nodes, unsigned int index, unsigned int depth) const {
+        const unsigned int first = nodes[index].first;
+        const unsigned int count = nodes[index].count;
+        if (count <= 1) return false;
+
+        const Box centroidBounds = nodes[index].centroidBounds;
+        BuildPrimitive* begin = primitives.data() + first;
+        BuildPrimitive* end = begin + count;
+        BuildPrimitive* middle = nullptr;
+
+        if (depth < MaxSahDepth) {
+            // Binned SAH: the cost of a split is NL * area(L) + NR * area(R), evaluated at the
+            // bin borders. All three axes are binned in the same pass over the primitives.
+            float lo[3], scale[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                lo[axis] = centroidBounds.min[axis];
+                float extent = centroidBounds.max[axis] - lo[axis];
+                scale[axis] = extent > 0.0f ? BinCount / extent : 0.0f;
+            }
+            auto binOf = [&](const BuildPrimitive& primitive, int axis) {
+                return std::min(BinCount - 1, static_cast<unsigned int>((primitive.Centroid(axis) - lo[axis]) * scale[axis]));
+            };
+
+            Box binBounds[3][BinCount];
+            unsigned int binCounts[3][BinCount] = {};
+            for (const BuildPrimitive* primitive = begin; primitive < end; ++primitive) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    unsigned int bin = binOf(*primitive, axis);
+                    binCounts[axis][bin]++;
+                    binBounds[axis][bin].Grow(primitive->box);
+                }
+            }
+
+            float bestCost = FLT_MAX;
+            int bestAxis = -1;
+            unsigned int bestBin = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (scale[axis] == 0.0f) continue;
+                float rightArea[BinCount];
+                unsigned int rightCount[BinCount];
+                Box accumulated;
+                unsigned int accumulatedCount = 0;
+                for (unsigned int bin = BinCount - 1; bin > 0; --bin) {
+                    accumulated.Grow(binBounds[axis][bin]);
+                    accumulatedCount += binCounts[axis][bin];
+                    rightArea[bin] = accumulated.HalfArea();
+                    rightCount[bin] = accumulatedCount;
+                }
+                accumulated = Box();
+                accumulatedCount = 0;
+                for (unsigned int bin = 0; bin + 1 < BinCount; ++bin) {
+                    accumulated.Grow(binBounds[axis][bin]);
+                    accumulatedCount += binCounts[axis][bin];
+                    if (accumulatedCount == 0 || rightCount[bin + 1] == 0) continue;
+                    float cost = accumulatedCount * accumulated.HalfArea() + rightCount[bin + 1] * rightArea[bin + 1];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = bin + 1;
+                    }
+                }
+            }
+
+            if (bestAxis >= 0) {
+                // A leaf costs one test per primitive, a split one node test plus its children
+                const float area = nodes[index].bounds.HalfArea();
+                if (count <= Bvh4::MaxLeafSize && bestCost + area >= count * area) return false;
+                middle = std::partition(begin, end, [&](const BuildPrimitive& primitive) {
+                    return binOf(primitive, bestAxis) < bestBin;
+                });
+            }
+            else if (count <= Bvh4::MaxLeafSize) {
+                return false;
+            }
+        }
+        else if (count <= Bvh4::MaxLeafSize) {
+            return false;
+        }
+
+        if (middle == nullptr || middle == begin || middle == end) {
+            // Too deep, or all centroids in one spot: object median along the widest axis
+            int axis = 0;
+            for (int k = 1; k < 3; ++k) {
+                if (centroidBounds.max[k] - centroidBounds.min[k] > centroidBounds.max[axis] - centroidBounds.min[axis]) axis = k;
+            }
+            middle = begin + count / 2;
+            std::nth_element(begin, middle, end, [&](const BuildPrimitive& a, const BuildPrimitive& b) {
+                return a.Centroid(axis) < b.Centroid(axis);
+            });
+        }
+
+        const unsigned int leftCount = static_cast<unsigned int>(middle - begin);
+        const unsigned int left = static_cast<unsigned int>(nodes.size());
+        nodes.push_back(MakeNode(first, leftCount));
+        nodes.push_back(MakeNode(first + leftCount, count - leftCount));
+        nodes[index].left = left;
+        nodes[index].right = left + 1;
+        nodes[index].count = 0;
+        return true;
+    }
+
+    // Splits the subtree under root. With pending set, nodes of at most stopCount primitives are
+    // not split but recorded together with their depth, to be built separately.
+    void BuildSubtree(std::vector<BinaryNode>& nodes, unsigned int root, unsigned int depth, unsigned int stopCount,
+        std::vector<std::pair<unsigned int, unsigned int>>* pending) const {
+        std::vector<std::pair<unsigned int, unsigned int>> stack = { { root, depth } };
+        while (!stack.empty()) {
+            auto [index, nodeDepth] = stack.back();
+            stack.pop_back();
+            if (pending && nodes[index].count <= stopCount) {
+                pending->push_back({ index, nodeDepth });
+                continue;
+            }
+            if (Split(nodes, index, nodeDepth)) {
+                stack.push_back({ nodes[index].left, nodeDepth + 1 });
+                stack.push_back({ nodes[index].right, nodeDepth + 1 });
+            }
+        }
+    }
+};
+
+Bvh4Node EmptyNode() {
+    // Inverted bounds no ray can enter
+    Bvh4Node node;
+    for (int s = 0; s < 4; ++s) {
+        node.minX[s] = node.minY[s] = node.minZ[s] = FLT_MAX;
+        node.maxX[s] = node.maxY[s] = node.maxZ[s] = -FLT_MAX;
+        node.children[s] = -1;
+    }
+    return node;
+}
+
+void SetChildBounds(Bvh4Node& node, int slot, const Box& box) {
+    node.minX[slot] = box.min[0];
+    node.minY[slot] = box.min[1];
+    node.minZ[slot] = box.min[2];
+    node.maxX[slot] = box.max[0];
+    node.maxY[slot] = box.max[1];
+    node.maxZ[slot] = box.max[2];
+}
+
+// Ray broadcast into SSE registers, with the slab order picked once per ray
+struct Ray {
+    __m128 ox, oy, oz;
+    __m128 dx, dy, dz;
+    __m128 invX, invY, invZ;
+    bool negX, negY, negZ;
+};
+
+Ray MakeRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction) {
+    // Zero components become tiny so the slab distances stay infinite instead of NaN
+    auto safe = [](float d) { return std::fabs(d) < 1e-20f ? (d < 0.0f ? -1e-20f : 1e-20f) : d; };
+    Ray ray;
+    ray.ox = _mm_set1_ps(origin.x);
+    ray.oy = _mm_set1_ps(origin.y);
+    ray.oz = _mm_set1_ps(origin.z);
+    ray.dx = _mm_set1_ps(direction.x);
+    ray.dy = _mm_set1_ps(direction.y);
+    ray.dz = _mm_set1_ps(direction.z);
+    ray.invX = _mm_set1_ps(1.0f / safe(direction.x));
+    ray.invY = _mm_set1_ps(1.0f / safe(direction.y));
+    ray.invZ = _mm_set1_ps(1.0f / safe(direction.z));
+    ray.negX = direction.x < 0.0f;
+    ray.negY = direction.y < 0.0f;
+    ray.negZ = direction.z < 0.0f;
+    return ray;
+}
+
+// Visits the leaves whose boxes the ray enters before tMax, nearest child first. leaf(index, tMax)
+// may shorten tMax and returns true to stop the traversal.
+template <typename LeafFn>
+void Traverse(const std::vector<Bvh4Node>& nodes, const Ray& ray, float& tMax, LeafFn&& leaf) {
+    if (nodes.empty()) return;
+
+    struct Entry {
+        int child;
+        float tNear;
+    };
+    Entry stack[TraversalStackSize];
+    int top = 0;
+    stack[top++] = { 0, 0.0f };
+
+    while (top > 0) {
+        const Entry entry = stack[--top];
+        if (entry.tNear > tMax) continue;
+        if (entry.child < 0) {
+            if (leaf(static_cast<unsigned int>(~entry.child), tMax)) return;
+            continue;
+        }
+
+        // Slab test of all four children at once
+        const Bvh4Node& node = nodes[entry.child];
+        __m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negX ? node.maxX : node.minX), ray.ox), ray.invX);
+        __m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negX ? node.minX : node.maxX), ray.ox), ray.invX);
+        __m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negY ? node.maxY : node.minY), ray.oy), ray.invY);
+        __m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negY ? node.minY : node.maxY), ray.oy), ray.invY);
+        __m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negZ ? node.maxZ : node.minZ), ray.oz), ray.invZ);
+        __m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negZ ? node.minZ : node.maxZ), ray.oz), ray.invZ);
+        __m128 tNear = _mm_max_ps(_mm_max_ps(nearX, nearY), _mm_max_ps(nearZ, _mm_setzero_ps()));
+        __m128 tFar = _mm_min_ps(_mm_min_ps(farX, farY), _mm_min_ps(farZ, _mm_set1_ps(tMax)));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+        if (mask == 0) continue;
+
+        alignas(16) float nearDistance[4];
+        _mm_store_ps(nearDistance, tNear);
+
+        // Sorted farthest first, so the nearest child ends up on top of the stack
+        Entry hits[4];
+        int hitCount = 0;
+        for (int slot = 0; slot < 4; ++slot) {
+            if (!(mask & (1 << slot))) continue;
+            Entry hit = { node.children[slot], nearDistance[slot] };
+            int i = hitCount++;
+            while (i > 0 && hits[i - 1].tNear < hit.tNear) {
+                hits[i] = hits[i - 1];
+                --i;
+            }
+            hits[i] = hit;
+        }
+        for (int i = 0; i < hitCount; ++i) {
+            stack[top++] = hits[i];
+        }
+    }
+}
+
+// Moller-Trumbore against the four triangles of a packet, returns the mask of lanes hit with 0 < t < tMax
+int IntersectPacket(const TrianglePacket& p, const Ray& ray, float tMax, __m128& t, __m128& u, __m128& v) {
+    const __m128 e1x = _mm_load_ps(p.e1x), e1y = _mm_load_ps(p.e1y), e1z = _mm_load_ps(p.e1z);
+    const __m128 e2x = _mm_load_ps(p.e2x), e2y = _mm_load_ps(p.e2y), e2z = _mm_load_ps(p.e2z);
+
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(ray.dy, e2z), _mm_mul_ps(ray.dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(ray.dz, e2x), _mm_mul_ps(ray.dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(ray.dx, e2y), _mm_mul_ps(ray.dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    __m128 sx = _mm_sub_ps(ray.ox, _mm_load_ps(p.v0x));
+    __m128 sy = _mm_sub_ps(ray.oy, _mm_load_ps(p.v0y));
+    __m128 sz = _mm_sub_ps(ray.oz, _mm_load_ps(p.v0z));
+    u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ray.dx, qx), _mm_mul_ps(ray.dy, qy)), _mm_mul_ps(ray.dz, qz)), inverseDet);
+    t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+    // Degenerate lanes have det = 0 and fail every comparison through inf/NaN
+    const __m128 zero = _mm_setzero_ps();
+    __m128 hit = _mm_cmpneq_ps(det, zero);
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, zero));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(tMax)));
+    return _mm_movemask_ps(hit);
+}
+
+void TransformRay(const DirectX::XMFLOAT4X4& matrix, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction,
+    DirectX::XMFLOAT3& outOrigin, DirectX::XMFLOAT3& outDirection) {
+    DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(&matrix);
+    DirectX::XMStoreFloat3(&outOrigin, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&origin), m));
+    DirectX::XMStoreFloat3(&outDirection, DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&direction), m));
+}
+
+}
+
+void Bvh4::Clear() {
+    nodes.clear();
+    leaves.clear();
+    order.clear();
+}
+
+void Bvh4::Build(const std::vector<DirectX::XMFLOAT3>& boxMin, const std::vector<DirectX::XMFLOAT3>& boxMax) {
+    Clear();
+    const unsigned int count = static_cast<unsigned int>(std::min(boxMin.size(), boxMax.size()));
+    if (count == 0) return;
+
+    std::vector<BuildPrimitive> primitives(count);
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0u);
+    JobSystem::Get().ParallelFor(count, [&](size_t begin, size_t end) {
+        for (unsigned int i = static_cast<unsigned int>(begin); i < end; ++i) {
+            BuildPrimitive& primitive = primitives[i];
+            primitive.box.Grow(boxMin[i]);
+            primitive.box.Grow(boxMax[i]);
+            primitive.centroid = { (boxMin[i].x + boxMax[i].x) * 0.5f, (boxMin[i].y + boxMax[i].y) * 0.5f, (boxMin[i].z + boxMax[i].z) * 0.5f };
+            primitive.index = i;
+        }
+    });
+
+    BinaryBuilder builder = { primitives };
+    std::vector<BinaryNode> binary;
+    binary.reserve(2 * (count / Bvh4::MaxLeafSize) + 1);
+    binary.push_back(builder.MakeNode(0, count));
+
+    if (count <= ParallelSubtreeSize) {
+        builder.BuildSubtree(binary, 0, 0, 0, nullptr);
+    }
+    else {
+        // The top levels are split here until every open node is small enough, those subtrees
+        // cover disjoint ranges of the primitives and are built in parallel into their own node arrays
+        const unsigned int threads = JobSystem::Get().GetThreadCount();
+        const unsigned int stopCount = std::max(ParallelSubtreeSize, count / (threads * 4));
+        std::vector<std::pair<unsigned int, unsigned int>> pending;
+        builder.BuildSubtree(binary, 0, 0, stopCount, &pending);
+
+        std::vector<std::vector<BinaryNode>> subtrees(pending.size());
+        JobSystem::Get().ParallelFor(pending.size(), [&](size_t begin, size_t end) {
+            for (size_t task = begin; task < end; ++task) {
+                std::vector<BinaryNode>& local = subtrees[task];
+                local.push_back(binary[pending[task].first]);
+                builder.BuildSubtree(local, 0, pending[task].second, 0, nullptr);
+            }
+        });
+
+        // Local node i > 0 lands at base + i - 1, the local root replaces the open node
+        for (size_t task = 0; task < subtrees.size(); ++task) {
+            const std::vector<BinaryNode>& local = subtrees[task];
+            const unsigned int base = static_cast<unsigned int>(binary.size());
+            auto remap = [&](BinaryNode node) {
+                if (node.count == 0) {
+                    node.left = base + node.left - 1;
+                    node.right = base + node.right - 1;
+                }
+                return node;
+            };
+            for (size_t i = 1; i < local.size(); ++i) {
+                binary.push_back(remap(local[i]));
+            }
+            binary[pending[task].first] = remap(local[0]);
+        }
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        order[i] = primitives[i].index;
+    }
+
+    // Collapse: every 4-wide node takes the children of its binary node and keeps opening the
+    // largest inner one among them until it has four
+    nodes.push_back(EmptyNode());
+    if (binary[0].count > 0) {
+        SetChildBounds(nodes[0], 0, binary[0].bounds);
+        leaves.push_back({ binary[0].first, binary[0].count });
+        nodes[0].children[0] = ~0;
+        return;
+    }
+
+    std::vector<std::pair<unsigned int, unsigned int>> stack = { { 0u, 0u } }; // binary node, 4-wide node
+    while (!stack.empty()) {
+        auto [binaryIndex, nodeIndex] = stack.back();
+        stack.pop_back();
+
+        unsigned int candidates[4] = { binary[binaryIndex].left, binary[binaryIndex].right };
+        int candidateCount = 2;
+        while (candidateCount < 4) {
+            int open = -1;
+            float openArea = -1.0f;
+            for (int i = 0; i < candidateCount; ++i) {
+                const BinaryNode& candidate = binary[candidates[i]];
+                if (candidate.count == 0 && candidate.bounds.HalfArea() > openArea) {
+                    open = i;
+                    openArea = candidate.bounds.HalfArea();
+                }
+            }
+            if (open < 0) break;
+            const BinaryNode& opened = binary[candidates[open]];
+            candidates[candidateCount++] = opened.right;
+            candidates[open] = opened.left;
+        }
+
+        for (int slot = 0; slot < candidateCount; ++slot) {
+            const BinaryNode& child = binary[candidates[slot]];
+            SetChildBounds(nodes[nodeIndex], slot, child.bounds);
+            if (child.count > 0) {
+                nodes[nodeIndex].children[slot] = ~static_cast<int>(leaves.size());
+                leaves.push_back({ child.first, child.count });
+            }
+            else {
+                const unsigned int childIndex = static_cast<unsigned int>(nodes.size());
+                nodes.push_back(EmptyNode());
+                nodes[nodeIndex].children[slot] = static_cast<int>(childIndex);
+                stack.push_back({ candidates[slot], childIndex });
+            }
+        }
+    }
+}
+
+void TriangleBvh::Clear() {
+    bvh.Clear();
+    packets.clear();
+}
+
+void TriangleBvh::Build(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    Clear();
+    const size_t faceCount = indices.size() / 3;
+    std::vector<DirectX::XMFLOAT3> boxMin(faceCount), boxMax(faceCount);
+    bool valid = true;
+    for (size_t f = 0; f < faceCount; ++f) {
+        Box box;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int index = indices[f * 3 + k];
+            if (index >= vertices.size()) {
+                valid = false;
+                break;
+            }
+            box.Grow(vertices[index].position);
+        }
+        boxMin[f] = { box.min[0], box.min[1], box.min[2] };
+        boxMax[f] = { box.max[0], box.max[1], box.max[2] };
+    }
+    if (!valid) return;
+
+    bvh.Build(boxMin, boxMax);
+
+    // One packet per leaf, so a leaf is tested with a single 4-wide intersection
+    packets.resize(bvh.leaves.size());
+    JobSystem::Get().ParallelFor(packets.size(), [&](size_t begin, size_t end) {
+        for (unsigned int leafId = static_cast<unsigned int>(begin); leafId < end; ++leafId) {
+            const BvhLeaf& leaf = bvh.leaves[leafId];
+            TrianglePacket& packet = packets[leafId];
+            for (unsigned int lane = 0; lane < 4; ++lane) {
+                if (lane >= leaf.count) {
+                    packet.v0x[lane] = packet.v0y[lane] = packet.v0z[lane] = 0.0f;
+                    packet.e1x[lane] = packet.e1y[lane] = packet.e1z[lane] = 0.0f;
+                    packet.e2x[lane] = packet.e2y[lane] = packet.e2z[lane] = 0.0f;
+                    packet.faces[lane] = 0xFFFFFFFFu;
+                    continue;
+                }
+                const unsigned int face = bvh.order[leaf.first + lane];
+                const DirectX::XMFLOAT3& p0 = vertices[indices[face * 3]].position;
+                const DirectX::XMFLOAT3& p1 = vertices[indices[face * 3 + 1]].position;
+                const DirectX::XMFLOAT3& p2 = vertices[indices[face * 3 + 2]].position;
+                packet.v0x[lane] = p0.x;
+                packet.v0y[lane] = p0.y;
+                packet.v0z[lane] = p0.z;
+                packet.e1x[lane] = p1.x - p0.x;
+                packet.e1y[lane] = p1.y - p0.y;
+                packet.e1z[lane] = p1.z - p0.z;
+                packet.e2x[lane] = p2.x - p0.x;
+                packet.e2y[lane] = p2.y - p0.y;
+                packet.e2z[lane] = p2.z - p0.z;
+                packet.faces[lane] = face;
+            }
+        }
+    });
+}
+
+bool TriangleBvh::Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const {
+    const Ray ray = MakeRay(origin, direction);
+    float tMax = maxDistance;
+    bool found = false;
+    Traverse(bvh.nodes, ray, tMax, [&](unsigned int leaf, float& closest) {
+        __m128 t, u, v;
+        int mask = IntersectPacket(packets[leaf], ray, closest, t, u, v);
+        if (mask == 0) return false;
+        alignas(16) float tLanes[4], uLanes[4], vLanes[4];
+        _mm_store_ps(tLanes, t);
+        _mm_store_ps(uLanes, u);
+        _mm_store_ps(vLanes, v);
+        for (int lane = 0; lane < 4; ++lane) {
+            if ((mask & (1 << lane)) && tLanes[lane] < closest) {
+                closest = tLanes[lane];
+                hit.triangle = packets[leaf].faces[lane];
+                hit.u = uLanes[lane];
+                hit.v = vLanes[lane];
+                found = true;
+            }
+        }
+        return false;
+    });
+    if (found) hit.distance = tMax;
+    return found;
+}
+
+bool TriangleBvh::Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance) const {
+    const Ray ray = MakeRay(origin, direction);
+    float tMax = maxDistance;
+    bool occluded = false;
+    Traverse(bvh.nodes, ray, tMax, [&](unsigned int leaf, float& closest) {
+        __m128 t, u, v;
+        occluded = IntersectPacket(packets[leaf], ray, closest, t, u, v) != 0;
+        return occluded;
+    });
+    return occluded;
+}
+
+void TriangleBvh::Overlap(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, std::vector<unsigned int>& outFaces) const {
+    if (bvh.nodes.empty()) return;
+    const __m128 loX = _mm_set1_ps(boxMin.x), loY = _mm_set1_ps(boxMin.y), loZ = _mm_set1_ps(boxMin.z);
+    const __m128 hiX = _mm_set1_ps(boxMax.x), hiY = _mm_set1_ps(boxMax.y), hiZ = _mm_set1_ps(boxMax.z);
+    auto overlaps = [&](__m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ) {
+        __m128 x = _mm_and_ps(_mm_cmple_ps(minX, hiX), _mm_cmpge_ps(maxX, loX));
+        __m128 y = _mm_and_ps(_mm_cmple_ps(minY, hiY), _mm_cmpge_ps(maxY, loY));
+        __m128 z = _mm_and_ps(_mm_cmple_ps(minZ, hiZ), _mm_cmpge_ps(maxZ, loZ));
+        return _mm_movemask_ps(_mm_and_ps(x, _mm_and_ps(y, z)));
+    };
+
+    int stack[TraversalStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Bvh4Node& node = bvh.nodes[stack[--top]];
+        int mask = overlaps(_mm_load_ps(node.minX), _mm_load_ps(node.minY), _mm_load_ps(node.minZ),
+            _mm_load_ps(node.maxX), _mm_load_ps(node.maxY), _mm_load_ps(node.maxZ));
+        for (int slot = 0; slot < 4; ++slot) {
+            if (!(mask & (1 << slot))) continue;
+            const int child = node.children[slot];
+            if (child >= 0) {
+                stack[top++] = child;
+                continue;
+            }
+
+            // Per triangle bounds straight from the packet, padding lanes never overlap
+            const TrianglePacket& packet = packets[~child];
+            const __m128 v0x = _mm_load_ps(packet.v0x), v0y = _mm_load_ps(packet.v0y), v0z = _mm_load_ps(packet.v0z);
+            const __m128 v1x = _mm_add_ps(v0x, _mm_load_ps(packet.e1x)), v1y = _mm_add_ps(v0y, _mm_load_ps(packet.e1y)), v1z = _mm_add_ps(v0z, _mm_load_ps(packet.e1z));
+            const __m128 v2x = _mm_add_ps(v0x, _mm_load_ps(packet.e2x)), v2y = _mm_add_ps(v0y, _mm_load_ps(packet.e2y)), v2z = _mm_add_ps(v0z, _mm_load_ps(packet.e2z));
+            int lanes = overlaps(_mm_min_ps(v0x, _mm_min_ps(v1x, v2x)), _mm_min_ps(v0y, _mm_min_ps(v1y, v2y)), _mm_min_ps(v0z, _mm_min_ps(v1z, v2z)),
+                _mm_max_ps(v0x, _mm_max_ps(v1x, v2x)), _mm_max_ps(v0y, _mm_max_ps(v1y, v2y)), _mm_max_ps(v0z, _mm_max_ps(v1z, v2z)));
+            for (int lane = 0; lane < 4; ++lane) {
+                if ((lanes & (1 << lane)) && packet.faces[lane] != 0xFFFFFFFFu) {
+                    outFaces.push_back(packet.faces[lane]);
+                }
+            }
+        }
+    }
+}
+
+void SceneBvh::Clear() {
+    instances.clear();
+    bvh.Clear();
+}
+
+void SceneBvh::Build(const std::vector<Model*>& models) {
+    Clear();
+    std::vector<DirectX::XMFLOAT3> boxMin, boxMax;
+    for (Model* model : models) {
+        if (!model || model->GetBvh().IsEmpty()) continue;
+        // The true world bounds, b may be padded for gameplay (see the diamonds)
+        BoundingBox world = model->TransformBounds(model->GetLocalBounds());
+        boxMin.push_back({ world.minX, world.minY, world.minZ });
+        boxMax.push_back({ world.maxX, world.maxY, world.maxZ });
+
+        Instance instance;
+        instance.model = model;
+        DirectX::XMStoreFloat4x4(&instance.worldToModel, DirectX::XMMatrixInverse(nullptr, model->GetModelMatrix()));
+        instances.push_back(instance);
+    }
+    bvh.Build(boxMin, boxMax);
+}
+
+bool SceneBvh::Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const {
+    DirectX::XMFLOAT3 unitDirection;
+    DirectX::XMVECTOR d = DirectX::XMLoadFloat3(&direction);
+    if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(d)) == 0.0f) return false;
+    DirectX::XMStoreFloat3(&unitDirection, DirectX::XMVector3Normalize(d));
+
+    // The model space ray keeps the parametrization, so model space hit distances are world distances
+    const Ray ray = MakeRay(origin, unitDirection);
+    float tMax = maxDistance;
+    bool found = false;
+    Traverse(bvh.nodes, ray, tMax, [&](unsigned int leaf, float& closest) {
+        const BvhLeaf& range = bvh.leaves[leaf];
+        for (unsigned int i = range.first; i < range.first + range.count; ++i) {
+            const Instance& instance = instances[bvh.order[i]];
+            DirectX::XMFLOAT3 localOrigin, localDirection;
+            TransformRay(instance.worldToModel, origin, unitDirection, localOrigin, localDirection);
+            RayHit local;
+            if (instance.model->GetBvh().Raycast(localOrigin, localDirection, closest, local)) {
+                closest = local.distance;
+                hit = local;
+                hit.model = instance.model;
+                found = true;
+            }
+        }
+        return false;
+    });
+    return found;
+}
+
+bool SceneBvh::Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, const Model* ignore) const {
+    DirectX::XMFLOAT3 unitDirection;
+    DirectX::XMVECTOR d = DirectX::XMLoadFloat3(&direction);
+    if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(d)) == 0.0f) return false;
+    DirectX::XMStoreFloat3(&unitDirection, DirectX::XMVector3Normalize(d));
+
+    const Ray ray = MakeRay(origin, unitDirection);
+    float tMax = maxDistance;
+    bool occluded = false;
+    Traverse(bvh.nodes, ray, tMax, [&](unsigned int leaf, float& closest) {
+        const BvhLeaf& range = bvh.leaves[leaf];
+        for (unsigned int i = range.first; i < range.first + range.count && !occluded; ++i) {
+            const Instance& instance = instances[bvh.order[i]];
+            if (instance.model == ignore) continue;
+            DirectX::XMFLOAT3 localOrigin, localDirection;
+            TransformRay(instance.worldToModel, origin, unitDirection, localOrigin, localDirection);
+            occluded = instance.model->GetBvh().Occluded(localOrigin, localDirection, closest);
+        }
+        return occluded;
+    });
+    return occluded;
+}
@@ -2,10 +2,25 @@
 #include <algorithm>
 #include <Audio.h>
 
+// Forward, right and up of the camera for a yaw and pitch
+static void Orient(float yaw, float pitch, DirectX::XMFLOAT3& outForward, DirectX::XMFLOAT3& outRight, DirectX::XMFLOAT3& outUp)
+{
+    DirectX::XMVECTOR forward = DirectX::XMVector3Normalize(DirectX::XMVectorSet(
+        sinf(yaw) * cosf(pitch), sinf(pitch), cosf(yaw) * cosf(pitch), 0.0f));
+    DirectX::XMVECTOR worldUp = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+    DirectX::XMVECTOR right = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(forward, worldUp));
+    DirectX::XMVECTOR up = DirectX::XMVector3Cross(right, forward);
+
+    DirectX::XMStoreFloat3(&outForward, forward);
+    DirectX::XMStoreFloat3(&outRight, right);
+    DirectX::XMStoreFloat3(&outUp, up);
+}
+
 Camera::Camera()
 {
-    // Set initial camera position
-    cameraPos = { 20.0f, 10.0f, -60.0f };
+    // Set initial camera position, standing on the ground
+    controller.position = { 20.0f, 0.0f, -60.0f };
+    cameraPos = { 20.0f, eyeHeight, -60.0f };
     cameraForward = { 0.0f, 0.0f, 1.0f };
     cameraUp = { 0.0f, 1.0f, 0.0f };
     cameraRight = { 1.0f, 0.0f, 0.0f };
@@ -15,6 +30,7 @@ Camera::Camera()
     mouseSensitivity = 0.005f;
     
     UpdateCameraVectors();
+    BeginStep();
 }
 
 Camera::~Camera()
@@ -24,97 +40,91 @@ Camera::~Camera()
 bool Camera::IsLookingAtModel(Model* model, float threshold) {
     if (!model) return false;
 
-    // Get model position
-    DirectX::XMFLOAT3 modelPos = model->GetPosition();
-
-    // Calculate direction from camera to model
-    DirectX::XMFLOAT3 toModel;
-    toModel.x = modelPos.x - cameraPos.x;
-    toModel.y = modelPos.y - cameraPos.y;
-    toModel.z = modelPos.z - cameraPos.z;
-
-    // Normalize the direction to model
-    DirectX::XMVECTOR toModelVec = DirectX::XMLoadFloat3(&toModel);
-    toModelVec = DirectX::XMVector3Normalize(toModelVec);
+    // Looking straight at any visible part of it
+    RayHit hit;
+    if (scene && scene->Raycast(cameraPos, cameraForward, gazeDistance, hit) && hit.model == model) {
+        return true;
+    }
 
-    // Get camera forward vector
-    DirectX::XMVECTOR forwardVec = DirectX::XMLoadFloat3(&cameraForward);
+    // Aim at the middle of the world bounds, the model origin is usually at its feet
+    const BoundingBox& bounds = model->b;
+    DirectX::XMFLOAT3 modelCenter = {
+        (bounds.minX + bounds.maxX) * 0.5f,
+        (bounds.minY + bounds.maxY) * 0.5f,
+        (bounds.minZ + bounds.maxZ) * 0.5f };
 
-    // Calculate dot product
-    DirectX::XMVECTOR dotVec = DirectX::XMVector3Dot(forwardVec, toModelVec);
-    float dot = DirectX::XMVectorGetX(dotVec);
+    // Calculate direction from camera to model
+    DirectX::XMVECTOR toModelVec = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&modelCenter), DirectX::XMLoadFloat3(&cameraPos));
+    float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(toModelVec));
+    if (distance <= 0.0f) return true;
+    toModelVec = DirectX::XMVectorScale(toModelVec, 1.0f / distance);
 
     // Check if dot product exceeds threshold (closer to 1.0 means more aligned)
-    return dot >= threshold;
+    float dot = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMLoadFloat3(&cameraForward), toModelVec));
+    if (dot < threshold) return false;
+
+    // Inside the cone, visible unless another model is in the way
+    if (!scene) return true;
+    DirectX::XMFLOAT3 toModel;
+    DirectX::XMStoreFloat3(&toModel, toModelVec);
+    return !scene->Occluded(cameraPos, toModel, distance, model);
 }
 
-bool Camera::CheckCollision(const DirectX::XMFLOAT3& newPosition) {
-    if (!models) return false;
-
-    // Create a bounding box around the camera position
-    BoundingBox cameraBounds;
-    cameraBounds.SetBbox(newPosition.x - collisionRadius, 
-        newPosition.x + collisionRadius, 
-        newPosition.z - collisionRadius, 
-        newPosition.z + collisionRadius,
-        10.0f,
-        10.0f);
-
-	bool isColliding = false;
-
-    // Check collision with each model
-    for (const auto& model : *models) {
-        if (cameraBounds.Intersects(model->b, cameraBounds)) {
-            if (model->isRemovable) {
-                collectedDiamonds.push_back(model);
-                break;
-            }
-            else {
-                isColliding = true;
-                break;
-            }
+void Camera::CollectPickups() {
+    if (!broadphase || !entities) return;
+
+    const DirectX::XMFLOAT3& feet = controller.position;
+    BoundingBox capsuleBounds;
+    capsuleBounds.SetBbox(feet.x - controller.radius, feet.x + controller.radius,
+        feet.z - controller.radius, feet.z + controller.radius,
+        feet.y, feet.y + controller.height);
+
+    nearbyProxies.clear();
+    broadphase->Query(capsuleBounds, nearbyProxies);
+    for (unsigned int proxy : nearbyProxies) {
+        Model* model = broadphase->GetModel(proxy);
+        if (entities->HasFlags(model->entity, EntityRemovable) && entities->GetPickupBounds(model->entity).Intersects(capsuleBounds)) {
+            collectedDiamonds.push_back(model->entity);
         }
     }
+}
 
-    return isColliding; // No collision
+void Camera::Walk(const DirectX::XMFLOAT3& displacement)
+{
+    controller.Move(displacement);
+    if (controller.IsGrounded()) fallSpeed = 0.0f;
+    cameraPos = { controller.position.x, controller.position.y + eyeHeight, controller.position.z };
+    CollectPickups();
 }
 
 void Camera::PanForward(float dir)
 {
-    //cameraPos.x += sin(yaw) * dir;
-    //cameraPos.z += cos(yaw) * dir;
-
-    // Keep camera at fixed walking height
-    const float walkingHeight = 5.0f;
-    //cameraPos.y = walkingHeight;
-
-    DirectX::XMFLOAT3 newPos;
-    newPos.x = cameraPos.x + sin(yaw) * dir;
-    newPos.y = walkingHeight;
-    newPos.z = cameraPos.z + cos(yaw) * dir;
-
-    if (!CheckCollision(newPos)) {
-        cameraPos = newPos;
-    }
+    // Swept, so a long step can't pass through thin walls, and blocked steps slide along them
+    Walk({ sinf(yaw) * dir, 0.0f, cosf(yaw) * dir });
 }
 
 void Camera::PanRight(float dir)
 {
-    //cameraPos.x += sin(yaw + DirectX::XM_PIDIV2) * dir;
-    //cameraPos.z += cos(yaw + DirectX::XM_PIDIV2) * dir;
-
-    // Keep camera at fixed walking height
-    const float walkingHeight = 5.0f;
-    //cameraPos.y = walkingHeight;
+    Walk({ sinf(yaw + DirectX::XM_PIDIV2) * dir, 0.0f, cosf(yaw + DirectX::XM_PIDIV2) * dir });
+}
 
-    DirectX::XMFLOAT3 newPos;
-    newPos.x = cameraPos.x + sin(yaw + DirectX::XM_PIDIV2) * dir;
-    newPos.y = walkingHeight;
-    newPos.z = cameraPos.z + cos(yaw + DirectX::XM_PIDIV2) * dir;
+void Camera::Move(float forward, float right, float deltaTime)
+{
+    const float length = sqrtf(forward * forward + right * right);
+    if (length <= 0.0f) return;
+    const float scale = moveSpeed * deltaTime / std::max(length, 1.0f);
+    forward *= scale;
+    right *= scale;
+    // One sweep for both, so a diagonal step slides along walls like a straight one
+    Walk({ sinf(yaw) * forward + sinf(yaw + DirectX::XM_PIDIV2) * right, 0.0f,
+        cosf(yaw) * forward + cosf(yaw + DirectX::XM_PIDIV2) * right });
+}
 
-    if (!CheckCollision(newPos)) {
-        cameraPos = newPos;
-    }
+void Camera::Update(float deltaTime)
+{
+    if (controller.IsGrounded()) return;
+    fallSpeed += gravity * deltaTime;
+    Walk({ 0.0f, -fallSpeed * deltaTime, 0.0f });
 }
 
 void Camera::MouseMovement(float dx, float dy)
@@ -131,21 +141,24 @@ void Camera::MouseMovement(float dx, float dy)
 
 void Camera::UpdateCameraVectors()
 {
-    // Calculate new forward vector based on yaw and pitch
-    cameraForward.x = sin(yaw) * cos(pitch);
-    cameraForward.y = sin(pitch);
-    cameraForward.z = cos(yaw) * cos(pitch);
-
-    // Normalize forward vector
-    DirectX::XMVECTOR forward = DirectX::XMLoadFloat3(&cameraForward);
-    forward = DirectX::XMVector3Normalize(forward);
-    DirectX::XMStoreFloat3(&cameraForward, forward);
+    Orient(yaw, pitch, cameraForward, cameraRight, cameraUp);
+}
 
-    // Calculate right and up vectors
-    DirectX::XMVECTOR worldUp = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-    DirectX::XMVECTOR right = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(forward, worldUp));
-    DirectX::XMVECTOR up = DirectX::XMVector3Cross(right, forward);
+void Camera::BeginStep()
+{
+    previousPos = cameraPos;
+    previousYaw = yaw;
+    previousPitch = pitch;
+}
 
-    DirectX::XMStoreFloat3(&cameraRight, right);
-    DirectX::XMStoreFloat3(&cameraUp, up);
+CameraView Camera::GetView(float alpha) const
+{
+    CameraView view;
+    DirectX::XMStoreFloat3(&view.position, DirectX::XMVectorLerp(
+        DirectX::XMLoadFloat3(&previousPos), DirectX::XMLoadFloat3(&cameraPos), alpha));
+    // yaw isn't wrapped, blending the angles never takes the long way around
+    DirectX::XMFLOAT3 right;
+    Orient(previousYaw + (yaw - previousYaw) * alpha, previousPitch + (pitch - previousPitch) * alpha,
+        view.forward, right, view.up);
+    return view;
 }
@@ -0,0 +1,351 @@
+#include "CharacterController.h"
+#include "Collision.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using DirectX::XMVECTOR;
+
+// Conservative advancement steps per shape before the sweep gives up and stops where it is
+constexpr int MaxAdvanceIterations = 24;
+constexpr int MaxSlideIterations = 4;
+constexpr int MaxDepenetrationIterations = 4;
+
+XMVECTOR Load(const DirectX::XMFLOAT3& v) { return DirectX::XMLoadFloat3(&v); }
+
+DirectX::XMFLOAT3 Store(XMVECTOR v) {
+    DirectX::XMFLOAT3 out;
+    DirectX::XMStoreFloat3(&out, v);
+    return out;
+}
+
+float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+float Length(const DirectX::XMFLOAT3& v) { return sqrtf(Dot(v, v)); }
+
+DirectX::XMFLOAT3 Add(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, float scale = 1.0f) {
+    return { a.x + b.x * scale, a.y + b.y * scale, a.z + b.z * scale };
+}
+
+void Grow(BoundingBox& box, float amount) {
+    box.minX -= amount;
+    box.maxX += amount;
+    box.minY -= amount;
+    box.maxY += amount;
+    box.minZ -= amount;
+    box.maxZ += amount;
+}
+
+BoundingBox Union(const BoundingBox& a, const BoundingBox& b) {
+    BoundingBox box;
+    box.SetBbox(std::min(a.minX, b.minX), std::max(a.maxX, b.maxX), std::min(a.minZ, b.minZ), std::max(a.maxZ, b.maxZ),
+        std::min(a.minY, b.minY), std::max(a.maxY, b.maxY));
+    return box;
+}
+
+// Distance between the capsule core [a, b] and a shape, with the unit normal from the shape
+// towards the core. Overlapping shapes get a best guess normal, depenetration is all it is used for.
+float ShapeDistance(const ConvexHull& hull, const DirectX::XMFLOAT4X4& world, const BoundingBox& bounds,
+    const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, DirectX::XMFLOAT3& normal) {
+    float distance = DistanceSegmentToHull(hull, DirectX::XMLoadFloat4x4(&world), a, b, normal);
+    if (distance == 0.0f) {
+        DirectX::XMFLOAT3 away = {
+            (a.x + b.x) * 0.5f - (bounds.minX + bounds.maxX) * 0.5f, 0.0f,
+            (a.z + b.z) * 0.5f - (bounds.minZ + bounds.maxZ) * 0.5f };
+        float length = Length(away);
+        normal = length > 0.0f ? DirectX::XMFLOAT3{ away.x / length, 0.0f, away.z / length } : DirectX::XMFLOAT3{ 0.0f, 1.0f, 0.0f };
+    }
+    return distance;
+}
+
+float ShapeDistance(const DirectX::XMFLOAT3 (&corners)[3], const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, DirectX::XMFLOAT3& normal) {
+    DirectX::XMFLOAT3 onSegment, onTriangle;
+    float distance = ClosestPointsSegmentTriangle(a, b, corners[0], corners[1], corners[2], onSegment, onTriangle);
+    if (distance > 1e-6f) {
+        normal = { (onSegment.x - onTriangle.x) / distance, (onSegment.y - onTriangle.y) / distance, (onSegment.z - onTriangle.z) / distance };
+        return distance;
+    }
+
+    // The core crosses the triangle, take the face normal on the side of the upper end
+    XMVECTOR face = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(Load(corners[1]), Load(corners[0])), DirectX::XMVectorSubtract(Load(corners[2]), Load(corners[0])));
+    face = DirectX::XMVector3Normalize(face);
+    if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(face, DirectX::XMVectorSubtract(Load(b), Load(corners[0])))) < 0.0f) {
+        face = DirectX::XMVectorNegate(face);
+    }
+    normal = Store(face);
+    if (Dot(normal, normal) == 0.0f) normal = { 0.0f, 1.0f, 0.0f };
+    return distance;
+}
+
+// Time of impact by conservative advancement: under pure translation the distance can't shrink
+// faster than the displacement is long, so stepping by the current gap never steps through the
+// shape. Returns true with fraction set when the capsule gets within the skin before fraction.
+template <typename Distance>
+bool Advance(Distance distanceAt, const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& displacement,
+    float length, float radius, float skin, float& fraction, DirectX::XMFLOAT3& normal) {
+    float t = 0.0f;
+    DirectX::XMFLOAT3 n;
+    for (int iteration = 0; iteration < MaxAdvanceIterations; ++iteration) {
+        float gap = distanceAt(Add(a, displacement, t), Add(b, displacement, t), n) - radius;
+        if (gap <= skin) {
+            // Touching at the start only blocks when the move heads into the shape, so resting on
+            // the ground or sliding along a wall goes on
+            if (t == 0.0f && Dot(n, displacement) >= 0.0f) return false;
+            fraction = t;
+            normal = n;
+            return true;
+        }
+        t += (gap - 0.5f * skin) / length;
+        if (t >= fraction) return false;
+    }
+    // Grazing approach, stop short rather than keep iterating
+    fraction = t;
+    normal = n;
+    return true;
+}
+
+}
+
+BoundingBox CharacterController::CapsuleBounds(const DirectX::XMFLOAT3& feet) const {
+    BoundingBox box;
+    box.SetBbox(feet.x - radius, feet.x + radius, feet.z - radius, feet.z + radius, feet.y, feet.y + std::max(height, 2.0f * radius));
+    return box;
+}
+
+void CharacterController::GatherTriangles(Model* model, const BoundingBox& region) {
+    const TriangleBvh& bvh = model->GetBvh();
+    if (bvh.IsEmpty()) return;
+
+    // The region in model space, the box of its transformed corners
+    DirectX::XMMATRIX world = model->GetModelMatrix();
+    DirectX::XMMATRIX toModel = DirectX::XMMatrixInverse(nullptr, world);
+    XMVECTOR lo = DirectX::XMVectorReplicate(FLT_MAX), hi = DirectX::XMVectorReplicate(-FLT_MAX);
+    for (int corner = 0; corner < 8; ++corner) {
+        XMVECTOR p = DirectX::XMVectorSet(corner & 1 ? region.maxX : region.minX, corner & 2 ? region.maxY : region.minY, corner & 4 ? region.maxZ : region.minZ, 1.0f);
+        p = DirectX::XMVector3TransformCoord(p, toModel);
+        lo = DirectX::XMVectorMin(lo, p);
+        hi = DirectX::XMVectorMax(hi, p);
+    }
+
+    faces.clear();
+    bvh.Overlap(Store(lo), Store(hi), faces);
+    const std::vector<Vertex>& vertices = model->GetVertices();
+    const std::vector<unsigned int>& indices = model->GetIndices();
+    for (unsigned int face : faces) {
+        TriangleShape triangle;
+        triangle.model = model;
+        for (int k = 0; k < 3; ++k) {
+            triangle.corners[k] = Store(DirectX::XMVector3TransformCoord(Load(vertices[indices[face * 3 + k]].position), world));
+        }
+        const DirectX::XMFLOAT3* c = triangle.corners;
+        triangle.bounds.SetBbox(
+            std::min({ c[0].x, c[1].x, c[2].x }), std::max({ c[0].x, c[1].x, c[2].x }),
+            std::min({ c[0].z, c[1].z, c[2].z }), std::max({ c[0].z, c[1].z, c[2].z }),
+            std::min({ c[0].y, c[1].y, c[2].y }), std::max({ c[0].y, c[1].y, c[2].y }));
+        triangles.push_back(triangle);
+    }
+}
+
+void CharacterController::Gather(const BoundingBox& region) {
+    hulls.clear();
+    triangles.clear();
+
+    auto gatherModel = [&](Model* model) {
+        if (!model || model == self || (entities && entities->HasFlags(model->entity, EntityRemovable))) return;
+        if (!model->HasCollisionHulls()) {
+            GatherTriangles(model, region);
+            return;
+        }
+        DirectX::XMFLOAT4X4 world;
+        DirectX::XMStoreFloat4x4(&world, model->GetModelMatrix());
+        for (const ConvexHull& hull : model->GetCollisionHulls()) {
+            BoundingBox local;
+            local.SetBbox(hull.boundsMin.x, hull.boundsMax.x, hull.boundsMin.z, hull.boundsMax.z, hull.boundsMin.y, hull.boundsMax.y);
+            BoundingBox bounds = model->TransformBounds(local);
+            if (!hull.IsEmpty() && bounds.Intersects(region)) {
+                hulls.push_back({ &hull, world, bounds, model });
+            }
+        }
+    };
+
+    if (broadphase) {
+        proxies.clear();
+        broadphase->Query(region, proxies);
+        for (unsigned int proxy : proxies) {
+            gatherModel(broadphase->GetModel(proxy));
+        }
+    }
+    for (Model* model : terrain) {
+        gatherModel(model);
+    }
+}
+
+bool CharacterController::SweepGathered(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& displacement, CapsuleHit& hit) const {
+    const float length = Length(displacement);
+    if (length <= 0.0f) return false;
+
+    BoundingBox swept = Union(CapsuleBounds(from), CapsuleBounds(Add(from, displacement)));
+    Grow(swept, skinWidth);
+    const DirectX::XMFLOAT3 a = { from.x, from.y + radius, from.z };
+    const DirectX::XMFLOAT3 b = { from.x, from.y + std::max(height - radius, radius), from.z };
+
+    bool found = false;
+    float fraction = 1.0f;
+    DirectX::XMFLOAT3 normal;
+    for (const HullShape& shape : hulls) {
+        if (!shape.bounds.Intersects(swept)) continue;
+        auto distanceAt = [&](const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT3& q, DirectX::XMFLOAT3& n) {
+            return ShapeDistance(*shape.hull, shape.world, shape.bounds, p, q, n);
+        };
+        if (Advance(distanceAt, a, b, displacement, length, radius, skinWidth, fraction, normal)) {
+            found = true;
+            hit.fraction = fraction;
+            hit.normal = normal;
+            hit.model = shape.model;
+        }
+    }
+    for (const TriangleShape& shape : triangles) {
+        if (!shape.bounds.Intersects(swept)) continue;
+        auto distanceAt = [&](const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT3& q, DirectX::XMFLOAT3& n) {
+            return ShapeDistance(shape.corners, p, q, n);
+        };
+        if (Advance(distanceAt, a, b, displacement, length, radius, skinWidth, fraction, normal)) {
+            found = true;
+            hit.fraction = fraction;
+            hit.normal = normal;
+            hit.model = shape.model;
+        }
+    }
+    return found;
+}
+
+bool CharacterController::Sweep(const DirectX::XMFLOAT3& displacement, CapsuleHit& hit) {
+    BoundingBox region = Union(CapsuleBounds(position), CapsuleBounds(Add(position, displacement)));
+    Grow(region, skinWidth);
+    Gather(region);
+    return SweepGathered(position, displacement, hit);
+}
+
+DirectX::XMFLOAT3 CharacterController::SweepAndMove(const DirectX::XMFLOAT3& displacement, CapsuleHit& hit, bool& blocked) {
+    hit = CapsuleHit();
+    blocked = SweepGathered(position, displacement, hit);
+    position = Add(position, displacement, hit.fraction);
+    return blocked ? Add(displacement, displacement, -hit.fraction) : DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
+}
+
+void CharacterController::Depenetrate() {
+    for (int iteration = 0; iteration < MaxDepenetrationIterations; ++iteration) {
+        BoundingBox bounds = CapsuleBounds(position);
+        const DirectX::XMFLOAT3 a = { position.x, position.y + radius, position.z };
+        const DirectX::XMFLOAT3 b = { position.x, position.y + std::max(height - radius, radius), position.z };
+
+        // Pushes out of the deepest overlap first, the next iteration sees what is left
+        float deepest = 0.0f;
+        DirectX::XMFLOAT3 push = { 0.0f, 0.0f, 0.0f };
+        auto consider = [&](float distance, const DirectX::XMFLOAT3& normal) {
+            float depth = radius - distance;
+            if (depth > deepest) {
+                deepest = depth;
+                push = normal;
+            }
+        };
+        for (const HullShape& shape : hulls) {
+            if (!shape.bounds.Intersects(bounds)) continue;
+            DirectX::XMFLOAT3 normal;
+            float distance = ShapeDistance(*shape.hull, shape.world, shape.bounds, a, b, normal);
+            consider(distance, normal);
+        }
+        for (const TriangleShape& shape : triangles) {
+            if (!shape.bounds.Intersects(bounds)) continue;
+            DirectX::XMFLOAT3 normal;
+            float distance = ShapeDistance(shape.corners, a, b, normal);
+            consider(distance, normal);
+        }
+        if (deepest <= 0.0f) return;
+        position = Add(position, push, deepest + 0.5f * skinWidth);
+    }
+}
+
+unsigned int CharacterController::Move(const DirectX::XMFLOAT3& displacement) {
+    const DirectX::XMFLOAT3 horizontal = { displacement.x, 0.0f, displacement.z };
+    const float horizontalLength = Length(horizontal);
+    const float rise = std::max(displacement.y, 0.0f);
+    const float fall = std::max(-displacement.y, 0.0f);
+    const bool wasGrounded = grounded;
+
+    // Everything the three passes can reach, gathered once
+    BoundingBox region = CapsuleBounds(position);
+    Grow(region, Length(displacement) + stepOffset + snapDistance + skinWidth);
+    Gather(region);
+    Depenetrate();
+
+    const DirectX::XMFLOAT3 start = position;
+    auto passes = [&](bool step, bool& steepLanding) {
+        unsigned int flags = CollisionNone;
+        CapsuleHit hit;
+        bool blocked;
+        steepLanding = false;
+
+        // Up: a walking capsule lifts by the step height so ledges below it don't block the side pass
+        const float stepUp = step && wasGrounded && horizontalLength > 0.0f ? stepOffset : 0.0f;
+        float stepped = 0.0f;
+        if (rise + stepUp > 0.0f) {
+            const float before = position.y;
+            SweepAndMove({ 0.0f, rise + stepUp, 0.0f }, hit, blocked);
+            if (blocked) flags |= CollisionAbove;
+            stepped = std::max(0.0f, position.y - before - rise);
+        }
+
+        // Side: slide along walls. Their normals are flattened, climbing is left to the step.
+        DirectX::XMFLOAT3 remaining = horizontal;
+        for (int iteration = 0; iteration < MaxSlideIterations && Length(remaining) > 1e-5f; ++iteration) {
+            DirectX::XMFLOAT3 left = SweepAndMove(remaining, hit, blocked);
+            if (!blocked) break;
+            flags |= CollisionSides;
+            if (hit.normal.y >= slopeLimit) {
+                // Walkable slope, the move follows it up
+                remaining = Add(left, hit.normal, -Dot(left, hit.normal));
+            }
+            else {
+                DirectX::XMFLOAT3 wall = { hit.normal.x, 0.0f, hit.normal.z };
+                float wallLength = Length(wall);
+                if (wallLength < 1e-4f) break;
+                wall = { wall.x / wallLength, 0.0f, wall.z / wallLength };
+                remaining = Add(left, wall, -Dot(left, wall));
+            }
+            // Never turn back, that is how corners make a capsule jitter
+            if (Dot(remaining, horizontal) <= 0.0f) break;
+        }
+
+        // Down: undo the step and follow the ground, a free fall only goes as far as asked
+        grounded = false;
+        const float snap = wasGrounded ? snapDistance : 0.0f;
+        const float drop = stepped + fall + snap;
+        if (drop > 0.0f) {
+            SweepAndMove({ 0.0f, -drop, 0.0f }, hit, blocked);
+            if (!blocked) {
+                position.y += snap;
+            }
+            else if (hit.normal.y >= slopeLimit) {
+                grounded = true;
+                groundNormal = hit.normal;
+                flags |= CollisionBelow;
+            }
+            else {
+                steepLanding = hit.normal.y > 0.0f;
+                if (steepLanding) flags |= CollisionBelow;
+            }
+        }
+        return flags;
+    };
+
+    bool steepLanding;
+    unsigned int flags = passes(true, steepLanding);
+    if (steepLanding && wasGrounded && horizontalLength > 0.0f) {
+        // Stepped onto a slope too steep to stand on, walk into it instead
+        position = start;
+        grounded = wasGrounded;
+        flags = passes(false, steepLanding);
+    }
+    return flags;
+}
@@ -0,0 +1,486 @@
+#include "ChunkStreamer.h"
+#include "Scatter.h"
+#include "File.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t ChunkCacheMagic = 0x4B4E4843; // "CHNK"
+constexpr uint32_t ChunkCacheVersion = 1;
+
+// Geometry and RGBA textures of a mesh, once in memory and once more on the GPU
+size_t MeshBytes(const Model& model) {
+    size_t bytes = model.GetVertices().size() * sizeof(Vertex) + model.GetIndices().size() * sizeof(unsigned int);
+    for (const Material& material : model.GetMaterials()) {
+        bytes += static_cast<size_t>(material.textureImage.GetWidth()) * material.textureImage.GetHeight() * 4;
+    }
+    return 2 * bytes;
+}
+
+// What every instance adds on top of the shared mesh: the Model with its transform, and its
+// entry in the Renderer's per-instance constants
+constexpr size_t InstanceBytes = sizeof(Model) + InstanceConstantsSize;
+
+// Every chunk scatters with its own stream, neighbours don't repeat each other
+uint32_t ChunkSeed(uint32_t seed, int chunk) {
+    uint32_t h = seed ^ (static_cast<uint32_t>(chunk) * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+}
+
+ChunkStreamer::~ChunkStreamer() {
+    // Resident models belong to the entity store by now, only unapplied reads are ours
+    for (std::unique_ptr<PendingLoad>& load : loads) {
+        JobSystem::Get().Wait(load->counter);
+        for (auto& model : load->models) delete model.first;
+        delete load->ground;
+    }
+}
+
+ChunkStreamerStats ChunkStreamer::Build(float minX, float minZ, float maxX, float maxZ, uint32_t seed,
+    const std::vector<ChunkLayer>& layers, const std::vector<BoundingBox>& obstacles, const Model* groundTemplate,
+    const std::string& cacheName, const ChunkStreamerOptions& options)
+{
+    Clear();
+    this->minX = std::min(minX, maxX);
+    this->minZ = std::min(minZ, maxZ);
+    this->options = options;
+    this->options.chunkSize = std::max(options.chunkSize, 1e-3f);
+    this->options.unloadRadius = std::max(options.unloadRadius, options.loadRadius);
+    const float chunkSize = this->options.chunkSize;
+    chunksX = std::max(1, static_cast<int>(std::ceil((std::max(minX, maxX) - this->minX) / chunkSize)));
+    chunksZ = std::max(1, static_cast<int>(std::ceil((std::max(minZ, maxZ) - this->minZ) / chunkSize)));
+    states.assign(static_cast<size_t>(chunksX) * chunksZ, ChunkUnloaded);
+    stats.chunks = static_cast<unsigned int>(states.size());
+
+    this->layers = layers;
+    for (const ChunkLayer& layer : layers) {
+        layerMeshBytes.push_back(layer.source ? MeshBytes(*layer.source) : 0);
+    }
+    layerUsers.assign(layers.size(), 0);
+    if (groundTemplate) {
+        // Stretched in XZ over exactly one chunk
+        ground = std::make_shared<Model>(*groundTemplate);
+        const DirectX::XMFLOAT3 scale = groundTemplate->GetScale();
+        const float width = std::max(groundTemplate->b.maxX - groundTemplate->b.minX, 1e-3f);
+        const float depth = std::max(groundTemplate->b.maxZ - groundTemplate->b.minZ, 1e-3f);
+        ground->SetScale(scale.x * chunkSize / width, scale.y, scale.z * chunkSize / depth);
+        groundMeshBytes = MeshBytes(*ground);
+    }
+
+    // FNV-1a over the world, the layers and the obstacles, another seed or a moved cabin bakes again
+    uint64_t key = 0xCBF29CE484222325ull;
+    auto hashBytes = [&key](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) key = (key ^ bytes[i]) * 0x100000001B3ull;
+    };
+    const float world[] = { this->minX, this->minZ, chunkSize, static_cast<float>(chunksX), static_cast<float>(chunksZ) };
+    hashBytes(world, sizeof(world));
+    hashBytes(&seed, sizeof(seed));
+    for (const ChunkLayer& layer : layers) {
+        const float values[] = { layer.source ? PoissonScatter::FootprintRadius(*layer.source) : 0.0f, static_cast<float>(layer.perChunk) };
+        hashBytes(values, sizeof(values));
+    }
+    for (const BoundingBox& obstacle : obstacles) {
+        const float bounds[] = { obstacle.minX, obstacle.minZ, obstacle.maxX, obstacle.maxZ };
+        hashBytes(bounds, sizeof(bounds));
+    }
+
+    std::filesystem::path cachePath;
+    if (!cacheName.empty()) {
+        cachePath = std::filesystem::path(GetExecutablePath()) / "cache" / cacheName;
+        if (Load(cachePath.string(), key)) {
+            stats.loadedFromCache = true;
+            return stats;
+        }
+    }
+
+    std::vector<Instance> instances;
+    Bake(seed, obstacles, instances);
+    stats.bakedInstances = static_cast<unsigned int>(instances.size());
+
+    bool saved = false;
+    if (!cachePath.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(cachePath.parent_path(), error);
+        saved = Save(cachePath.string(), key, instances);
+        if (!saved) std::cerr << "Failed to write chunk cache: " << cachePath.string() << std::endl;
+    }
+    if (saved) path = cachePath.string();
+    else unsavedInstances.swap(instances);
+    return stats;
+}
+
+void ChunkStreamer::Clear() {
+    for (std::unique_ptr<PendingLoad>& load : loads) {
+        JobSystem::Get().Wait(load->counter);
+        for (auto& model : load->models) delete model.first;
+        delete load->ground;
+    }
+    loads.clear();
+    while (!residents.empty()) {
+        Unload(residents.begin()->first);
+    }
+
+    chunksX = chunksZ = 0;
+    layers.clear();
+    layerMeshBytes.clear();
+    layerUsers.clear();
+    ground.reset();
+    groundMeshBytes = 0;
+    groundUsers = 0;
+    path.clear();
+    dataOffset = 0;
+    ranges.clear();
+    unsavedInstances.clear();
+    states.clear();
+    stats = ChunkStreamerStats();
+}
+
+void ChunkStreamer::Bake(uint32_t seed, const std::vector<BoundingBox>& obstacles, std::vector<Instance>& outInstances) {
+    const float chunkSize = options.chunkSize;
+    std::vector<float> radii;
+    float inset = 0.0f;
+    for (const ChunkLayer& layer : layers) {
+        radii.push_back(layer.source ? PoissonScatter::FootprintRadius(*layer.source) : 0.0f);
+        inset = std::max(inset, radii.back());
+    }
+    // A chunk narrower than two footprints gets nothing
+    const bool fits = 2.0f * inset < chunkSize;
+
+    std::vector<std::vector<Instance>> perChunk(states.size());
+    JobSystem::Get().ParallelFor(states.size(), [&](size_t begin, size_t end) {
+        std::vector<ScatterPoint> points;
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            const float x0 = minX + static_cast<float>(chunk % chunksX) * chunkSize;
+            const float z0 = minZ + static_cast<float>(chunk / chunksX) * chunkSize;
+            PoissonScatter scatter(x0 + inset, z0 + inset, x0 + chunkSize - inset, z0 + chunkSize - inset, ChunkSeed(seed, static_cast<int>(chunk)));
+            for (const BoundingBox& obstacle : obstacles) {
+                if (obstacle.maxX < x0 || obstacle.minX > x0 + chunkSize || obstacle.maxZ < z0 || obstacle.minZ > z0 + chunkSize) continue;
+                scatter.AddObstacle(obstacle);
+            }
+
+            for (uint32_t l = 0; l < layers.size() && fits; ++l) {
+                if (!layers[l].source || layers[l].perChunk == 0) continue;
+                ScatterLayer layer;
+                layer.radius = radii[l];
+                layer.minDistance = scatter.SpacingForCount(layers[l].perChunk);
+                layer.maxCount = layers[l].perChunk;
+                points.clear();
+                scatter.Scatter(layer, points);
+                for (const ScatterPoint& point : points) {
+                    perChunk[chunk].push_back({ l, point.x, point.z });
+                }
+            }
+        }
+    });
+
+    ranges.resize(states.size());
+    for (size_t chunk = 0; chunk < states.size(); ++chunk) {
+        ranges[chunk] = { static_cast<uint32_t>(outInstances.size()), static_cast<uint32_t>(perChunk[chunk].size()) };
+        outInstances.insert(outInstances.end(), perChunk[chunk].begin(), perChunk[chunk].end());
+    }
+}
+
+bool ChunkStreamer::Save(const std::string& file, uint64_t key, const std::vector<Instance>& instances) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    // The manifest first, a chunk's instances are read on their own from behind it
+    uint32_t header[2] = { ChunkCacheMagic, ChunkCacheVersion };
+    uint32_t counts[2] = { static_cast<uint32_t>(ranges.size()), static_cast<uint32_t>(instances.size()) };
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    out.write(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(ChunkRange));
+    out.write(reinterpret_cast<const char*>(instances.data()), instances.size() * sizeof(Instance));
+    dataOffset = sizeof(header) + sizeof(key) + sizeof(counts) + ranges.size() * sizeof(ChunkRange);
+    return out.good();
+}
+
+bool ChunkStreamer::Load(const std::string& file, uint64_t key) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    uint32_t header[2] = {};
+    uint64_t fileKey = 0;
+    uint32_t counts[2] = {};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+    in.read(reinterpret_cast<char*>(counts), sizeof(counts));
+    if (!in || header[0] != ChunkCacheMagic || header[1] != ChunkCacheVersion || fileKey != key) return false;
+    if (counts[0] != states.size()) return false;
+
+    std::vector<ChunkRange> loadedRanges(counts[0]);
+    in.read(reinterpret_cast<char*>(loadedRanges.data()), loadedRanges.size() * sizeof(ChunkRange));
+    if (!in) return false;
+    for (const ChunkRange& range : loadedRanges) {
+        if (range.first > counts[1] || range.count > counts[1] - range.first) return false;
+    }
+    dataOffset = sizeof(header) + sizeof(fileKey) + sizeof(counts) + loadedRanges.size() * sizeof(ChunkRange);
+    in.seekg(0, std::ios::end);
+    if (static_cast<uint64_t>(in.tellg()) < dataOffset + static_cast<uint64_t>(counts[1]) * sizeof(Instance)) return false;
+
+    ranges.swap(loadedRanges);
+    path = file;
+    stats.bakedInstances = counts[1];
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming
+// ---------------------------------------------------------------------------
+
+int ChunkStreamer::GetChunk(const DirectX::XMFLOAT3& p) const {
+    if (states.empty()) return -1;
+    const float cx = std::floor((p.x - minX) / options.chunkSize);
+    const float cz = std::floor((p.z - minZ) / options.chunkSize);
+    if (cx < 0.0f || cz < 0.0f || cx >= static_cast<float>(chunksX) || cz >= static_cast<float>(chunksZ)) return -1;
+    return static_cast<int>(cz) * chunksX + static_cast<int>(cx);
+}
+
+float ChunkStreamer::DistanceSq(int chunk, const DirectX::XMFLOAT3& p) const {
+    const float x0 = minX + static_cast<float>(chunk % chunksX) * options.chunkSize;
+    const float z0 = minZ + static_cast<float>(chunk / chunksX) * options.chunkSize;
+    const float dx = std::max({ x0 - p.x, 0.0f, p.x - (x0 + options.chunkSize) });
+    const float dz = std::max({ z0 - p.z, 0.0f, p.z - (z0 + options.chunkSize) });
+    return dx * dx + dz * dz;
+}
+
+size_t ChunkStreamer::EstimateBytes(int chunk) const {
+    size_t bytes = ranges[chunk].count * InstanceBytes;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        if (layerUsers[l] == 0 && layers[l].perChunk > 0) bytes += layerMeshBytes[l];
+    }
+    if (ground) bytes += InstanceBytes + (groundUsers == 0 ? groundMeshBytes : 0);
+    return bytes;
+}
+
+bool ChunkStreamer::Update(const DirectX::XMFLOAT3& cameraPos) {
+    if (states.empty() || !entities) return false;
+    bool changed = false;
+
+    // The chunk under the camera holds its ground, it can't wait for a later frame
+    const int current = GetChunk(cameraPos);
+    if (current >= 0 && states[current] != ChunkResident) {
+        const bool initial = residents.empty();
+        const auto start = std::chrono::steady_clock::now();
+        if (states[current] == ChunkUnloaded) StartLoad(current);
+        auto found = std::find_if(loads.begin(), loads.end(), [current](const auto& load) { return load->chunk == current; });
+        std::unique_ptr<PendingLoad> load = std::move(*found);
+        loads.erase(found);
+        JobSystem::Get().Wait(load->counter);
+        Apply(std::move(load));
+        changed = true;
+
+        if (!initial) {
+            const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            stats.stalls++;
+            stats.stallMs += ms;
+            stats.worstStallMs = std::max(stats.worstStallMs, ms);
+        }
+    }
+
+    // Finished reads, the nearest few per frame so a burst doesn't land in one frame
+    std::vector<std::unique_ptr<PendingLoad>> finished;
+    for (size_t i = 0; i < loads.size();) {
+        if (loads[i]->counter.IsDone()) {
+            finished.push_back(std::move(loads[i]));
+            loads[i] = std::move(loads.back());
+            loads.pop_back();
+        }
+        else {
+            ++i;
+        }
+    }
+    std::sort(finished.begin(), finished.end(), [this, &cameraPos](const auto& a, const auto& b) {
+        return DistanceSq(a->chunk, cameraPos) < DistanceSq(b->chunk, cameraPos);
+    });
+    for (size_t i = 0; i < finished.size(); ++i) {
+        if (i < options.maxAppliedPerFrame) {
+            JobSystem::Get().Wait(finished[i]->counter);
+            Apply(std::move(finished[i]));
+            changed = true;
+        }
+        else {
+            loads.push_back(std::move(finished[i]));
+        }
+    }
+
+    // Hysteresis, a chunk stays until it is clearly out of reach
+    const float unloadSq = options.unloadRadius * options.unloadRadius;
+    std::vector<int> leaving;
+    for (const auto& resident : residents) {
+        if (DistanceSq(resident.first, cameraPos) > unloadSq) leaving.push_back(resident.first);
+    }
+    for (int chunk : leaving) {
+        Unload(chunk);
+        changed = true;
+    }
+
+    // Chunks in reach, only the square around the camera is looked at, not the whole world
+    const float loadSq = options.loadRadius * options.loadRadius;
+    const int x0 = std::max(0, static_cast<int>(std::floor((cameraPos.x - options.loadRadius - minX) / options.chunkSize)));
+    const int x1 = std::min(chunksX - 1, static_cast<int>(std::floor((cameraPos.x + options.loadRadius - minX) / options.chunkSize)));
+    const int z0 = std::max(0, static_cast<int>(std::floor((cameraPos.z - options.loadRadius - minZ) / options.chunkSize)));
+    const int z1 = std::min(chunksZ - 1, static_cast<int>(std::floor((cameraPos.z + options.loadRadius - minZ) / options.chunkSize)));
+    wanted.clear();
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+            const int chunk = z * chunksX + x;
+            if (states[chunk] == ChunkUnloaded && DistanceSq(chunk, cameraPos) < loadSq) wanted.push_back(chunk);
+        }
+    }
+    std::sort(wanted.begin(), wanted.end(), [this, &cameraPos](int a, int b) { return DistanceSq(a, cameraPos) < DistanceSq(b, cameraPos); });
+
+    for (int chunk : wanted) {
+        if (loads.size() >= options.maxLoadsInFlight) break;
+
+        // Within the memory budget, farther chunks make room for nearer ones
+        size_t inFlight = 0;
+        for (const std::unique_ptr<PendingLoad>& load : loads) inFlight += EstimateBytes(load->chunk);
+        const size_t needed = EstimateBytes(chunk);
+        const float distance = DistanceSq(chunk, cameraPos);
+        while (stats.residentBytes + inFlight + needed > options.maxResidentBytes) {
+            int farthest = -1;
+            float farthestDistance = distance;
+            for (const auto& resident : residents) {
+                const float d = DistanceSq(resident.first, cameraPos);
+                if (d > farthestDistance) {
+                    farthest = resident.first;
+                    farthestDistance = d;
+                }
+            }
+            if (farthest < 0) break;
+            Unload(farthest);
+            changed = true;
+        }
+        if (stats.residentBytes + inFlight + needed > options.maxResidentBytes) break;
+        StartLoad(chunk);
+    }
+
+    stats.resident = static_cast<unsigned int>(residents.size());
+    stats.loading = static_cast<unsigned int>(loads.size());
+    return changed;
+}
+
+void ChunkStreamer::StartLoad(int chunk) {
+    auto load = std::make_unique<PendingLoad>();
+    load->chunk = chunk;
+    PendingLoad* pending = load.get();
+    loads.push_back(std::move(load));
+    states[chunk] = ChunkLoading;
+    JobSystem::Get().Run([this, pending]() { ReadChunk(*pending); }, &pending->counter);
+}
+
+void ChunkStreamer::ReadChunk(PendingLoad& load) const {
+    const ChunkRange range = ranges[load.chunk];
+    std::vector<Instance> instances(range.count);
+    if (!path.empty()) {
+        std::ifstream in(path, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(dataOffset + static_cast<uint64_t>(range.first) * sizeof(Instance)));
+        in.read(reinterpret_cast<char*>(instances.data()), instances.size() * sizeof(Instance));
+        if (!in) {
+            std::cerr << "Failed to read chunk " << load.chunk << " from " << path << std::endl;
+            instances.clear();
+        }
+    }
+    else {
+        std::copy_n(unsavedInstances.begin() + range.first, range.count, instances.begin());
+    }
+
+    // Only transforms, the instances share their layer's mesh
+    load.layerCounts.assign(layers.size(), 0);
+    for (const Instance& instance : instances) {
+        if (instance.layer >= layers.size() || !layers[instance.layer].source) continue;
+        const ChunkLayer& layer = layers[instance.layer];
+        Model* model = Model::CreateInstance(layer.source).release();
+        model->SetPosition(instance.x, layer.y, instance.z);
+        load.models.emplace_back(model, layer.flags);
+        load.layerCounts[instance.layer]++;
+    }
+    if (ground) {
+        load.ground = Model::CreateInstance(ground).release();
+        const float half = 0.5f * options.chunkSize;
+        const DirectX::XMFLOAT3 position = ground->GetPosition();
+        load.ground->SetPosition(minX + static_cast<float>(load.chunk % chunksX) * options.chunkSize + half, position.y,
+            minZ + static_cast<float>(load.chunk / chunksX) * options.chunkSize + half);
+    }
+}
+
+void ChunkStreamer::Apply(std::unique_ptr<PendingLoad> load) {
+    Resident& resident = residents[load->chunk];
+    for (const auto& [model, flags] : load->models) {
+        resident.entities.push_back(entities->Create(model, flags));
+        if (broadphase) model->broadphaseProxy = broadphase->Insert(model->b, model);
+    }
+    if (load->ground) {
+        // Walked on through the terrain list, like the cabin's grass plane was
+        resident.entities.push_back(entities->Create(load->ground, EntityStatic));
+        resident.ground = load->ground;
+        if (terrain) terrain->push_back(load->ground);
+    }
+    resident.bytes = resident.entities.size() * InstanceBytes;
+    resident.layerCounts = std::move(load->layerCounts);
+    AddMeshUsers(resident.layerCounts, resident.ground != nullptr);
+
+    states[load->chunk] = ChunkResident;
+    stats.residentBytes += resident.bytes;
+    stats.peakResidentBytes = std::max(stats.peakResidentBytes, stats.residentBytes);
+    stats.loads++;
+}
+
+void ChunkStreamer::Unload(int chunk) {
+    auto found = residents.find(chunk);
+    if (found == residents.end()) return;
+    Resident& resident = found->second;
+
+    if (resident.ground && terrain) {
+        terrain->erase(std::remove(terrain->begin(), terrain->end(), resident.ground), terrain->end());
+    }
+    for (EntityHandle entity : resident.entities) {
+        Model* model = entities->GetModel(entity);
+        if (!model) continue;
+        if (broadphase && model->broadphaseProxy != 0xFFFFFFFFu) broadphase->Remove(model->broadphaseProxy);
+        entities->Destroy(entity);
+    }
+
+    stats.residentBytes -= resident.bytes;
+    RemoveMeshUsers(resident.layerCounts, resident.ground != nullptr);
+    stats.unloads++;
+    states[chunk] = ChunkUnloaded;
+    residents.erase(found);
+}
+
+void ChunkStreamer::AddMeshUsers(const std::vector<uint32_t>& layerCounts, bool withGround) {
+    size_t added = 0;
+    for (size_t l = 0; l < layerCounts.size(); ++l) {
+        if (layerCounts[l] == 0) continue;
+        if (layerUsers[l] == 0) added += layerMeshBytes[l];
+        layerUsers[l] += layerCounts[l];
+    }
+    if (withGround && groundUsers++ == 0) added += groundMeshBytes;
+    stats.meshBytes += added;
+    stats.residentBytes += added;
+}
+
+void ChunkStreamer::RemoveMeshUsers(const std::vector<uint32_t>& layerCounts, bool withGround) {
+    size_t removed = 0;
+    for (size_t l = 0; l < layerCounts.size(); ++l) {
+        if (layerCounts[l] == 0) continue;
+        layerUsers[l] -= layerCounts[l];
+        if (layerUsers[l] == 0) removed += layerMeshBytes[l];
+    }
+    if (withGround && --groundUsers == 0) removed += groundMeshBytes;
+    stats.meshBytes -= removed;
+    stats.residentBytes -= removed;
+}
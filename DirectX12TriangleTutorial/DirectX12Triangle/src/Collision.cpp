@@ -0,0 +1,395 @@
+#include "Collision.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+namespace {
+
+using DirectX::XMVECTOR;
+
+float Dot(XMVECTOR a, XMVECTOR b) { return DirectX::XMVectorGetX(DirectX::XMVector3Dot(a, b)); }
+
+// Support mapping of the hull after the world transform minus a segment (a point when both ends
+// are equal), so the origin is enclosed exactly when the two overlap
+struct WorldHull {
+    const ConvexHull& hull;
+    DirectX::XMMATRIX world;
+    DirectX::XMMATRIX directionToModel; // transpose of the linear part, takes directions into model space
+    XMVECTOR offsetA;
+    XMVECTOR offsetB;
+
+    WorldHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+        : hull(hull), world(world), directionToModel(DirectX::XMMatrixTranspose(world)), offsetA(DirectX::XMLoadFloat3(&a)), offsetB(DirectX::XMLoadFloat3(&b)) {}
+
+    XMVECTOR Support(XMVECTOR direction) const {
+        XMVECTOR d = DirectX::XMVector3TransformNormal(direction, directionToModel);
+        const DirectX::XMFLOAT3* best = &hull.points[0];
+        float bestDot = -FLT_MAX;
+        for (const DirectX::XMFLOAT3& p : hull.points) {
+            float dot = Dot(DirectX::XMLoadFloat3(&p), d);
+            if (dot > bestDot) {
+                bestDot = dot;
+                best = &p;
+            }
+        }
+        XMVECTOR offset = Dot(offsetA, direction) <= Dot(offsetB, direction) ? offsetA : offsetB;
+        return DirectX::XMVectorSubtract(DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(best), world), offset);
+    }
+};
+
+// Simplex of up to four support points, reduced to the smallest subset whose hull holds the
+// point closest to the origin
+struct Simplex {
+    XMVECTOR points[4];
+    int count = 0;
+
+    // Returns the closest point to the origin, or false when the origin is enclosed
+    bool Solve(XMVECTOR& closest) {
+        switch (count) {
+        case 1:
+            closest = points[0];
+            return true;
+        case 2:
+            closest = Segment(points[0], points[1]);
+            return true;
+        case 3:
+            closest = Triangle(points[0], points[1], points[2]);
+            return true;
+        default:
+            return Tetrahedron(closest);
+        }
+    }
+
+private:
+    void Keep(std::initializer_list<XMVECTOR> kept) {
+        count = 0;
+        for (XMVECTOR p : kept) points[count++] = p;
+    }
+
+    XMVECTOR Segment(XMVECTOR a, XMVECTOR b) {
+        XMVECTOR ab = DirectX::XMVectorSubtract(b, a);
+        float t = -Dot(a, ab);
+        if (t <= 0.0f) {
+            Keep({ a });
+            return a;
+        }
+        float lengthSq = Dot(ab, ab);
+        if (t >= lengthSq) {
+            Keep({ b });
+            return b;
+        }
+        Keep({ a, b });
+        return DirectX::XMVectorAdd(a, DirectX::XMVectorScale(ab, t / lengthSq));
+    }
+
+    // Ericson, Real-Time Collision Detection 5.1.5, with the query point at the origin
+    XMVECTOR Triangle(XMVECTOR a, XMVECTOR b, XMVECTOR c) {
+        XMVECTOR ab = DirectX::XMVectorSubtract(b, a);
+        XMVECTOR ac = DirectX::XMVectorSubtract(c, a);
+        XMVECTOR ap = DirectX::XMVectorNegate(a);
+        float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) { Keep({ a }); return a; }
+
+        XMVECTOR bp = DirectX::XMVectorNegate(b);
+        float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) { Keep({ b }); return b; }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            Keep({ a, b });
+            return DirectX::XMVectorAdd(a, DirectX::XMVectorScale(ab, d1 / (d1 - d3)));
+        }
+
+        XMVECTOR cp = DirectX::XMVectorNegate(c);
+        float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) { Keep({ c }); return c; }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            Keep({ a, c });
+            return DirectX::XMVectorAdd(a, DirectX::XMVectorScale(ac, d2 / (d2 - d6)));
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            Keep({ b, c });
+            return DirectX::XMVectorAdd(b, DirectX::XMVectorScale(DirectX::XMVectorSubtract(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+        }
+
+        Keep({ a, b, c });
+        float denominator = 1.0f / (va + vb + vc);
+        return DirectX::XMVectorAdd(a, DirectX::XMVectorAdd(DirectX::XMVectorScale(ab, vb * denominator), DirectX::XMVectorScale(ac, vc * denominator)));
+    }
+
+    bool Tetrahedron(XMVECTOR& closest) {
+        const XMVECTOR a = points[0], b = points[1], c = points[2], d = points[3];
+        const XMVECTOR faces[4][4] = { { a, b, c, d }, { a, c, d, b }, { a, d, b, c }, { b, d, c, a } };
+
+        // Only faces that separate the origin from the opposite vertex can hold the closest point.
+        // A flat tetrahedron encloses nothing, all of its faces are candidates then.
+        XMVECTOR ab = DirectX::XMVectorSubtract(b, a), ac = DirectX::XMVectorSubtract(c, a), ad = DirectX::XMVectorSubtract(d, a);
+        float volume = Dot(ab, DirectX::XMVector3Cross(ac, ad));
+        float scale = Dot(ab, ab) + Dot(ac, ac) + Dot(ad, ad);
+        const bool flat = fabsf(volume) <= 1e-6f * scale * sqrtf(scale);
+        float bestDistance = FLT_MAX;
+        bool outside = false;
+        Simplex best;
+        for (const auto& face : faces) {
+            XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(face[1], face[0]), DirectX::XMVectorSubtract(face[2], face[0]));
+            float originSide = -Dot(normal, face[0]);
+            float vertexSide = Dot(normal, DirectX::XMVectorSubtract(face[3], face[0]));
+            if (!flat && originSide * vertexSide >= 0.0f) continue;
+
+            outside = true;
+            Simplex candidate;
+            candidate.count = 3;
+            candidate.points[0] = face[0];
+            candidate.points[1] = face[1];
+            candidate.points[2] = face[2];
+            XMVECTOR point = candidate.Triangle(face[0], face[1], face[2]);
+            float distance = Dot(point, point);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                closest = point;
+                best = candidate;
+            }
+        }
+        if (!outside) return false;
+        *this = best;
+        return true;
+    }
+};
+
+enum class GjkResult { Separated, Touching, Inside };
+
+// Runs GJK towards the origin. With a radius it stops as soon as the answer to
+// "is the distance below radius" is known, otherwise it converges to the distance.
+// closest receives the point of the shape closest to the origin found so far.
+GjkResult RunGjk(const WorldHull& shape, float radius, float& distance, XMVECTOR* closest = nullptr) {
+    distance = 0.0f;
+    if (shape.hull.points.empty()) {
+        distance = FLT_MAX;
+        if (closest) *closest = DirectX::XMVectorZero();
+        return GjkResult::Separated;
+    }
+
+    Simplex simplex;
+    XMVECTOR v = shape.Support(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f));
+    simplex.points[0] = v;
+    simplex.count = 1;
+    const float radiusSq = radius * radius;
+    for (int iteration = 0; iteration < 64; ++iteration) {
+        float vLengthSq = Dot(v, v);
+        if (vLengthSq <= radiusSq || vLengthSq <= 1e-12f) {
+            distance = sqrtf(vLengthSq);
+            if (closest) *closest = v;
+            return vLengthSq <= 1e-12f ? GjkResult::Inside : GjkResult::Touching;
+        }
+
+        XMVECTOR w = shape.Support(DirectX::XMVectorNegate(v));
+        float vw = Dot(v, w);
+        // The plane through w with normal v separates the hull from the origin at this distance
+        if (radius > 0.0f && vw > 0.0f && vw * vw > radiusSq * vLengthSq) {
+            distance = vw / sqrtf(vLengthSq);
+            if (closest) *closest = v;
+            return GjkResult::Separated;
+        }
+        if (vLengthSq - vw <= 1e-6f * vLengthSq) break;
+
+        simplex.points[simplex.count++] = w;
+        XMVECTOR previous = v;
+        if (!simplex.Solve(v)) {
+            distance = 0.0f;
+            if (closest) *closest = DirectX::XMVectorZero();
+            return GjkResult::Inside;
+        }
+        // Rounding can keep a degenerate simplex from getting any closer, v is as good as it gets then
+        if (Dot(v, v) >= vLengthSq) {
+            v = previous;
+            break;
+        }
+    }
+    distance = sqrtf(Dot(v, v));
+    if (closest) *closest = v;
+    return distance <= radius ? GjkResult::Touching : GjkResult::Separated;
+}
+
+// Ericson, Real-Time Collision Detection 5.1.5
+XMVECTOR ClosestPointOnTriangle(XMVECTOR p, XMVECTOR a, XMVECTOR b, XMVECTOR c) {
+    XMVECTOR ab = DirectX::XMVectorSubtract(b, a);
+    XMVECTOR ac = DirectX::XMVectorSubtract(c, a);
+    XMVECTOR ap = DirectX::XMVectorSubtract(p, a);
+    float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    XMVECTOR bp = DirectX::XMVectorSubtract(p, b);
+    float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return DirectX::XMVectorAdd(a, DirectX::XMVectorScale(ab, d1 / (d1 - d3)));
+
+    XMVECTOR cp = DirectX::XMVectorSubtract(p, c);
+    float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return DirectX::XMVectorAdd(a, DirectX::XMVectorScale(ac, d2 / (d2 - d6)));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return DirectX::XMVectorAdd(b, DirectX::XMVectorScale(DirectX::XMVectorSubtract(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+
+    float denominator = 1.0f / (va + vb + vc);
+    return DirectX::XMVectorAdd(a, DirectX::XMVectorAdd(DirectX::XMVectorScale(ab, vb * denominator), DirectX::XMVectorScale(ac, vc * denominator)));
+}
+
+// Ericson 5.1.9, returns the squared distance
+float ClosestPointsSegmentSegment(XMVECTOR p1, XMVECTOR q1, XMVECTOR p2, XMVECTOR q2, XMVECTOR& c1, XMVECTOR& c2) {
+    XMVECTOR d1 = DirectX::XMVectorSubtract(q1, p1);
+    XMVECTOR d2 = DirectX::XMVectorSubtract(q2, p2);
+    XMVECTOR r = DirectX::XMVectorSubtract(p1, p2);
+    float a = Dot(d1, d1), e = Dot(d2, d2), f = Dot(d2, r);
+    float s = 0.0f, t = 0.0f;
+    if (a <= 1e-12f && e <= 1e-12f) {
+        // Both degenerate
+    }
+    else if (a <= 1e-12f) {
+        t = std::clamp(f / e, 0.0f, 1.0f);
+    }
+    else {
+        float c = Dot(d1, r);
+        if (e <= 1e-12f) {
+            s = std::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else {
+            float b = Dot(d1, d2);
+            float denominator = a * e - b * b;
+            s = denominator != 0.0f ? std::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = std::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else if (t > 1.0f) {
+                t = 1.0f;
+                s = std::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    c1 = DirectX::XMVectorAdd(p1, DirectX::XMVectorScale(d1, s));
+    c2 = DirectX::XMVectorAdd(p2, DirectX::XMVectorScale(d2, t));
+    XMVECTOR delta = DirectX::XMVectorSubtract(c1, c2);
+    return Dot(delta, delta);
+}
+
+}
+
+float DistanceToHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& point) {
+    float distance;
+    RunGjk(WorldHull(hull, world, point, point), 0.0f, distance);
+    return distance;
+}
+
+bool SphereIntersectsHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& center, float radius) {
+    float distance;
+    return RunGjk(WorldHull(hull, world, center, center), radius, distance) != GjkResult::Separated;
+}
+
+bool BoxIntersectsHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax) {
+    if (hull.points.empty()) return false;
+
+    // Box axes: the world bounds of the hull points
+    DirectX::XMVECTOR lo = DirectX::XMVectorReplicate(FLT_MAX);
+    DirectX::XMVECTOR hi = DirectX::XMVectorReplicate(-FLT_MAX);
+    for (const DirectX::XMFLOAT3& p : hull.points) {
+        DirectX::XMVECTOR q = DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&p), world);
+        lo = DirectX::XMVectorMin(lo, q);
+        hi = DirectX::XMVectorMax(hi, q);
+    }
+    DirectX::XMFLOAT3 hullMin, hullMax;
+    DirectX::XMStoreFloat3(&hullMin, lo);
+    DirectX::XMStoreFloat3(&hullMax, hi);
+    if (hullMin.x > boxMax.x || hullMax.x < boxMin.x ||
+        hullMin.y > boxMax.y || hullMax.y < boxMin.y ||
+        hullMin.z > boxMax.z || hullMax.z < boxMin.z) return false;
+
+    // Hull face normals: the box is separated from a face plane when its nearest corner is in front
+    DirectX::XMMATRIX planeToWorld = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, world));
+    DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&boxMin), DirectX::XMLoadFloat3(&boxMax)), 0.5f);
+    DirectX::XMVECTOR extents = DirectX::XMVectorScale(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&boxMax), DirectX::XMLoadFloat3(&boxMin)), 0.5f);
+    center = DirectX::XMVectorSetW(center, 1.0f);
+    for (const DirectX::XMFLOAT4& plane : hull.planes) {
+        DirectX::XMVECTOR p = DirectX::XMVector4Transform(DirectX::XMLoadFloat4(&plane), planeToWorld);
+        float distance = DirectX::XMVectorGetX(DirectX::XMVector4Dot(p, center));
+        float reach = Dot(DirectX::XMVectorAbs(p), extents);
+        float length = sqrtf(Dot(p, p));
+        if (distance - reach > 1e-6f * length) return false;
+    }
+    return true;
+}
+
+float DistanceSegmentToHull(const ConvexHull& hull, DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, DirectX::XMFLOAT3& normal) {
+    float distance;
+    XMVECTOR closest;
+    RunGjk(WorldHull(hull, world, a, b), 0.0f, distance, &closest);
+    // closest is hull point minus segment point, the normal points the other way
+    if (distance > 0.0f && distance != FLT_MAX) {
+        DirectX::XMStoreFloat3(&normal, DirectX::XMVectorScale(closest, -1.0f / distance));
+    }
+    else {
+        normal = { 0.0f, 0.0f, 0.0f };
+    }
+    return distance;
+}
+
+float ClosestPointsSegmentTriangle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b,
+    const DirectX::XMFLOAT3& p0, const DirectX::XMFLOAT3& p1, const DirectX::XMFLOAT3& p2,
+    DirectX::XMFLOAT3& onSegment, DirectX::XMFLOAT3& onTriangle) {
+    const XMVECTOR sa = DirectX::XMLoadFloat3(&a), sb = DirectX::XMLoadFloat3(&b);
+    const XMVECTOR t0 = DirectX::XMLoadFloat3(&p0), t1 = DirectX::XMLoadFloat3(&p1), t2 = DirectX::XMLoadFloat3(&p2);
+
+    // A segment crossing the triangle touches it where it crosses the plane
+    XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(t1, t0), DirectX::XMVectorSubtract(t2, t0));
+    float da = Dot(normal, DirectX::XMVectorSubtract(sa, t0));
+    float db = Dot(normal, DirectX::XMVectorSubtract(sb, t0));
+    if ((da <= 0.0f && db >= 0.0f) || (da >= 0.0f && db <= 0.0f)) {
+        if (da != db) {
+            XMVECTOR x = DirectX::XMVectorLerp(sa, sb, da / (da - db));
+            XMVECTOR n0 = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(t1, t0), DirectX::XMVectorSubtract(x, t0));
+            XMVECTOR n1 = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(t2, t1), DirectX::XMVectorSubtract(x, t1));
+            XMVECTOR n2 = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(t0, t2), DirectX::XMVectorSubtract(x, t2));
+            if (Dot(n0, normal) >= 0.0f && Dot(n1, normal) >= 0.0f && Dot(n2, normal) >= 0.0f) {
+                DirectX::XMStoreFloat3(&onSegment, x);
+                onTriangle = onSegment;
+                return 0.0f;
+            }
+        }
+    }
+
+    // Otherwise the closest pair has an end of the segment or an edge of the triangle in it
+    XMVECTOR bestSegment = sa;
+    XMVECTOR bestTriangle = ClosestPointOnTriangle(sa, t0, t1, t2);
+    float best = Dot(DirectX::XMVectorSubtract(sa, bestTriangle), DirectX::XMVectorSubtract(sa, bestTriangle));
+    XMVECTOR onB = ClosestPointOnTriangle(sb, t0, t1, t2);
+    float distanceB = Dot(DirectX::XMVectorSubtract(sb, onB), DirectX::XMVectorSubtract(sb, onB));
+    if (distanceB < best) {
+        best = distanceB;
+        bestSegment = sb;
+        bestTriangle = onB;
+    }
+    const XMVECTOR edges[3][2] = { { t0, t1 }, { t1, t2 }, { t2, t0 } };
+    for (const auto& edge : edges) {
+        XMVECTOR c1, c2;
+        float distance = ClosestPointsSegmentSegment(sa, sb, edge[0], edge[1], c1, c2);
+        if (distance < best) {
+            best = distance;
+            bestSegment = c1;
+            bestTriangle = c2;
+        }
+    }
+    DirectX::XMStoreFloat3(&onSegment, bestSegment);
+    DirectX::XMStoreFloat3(&onTriangle, bestTriangle);
+    return sqrtf(best);
+}
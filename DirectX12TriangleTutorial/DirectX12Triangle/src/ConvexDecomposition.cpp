@@ -0,0 +1,751 @@
+#include "ConvexDecomposition.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <cstdint>
+#include <cmath>
+#include <climits>
+#include <cfloat>
+
+namespace {
+
+// ---------------------------------------------------------------------------------------------
+// Quickhull
+
+uint64_t EdgeKey(unsigned int a, unsigned int b) {
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+class HullBuilder {
+public:
+    HullBuilder(const std::vector<DirectX::XMFLOAT3>& points) : points(points) {}
+
+    bool Build(ConvexHull& out) {
+        if (points.size() < 4 || !BuildInitialSimplex()) return false;
+
+        // Expand the face with the farthest outside point until no face has points outside
+        for (size_t f = 0; f < faces.size(); ++f) {
+            while (faces[f].alive && !faces[f].outside.empty()) {
+                AddPoint(f);
+            }
+        }
+        Output(out);
+        return true;
+    }
+
+private:
+    struct Face {
+        unsigned int v[3];
+        DirectX::XMFLOAT3 normal;
+        float d;
+        std::vector<unsigned int> outside;
+        bool alive;
+    };
+
+    const std::vector<DirectX::XMFLOAT3>& points;
+    std::vector<Face> faces;
+    std::unordered_map<uint64_t, unsigned int> edgeFace; // directed edge -> face that owns it
+    float epsilon = 0.0f;
+
+    float Distance(const Face& face, unsigned int p) const {
+        const DirectX::XMFLOAT3& q = points[p];
+        return face.normal.x * q.x + face.normal.y * q.y + face.normal.z * q.z + face.d;
+    }
+
+    unsigned int AddFace(unsigned int a, unsigned int b, unsigned int c) {
+        DirectX::XMVECTOR pa = DirectX::XMLoadFloat3(&points[a]);
+        DirectX::XMVECTOR n = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(
+            DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[b]), pa),
+            DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[c]), pa)));
+        Face face;
+        face.v[0] = a;
+        face.v[1] = b;
+        face.v[2] = c;
+        DirectX::XMStoreFloat3(&face.normal, n);
+        face.d = -DirectX::XMVectorGetX(DirectX::XMVector3Dot(n, pa));
+        face.alive = true;
+        unsigned int index = static_cast<unsigned int>(faces.size());
+        faces.push_back(std::move(face));
+        edgeFace[EdgeKey(a, b)] = index;
+        edgeFace[EdgeKey(b, c)] = index;
+        edgeFace[EdgeKey(c, a)] = index;
+        return index;
+    }
+
+    bool BuildInitialSimplex() {
+        // Extreme points along the widest axis
+        DirectX::XMFLOAT3 mn = points[0], mx = points[0];
+        unsigned int minIndex[3] = {}, maxIndex[3] = {};
+        for (unsigned int i = 1; i < points.size(); ++i) {
+            const float* p = &points[i].x;
+            float* lo = &mn.x;
+            float* hi = &mx.x;
+            for (int a = 0; a < 3; ++a) {
+                if (p[a] < lo[a]) { lo[a] = p[a]; minIndex[a] = i; }
+                if (p[a] > hi[a]) { hi[a] = p[a]; maxIndex[a] = i; }
+            }
+        }
+        float extent[3] = { mx.x - mn.x, mx.y - mn.y, mx.z - mn.z };
+        int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+        epsilon = 1e-5f * (extent[0] + extent[1] + extent[2]);
+        if (extent[axis] <= epsilon) return false;
+
+        unsigned int i0 = minIndex[axis], i1 = maxIndex[axis];
+        DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&points[i0]);
+        DirectX::XMVECTOR dir = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[i1]), p0));
+
+        // Farthest from the line, then farthest from the plane
+        unsigned int i2 = 0;
+        float best = 0.0f;
+        for (unsigned int i = 0; i < points.size(); ++i) {
+            DirectX::XMVECTOR v = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[i]), p0);
+            float d = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVector3Cross(v, dir)));
+            if (d > best) { best = d; i2 = i; }
+        }
+        if (best <= epsilon * epsilon) return false;
+
+        DirectX::XMVECTOR n = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(
+            DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[i1]), p0),
+            DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[i2]), p0)));
+        unsigned int i3 = 0;
+        float signedBest = 0.0f;
+        best = 0.0f;
+        for (unsigned int i = 0; i < points.size(); ++i) {
+            float d = DirectX::XMVectorGetX(DirectX::XMVector3Dot(n, DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&points[i]), p0)));
+            if (fabsf(d) > best) { best = fabsf(d); signedBest = d; i3 = i; }
+        }
+        if (best <= epsilon) return false;
+
+        // Orient the base so the fourth point is behind it
+        if (signedBest > 0.0f) std::swap(i1, i2);
+        AddFace(i0, i1, i2);
+        AddFace(i0, i3, i1);
+        AddFace(i1, i3, i2);
+        AddFace(i2, i3, i0);
+
+        for (unsigned int i = 0; i < points.size(); ++i) {
+            if (i == i0 || i == i1 || i == i2 || i == i3) continue;
+            AssignToFace(i, 0, 4);
+        }
+        return true;
+    }
+
+    void AssignToFace(unsigned int p, size_t firstFace, size_t endFace) {
+        for (size_t f = firstFace; f < endFace; ++f) {
+            if (faces[f].alive && Distance(faces[f], p) > epsilon) {
+                faces[f].outside.push_back(p);
+                return;
+            }
+        }
+    }
+
+    void AddPoint(size_t startFace) {
+        // Farthest outside point of the face
+        unsigned int eye = faces[startFace].outside[0];
+        float best = -1.0f;
+        for (unsigned int p : faces[startFace].outside) {
+            float d = Distance(faces[startFace], p);
+            if (d > best) { best = d; eye = p; }
+        }
+
+        // Flood the faces the eye point sees, the edges where it stops form the horizon
+        std::vector<unsigned int> visible = { static_cast<unsigned int>(startFace) };
+        std::vector<std::pair<unsigned int, unsigned int>> horizon;
+        faces[startFace].alive = false;
+        for (size_t i = 0; i < visible.size(); ++i) {
+            const Face& face = faces[visible[i]];
+            for (int e = 0; e < 3; ++e) {
+                unsigned int a = face.v[e], b = face.v[(e + 1) % 3];
+                auto it = edgeFace.find(EdgeKey(b, a));
+                if (it == edgeFace.end()) continue;
+                Face& neighbor = faces[it->second];
+                if (!neighbor.alive) continue;
+                if (Distance(neighbor, eye) > epsilon) {
+                    neighbor.alive = false;
+                    visible.push_back(it->second);
+                }
+            }
+        }
+        for (unsigned int f : visible) {
+            const Face& face = faces[f];
+            for (int e = 0; e < 3; ++e) {
+                unsigned int a = face.v[e], b = face.v[(e + 1) % 3];
+                auto it = edgeFace.find(EdgeKey(b, a));
+                if (it != edgeFace.end() && faces[it->second].alive) horizon.push_back({ a, b });
+            }
+        }
+
+        std::vector<unsigned int> orphans;
+        for (unsigned int f : visible) {
+            Face& face = faces[f];
+            for (int e = 0; e < 3; ++e) {
+                auto it = edgeFace.find(EdgeKey(face.v[e], face.v[(e + 1) % 3]));
+                if (it != edgeFace.end() && it->second == f) edgeFace.erase(it);
+            }
+            for (unsigned int p : face.outside) {
+                if (p != eye) orphans.push_back(p);
+            }
+            std::vector<unsigned int>().swap(face.outside);
+        }
+
+        size_t firstNew = faces.size();
+        for (const auto& [a, b] : horizon) {
+            AddFace(a, b, eye);
+        }
+        for (unsigned int p : orphans) {
+            AssignToFace(p, firstNew, faces.size());
+        }
+    }
+
+    void Output(ConvexHull& out) {
+        out = ConvexHull();
+        std::vector<unsigned int> remap(points.size(), UINT_MAX);
+        for (const Face& face : faces) {
+            if (!face.alive) continue;
+            for (unsigned int v : face.v) {
+                if (remap[v] == UINT_MAX) {
+                    remap[v] = static_cast<unsigned int>(out.points.size());
+                    out.points.push_back(points[v]);
+                }
+                out.indices.push_back(remap[v]);
+            }
+
+            // Coplanar triangles share one plane
+            bool merged = false;
+            for (const DirectX::XMFLOAT4& plane : out.planes) {
+                if (plane.x * face.normal.x + plane.y * face.normal.y + plane.z * face.normal.z > 1.0f - 1e-5f &&
+                    fabsf(plane.w - face.d) <= epsilon) {
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) out.planes.push_back({ face.normal.x, face.normal.y, face.normal.z, face.d });
+        }
+
+        out.boundsMin = out.boundsMax = out.points[0];
+        for (const DirectX::XMFLOAT3& p : out.points) {
+            out.boundsMin = { std::min(out.boundsMin.x, p.x), std::min(out.boundsMin.y, p.y), std::min(out.boundsMin.z, p.z) };
+            out.boundsMax = { std::max(out.boundsMax.x, p.x), std::max(out.boundsMax.y, p.y), std::max(out.boundsMax.z, p.z) };
+        }
+
+        // Tetrahedra fanned from the first point
+        DirectX::XMVECTOR origin = DirectX::XMLoadFloat3(&out.points[0]);
+        float volume = 0.0f;
+        for (size_t i = 0; i < out.indices.size(); i += 3) {
+            DirectX::XMVECTOR a = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&out.points[out.indices[i]]), origin);
+            DirectX::XMVECTOR b = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&out.points[out.indices[i + 1]]), origin);
+            DirectX::XMVECTOR c = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&out.points[out.indices[i + 2]]), origin);
+            volume += DirectX::XMVectorGetX(DirectX::XMVector3Dot(a, DirectX::XMVector3Cross(b, c)));
+        }
+        out.volume = fabsf(volume) / 6.0f;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Voxelization
+
+enum VoxelState : uint8_t { Empty = 0, Solid = 1, Outside = 2 };
+
+struct VoxelGrid {
+    int size[3] = {};
+    DirectX::XMFLOAT3 origin = {};
+    float cellSize = 1.0f;
+    std::vector<uint8_t> cells;
+
+    size_t Index(int x, int y, int z) const { return (static_cast<size_t>(z) * size[1] + y) * size[0] + x; }
+};
+
+// Akenine-Moller triangle / box overlap with the box centered at the origin
+bool TriangleOverlapsBox(DirectX::XMVECTOR v0, DirectX::XMVECTOR v1, DirectX::XMVECTOR v2, float halfSize) {
+    DirectX::XMVECTOR e[3] = {
+        DirectX::XMVectorSubtract(v1, v0),
+        DirectX::XMVectorSubtract(v2, v1),
+        DirectX::XMVectorSubtract(v0, v2) };
+
+    // Box face normals
+    DirectX::XMVECTOR mn = DirectX::XMVectorMin(v0, DirectX::XMVectorMin(v1, v2));
+    DirectX::XMVECTOR mx = DirectX::XMVectorMax(v0, DirectX::XMVectorMax(v1, v2));
+    DirectX::XMFLOAT3 lo, hi;
+    DirectX::XMStoreFloat3(&lo, mn);
+    DirectX::XMStoreFloat3(&hi, mx);
+    if (lo.x > halfSize || lo.y > halfSize || lo.z > halfSize || hi.x < -halfSize || hi.y < -halfSize || hi.z < -halfSize) return false;
+
+    // Triangle normal
+    DirectX::XMVECTOR n = DirectX::XMVector3Cross(e[0], e[1]);
+    float d = DirectX::XMVectorGetX(DirectX::XMVector3Dot(n, v0));
+    float r = halfSize * DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVectorAbs(n), DirectX::XMVectorReplicate(1.0f)));
+    if (fabsf(d) > r) return false;
+
+    // Edge x box axis
+    const DirectX::XMVECTOR axes[3] = {
+        DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f),
+        DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+        DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) };
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            DirectX::XMVECTOR a = DirectX::XMVector3Cross(e[i], axes[j]);
+            float p0 = DirectX::XMVectorGetX(DirectX::XMVector3Dot(a, v0));
+            float p1 = DirectX::XMVectorGetX(DirectX::XMVector3Dot(a, v1));
+            float p2 = DirectX::XMVectorGetX(DirectX::XMVector3Dot(a, v2));
+            float radius = halfSize * DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVectorAbs(a), DirectX::XMVectorReplicate(1.0f)));
+            if (std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius) return false;
+        }
+    }
+    return true;
+}
+
+void Voxelize(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    const ConvexDecompositionOptions& options, VoxelGrid& grid) {
+    DirectX::XMFLOAT3 mn = vertices[0].position, mx = vertices[0].position;
+    for (const Vertex& v : vertices) {
+        mn = { std::min(mn.x, v.position.x), std::min(mn.y, v.position.y), std::min(mn.z, v.position.z) };
+        mx = { std::max(mx.x, v.position.x), std::max(mx.y, v.position.y), std::max(mx.z, v.position.z) };
+    }
+    const unsigned int resolution = std::clamp(options.resolution, 4u, 1000u);
+    float extent = std::max(mx.x - mn.x, std::max(mx.y - mn.y, mx.z - mn.z));
+    grid.cellSize = std::max(extent, 1e-6f) / resolution;
+
+    // One cell of padding on every side keeps the outside connected for the flood fill
+    float extents[3] = { mx.x - mn.x, mx.y - mn.y, mx.z - mn.z };
+    for (int a = 0; a < 3; ++a) {
+        grid.size[a] = static_cast<int>(ceilf(extents[a] / grid.cellSize)) + 3;
+    }
+    grid.origin = { mn.x - grid.cellSize, mn.y - grid.cellSize, mn.z - grid.cellSize };
+    grid.cells.assign(static_cast<size_t>(grid.size[0]) * grid.size[1] * grid.size[2], Empty);
+
+    // Triangles are binned into z slabs, every slab only writes its own cells
+    const int slabDepth = std::max(1, grid.size[2] / 32);
+    const int numSlabs = (grid.size[2] + slabDepth - 1) / slabDepth;
+    std::vector<std::vector<unsigned int>> slabTriangles(numSlabs);
+    const float inverseCell = 1.0f / grid.cellSize;
+    for (unsigned int t = 0; t + 2 < indices.size(); t += 3) {
+        float z0 = vertices[indices[t]].position.z, z1 = vertices[indices[t + 1]].position.z, z2 = vertices[indices[t + 2]].position.z;
+        int lo = std::clamp(static_cast<int>((std::min(z0, std::min(z1, z2)) - grid.origin.z) * inverseCell) - 1, 0, grid.size[2] - 1);
+        int hi = std::clamp(static_cast<int>((std::max(z0, std::max(z1, z2)) - grid.origin.z) * inverseCell) + 1, 0, grid.size[2] - 1);
+        for (int s = lo / slabDepth; s <= hi / slabDepth; ++s) {
+            slabTriangles[s].push_back(t);
+        }
+    }
+
+    JobSystem::Get().ParallelFor(numSlabs, [&](size_t begin, size_t end) {
+        for (int slab = static_cast<int>(begin); slab < static_cast<int>(end); ++slab) {
+            const int zBegin = slab * slabDepth;
+            const int zEnd = std::min(zBegin + slabDepth, grid.size[2]);
+            const float half = grid.cellSize * 0.5f;
+            for (unsigned int t : slabTriangles[slab]) {
+                DirectX::XMVECTOR p[3];
+                int lo[3] = { INT_MAX, INT_MAX, INT_MAX }, hi[3] = { INT_MIN, INT_MIN, INT_MIN };
+                for (int k = 0; k < 3; ++k) {
+                    const DirectX::XMFLOAT3& q = vertices[indices[t + k]].position;
+                    p[k] = DirectX::XMLoadFloat3(&q);
+                    const float c[3] = { (q.x - grid.origin.x) * inverseCell, (q.y - grid.origin.y) * inverseCell, (q.z - grid.origin.z) * inverseCell };
+                    for (int a = 0; a < 3; ++a) {
+                        lo[a] = std::min(lo[a], static_cast<int>(floorf(c[a])));
+                        hi[a] = std::max(hi[a], static_cast<int>(floorf(c[a])));
+                    }
+                }
+                lo[2] = std::max(lo[2], zBegin);
+                hi[2] = std::min(hi[2], zEnd - 1);
+                for (int a = 0; a < 2; ++a) {
+                    lo[a] = std::max(lo[a], 0);
+                    hi[a] = std::min(hi[a], grid.size[a] - 1);
+                }
+                for (int z = lo[2]; z <= hi[2]; ++z) {
+                    for (int y = lo[1]; y <= hi[1]; ++y) {
+                        for (int x = lo[0]; x <= hi[0]; ++x) {
+                            uint8_t& cell = grid.cells[grid.Index(x, y, z)];
+                            if (cell == Solid) continue;
+                            DirectX::XMVECTOR center = DirectX::XMVectorSet(
+                                grid.origin.x + (x + 0.5f) * grid.cellSize,
+                                grid.origin.y + (y + 0.5f) * grid.cellSize,
+                                grid.origin.z + (z + 0.5f) * grid.cellSize, 0.0f);
+                            if (TriangleOverlapsBox(DirectX::XMVectorSubtract(p[0], center), DirectX::XMVectorSubtract(p[1], center),
+                                DirectX::XMVectorSubtract(p[2], center), half)) {
+                                cell = Solid;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    if (!options.fillInterior) return;
+
+    // Everything the outside flood can't reach is enclosed by the surface
+    std::vector<size_t> stack = { 0 };
+    grid.cells[0] = Outside;
+    while (!stack.empty()) {
+        size_t index = stack.back();
+        stack.pop_back();
+        int x = static_cast<int>(index % grid.size[0]);
+        int y = static_cast<int>((index / grid.size[0]) % grid.size[1]);
+        int z = static_cast<int>(index / (static_cast<size_t>(grid.size[0]) * grid.size[1]));
+        const int neighbors[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+        for (const auto& n : neighbors) {
+            if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= grid.size[0] || n[1] >= grid.size[1] || n[2] >= grid.size[2]) continue;
+            size_t ni = grid.Index(n[0], n[1], n[2]);
+            if (grid.cells[ni] == Empty) {
+                grid.cells[ni] = Outside;
+                stack.push_back(ni);
+            }
+        }
+    }
+    for (uint8_t& cell : grid.cells) {
+        cell = cell == Outside ? Empty : Solid;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Recursive splitting
+
+// Voxel coordinates packed 10 bits per axis
+uint32_t PackVoxel(int x, int y, int z) { return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 10) | (static_cast<uint32_t>(z) << 20); }
+int VoxelCoord(uint32_t voxel, int axis) { return static_cast<int>((voxel >> (axis * 10)) & 0x3FF); }
+
+struct Part {
+    std::vector<uint32_t> voxels;
+    unsigned int depth = 0;
+};
+
+// Hull of a set of voxels in grid units. Inside every x row only the first and last voxel can
+// contribute hull vertices, so only their outer corners are fed to quickhull.
+template <typename Filter>
+bool VoxelHull(const std::vector<uint32_t>& voxels, Filter&& keep, ConvexHull& hull, size_t* count = nullptr) {
+    int lo[3] = { INT_MAX, INT_MAX, INT_MAX }, hi[3] = { INT_MIN, INT_MIN, INT_MIN };
+    size_t kept = 0;
+    for (uint32_t v : voxels) {
+        if (!keep(v)) continue;
+        kept++;
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], VoxelCoord(v, a));
+            hi[a] = std::max(hi[a], VoxelCoord(v, a));
+        }
+    }
+    if (count) *count = kept;
+    if (kept == 0) return false;
+
+    const int rowsY = hi[1] - lo[1] + 1;
+    const int rowsZ = hi[2] - lo[2] + 1;
+    std::vector<std::pair<int, int>> rows(static_cast<size_t>(rowsY) * rowsZ, { INT_MAX, INT_MIN });
+    for (uint32_t v : voxels) {
+        if (!keep(v)) continue;
+        auto& row = rows[static_cast<size_t>(VoxelCoord(v, 2) - lo[2]) * rowsY + (VoxelCoord(v, 1) - lo[1])];
+        row.first = std::min(row.first, VoxelCoord(v, 0));
+        row.second = std::max(row.second, VoxelCoord(v, 0));
+    }
+
+    std::vector<uint64_t> corners;
+    for (int z = 0; z < rowsZ; ++z) {
+        for (int y = 0; y < rowsY; ++y) {
+            const auto& row = rows[static_cast<size_t>(z) * rowsY + y];
+            if (row.first > row.second) continue;
+            for (int x : { row.first, row.second + 1 }) {
+                for (int dz = 0; dz < 2; ++dz) {
+                    for (int dy = 0; dy < 2; ++dy) {
+                        corners.push_back(static_cast<uint64_t>(x) | (static_cast<uint64_t>(lo[1] + y + dy) << 21) | (static_cast<uint64_t>(lo[2] + z + dz) << 42));
+                    }
+                }
+            }
+        }
+    }
+    std::sort(corners.begin(), corners.end());
+    corners.erase(std::unique(corners.begin(), corners.end()), corners.end());
+
+    std::vector<DirectX::XMFLOAT3> points(corners.size());
+    for (size_t i = 0; i < corners.size(); ++i) {
+        points[i] = {
+            static_cast<float>(corners[i] & 0x1FFFFF),
+            static_cast<float>((corners[i] >> 21) & 0x1FFFFF),
+            static_cast<float>((corners[i] >> 42) & 0x1FFFFF) };
+    }
+    return ComputeConvexHull(points, hull);
+}
+
+float Concavity(const ConvexHull& hull, size_t voxelCount, float totalVolume) {
+    return std::max(0.0f, hull.volume - static_cast<float>(voxelCount)) / totalVolume;
+}
+
+struct CutCandidate {
+    int axis;
+    int position; // voxels with coordinate < position go left
+    float cost;
+};
+
+// Splits parts until they are convex enough, returns their hulls in grid units
+std::vector<ConvexHull> SplitParts(Part root, const ConvexDecompositionOptions& options, float& totalVolume) {
+    std::vector<ConvexHull> result;
+    ConvexHull rootHull;
+    if (!VoxelHull(root.voxels, [](uint32_t) { return true; }, rootHull)) return result;
+    totalVolume = std::max(rootHull.volume, 1.0f);
+
+    std::vector<std::pair<Part, ConvexHull>> pending;
+    pending.push_back({ std::move(root), std::move(rootHull) });
+    while (!pending.empty()) {
+        auto [part, hull] = std::move(pending.back());
+        pending.pop_back();
+
+        if (part.depth >= options.maxDepth || part.voxels.size() < 8 ||
+            Concavity(hull, part.voxels.size(), totalVolume) <= options.concavityThreshold) {
+            result.push_back(std::move(hull));
+            continue;
+        }
+
+        // Candidate planes spread evenly along every axis of the part's bounds
+        int lo[3] = { INT_MAX, INT_MAX, INT_MAX }, hi[3] = { INT_MIN, INT_MIN, INT_MIN };
+        for (uint32_t v : part.voxels) {
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = std::min(lo[a], VoxelCoord(v, a));
+                hi[a] = std::max(hi[a], VoxelCoord(v, a));
+            }
+        }
+        std::vector<CutCandidate> candidates;
+        for (int a = 0; a < 3; ++a) {
+            int span = hi[a] - lo[a] + 1;
+            if (span < 2) continue;
+            int last = -1;
+            for (unsigned int k = 1; k <= options.planesPerAxis; ++k) {
+                int position = lo[a] + static_cast<int>(static_cast<long long>(span) * k / (options.planesPerAxis + 1));
+                position = std::clamp(position, lo[a] + 1, hi[a]);
+                if (position != last) candidates.push_back({ a, position, FLT_MAX });
+                last = position;
+            }
+        }
+        if (candidates.empty()) {
+            result.push_back(std::move(hull));
+            continue;
+        }
+
+        // Both halves of every candidate are hulled independently, so they run in parallel
+        JobSystem::Get().ParallelFor(candidates.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                CutCandidate& cut = candidates[k];
+                float cost = 0.0f;
+                for (int side = 0; side < 2; ++side) {
+                    ConvexHull sideHull;
+                    size_t count = 0;
+                    auto keep = [&](uint32_t v) { return (VoxelCoord(v, cut.axis) < cut.position) == (side == 0); };
+                    if (VoxelHull(part.voxels, keep, sideHull, &count)) {
+                        cost += Concavity(sideHull, count, totalVolume);
+                    }
+                }
+                cut.cost = cost;
+            }
+        });
+        const CutCandidate& best = *std::min_element(candidates.begin(), candidates.end(),
+            [](const CutCandidate& a, const CutCandidate& b) { return a.cost < b.cost; });
+
+        Part halves[2];
+        for (uint32_t v : part.voxels) {
+            halves[VoxelCoord(v, best.axis) < best.position ? 0 : 1].voxels.push_back(v);
+        }
+        for (Part& half : halves) {
+            if (half.voxels.empty()) continue;
+            half.depth = part.depth + 1;
+            ConvexHull halfHull;
+            if (VoxelHull(half.voxels, [](uint32_t) { return true; }, halfHull)) {
+                pending.push_back({ std::move(half), std::move(halfHull) });
+            }
+        }
+    }
+    return result;
+}
+
+bool BoundsTouch(const ConvexHull& a, const ConvexHull& b, float margin) {
+    return a.boundsMin.x <= b.boundsMax.x + margin && b.boundsMin.x <= a.boundsMax.x + margin &&
+        a.boundsMin.y <= b.boundsMax.y + margin && b.boundsMin.y <= a.boundsMax.y + margin &&
+        a.boundsMin.z <= b.boundsMax.z + margin && b.boundsMin.z <= a.boundsMax.z + margin;
+}
+
+bool MergeHulls(const ConvexHull& a, const ConvexHull& b, ConvexHull& out) {
+    std::vector<DirectX::XMFLOAT3> points = a.points;
+    points.insert(points.end(), b.points.begin(), b.points.end());
+    return ComputeConvexHull(points, out);
+}
+
+// Greedily merges the pair of touching hulls whose union adds the least volume
+void MergeToLimit(std::vector<ConvexHull>& hulls, unsigned int maxHulls) {
+    maxHulls = std::max(maxHulls, 1u);
+    struct PairCost {
+        unsigned int a, b;
+        float cost;
+    };
+    auto mergeCost = [&](unsigned int i, unsigned int j) {
+        ConvexHull merged;
+        if (!MergeHulls(hulls[i], hulls[j], merged)) return FLT_MAX;
+        return merged.volume - hulls[i].volume - hulls[j].volume;
+    };
+
+    std::vector<PairCost> pairs;
+    for (unsigned int i = 0; i < hulls.size(); ++i) {
+        for (unsigned int j = i + 1; j < hulls.size(); ++j) {
+            if (BoundsTouch(hulls[i], hulls[j], 1.0f)) pairs.push_back({ i, j, 0.0f });
+        }
+    }
+    // Costs of the pairs from first on, every pair is independent
+    auto updateCosts = [&](size_t first) {
+        JobSystem::Get().ParallelFor(pairs.size() - first, [&](size_t begin, size_t end) {
+            for (size_t k = first + begin; k < first + end; ++k) pairs[k].cost = mergeCost(pairs[k].a, pairs[k].b);
+        });
+    };
+    updateCosts(0);
+
+    std::vector<bool> alive(hulls.size(), true);
+    size_t aliveCount = hulls.size();
+    // Pairs ComputeConvexHull failed on (e.g. all points in a plane), never tried again
+    std::unordered_set<uint64_t> unmergeable;
+    auto pairKey = [](unsigned int i, unsigned int j) { return (static_cast<uint64_t>(std::min(i, j)) << 32) | std::max(i, j); };
+    while (aliveCount > maxHulls) {
+        auto best = std::min_element(pairs.begin(), pairs.end(), [](const PairCost& x, const PairCost& y) { return x.cost < y.cost; });
+        unsigned int keep = 0, drop = 0;
+        ConvexHull merged;
+        if (best != pairs.end() && best->cost != FLT_MAX) {
+            keep = best->a;
+            drop = best->b;
+            if (!MergeHulls(hulls[keep], hulls[drop], merged)) {
+                unmergeable.insert(pairKey(keep, drop));
+                best->cost = FLT_MAX;
+                continue;
+            }
+        }
+        else {
+            // Nothing touches anymore, fall back to the smallest hulls, the smallest pair that merges
+            std::vector<unsigned int> order;
+            for (unsigned int i = 0; i < hulls.size(); ++i) if (alive[i]) order.push_back(i);
+            std::sort(order.begin(), order.end(), [&](unsigned int x, unsigned int y) { return hulls[x].volume < hulls[y].volume; });
+            bool found = false;
+            for (size_t x = 0; x < order.size() && !found; ++x) {
+                for (size_t y = x + 1; y < order.size() && !found; ++y) {
+                    if (unmergeable.count(pairKey(order[x], order[y]))) continue;
+                    if (MergeHulls(hulls[order[x]], hulls[order[y]], merged)) {
+                        keep = order[x];
+                        drop = order[y];
+                        found = true;
+                    }
+                    else {
+                        unmergeable.insert(pairKey(order[x], order[y]));
+                    }
+                }
+            }
+            // No two of them merge, more than maxHulls stay rather than losing geometry
+            if (!found) break;
+        }
+
+        // drop is only retired once its geometry is part of keep
+        hulls[keep] = std::move(merged);
+        alive[drop] = false;
+        aliveCount--;
+        // keep has new points, pairs with it may merge now
+        std::erase_if(unmergeable, [keep](uint64_t key) { return (key >> 32) == keep || (key & 0xFFFFFFFFu) == keep; });
+
+        // Costs involving either hull are stale, the merged one gets fresh pairs
+        pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [&](const PairCost& p) {
+            return p.a == keep || p.b == keep || p.a == drop || p.b == drop; }), pairs.end());
+        size_t firstNew = pairs.size();
+        for (unsigned int i = 0; i < hulls.size(); ++i) {
+            if (alive[i] && i != keep && BoundsTouch(hulls[i], hulls[keep], 1.0f)) pairs.push_back({ std::min(i, keep), std::max(i, keep), 0.0f });
+        }
+        updateCosts(firstNew);
+    }
+
+    size_t dst = 0;
+    for (size_t i = 0; i < hulls.size(); ++i) {
+        if (alive[i]) {
+            if (dst != i) hulls[dst] = std::move(hulls[i]);
+            dst++;
+        }
+    }
+    hulls.resize(dst);
+}
+
+}
+
+bool ComputeConvexHull(const std::vector<DirectX::XMFLOAT3>& points, ConvexHull& out) {
+    return HullBuilder(points).Build(out);
+}
+
+std::vector<ConvexHull> DecomposeConvex(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    const ConvexDecompositionOptions& options, ConvexDecompositionStats* stats) {
+    std::vector<ConvexHull> hulls;
+    if (vertices.empty() || indices.size() < 3) return hulls;
+
+    VoxelGrid grid;
+    Voxelize(vertices, indices, options, grid);
+
+    Part root;
+    for (int z = 0; z < grid.size[2]; ++z) {
+        for (int y = 0; y < grid.size[1]; ++y) {
+            for (int x = 0; x < grid.size[0]; ++x) {
+                if (grid.cells[grid.Index(x, y, z)] == Solid) root.voxels.push_back(PackVoxel(x, y, z));
+            }
+        }
+    }
+    if (stats) stats->solidVoxels = static_cast<unsigned int>(root.voxels.size());
+
+    float totalVolume = 1.0f;
+    hulls = SplitParts(std::move(root), options, totalVolume);
+    if (stats) stats->partsBeforeMerge = static_cast<unsigned int>(hulls.size());
+    MergeToLimit(hulls, options.maxHulls);
+
+    // Grid units back to model space, the hull is rebuilt so planes and volume follow
+    for (ConvexHull& hull : hulls) {
+        std::vector<DirectX::XMFLOAT3> points = hull.points;
+        for (DirectX::XMFLOAT3& p : points) {
+            p = { grid.origin.x + p.x * grid.cellSize, grid.origin.y + p.y * grid.cellSize, grid.origin.z + p.z * grid.cellSize };
+        }
+        ComputeConvexHull(points, hull);
+    }
+    if (stats) stats->hulls = static_cast<unsigned int>(hulls.size());
+    return hulls;
+}
+
+namespace {
+constexpr uint32_t HullCacheMagic = 0x4C4C5548; // "HULL"
+constexpr uint32_t HullCacheVersion = 1;
+}
+
+bool SaveConvexHulls(const std::string& path, uint64_t key, const std::vector<ConvexHull>& hulls) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    // Only the points are stored, faces and planes are rebuilt on load
+    uint32_t header[2] = { HullCacheMagic, HullCacheVersion };
+    uint32_t count = static_cast<uint32_t>(hulls.size());
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const ConvexHull& hull : hulls) {
+        uint32_t points = static_cast<uint32_t>(hull.points.size());
+        file.write(reinterpret_cast<const char*>(&points), sizeof(points));
+        file.write(reinterpret_cast<const char*>(hull.points.data()), points * sizeof(DirectX::XMFLOAT3));
+    }
+    return file.good();
+}
+
+bool LoadConvexHulls(const std::string& path, uint64_t key, std::vector<ConvexHull>& hulls) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    uint32_t header[2] = {};
+    uint64_t fileKey = 0;
+    uint32_t count = 0;
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || header[0] != HullCacheMagic || header[1] != HullCacheVersion || fileKey != key) return false;
+
+    std::vector<ConvexHull> loaded(count);
+    std::vector<DirectX::XMFLOAT3> points;
+    for (ConvexHull& hull : loaded) {
+        uint32_t numPoints = 0;
+        file.read(reinterpret_cast<char*>(&numPoints), sizeof(numPoints));
+        if (!file || numPoints > (1u << 20)) return false;
+        points.resize(numPoints);
+        file.read(reinterpret_cast<char*>(points.data()), numPoints * sizeof(DirectX::XMFLOAT3));
+        if (!file || !ComputeConvexHull(points, hull)) return false;
+    }
+    hulls.swap(loaded);
+    return true;
+}
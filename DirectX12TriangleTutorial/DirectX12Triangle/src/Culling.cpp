@@ -0,0 +1,206 @@
+#include "Culling.h"
+#include <algorithm>
+#include <cmath>
+
+void Frustum::ExtractPlanes(DirectX::FXMMATRIX viewProj)
+{
+    // Gribb/Hartmann: with row vectors the planes are combinations of the matrix columns
+    DirectX::XMMATRIX m = DirectX::XMMatrixTranspose(viewProj);
+    DirectX::XMVECTOR c0 = m.r[0];
+    DirectX::XMVECTOR c1 = m.r[1];
+    DirectX::XMVECTOR c2 = m.r[2];
+    DirectX::XMVECTOR c3 = m.r[3];
+
+    DirectX::XMVECTOR p[Count];
+    p[Left] = DirectX::XMVectorAdd(c3, c0);
+    p[Right] = DirectX::XMVectorSubtract(c3, c0);
+    p[Bottom] = DirectX::XMVectorAdd(c3, c1);
+    p[Top] = DirectX::XMVectorSubtract(c3, c1);
+    p[Near] = c2;
+    p[Far] = DirectX::XMVectorSubtract(c3, c2);
+
+    for (int i = 0; i < Count; ++i) {
+        DirectX::XMStoreFloat4(&planes[i], DirectX::XMPlaneNormalize(p[i]));
+    }
+}
+
+void SceneCuller::UpdateBounds(const std::vector<Model*>& models)
+{
+    for (std::vector<float>* v : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+        v->clear();
+    }
+    modelIndices.clear();
+
+    for (size_t i = 0; i < models.size(); ++i) {
+        if (models[i] == nullptr) continue;
+        const BoundingBox& b = models[i]->b;
+        minX.push_back(b.minX);
+        minY.push_back(b.minY);
+        minZ.push_back(b.minZ);
+        maxX.push_back(b.maxX);
+        maxY.push_back(b.maxY);
+        maxZ.push_back(b.maxZ);
+        modelIndices.push_back(static_cast<unsigned int>(i));
+    }
+}
+
+void SceneCuller::UpdateBounds(const std::vector<BoundingBox>& bounds, const std::vector<unsigned int>& indices)
+{
+    for (std::vector<float>* v : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+        v->resize(indices.size());
+    }
+    for (size_t i = 0; i < indices.size(); ++i) {
+        const BoundingBox& b = bounds[indices[i]];
+        minX[i] = b.minX;
+        minY[i] = b.minY;
+        minZ[i] = b.minZ;
+        maxX[i] = b.maxX;
+        maxY[i] = b.maxY;
+        maxZ[i] = b.maxZ;
+    }
+    modelIndices = indices;
+}
+
+void SceneCuller::Cull(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos,
+    const DirectX::XMFLOAT3& cameraForward, std::vector<unsigned int>& outVisible)
+{
+    Frustum frustum;
+    frustum.ExtractPlanes(DirectX::XMMatrixMultiply(view, proj));
+
+    DirectX::XMFLOAT4 planes[Frustum::Count + 1];
+    size_t planeCount = Frustum::Count;
+    std::copy(frustum.planes, frustum.planes + Frustum::Count, planes);
+
+    if (fogDistance > 0.0f) {
+        // Depth along the view direction never exceeds the distance, so a box past this plane
+        // is past the fog distance too
+        DirectX::XMVECTOR forward = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&cameraForward));
+        float cameraDepth = DirectX::XMVectorGetX(DirectX::XMVector3Dot(forward, DirectX::XMLoadFloat3(&cameraPos)));
+        DirectX::XMFLOAT3 normal;
+        DirectX::XMStoreFloat3(&normal, DirectX::XMVectorNegate(forward));
+        planes[planeCount++] = { normal.x, normal.y, normal.z, cameraDepth + fogDistance };
+    }
+
+    BoxSoA boxes = { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), modelIndices.size() };
+    outVisible.resize(boxes.count);
+    size_t visible = GeometryKernels::CullBoxes(boxes, planes, planeCount, outVisible.data());
+    outVisible.resize(visible);
+    for (unsigned int& index : outVisible) {
+        index = modelIndices[index];
+    }
+
+    stats.tested = static_cast<unsigned int>(boxes.count);
+    stats.visible = static_cast<unsigned int>(visible);
+}
+
+void ClusterCuller::BeginFrame(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos)
+{
+    frustum.ExtractPlanes(DirectX::XMMatrixMultiply(view, proj));
+    this->cameraPos = cameraPos;
+    stats = ClusterCullStats();
+}
+
+void ClusterCuller::Cull(const Model& model, DirectX::FXMMATRIX modelMatrix, std::vector<DrawRange>& outRanges)
+{
+    outRanges.clear();
+
+    const std::vector<Meshlet>& meshlets = model.GetMeshlets();
+    if (meshlets.empty()) {
+        if (model.GetNumIndices() > 0) {
+            outRanges.push_back({ 0, model.GetNumIndices(), 0 });
+        }
+        return;
+    }
+
+    // Work in model space: planes and camera are transformed once instead of every meshlet.
+    // Plane side and "camera behind every face" are preserved by any affine transform.
+    DirectX::XMMATRIX planeToLocal = DirectX::XMMatrixTranspose(modelMatrix);
+    DirectX::XMVECTOR localPlanes[Frustum::Count];
+    for (int i = 0; i < Frustum::Count; ++i) {
+        DirectX::XMVECTOR plane = DirectX::XMVector4Transform(DirectX::XMLoadFloat4(&frustum.planes[i]), planeToLocal);
+        localPlanes[i] = DirectX::XMPlaneNormalize(plane);
+    }
+
+    DirectX::XMVECTOR det;
+    DirectX::XMMATRIX invModel = DirectX::XMMatrixInverse(&det, modelMatrix);
+    DirectX::XMVECTOR localCamera = DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&cameraPos), invModel);
+
+    // Largest axis scale, only needed to hand world space spheres to the occlusion test
+    float maxScale = 1.0f;
+    if (occlusionTest) {
+        maxScale = std::max({
+            DirectX::XMVectorGetX(DirectX::XMVector3Length(modelMatrix.r[0])),
+            DirectX::XMVectorGetX(DirectX::XMVector3Length(modelMatrix.r[1])),
+            DirectX::XMVectorGetX(DirectX::XMVector3Length(modelMatrix.r[2])) });
+    }
+
+    auto outsideFrustum = [&](DirectX::FXMVECTOR center, float radius) {
+        for (int i = 0; i < Frustum::Count; ++i) {
+            if (DirectX::XMVectorGetX(DirectX::XMPlaneDotCoord(localPlanes[i], center)) < -radius) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Groups own contiguous meshlet ranges, a group outside the frustum rejects all of them at once
+    const std::vector<MeshGroup>& groups = model.GetGroups();
+    meshletRanges.clear();
+    if (groups.empty()) {
+        meshletRanges.push_back({ 0, static_cast<unsigned int>(meshlets.size()) });
+    }
+    for (const MeshGroup& group : groups) {
+        if (group.meshletCount == 0) continue;
+        if (outsideFrustum(DirectX::XMLoadFloat3(&group.center), group.radius)) {
+            stats.groupsCulled++;
+            stats.tested += group.meshletCount;
+            stats.frustumCulled += group.meshletCount;
+            continue;
+        }
+        meshletRanges.push_back({ group.firstMeshlet, group.firstMeshlet + group.meshletCount });
+    }
+
+    for (const auto& [rangeBegin, rangeEnd] : meshletRanges) {
+        for (unsigned int index = rangeBegin; index < rangeEnd; ++index) {
+            const Meshlet& m = meshlets[index];
+            stats.tested++;
+
+            DirectX::XMVECTOR center = DirectX::XMLoadFloat3(&m.center);
+            if (outsideFrustum(center, m.radius)) {
+                stats.frustumCulled++;
+                continue;
+            }
+
+            if (enableBackfaceCulling && m.coneCutoff < 1.0f) {
+                DirectX::XMVECTOR toApex = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&m.coneApex), localCamera);
+                toApex = DirectX::XMVector3Normalize(toApex);
+                float d = DirectX::XMVectorGetX(DirectX::XMVector3Dot(toApex, DirectX::XMLoadFloat3(&m.coneAxis)));
+                if (d >= m.coneCutoff) {
+                    stats.backfaceCulled++;
+                    continue;
+                }
+            }
+
+            if (occlusionTest) {
+                DirectX::XMFLOAT3 worldCenter;
+                DirectX::XMStoreFloat3(&worldCenter, DirectX::XMVector3Transform(center, modelMatrix));
+                if (occlusionTest(worldCenter, m.radius * maxScale)) {
+                    stats.occlusionCulled++;
+                    continue;
+                }
+            }
+
+            stats.visible++;
+
+            // Compact: extend the previous range when this meshlet directly follows it
+            if (!outRanges.empty()) {
+                DrawRange& last = outRanges.back();
+                if (last.materialIndex == m.materialIndex && last.startIndex + last.indexCount == m.startIndex) {
+                    last.indexCount += m.indexCount;
+                    continue;
+                }
+            }
+            outRanges.push_back({ m.startIndex, m.indexCount, m.materialIndex });
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include "Engine.h"
 #include <random>
+#include <chrono>
 
 static Engine * engine = nullptr;
 
@@ -9,28 +10,25 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lPara
         return 0;
     }
     else if (message == WM_KEYDOWN) {
-        // Handle key press events here
+        // Handle key press events here, movement keys are only recorded as held, the
+        // simulation walks while they are
+        engine->input.KeyDown(static_cast<unsigned int>(wParam));
+        const bool repeat = (lParam & (1 << 30)) != 0;
         switch (wParam) {
         case VK_ESCAPE:
             // Exit on Escape key
             PostQuitMessage(0);
             return 0;
-        case 'W':
-            engine->renderer->HandleForward(1.0f);
-            return 0;
-        case 'A':
-            engine->renderer->HandleX(-1.0f);
-            return 0;
-        case 'S':
-            engine->renderer->HandleForward(-1.0f);
-            return 0;
-        case 'D':
-            engine->renderer->HandleX(1.0f);
-            return 0;
         case 'C':
-            engine->toggleClickCamera = !engine->toggleClickCamera;
+            if (!repeat) engine->toggleClickCamera = !engine->toggleClickCamera;
         }
     }
+    else if (message == WM_KEYUP) {
+        engine->input.KeyUp(static_cast<unsigned int>(wParam));
+    }
+    else if (message == WM_KILLFOCUS) {
+        engine->input.ReleaseAll();
+    }
     else if (message == WM_SETFOCUS)
     {
         // Hide cursor
@@ -64,7 +62,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lPara
                 engine->lastPos = currentPos;
 
                 if (engine) {
-                    engine->renderer->HandleMouseMove(deltaX, deltaY);
+                    engine->input.MouseMove(deltaX, deltaY);
                 }
             }
             // Recenter cursor to prevent hitting window boundaries
@@ -99,7 +97,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lPara
                     engine->lastPos = currentPos;
 
                     if (engine) {
-                        engine->renderer->HandleMouseMove(deltaX, deltaY);
+                        engine->input.MouseMove(deltaX, deltaY);
                     }
                 }
                 // Recenter cursor to prevent hitting window boundaries
@@ -116,7 +114,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lPara
 }
 
 Engine::Engine(HINSTANCE hInstance, int width, int height) 
-    : hInstance(hInstance), hwnd(nullptr), width(width), height(height), renderer(nullptr)
+    : hInstance(hInstance), hwnd(nullptr), width(width), height(height), renderer(nullptr),
+    scatter(-clearingHalfSize, -clearingHalfSize, clearingHalfSize, clearingHalfSize, scatterSeed)
 {
     engine = this;
 }
@@ -158,6 +157,9 @@ void Engine::InitWindow() {
 }
 
 void Engine::Init() {
+    startTime = std::chrono::steady_clock::now();
+    // Created here so this thread is the main thread, the loading below already runs on it
+    JobSystem::Get();
     InitWindow();
     
     audioPlayer = new AudioPlayer();
@@ -171,229 +173,303 @@ void Engine::Init() {
         audioPlayer->SetVolume(300); // 50% volume
     }
 
-    // Load multiple models
-    models.clear();
-    
-    std::vector<BoundingBox> placedBoundingBoxes;
-
-    // Example: Load grassplane
-    Model* grassplane = new Model();
-    if (grassplane->LoadFromObj("grassplane.obj")) {
-        std::cout << "Grassplane loaded: " << grassplane->GetNumVertices() << " vertices" << std::endl;
-        grassplane->SetPosition(0.0f, 0.0f, 0.0f);
-        grassplane->ApplyTransformation();
-        models.push_back(grassplane);
-    } else {
+    // Everything loads in the background, the first frame doesn't wait for it
+    chunks.Clear();
+    entities.Clear();
+    broadphase.Clear();
+    scatter = PoissonScatter(-clearingHalfSize, -clearingHalfSize, clearingHalfSize, clearingHalfSize, scatterSeed);
+
+    // Create renderer and bind all models
+    renderer = new Renderer(hwnd, width, height);
+    renderer->BindEntities(entities);
+    renderer->c.broadphase = &broadphase;
+    renderer->c.entities = &entities;
+    renderer->c.scene = &scene;
+    renderer->pvs = &pvs;
+    renderer->c.controller.broadphase = &broadphase;
+    renderer->c.controller.entities = &entities;
+    renderer->c.controller.terrain.clear();
+    renderer->Init();
+
+    chunks.entities = &entities;
+    chunks.broadphase = &broadphase;
+    chunks.terrain = &renderer->c.controller.terrain;
+
+    // Started last, what arrives is placed into the scene the renderer already shows
+    sceneLoad = LoadScene();
+}
+
+Task<> Engine::LoadScene() {
+    // All loads start right away and run in parallel. They are awaited in this order, so the
+    // diamonds can scatter around the cabin and Herobrine and the trees around all of them. The
+    // ground and the cabin are next to the start, their reads go first.
+    auto grassplaneLoad = loader.LoadModelAsync("grassplane.obj", [](Model& grassplane) { grassplane.BuildBvh(); }, AssetPriority::High);
+
+    // Written on a worker before the load completes, read after it was awaited
+    MeshCleanupStats cabinCleanup;
+    ConvexDecompositionStats cabinHulls;
+    auto cabinLoad = loader.LoadModelAsync("cottage_obj.obj", [&cabinCleanup, &cabinHulls](Model& cube) {
+        // The export has zero area faces, welding them away leaves their vertices unused
+        cabinCleanup = cube.Cleanup();
+        cabinHulls = cube.BuildCollisionHulls("cottage_obj.hulls");
+        cube.BuildOccluder();
+        cube.BuildBvh();
+    }, AssetPriority::High);
+
+    auto herobrineLoad = loader.LoadModelAsync("Herobrine.obj", [](Model& herobrine) {
+        herobrine.BuildCollisionHulls("Herobrine.hulls");
+        herobrine.BuildBvh();
+    });
+
+    // Every tree is a copy of one loaded tree, the file is parsed and decomposed once
+    MeshCleanupStats treeCleanup;
+    ConvexDecompositionStats treeHulls;
+    auto treeLoad = loader.LoadModelAsync("Mineways2Skfb.obj", [&treeCleanup, &treeHulls](Model& treeTemplate) {
+        // The Mineways export duplicates positions and has zero area faces
+        treeCleanup = treeTemplate.Cleanup();
+        treeHulls = treeTemplate.BuildCollisionHulls("Mineways2Skfb.hulls");
+        // Leaves and trunk share an alpha tested material, only the solid trunk faces occlude
+        treeTemplate.BuildOccluder();
+        treeTemplate.BuildBvh();
+    });
+
+    auto diamondLoad = loader.LoadModelAsync("diamond.obj", [](Model& diamondTemplate) { diamondTemplate.BuildBvh(); }, AssetPriority::Low);
+
+    // Every chunk of the world gets a copy of the grass plane, walked on through the terrain list
+    groundTemplate = co_await grassplaneLoad;
+    if (groundTemplate) {
+        std::cout << "Grassplane loaded: " << groundTemplate->GetNumVertices() << " vertices" << std::endl;
+        groundTemplate->SetPosition(0.0f, 0.0f, 0.0f);
+    }
+    else {
         std::cout << "Failed to load grassplane.obj" << std::endl;
-        delete grassplane;
     }
 
-    // Example: Load cube
-    Model* cube = new Model();
-    if (cube->LoadFromObj("cottage_obj.obj")) {
+    if (std::unique_ptr<Model> cube = co_await cabinLoad) {
         std::cout << "Cube loaded: " << cube->GetNumVertices() << " vertices" << std::endl;
+        std::cout << "Cabin cleanup removed " << cabinCleanup.RemovedVertices() << " vertices, "
+            << cabinCleanup.RemovedTriangles() << " triangles" << std::endl;
+        std::cout << "Cabin collision: " << cabinHulls.hulls << " convex hulls" << (cabinHulls.loadedFromCache ? " (cached)" : "") << std::endl;
         cube->SetPosition(-10.0f, 0.0f, 0.0f);
         cube->SetRotation(0.0f, DirectX::XM_PIDIV2, 0.0f); // DirectX::XM_PIDIV4
         cube->SetScale(2.0f, 2.0f, 2.0f);
-        cube->ApplyTransformation();
-        models.push_back(cube);
-
-		placedBoundingBoxes.push_back(cube->b);
+        Model* cabin = cube.release();
+        entities.Create(cabin, EntityStatic);
+        cabin->broadphaseProxy = broadphase.Insert(cabin->b, cabin);
+        scene.Build(entities.GetModels());
     }
     else {
         std::cout << "Failed to load cube.obj" << std::endl;
-        delete cube;
     }
 
-    Model* herobrine = new Model();
-    herobrineModel = herobrine;
-    if (herobrine->LoadFromObj("Herobrine.obj")) {
-        std::cout << "Cube loaded: " << herobrine->GetNumVertices() << " vertices" << std::endl;
+    if (std::unique_ptr<Model> loaded = co_await herobrineLoad) {
+        std::cout << "Cube loaded: " << loaded->GetNumVertices() << " vertices" << std::endl;
+        Model* herobrine = loaded.release();
         herobrine->SetPosition(20.0f, 0.0f, 0.0f);
         herobrine->SetRotation(0.0f, DirectX::XM_PI, 0.0f); // DirectX::XM_PIDIV4
         herobrine->SetScale(2.0f, 2.0f, 2.0f);
-        herobrine->ApplyTransformation();
-        models.push_back(herobrine);
-
-        placedBoundingBoxes.push_back(herobrine->b);
+        herobrineEntity = entities.Create(herobrine);
+        herobrine->broadphaseProxy = broadphase.Insert(herobrine->b, herobrine);
+        scene.Build(entities.GetModels());
     }
     else {
         std::cout << "Failed to load herobrine.obj" << std::endl;
-        delete herobrine;
     }
 
-    // randomly scatter trees
-    int treeNum = 50;
-    int maxAttempts = 100; // Maximum attempts to place each tree
-    std::uniform_real_distribution<float> distX(-200.0f, 200.0f);
-    std::uniform_real_distribution<float> distZ(-200.0f, 200.0f);
-    std::random_device rd;
-    std::mt19937 gen(rd());
-
-    for (int i = 0; i < treeNum; ++i) {
-        Model* tree = new Model();
-        if (tree->LoadFromObj("Mineways2Skfb.obj")) {
-            bool placed = false;
-
-            // Try to find a non-intersecting position
-            for (int attempt = 0; attempt < maxAttempts; ++attempt) {
-                // Random position
-                float x = distX(gen);
-                float z = distZ(gen);
-                float y = -15.0f; // Keep trees at ground level
-
-                // Set position and scale, then apply transformation to compute bounding box
-                tree->SetPosition(x, y, z);
-                tree->SetScale(30.0f, 30.0f, 30.0f);
-                tree->ApplyTransformation();
-
-                // Check if this tree intersects with any already placed model
-                bool intersects = false;
-                for (const auto& existingBox : placedBoundingBoxes) {
-                    if (tree->b.Intersects(existingBox, tree->b)) {
-                        intersects = true;
-                        break;
-                    }
-                }
+    // Diamonds are scattered around what already stands, the same seed gives the same layout
+    for (Model* model : entities.GetModels()) {
+        scatter.AddObstacle(model->b);
+    }
 
-                if (!intersects) {
-                    // Successfully placed without intersection
-                    models.push_back(tree);
-                    placedBoundingBoxes.push_back(tree->b);
-                    placed = true;
-                    break;
-                }
-            }
-        }
-        else {
-            std::cout << "Failed to load tree.obj" << std::endl;
-            delete tree;
+    if (std::unique_ptr<Model> diamondTemplate = co_await diamondLoad) {
+        diamondTemplate->SetScale(30.0f, 30.0f, 30.0f);
+        diamondTemplate->SetRotation(0.0f, DirectX::XM_PI / 2.0f, 0.0f);
+
+        // The pickup box is 2 wider on every side than the diamond itself
+        int diamondNum = 5;
+        ScatterLayer diamonds;
+        diamonds.radius = PoissonScatter::FootprintRadius(*diamondTemplate) + 2.0f * 1.41421356f;
+        diamonds.minDistance = scatter.SpacingForCount(diamondNum);
+        diamonds.maxCount = diamondNum;
+        std::vector<ScatterPoint> points;
+        scatter.Scatter(diamonds, points);
+        for (const ScatterPoint& point : points) {
+            Model* diamond = new Model(*diamondTemplate);
+            diamond->SetPosition(point.x, 1.0f, point.z);
+            const EntityHandle entity = entities.Create(diamond, EntityStatic | EntityRemovable);
+
+            // Reaches down to the ground and up to 11.5, so walking under it picks it up
+            PickupExtent pickup;
+            pickup.horizontal = 2.0f;
+            pickup.below = 1.0f;
+            pickup.above = 9.0f;
+            entities.SetPickupExtent(entity, pickup);
+            diamond->broadphaseProxy = broadphase.Insert(entities.GetPickupBounds(entity), diamond);
         }
+        scene.Build(entities.GetModels());
+    }
+    else {
+        std::cout << "Failed to load diamond.obj" << std::endl;
     }
 
-    // randomly scatter diamonds
-    int diamondNum = 5;
-    std::uniform_real_distribution<float> diamondX(-200.0f, 200.0f);
-    std::uniform_real_distribution<float> diamondZ(-200.0f, 200.0f);
-    for (int i = 0; i < diamondNum; ++i) {
-        Model* diamond = new Model();
-        diamond->isRemovable = true;
-        if (diamond->LoadFromObj("diamond.obj")) {
-            bool placed = false;
-
-            // Try to find a non-intersecting position
-            for (int attempt = 0; attempt < maxAttempts; ++attempt) {
-                // Random position
-                float x = diamondX(gen);
-                float z = diamondZ(gen);
-                float y = 1.0f;
-
-                // Set position and scale, then apply transformation to compute bounding box
-                diamond->SetPosition(x, y, z);
-                diamond->SetScale(30.0f, 30.0f, 30.0f);
-				diamond->SetRotation(0.0f, DirectX::XM_PI/2.0f, 0.0f);
-                diamond->ApplyTransformation();
-
-                diamond->b.minY = 10.0f;
-                diamond->b.maxY = 11.5f;
-				diamond->b.minX -= 2.0f;
-				diamond->b.maxX += 2.0f;
-				diamond->b.minZ -= 2.0f;
-				diamond->b.maxZ += 2.0f;
-
-                // Check if this diamond intersects with any already placed model
-                bool intersects = false;
-                for (const auto& existingBox : placedBoundingBoxes) {
-                    if (diamond->b.Intersects(existingBox, diamond->b)) {
-                        intersects = true;
-                        break;
-                    }
-                }
-
-                if (!intersects) {
-                    // Successfully placed without intersection
-                    models.push_back(diamond);
-                    placedBoundingBoxes.push_back(diamond->b);
-                    placed = true;
-                    break;
-                }
-            }
-        }
-        else {
-            std::cout << "Failed to load diamond.obj" << std::endl;
-            delete diamond;
-        }
+    // The trees fill a world far larger than the cabin's clearing, chunk by chunk around the
+    // camera. The placement is baked once, around everything placed so far.
+    treeTemplate = co_await treeLoad;
+    std::vector<ChunkLayer> layers;
+    if (treeTemplate) {
+        std::cout << "Tree cleanup removed " << treeCleanup.RemovedVertices() << " vertices, "
+            << treeCleanup.RemovedTriangles() << " triangles" << std::endl;
+        std::cout << "Tree collision: " << treeHulls.hulls << " convex hulls" << (treeHulls.loadedFromCache ? " (cached)" : "") << std::endl;
+        std::cout << "Tree occluder: " << treeTemplate->GetOccluderIndices().size() / 3 << " of "
+            << treeTemplate->GetNumFaces() << " triangles" << std::endl;
+        treeTemplate->SetScale(30.0f, 30.0f, 30.0f);
+
+        // As dense as the 50 trees that used to stand on the 400 x 400 clearing
+        ChunkLayer trees;
+        trees.source = treeTemplate;
+        trees.y = -15.0f; // Keep trees at ground level
+        trees.perChunk = 3;
+        layers.push_back(trees);
     }
-    
-    std::cout << "Total models loaded: " << models.size() << std::endl;
-    
-    // Create renderer and bind all models
-    renderer = new Renderer(hwnd, width, height);
-    renderer->BindModels(models);
-    renderer->Init();
+    else {
+        std::cout << "Failed to load tree.obj" << std::endl;
+    }
+    std::vector<BoundingBox> obstacles;
+    for (Model* model : entities.GetModels()) {
+        obstacles.push_back(model->b);
+    }
+    const ChunkStreamerStats world = chunks.Build(-worldHalfSize, -worldHalfSize, worldHalfSize, worldHalfSize, scatterSeed,
+        layers, obstacles, groundTemplate.get(), "world.chunks");
+    std::cout << "World: " << world.chunks << " chunks, " << world.bakedInstances << " trees" << (world.loadedFromCache ? " (cached)" : "") << std::endl;
+
+    std::cout << "Total models loaded: " << entities.Size() << std::endl;
+
+    // Herobrine teleports and isn't static, a picked up diamond only leaves its bit unused.
+    // Streamed chunks come later and are never rejected. So only the clearing is baked: the
+    // static models all stand in it, and beyond it the cells would only hold the cabin and the
+    // diamonds, seen over the treetops, for 100 times the bake. The camera outside the clearing
+    // is in no cell and keeps everything.
+    std::vector<Model*> staticModels;
+    for (size_t i = 0; i < entities.Size(); ++i) {
+        if (entities.GetFlags()[i] & EntityStatic) staticModels.push_back(entities.GetModels()[i]);
+    }
+    PvsStats visibility = pvs.Build(staticModels, -clearingHalfSize, -clearingHalfSize, clearingHalfSize, clearingHalfSize, "scene.pvs");
+    std::cout << "PVS: " << visibility.cells << " cells, " << visibility.averageVisible << " of " << visibility.objects
+        << " models visible per cell, " << visibility.uniqueRows << " distinct sets" << (visibility.loadedFromCache ? " (cached)" : "") << std::endl;
+
+    const AssetLoaderStats loading = loader.GetStats();
+    std::cout << "Scene loaded after " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count() << " ms: "
+        << loading.models << " models, " << loading.materialFiles << " material files, " << loading.textures << " textures, "
+        << loading.sharedReferences << " shared, " << loading.bytesRead << " bytes read, at most " << loading.peakBytesInFlight << " in flight" << std::endl;
 }
 
 void Engine::Run() {
     MSG msg = {};
-    while (msg.message != WM_QUIT) {
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+    bool running = true;
+    frameClock.Reset();
+    while (running) {
+        // Every message that arrived since the last frame, input lands in the buffered state and
+        // a burst of mouse moves can't hold back the frame
+        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                running = false;
+                break;
+            }
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
-        else {
-            if (renderer->c.IsLookingAtModel(herobrineModel, 0.9f)) {
-                
-                /*std::filesystem::path exePath = GetExecutablePath();
-                std::filesystem::path soundFile = exePath / "assets" / "Audio" / "Cave5.mp3";
-                audioPlayer->PlaySoundEffect(soundFile.string());*/
-                
-                std::uniform_real_distribution<float> distX(-200.0f, 200.0f);
-                std::uniform_real_distribution<float> distZ(-200.0f, 200.0f);
-                std::random_device rd;
-                std::mt19937 gen(rd());
-
-                float x = distX(gen);
-                float z = distZ(gen);
-                float y = 0.0f;
-
-                herobrineModel->SetPosition(x, y, z);
-				herobrineModel->ApplyTransformation();
-
-                renderer->BindModels(models);
-                renderer->CreateAssets();
-                renderer->CreateTextureResources();
-            }
+        if (!running) break;
 
-            if (!renderer->c.collectedDiamonds.empty()) {
-                for (auto* diamond : renderer->c.collectedDiamonds) {
-                    // Find and remove the diamond
-                    auto it = std::find(models.begin(), models.end(), diamond);
-                    if (it != models.end()) {
-                        delete* it;
-                        models.erase(it);
-                    }
-                }
+        // Models that finished loading join the scene, the first frames render without them
+        loader.Update();
 
-                // Clear the collected diamonds list
-                renderer->c.collectedDiamonds.clear();
+        // Chunks around the camera come and go, the one under it is always there
+        if (chunks.Update(renderer->c.cameraPos)) {
+            scene.Build(entities.GetModels());
+        }
 
-                std::filesystem::path exePath = GetExecutablePath();
-                std::filesystem::path soundFile = exePath / "assets" / "Audio" / "diamond.mp3";
-                audioPlayer->PlaySoundEffect(soundFile.string());
+        // As many fixed steps as the real time since the last frame holds, none on a fast display
+        const unsigned int steps = frameClock.Advance();
+        for (unsigned int i = 0; i < steps; ++i) {
+            const auto stepStart = std::chrono::steady_clock::now();
+            Simulate(static_cast<float>(frameClock.GetStep()));
+            frameClock.AddStepTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - stepStart).count());
+        }
 
-                // Update renderer with new model list
-                renderer->BindModels(models);
-                renderer->CreateAssets();
-                renderer->CreateTextureResources();
-            }
+        // Work other threads handed back to the main thread, like D3D calls
+        JobSystem::Get().PumpMainThread();
 
-            renderer->Update();
-            renderer->Render();
+        // Entities below the ones that moved follow, untouched subtrees cost nothing
+        entities.UpdateTransforms();
+
+        // Only what was created, destroyed or moved this frame reaches the renderer
+        EntityChanges changes = entities.TakeChanges();
+        if (!changes.IsEmpty()) {
+            renderer->ApplyChanges(changes);
+        }
+
+        renderer->Update();
+        renderer->Render(frameClock.GetAlpha(), frameClock.GetTime());
+        if (!firstFrameShown) {
+            firstFrameShown = true;
+            std::cout << "Time to first frame: " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count() << " ms" << std::endl;
         }
     }
 }
 
+void Engine::Simulate(float deltaTime) {
+    Camera& camera = renderer->c;
+    camera.BeginStep();
+
+    // Everything the mouse moved since the last step, then the held keys
+    const DirectX::XMFLOAT2 look = input.TakeMouseDelta();
+    if (look.x != 0.0f || look.y != 0.0f) {
+        camera.MouseMovement(look.x, look.y);
+    }
+    const float forward = (input.IsDown('W') ? 1.0f : 0.0f) - (input.IsDown('S') ? 1.0f : 0.0f);
+    const float right = (input.IsDown('D') ? 1.0f : 0.0f) - (input.IsDown('A') ? 1.0f : 0.0f);
+    camera.Move(forward, right, deltaTime);
+    camera.Update(deltaTime);
+
+    Model* herobrine = entities.GetModel(herobrineEntity);
+    if (camera.IsLookingAtModel(herobrine, 0.9f)) {
+        
+        /*std::filesystem::path exePath = GetExecutablePath();
+        std::filesystem::path soundFile = exePath / "assets" / "Audio" / "Cave5.mp3";
+        audioPlayer->PlaySoundEffect(soundFile.string());*/
+        
+        std::uniform_real_distribution<float> distX(-worldHalfSize, worldHalfSize);
+        std::uniform_real_distribution<float> distZ(-worldHalfSize, worldHalfSize);
+
+        float x = distX(gameplayRandom);
+        float z = distZ(gameplayRandom);
+        float y = 0.0f;
+
+        // Only the world matrix changes, the uploaded geometry stays valid
+        entities.SetPosition(herobrineEntity, { x, y, z });
+        broadphase.Move(herobrine->broadphaseProxy, herobrine->b);
+        scene.Build(entities.GetModels());
+    }
+
+    if (!camera.collectedDiamonds.empty()) {
+        for (EntityHandle diamond : camera.collectedDiamonds) {
+            RemoveEntity(diamond);
+        }
+
+        // Clear the collected diamonds list
+        camera.collectedDiamonds.clear();
+        scene.Build(entities.GetModels());
+
+        std::filesystem::path exePath = GetExecutablePath();
+        std::filesystem::path soundFile = exePath / "assets" / "Audio" / "diamond.mp3";
+        audioPlayer->PlaySoundEffect(soundFile.string());
+    }
+}
+
 void Engine::Cleanup() {
+    // Its ground copies are in the renderer's terrain list
+    chunks.Clear();
+
     if (renderer) {
         delete renderer;
         renderer = nullptr;
@@ -405,9 +481,16 @@ void Engine::Cleanup() {
         audioPlayer = nullptr;
     }
     
-    // Clean up dynamically allocated models
-    for (auto& model : models) {
-        delete model;
-    }
-    models.clear();
+    // Deletes the models
+    entities.Clear();
+    broadphase.Clear();
+    scene.Clear();
+}
+
+void Engine::RemoveEntity(EntityHandle entity) {
+    // Stale handles (a diamond collected twice) find no model
+    Model* model = entities.GetModel(entity);
+    if (!model) return;
+    broadphase.Remove(model->broadphaseProxy);
+    entities.Destroy(entity);
 }
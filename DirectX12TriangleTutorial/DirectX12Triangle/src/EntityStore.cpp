@@ -0,0 +1,190 @@
+#include "EntityStore.h"
+#include <utility>
+
+EntityStore::~EntityStore() {
+    Clear();
+}
+
+EntityHandle EntityStore::Create(Model* model, uint32_t entityFlags, EntityHandle parent) {
+    if (!model) return EntityHandle();
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(denseIndices.size());
+        denseIndices.push_back(InvalidIndex);
+        generations.push_back(0);
+    }
+
+    const EntityHandle entity = { slot, generations[slot] };
+
+    const uint32_t parentIndex = IndexOf(parent);
+    const uint32_t parentNode = parentIndex != InvalidIndex ? nodes[parentIndex] : TransformGraph::NoNode;
+    const uint32_t node = transforms.Add(model->GetLocalMatrix(), parentNode);
+    if (parentNode != TransformGraph::NoNode) {
+        model->SetWorldMatrix(transforms.GetWorld(parentNode), transforms.GetWorld(node));
+    }
+    if (node >= nodeEntities.size()) nodeEntities.resize(node + 1);
+    nodeEntities[node] = entity;
+
+    denseIndices[slot] = static_cast<uint32_t>(models.size());
+    models.push_back(model);
+    worlds.emplace_back();
+    normalMatrices.push_back(transforms.GetNormalMatrix(node));
+    nodes.push_back(node);
+    bounds.push_back(model->b);
+    flags.push_back(entityFlags);
+    pickupExtents.emplace_back();
+    handles.push_back(entity);
+    model->entity = entity;
+    SyncAt(denseIndices[slot]);
+    changes.created.push_back(entity);
+    return entity;
+}
+
+bool EntityStore::Destroy(EntityHandle entity) {
+    const uint32_t index = IndexOf(entity);
+    if (index == InvalidIndex) return false;
+
+    // What hangs below goes with it
+    removedNodes.clear();
+    transforms.Remove(nodes[index], &removedNodes);
+    for (uint32_t node : removedNodes) {
+        DestroyAt(IndexOf(nodeEntities[node]));
+    }
+    return true;
+}
+
+void EntityStore::DestroyAt(uint32_t index) {
+    const EntityHandle entity = handles[index];
+    delete models[index];
+
+    // The last entity fills the hole
+    const uint32_t last = static_cast<uint32_t>(models.size() - 1);
+    if (index != last) {
+        models[index] = models[last];
+        worlds[index] = worlds[last];
+        normalMatrices[index] = normalMatrices[last];
+        nodes[index] = nodes[last];
+        bounds[index] = bounds[last];
+        flags[index] = flags[last];
+        pickupExtents[index] = pickupExtents[last];
+        handles[index] = handles[last];
+        denseIndices[handles[index].index] = index;
+    }
+    models.pop_back();
+    worlds.pop_back();
+    normalMatrices.pop_back();
+    nodes.pop_back();
+    bounds.pop_back();
+    flags.pop_back();
+    pickupExtents.pop_back();
+    handles.pop_back();
+
+    denseIndices[entity.index] = InvalidIndex;
+    ++generations[entity.index];
+    freeSlots.push_back(entity.index);
+    changes.destroyed.push_back(entity);
+}
+
+void EntityStore::Clear() {
+    for (size_t i = 0; i < models.size(); ++i) {
+        delete models[i];
+        changes.destroyed.push_back(handles[i]);
+    }
+    models.clear();
+    worlds.clear();
+    normalMatrices.clear();
+    nodes.clear();
+    bounds.clear();
+    flags.clear();
+    pickupExtents.clear();
+    handles.clear();
+    transforms.Clear();
+    nodeEntities.clear();
+    // Generations are kept, handles from before the clear stay stale
+    freeSlots.clear();
+    for (uint32_t slot = 0; slot < denseIndices.size(); ++slot) {
+        denseIndices[slot] = InvalidIndex;
+        ++generations[slot];
+        freeSlots.push_back(slot);
+    }
+}
+
+uint32_t EntityStore::IndexOf(EntityHandle entity) const {
+    if (entity.index >= denseIndices.size() || generations[entity.index] != entity.generation) return InvalidIndex;
+    return denseIndices[entity.index];
+}
+
+Model* EntityStore::GetModel(EntityHandle entity) const {
+    const uint32_t index = IndexOf(entity);
+    return index != InvalidIndex ? models[index] : nullptr;
+}
+
+bool EntityStore::HasFlags(EntityHandle entity, uint32_t entityFlags) const {
+    const uint32_t index = IndexOf(entity);
+    return index != InvalidIndex && (flags[index] & entityFlags) == entityFlags;
+}
+
+void EntityStore::SetPickupExtent(EntityHandle entity, const PickupExtent& extent) {
+    const uint32_t index = IndexOf(entity);
+    if (index != InvalidIndex) pickupExtents[index] = extent;
+}
+
+BoundingBox EntityStore::GetPickupBounds(EntityHandle entity) const {
+    const uint32_t index = IndexOf(entity);
+    if (index == InvalidIndex) return {};
+    const BoundingBox& b = bounds[index];
+    const PickupExtent& extent = pickupExtents[index];
+    BoundingBox pickup;
+    pickup.SetBbox(b.minX - extent.horizontal, b.maxX + extent.horizontal, b.minZ - extent.horizontal, b.maxZ + extent.horizontal,
+        b.minY - extent.below, b.maxY + extent.above);
+    return pickup;
+}
+
+void EntityStore::SetPosition(EntityHandle entity, const DirectX::XMFLOAT3& position) {
+    const uint32_t index = IndexOf(entity);
+    if (index == InvalidIndex) return;
+    models[index]->SetPosition(position.x, position.y, position.z);
+    transforms.SetLocal(nodes[index], models[index]->GetLocalMatrix());
+    SyncAt(index);
+    changes.moved.push_back(entity);
+}
+
+void EntityStore::Sync(EntityHandle entity) {
+    const uint32_t index = IndexOf(entity);
+    if (index == InvalidIndex) return;
+    transforms.SetLocal(nodes[index], models[index]->GetLocalMatrix());
+    SyncAt(index);
+    changes.moved.push_back(entity);
+}
+
+void EntityStore::UpdateTransforms() {
+    transforms.Update();
+    for (uint32_t node : transforms.GetUpdated()) {
+        const EntityHandle entity = nodeEntities[node];
+        const uint32_t index = IndexOf(entity);
+        const uint32_t parent = transforms.GetParent(node);
+        // A root placed itself when it was moved
+        if (parent != TransformGraph::NoNode) {
+            models[index]->SetWorldMatrix(transforms.GetWorld(parent), transforms.GetWorld(node));
+            SyncAt(index);
+            changes.moved.push_back(entity);
+        }
+        normalMatrices[index] = transforms.GetNormalMatrix(node);
+    }
+}
+
+EntityChanges EntityStore::TakeChanges() {
+    EntityChanges taken;
+    std::swap(taken, changes);
+    return taken;
+}
+
+void EntityStore::SyncAt(uint32_t index) {
+    DirectX::XMStoreFloat4x4(&worlds[index], models[index]->GetModelMatrix());
+    bounds[index] = models[index]->b;
+}
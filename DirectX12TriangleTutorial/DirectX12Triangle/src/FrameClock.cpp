@@ -0,0 +1,58 @@
+#include "FrameClock.h"
+#include <algorithm>
+
+FrameClock::FrameClock(unsigned int stepsPerSecond, unsigned int maxStepsPerFrame)
+    : stepsPerSecond(std::max(stepsPerSecond, 1u)), maxStepsPerFrame(std::max(maxStepsPerFrame, 1u)) {
+}
+
+void FrameClock::Reset() {
+    accumulator = 0;
+    stepCount = 0;
+    lastFrame = Clock::now();
+    started = true;
+    stats = {};
+    frameSeconds = 0.0;
+    stepSeconds = 0.0;
+}
+
+unsigned int FrameClock::Advance() {
+    if (!started) Reset();
+    const Clock::time_point now = Clock::now();
+    const std::chrono::nanoseconds frameTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastFrame);
+    lastFrame = now;
+    return Advance(frameTime);
+}
+
+unsigned int FrameClock::Advance(std::chrono::nanoseconds frameTime) {
+    const uint64_t nanoseconds = static_cast<uint64_t>(std::max<int64_t>(frameTime.count(), 0));
+    const double seconds = static_cast<double>(nanoseconds) * 1e-9;
+    stats.frames++;
+    frameSeconds += seconds;
+    stats.worstFrameMs = std::max(stats.worstFrameMs, static_cast<float>(seconds * 1000.0));
+
+    accumulator += nanoseconds * stepsPerSecond;
+    unsigned int steps = static_cast<unsigned int>(accumulator / StepTicks);
+    accumulator %= StepTicks;
+    if (steps > maxStepsPerFrame) {
+        stats.droppedSteps += steps - maxStepsPerFrame;
+        steps = maxStepsPerFrame;
+    }
+    stepCount += steps;
+    stats.steps += steps;
+    return steps;
+}
+
+void FrameClock::AddStepTime(double seconds) {
+    stepSeconds += seconds;
+    stats.worstStepMs = std::max(stats.worstStepMs, static_cast<float>(seconds * 1000.0));
+}
+
+FrameClockStats FrameClock::TakeStats() {
+    FrameClockStats result = stats;
+    result.frameMs = result.frames > 0 ? static_cast<float>(frameSeconds * 1000.0 / result.frames) : 0.0f;
+    result.stepMs = result.steps > 0 ? static_cast<float>(stepSeconds * 1000.0 / result.steps) : 0.0f;
+    stats = {};
+    frameSeconds = 0.0;
+    stepSeconds = 0.0;
+    return result;
+}
@@ -0,0 +1,959 @@
+#include "GeometryKernels.h"
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+#include <bit>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GEOMETRY_KERNELS_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+// MSVC accepts every intrinsic regardless of /arch, the dispatcher guards their use
+#define KERNEL_TARGET(isa)
+#else
+#include <immintrin.h>
+#include <cpuid.h>
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace {
+
+struct KernelTable {
+    void (*transformPoints)(Float3Span, const DirectX::XMFLOAT4X4&);
+    void (*transformNormals)(Float3Span, const DirectX::XMFLOAT4X4&);
+    void (*computeBounds)(Float3Span, DirectX::XMFLOAT3&, DirectX::XMFLOAT3&);
+    void (*scaleTranslate)(Float3Span, const DirectX::XMFLOAT3&, const DirectX::XMFLOAT3&);
+    void (*accumulateFaceNormals)(Float3Span, const unsigned int*, size_t, Float3Span);
+    void (*normalize)(Float3Span);
+    size_t (*overlapBoxes)(const BoxSoA&, const DirectX::XMFLOAT3&, const DirectX::XMFLOAT3&, unsigned int*);
+    size_t (*cullBoxes)(const BoxSoA&, const DirectX::XMFLOAT4*, size_t, unsigned int*);
+    void (*multiplyMatrices)(const DirectX::XMFLOAT4X4*, const DirectX::XMFLOAT4X4*, DirectX::XMFLOAT4X4*, size_t);
+};
+
+// ---------------------------------------------------------------------------
+// Scalar reference, also used for the tails of the SIMD variants
+// ---------------------------------------------------------------------------
+
+void TransformPointsScalar(Float3Span p, const DirectX::XMFLOAT4X4& m) {
+    for (size_t i = 0; i < p.count; ++i) {
+        float* v = p.At(i);
+        float x = v[0], y = v[1], z = v[2];
+        v[0] = x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + m.m[3][0];
+        v[1] = x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + m.m[3][1];
+        v[2] = x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2] + m.m[3][2];
+    }
+}
+
+inline void NormalizeScalar(float* v) {
+    float lenSq = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    if (lenSq > 0.0f) {
+        float len = sqrtf(lenSq);
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    }
+}
+
+void TransformNormalsScalar(Float3Span n, const DirectX::XMFLOAT4X4& m) {
+    for (size_t i = 0; i < n.count; ++i) {
+        float* v = n.At(i);
+        float x = v[0], y = v[1], z = v[2];
+        v[0] = x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0];
+        v[1] = x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1];
+        v[2] = x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2];
+        NormalizeScalar(v);
+    }
+}
+
+void ComputeBoundsScalar(Float3Span p, DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax) {
+    float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < p.count; ++i) {
+        const float* v = p.At(i);
+        for (int k = 0; k < 3; ++k) {
+            mn[k] = std::min(mn[k], v[k]);
+            mx[k] = std::max(mx[k], v[k]);
+        }
+    }
+    outMin = { mn[0], mn[1], mn[2] };
+    outMax = { mx[0], mx[1], mx[2] };
+}
+
+void ScaleTranslateScalar(Float3Span p, const DirectX::XMFLOAT3& s, const DirectX::XMFLOAT3& o) {
+    for (size_t i = 0; i < p.count; ++i) {
+        float* v = p.At(i);
+        v[0] = v[0] * s.x + o.x;
+        v[1] = v[1] * s.y + o.y;
+        v[2] = v[2] * s.z + o.z;
+    }
+}
+
+inline void AddCorner(Float3Span normals, unsigned int index, float x, float y, float z) {
+    float* n = normals.At(index);
+    n[0] += x;
+    n[1] += y;
+    n[2] += z;
+}
+
+void AccumulateFaceNormalsScalar(Float3Span positions, const unsigned int* indices, size_t indexCount, Float3Span normals) {
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const float* p0 = positions.At(indices[t]);
+        const float* p1 = positions.At(indices[t + 1]);
+        const float* p2 = positions.At(indices[t + 2]);
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float cx = e1[1] * e2[2] - e1[2] * e2[1];
+        float cy = e1[2] * e2[0] - e1[0] * e2[2];
+        float cz = e1[0] * e2[1] - e1[1] * e2[0];
+        for (size_t k = 0; k < 3; ++k) {
+            AddCorner(normals, indices[t + k], cx, cy, cz);
+        }
+    }
+}
+
+void NormalizeScalarSpan(Float3Span v) {
+    for (size_t i = 0; i < v.count; ++i) {
+        NormalizeScalar(v.At(i));
+    }
+}
+
+size_t OverlapBoxesScalar(const BoxSoA& b, const DirectX::XMFLOAT3& qMin, const DirectX::XMFLOAT3& qMax, unsigned int* out) {
+    size_t hits = 0;
+    for (size_t i = 0; i < b.count; ++i) {
+        bool overlap = b.minX[i] <= qMax.x && b.maxX[i] >= qMin.x &&
+            b.minY[i] <= qMax.y && b.maxY[i] >= qMin.y &&
+            b.minZ[i] <= qMax.z && b.maxZ[i] >= qMin.z;
+        // Always written, only kept when it overlaps
+        out[hits] = static_cast<unsigned int>(i);
+        hits += overlap;
+    }
+    return hits;
+}
+
+// Corner of the boxes farthest along the plane normal, the box is outside when even that one is
+struct PositiveCorner {
+    const float* x;
+    const float* y;
+    const float* z;
+
+    PositiveCorner(const BoxSoA& b, const DirectX::XMFLOAT4& plane)
+        : x(plane.x >= 0.0f ? b.maxX : b.minX), y(plane.y >= 0.0f ? b.maxY : b.minY), z(plane.z >= 0.0f ? b.maxZ : b.minZ) {
+    }
+};
+
+size_t CullBoxesScalar(const BoxSoA& b, const DirectX::XMFLOAT4* planes, size_t planeCount, unsigned int* out) {
+    size_t hits = 0;
+    for (size_t i = 0; i < b.count; ++i) {
+        bool inside = true;
+        for (size_t p = 0; p < planeCount && inside; ++p) {
+            const DirectX::XMFLOAT4& plane = planes[p];
+            PositiveCorner c(b, plane);
+            inside = plane.x * c.x[i] + plane.y * c.y[i] + plane.z * c.z[i] + plane.w >= 0.0f;
+        }
+        out[hits] = static_cast<unsigned int>(i);
+        hits += inside;
+    }
+    return hits;
+}
+
+BoxSoA SubBoxes(const BoxSoA& b, size_t offset) {
+    return { b.minX + offset, b.minY + offset, b.minZ + offset, b.maxX + offset, b.maxY + offset, b.maxZ + offset, b.count - offset };
+}
+
+// Appends base + the set bits of mask, lowest first
+inline size_t EmitMask(unsigned int mask, size_t base, unsigned int* out, size_t hits) {
+    while (mask) {
+        out[hits++] = static_cast<unsigned int>(base + std::countr_zero(mask));
+        mask &= mask - 1;
+    }
+    return hits;
+}
+
+void MultiplyMatricesScalar(const DirectX::XMFLOAT4X4* a, const DirectX::XMFLOAT4X4* b, DirectX::XMFLOAT4X4* out, size_t count) {
+    for (size_t n = 0; n < count; ++n) {
+        const DirectX::XMFLOAT4X4 rhs = b[n]; // out may alias b
+        for (int r = 0; r < 4; ++r) {
+            const float a0 = a[n].m[r][0], a1 = a[n].m[r][1], a2 = a[n].m[r][2], a3 = a[n].m[r][3];
+            for (int c = 0; c < 4; ++c) {
+                out[n].m[r][c] = a0 * rhs.m[0][c] + a1 * rhs.m[1][c] + a2 * rhs.m[2][c] + a3 * rhs.m[3][c];
+            }
+        }
+    }
+}
+
+const KernelTable scalarTable = {
+    TransformPointsScalar, TransformNormalsScalar, ComputeBoundsScalar,
+    ScaleTranslateScalar, AccumulateFaceNormalsScalar, NormalizeScalarSpan,
+    OverlapBoxesScalar,
+    CullBoxesScalar,
+    MultiplyMatricesScalar
+};
+
+#ifdef GEOMETRY_KERNELS_X86
+
+// ---------------------------------------------------------------------------
+// SSE4.1: one float3 per register, loads/stores never touch the 4th float
+// ---------------------------------------------------------------------------
+
+KERNEL_TARGET("sse4.1") inline __m128 LoadFloat3(const float* p) {
+    __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+    __m128 z = _mm_load_ss(p + 2);
+    return _mm_movelh_ps(xy, z);
+}
+
+KERNEL_TARGET("sse4.1") inline void StoreFloat3(float* p, __m128 v) {
+    _mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(v));
+    _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+}
+
+KERNEL_TARGET("sse4.1") inline __m128 Normalize3(__m128 v) {
+    __m128 lenSq = _mm_dp_ps(v, v, 0x7F);
+    __m128 valid = _mm_cmpgt_ps(lenSq, _mm_setzero_ps());
+    return _mm_blendv_ps(v, _mm_div_ps(v, _mm_sqrt_ps(lenSq)), valid);
+}
+
+KERNEL_TARGET("sse4.1") inline __m128 Transform3(__m128 v, __m128 r0, __m128 r1, __m128 r2) {
+    __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0), _mm_mul_ps(y, r1)), _mm_mul_ps(z, r2));
+}
+
+KERNEL_TARGET("sse4.1") void TransformPointsSSE41(Float3Span p, const DirectX::XMFLOAT4X4& m) {
+    __m128 r0 = _mm_loadu_ps(m.m[0]);
+    __m128 r1 = _mm_loadu_ps(m.m[1]);
+    __m128 r2 = _mm_loadu_ps(m.m[2]);
+    __m128 r3 = _mm_loadu_ps(m.m[3]);
+    for (size_t i = 0; i < p.count; ++i) {
+        float* v = p.At(i);
+        StoreFloat3(v, _mm_add_ps(Transform3(LoadFloat3(v), r0, r1, r2), r3));
+    }
+}
+
+KERNEL_TARGET("sse4.1") void TransformNormalsSSE41(Float3Span n, const DirectX::XMFLOAT4X4& m) {
+    __m128 r0 = _mm_loadu_ps(m.m[0]);
+    __m128 r1 = _mm_loadu_ps(m.m[1]);
+    __m128 r2 = _mm_loadu_ps(m.m[2]);
+    for (size_t i = 0; i < n.count; ++i) {
+        float* v = n.At(i);
+        StoreFloat3(v, Normalize3(Transform3(LoadFloat3(v), r0, r1, r2)));
+    }
+}
+
+KERNEL_TARGET("sse4.1") void ComputeBoundsSSE41(Float3Span p, DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax) {
+    __m128 mn = _mm_set1_ps(FLT_MAX);
+    __m128 mx = _mm_set1_ps(-FLT_MAX);
+    for (size_t i = 0; i < p.count; ++i) {
+        __m128 v = LoadFloat3(p.At(i));
+        mn = _mm_min_ps(mn, v);
+        mx = _mm_max_ps(mx, v);
+    }
+    StoreFloat3(&outMin.x, mn);
+    StoreFloat3(&outMax.x, mx);
+}
+
+KERNEL_TARGET("sse4.1") void ScaleTranslateSSE41(Float3Span p, const DirectX::XMFLOAT3& s, const DirectX::XMFLOAT3& o) {
+    __m128 scale = LoadFloat3(&s.x);
+    __m128 offset = LoadFloat3(&o.x);
+    for (size_t i = 0; i < p.count; ++i) {
+        float* v = p.At(i);
+        StoreFloat3(v, _mm_add_ps(_mm_mul_ps(LoadFloat3(v), scale), offset));
+    }
+}
+
+KERNEL_TARGET("sse4.1") inline __m128 Cross3(__m128 a, __m128 b) {
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+KERNEL_TARGET("sse4.1") void AccumulateFaceNormalsSSE41(Float3Span positions, const unsigned int* indices, size_t indexCount, Float3Span normals) {
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        __m128 p0 = LoadFloat3(positions.At(indices[t]));
+        __m128 p1 = LoadFloat3(positions.At(indices[t + 1]));
+        __m128 p2 = LoadFloat3(positions.At(indices[t + 2]));
+        __m128 c = Cross3(_mm_sub_ps(p1, p0), _mm_sub_ps(p2, p0));
+        for (size_t k = 0; k < 3; ++k) {
+            float* n = normals.At(indices[t + k]);
+            StoreFloat3(n, _mm_add_ps(LoadFloat3(n), c));
+        }
+    }
+}
+
+KERNEL_TARGET("sse4.1") void NormalizeSSE41(Float3Span v) {
+    for (size_t i = 0; i < v.count; ++i) {
+        float* p = v.At(i);
+        StoreFloat3(p, Normalize3(LoadFloat3(p)));
+    }
+}
+
+KERNEL_TARGET("sse4.1") size_t OverlapBoxesSSE41(const BoxSoA& b, const DirectX::XMFLOAT3& qMin, const DirectX::XMFLOAT3& qMax, unsigned int* out) {
+    const __m128 loX = _mm_set1_ps(qMin.x), loY = _mm_set1_ps(qMin.y), loZ = _mm_set1_ps(qMin.z);
+    const __m128 hiX = _mm_set1_ps(qMax.x), hiY = _mm_set1_ps(qMax.y), hiZ = _mm_set1_ps(qMax.z);
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 4 <= b.count; i += 4) {
+        __m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(b.minX + i), hiX), _mm_cmpge_ps(_mm_loadu_ps(b.maxX + i), loX));
+        overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(b.minY + i), hiY), _mm_cmpge_ps(_mm_loadu_ps(b.maxY + i), loY)));
+        overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(b.minZ + i), hiZ), _mm_cmpge_ps(_mm_loadu_ps(b.maxZ + i), loZ)));
+        hits = EmitMask(static_cast<unsigned int>(_mm_movemask_ps(overlap)), i, out, hits);
+    }
+    size_t tail = OverlapBoxesScalar(SubBoxes(b, i), qMin, qMax, out + hits);
+    for (size_t k = hits; k < hits + tail; ++k) out[k] += static_cast<unsigned int>(i);
+    return hits + tail;
+}
+
+KERNEL_TARGET("sse4.1") size_t CullBoxesSSE41(const BoxSoA& b, const DirectX::XMFLOAT4* planes, size_t planeCount, unsigned int* out) {
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 4 <= b.count; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (size_t p = 0; p < planeCount; ++p) {
+            const DirectX::XMFLOAT4& plane = planes[p];
+            PositiveCorner c(b, plane);
+            __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(c.x + i)), _mm_set1_ps(plane.w));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(c.y + i)));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(c.z + i)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+            if (_mm_movemask_ps(inside) == 0) break;
+        }
+        hits = EmitMask(static_cast<unsigned int>(_mm_movemask_ps(inside)), i, out, hits);
+    }
+    size_t tail = CullBoxesScalar(SubBoxes(b, i), planes, planeCount, out + hits);
+    for (size_t k = hits; k < hits + tail; ++k) out[k] += static_cast<unsigned int>(i);
+    return hits + tail;
+}
+
+// One output row per register: the row of a, broadcast element by element, weights the rows of b
+KERNEL_TARGET("sse4.1") void MultiplyMatricesSSE41(const DirectX::XMFLOAT4X4* a, const DirectX::XMFLOAT4X4* b, DirectX::XMFLOAT4X4* out, size_t count) {
+    for (size_t n = 0; n < count; ++n) {
+        const __m128 b0 = _mm_loadu_ps(b[n].m[0]);
+        const __m128 b1 = _mm_loadu_ps(b[n].m[1]);
+        const __m128 b2 = _mm_loadu_ps(b[n].m[2]);
+        const __m128 b3 = _mm_loadu_ps(b[n].m[3]);
+        for (int r = 0; r < 4; ++r) {
+            const __m128 row = _mm_loadu_ps(a[n].m[r]);
+            __m128 v = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+            _mm_storeu_ps(out[n].m[r], v);
+        }
+    }
+}
+
+const KernelTable sse41Table = {
+    TransformPointsSSE41, TransformNormalsSSE41, ComputeBoundsSSE41,
+    ScaleTranslateSSE41, AccumulateFaceNormalsSSE41, NormalizeSSE41,
+    OverlapBoxesSSE41,
+    CullBoxesSSE41,
+    MultiplyMatricesSSE41
+};
+
+// ---------------------------------------------------------------------------
+// AVX2: 8 elements per register in SoA form, gathered from the strided span.
+// AVX2 has no scatter, so results go through a small stack buffer.
+// ---------------------------------------------------------------------------
+
+// Gathers use 32-bit byte offsets
+inline bool FitsGather(const Float3Span& s, size_t lanes) {
+    return s.stride * lanes <= static_cast<size_t>(INT_MAX);
+}
+
+KERNEL_TARGET("avx2,fma") inline __m256i LaneOffsets8(size_t stride) {
+    return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(stride)));
+}
+
+KERNEL_TARGET("avx2,fma") inline void Scatter8(Float3Span s, size_t i, __m256 x, __m256 y, __m256 z) {
+    alignas(32) float bx[8], by[8], bz[8];
+    _mm256_store_ps(bx, x);
+    _mm256_store_ps(by, y);
+    _mm256_store_ps(bz, z);
+    for (int k = 0; k < 8; ++k) {
+        float* v = s.At(i + k);
+        v[0] = bx[k];
+        v[1] = by[k];
+        v[2] = bz[k];
+    }
+}
+
+KERNEL_TARGET("avx2,fma") inline void Normalize8(__m256& x, __m256& y, __m256& z) {
+    __m256 lenSq = _mm256_fmadd_ps(z, z, _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x)));
+    __m256 valid = _mm256_cmp_ps(lenSq, _mm256_setzero_ps(), _CMP_GT_OQ);
+    __m256 len = _mm256_sqrt_ps(lenSq);
+    x = _mm256_blendv_ps(x, _mm256_div_ps(x, len), valid);
+    y = _mm256_blendv_ps(y, _mm256_div_ps(y, len), valid);
+    z = _mm256_blendv_ps(z, _mm256_div_ps(z, len), valid);
+}
+
+KERNEL_TARGET("avx2,fma") void TransformPointsAVX2(Float3Span p, const DirectX::XMFLOAT4X4& m) {
+    size_t i = 0;
+    if (FitsGather(p, 8)) {
+        const __m256i offsets = LaneOffsets8(p.stride);
+        __m256 m00 = _mm256_set1_ps(m.m[0][0]), m01 = _mm256_set1_ps(m.m[0][1]), m02 = _mm256_set1_ps(m.m[0][2]);
+        __m256 m10 = _mm256_set1_ps(m.m[1][0]), m11 = _mm256_set1_ps(m.m[1][1]), m12 = _mm256_set1_ps(m.m[1][2]);
+        __m256 m20 = _mm256_set1_ps(m.m[2][0]), m21 = _mm256_set1_ps(m.m[2][1]), m22 = _mm256_set1_ps(m.m[2][2]);
+        __m256 m30 = _mm256_set1_ps(m.m[3][0]), m31 = _mm256_set1_ps(m.m[3][1]), m32 = _mm256_set1_ps(m.m[3][2]);
+        for (; i + 8 <= p.count; i += 8) {
+            const float* base = p.At(i);
+            __m256 x = _mm256_i32gather_ps(base, offsets, 1);
+            __m256 y = _mm256_i32gather_ps(base + 1, offsets, 1);
+            __m256 z = _mm256_i32gather_ps(base + 2, offsets, 1);
+            __m256 rx = _mm256_fmadd_ps(z, m20, _mm256_fmadd_ps(y, m10, _mm256_fmadd_ps(x, m00, m30)));
+            __m256 ry = _mm256_fmadd_ps(z, m21, _mm256_fmadd_ps(y, m11, _mm256_fmadd_ps(x, m01, m31)));
+            __m256 rz = _mm256_fmadd_ps(z, m22, _mm256_fmadd_ps(y, m12, _mm256_fmadd_ps(x, m02, m32)));
+            Scatter8(p, i, rx, ry, rz);
+        }
+    }
+    TransformPointsSSE41(p.Subspan(i), m);
+}
+
+KERNEL_TARGET("avx2,fma") void TransformNormalsAVX2(Float3Span n, const DirectX::XMFLOAT4X4& m) {
+    size_t i = 0;
+    if (FitsGather(n, 8)) {
+        const __m256i offsets = LaneOffsets8(n.stride);
+        __m256 m00 = _mm256_set1_ps(m.m[0][0]), m01 = _mm256_set1_ps(m.m[0][1]), m02 = _mm256_set1_ps(m.m[0][2]);
+        __m256 m10 = _mm256_set1_ps(m.m[1][0]), m11 = _mm256_set1_ps(m.m[1][1]), m12 = _mm256_set1_ps(m.m[1][2]);
+        __m256 m20 = _mm256_set1_ps(m.m[2][0]), m21 = _mm256_set1_ps(m.m[2][1]), m22 = _mm256_set1_ps(m.m[2][2]);
+        for (; i + 8 <= n.count; i += 8) {
+            const float* base = n.At(i);
+            __m256 x = _mm256_i32gather_ps(base, offsets, 1);
+            __m256 y = _mm256_i32gather_ps(base + 1, offsets, 1);
+            __m256 z = _mm256_i32gather_ps(base + 2, offsets, 1);
+            __m256 rx = _mm256_fmadd_ps(z, m20, _mm256_fmadd_ps(y, m10, _mm256_mul_ps(x, m00)));
+            __m256 ry = _mm256_fmadd_ps(z, m21, _mm256_fmadd_ps(y, m11, _mm256_mul_ps(x, m01)));
+            __m256 rz = _mm256_fmadd_ps(z, m22, _mm256_fmadd_ps(y, m12, _mm256_mul_ps(x, m02)));
+            Normalize8(rx, ry, rz);
+            Scatter8(n, i, rx, ry, rz);
+        }
+    }
+    TransformNormalsSSE41(n.Subspan(i), m);
+}
+
+KERNEL_TARGET("avx2,fma") inline float HorizontalMin8(__m256 v) {
+    __m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(m);
+}
+
+KERNEL_TARGET("avx2,fma") inline float HorizontalMax8(__m256 v) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(m);
+}
+
+KERNEL_TARGET("avx2,fma") void ComputeBoundsAVX2(Float3Span p, DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax) {
+    size_t i = 0;
+    __m256 mnX = _mm256_set1_ps(FLT_MAX), mnY = mnX, mnZ = mnX;
+    __m256 mxX = _mm256_set1_ps(-FLT_MAX), mxY = mxX, mxZ = mxX;
+    if (FitsGather(p, 8)) {
+        const __m256i offsets = LaneOffsets8(p.stride);
+        for (; i + 8 <= p.count; i += 8) {
+            const float* base = p.At(i);
+            __m256 x = _mm256_i32gather_ps(base, offsets, 1);
+            __m256 y = _mm256_i32gather_ps(base + 1, offsets, 1);
+            __m256 z = _mm256_i32gather_ps(base + 2, offsets, 1);
+            mnX = _mm256_min_ps(mnX, x); mxX = _mm256_max_ps(mxX, x);
+            mnY = _mm256_min_ps(mnY, y); mxY = _mm256_max_ps(mxY, y);
+            mnZ = _mm256_min_ps(mnZ, z); mxZ = _mm256_max_ps(mxZ, z);
+        }
+    }
+    DirectX::XMFLOAT3 tailMin, tailMax;
+    ComputeBoundsSSE41(p.Subspan(i), tailMin, tailMax);
+    outMin = { std::min(HorizontalMin8(mnX), tailMin.x), std::min(HorizontalMin8(mnY), tailMin.y), std::min(HorizontalMin8(mnZ), tailMin.z) };
+    outMax = { std::max(HorizontalMax8(mxX), tailMax.x), std::max(HorizontalMax8(mxY), tailMax.y), std::max(HorizontalMax8(mxZ), tailMax.z) };
+}
+
+KERNEL_TARGET("avx2,fma") void ScaleTranslateAVX2(Float3Span p, const DirectX::XMFLOAT3& s, const DirectX::XMFLOAT3& o) {
+    size_t i = 0;
+    if (FitsGather(p, 8)) {
+        const __m256i offsets = LaneOffsets8(p.stride);
+        __m256 sx = _mm256_set1_ps(s.x), sy = _mm256_set1_ps(s.y), sz = _mm256_set1_ps(s.z);
+        __m256 ox = _mm256_set1_ps(o.x), oy = _mm256_set1_ps(o.y), oz = _mm256_set1_ps(o.z);
+        for (; i + 8 <= p.count; i += 8) {
+            const float* base = p.At(i);
+            __m256 x = _mm256_fmadd_ps(_mm256_i32gather_ps(base, offsets, 1), sx, ox);
+            __m256 y = _mm256_fmadd_ps(_mm256_i32gather_ps(base + 1, offsets, 1), sy, oy);
+            __m256 z = _mm256_fmadd_ps(_mm256_i32gather_ps(base + 2, offsets, 1), sz, oz);
+            Scatter8(p, i, x, y, z);
+        }
+    }
+    ScaleTranslateSSE41(p.Subspan(i), s, o);
+}
+
+KERNEL_TARGET("avx2,fma") void AccumulateFaceNormalsAVX2(Float3Span positions, const unsigned int* indices, size_t indexCount, Float3Span normals) {
+    size_t t = 0;
+    // Vertex offsets are index * stride and must fit the 32-bit gather offsets
+    if (FitsGather(positions, positions.count)) {
+        const __m256i triOffsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        const __m256i stride = _mm256_set1_epi32(static_cast<int>(positions.stride));
+        const float* base = positions.data;
+        alignas(32) float cx[8], cy[8], cz[8];
+        for (; t + 24 <= indexCount; t += 24) {
+            const int* tri = reinterpret_cast<const int*>(indices + t);
+            __m256i o0 = _mm256_mullo_epi32(_mm256_i32gather_epi32(tri, triOffsets, 4), stride);
+            __m256i o1 = _mm256_mullo_epi32(_mm256_i32gather_epi32(tri + 1, triOffsets, 4), stride);
+            __m256i o2 = _mm256_mullo_epi32(_mm256_i32gather_epi32(tri + 2, triOffsets, 4), stride);
+            __m256 p0x = _mm256_i32gather_ps(base, o0, 1), p0y = _mm256_i32gather_ps(base + 1, o0, 1), p0z = _mm256_i32gather_ps(base + 2, o0, 1);
+            __m256 e1x = _mm256_sub_ps(_mm256_i32gather_ps(base, o1, 1), p0x);
+            __m256 e1y = _mm256_sub_ps(_mm256_i32gather_ps(base + 1, o1, 1), p0y);
+            __m256 e1z = _mm256_sub_ps(_mm256_i32gather_ps(base + 2, o1, 1), p0z);
+            __m256 e2x = _mm256_sub_ps(_mm256_i32gather_ps(base, o2, 1), p0x);
+            __m256 e2y = _mm256_sub_ps(_mm256_i32gather_ps(base + 1, o2, 1), p0y);
+            __m256 e2z = _mm256_sub_ps(_mm256_i32gather_ps(base + 2, o2, 1), p0z);
+            _mm256_store_ps(cx, _mm256_fmsub_ps(e1y, e2z, _mm256_mul_ps(e1z, e2y)));
+            _mm256_store_ps(cy, _mm256_fmsub_ps(e1z, e2x, _mm256_mul_ps(e1x, e2z)));
+            _mm256_store_ps(cz, _mm256_fmsub_ps(e1x, e2y, _mm256_mul_ps(e1y, e2x)));
+
+            // Corners of different triangles can share a vertex, so the scatter-add stays serial
+            for (int k = 0; k < 8; ++k) {
+                for (int c = 0; c < 3; ++c) {
+                    AddCorner(normals, indices[t + k * 3 + c], cx[k], cy[k], cz[k]);
+                }
+            }
+        }
+    }
+    AccumulateFaceNormalsSSE41(positions, indices + t, indexCount - t, normals);
+}
+
+KERNEL_TARGET("avx2,fma") void NormalizeAVX2(Float3Span v) {
+    size_t i = 0;
+    if (FitsGather(v, 8)) {
+        const __m256i offsets = LaneOffsets8(v.stride);
+        for (; i + 8 <= v.count; i += 8) {
+            const float* base = v.At(i);
+            __m256 x = _mm256_i32gather_ps(base, offsets, 1);
+            __m256 y = _mm256_i32gather_ps(base + 1, offsets, 1);
+            __m256 z = _mm256_i32gather_ps(base + 2, offsets, 1);
+            Normalize8(x, y, z);
+            Scatter8(v, i, x, y, z);
+        }
+    }
+    NormalizeSSE41(v.Subspan(i));
+}
+
+KERNEL_TARGET("avx2,fma") size_t OverlapBoxesAVX2(const BoxSoA& b, const DirectX::XMFLOAT3& qMin, const DirectX::XMFLOAT3& qMax, unsigned int* out) {
+    const __m256 loX = _mm256_set1_ps(qMin.x), loY = _mm256_set1_ps(qMin.y), loZ = _mm256_set1_ps(qMin.z);
+    const __m256 hiX = _mm256_set1_ps(qMax.x), hiY = _mm256_set1_ps(qMax.y), hiZ = _mm256_set1_ps(qMax.z);
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 8 <= b.count; i += 8) {
+        __m256 overlap = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(b.minX + i), hiX, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(b.maxX + i), loX, _CMP_GE_OQ));
+        overlap = _mm256_and_ps(overlap, _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(b.minY + i), hiY, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(b.maxY + i), loY, _CMP_GE_OQ)));
+        overlap = _mm256_and_ps(overlap, _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(b.minZ + i), hiZ, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(b.maxZ + i), loZ, _CMP_GE_OQ)));
+        hits = EmitMask(static_cast<unsigned int>(_mm256_movemask_ps(overlap)), i, out, hits);
+    }
+    size_t tail = OverlapBoxesSSE41(SubBoxes(b, i), qMin, qMax, out + hits);
+    for (size_t k = hits; k < hits + tail; ++k) out[k] += static_cast<unsigned int>(i);
+    return hits + tail;
+}
+
+// The plane loop is the inner one, a batch stops testing once all 8 boxes are out
+KERNEL_TARGET("avx2,fma") size_t CullBoxesAVX2(const BoxSoA& b, const DirectX::XMFLOAT4* planes, size_t planeCount, unsigned int* out) {
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 8 <= b.count; i += 8) {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t p = 0; p < planeCount; ++p) {
+            const DirectX::XMFLOAT4& plane = planes[p];
+            PositiveCorner c(b, plane);
+            __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(plane.x), _mm256_loadu_ps(c.x + i), _mm256_set1_ps(plane.w));
+            d = _mm256_fmadd_ps(_mm256_set1_ps(plane.y), _mm256_loadu_ps(c.y + i), d);
+            d = _mm256_fmadd_ps(_mm256_set1_ps(plane.z), _mm256_loadu_ps(c.z + i), d);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0) break;
+        }
+        hits = EmitMask(static_cast<unsigned int>(_mm256_movemask_ps(inside)), i, out, hits);
+    }
+    size_t tail = CullBoxesSSE41(SubBoxes(b, i), planes, planeCount, out + hits);
+    for (size_t k = hits; k < hits + tail; ++k) out[k] += static_cast<unsigned int>(i);
+    return hits + tail;
+}
+
+// Two output rows per register, the in-lane permute broadcasts an element of each row of a
+KERNEL_TARGET("avx2,fma") void MultiplyMatricesAVX2(const DirectX::XMFLOAT4X4* a, const DirectX::XMFLOAT4X4* b, DirectX::XMFLOAT4X4* out, size_t count) {
+    for (size_t n = 0; n < count; ++n) {
+        const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[n].m[0]));
+        const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[n].m[1]));
+        const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[n].m[2]));
+        const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[n].m[3]));
+        for (int r = 0; r < 4; r += 2) {
+            const __m256 rows = _mm256_loadu_ps(a[n].m[r]);
+            __m256 v = _mm256_mul_ps(_mm256_permute_ps(rows, 0x00), b0);
+            v = _mm256_fmadd_ps(_mm256_permute_ps(rows, 0x55), b1, v);
+            v = _mm256_fmadd_ps(_mm256_permute_ps(rows, 0xAA), b2, v);
+            v = _mm256_fmadd_ps(_mm256_permute_ps(rows, 0xFF), b3, v);
+            _mm256_storeu_ps(out[n].m[r], v);
+        }
+    }
+}
+
+const KernelTable avx2Table = {
+    TransformPointsAVX2, TransformNormalsAVX2, ComputeBoundsAVX2,
+    ScaleTranslateAVX2, AccumulateFaceNormalsAVX2, NormalizeAVX2,
+    OverlapBoxesAVX2,
+    CullBoxesAVX2,
+    MultiplyMatricesAVX2
+};
+
+// ---------------------------------------------------------------------------
+// AVX-512: 16 elements per register with native gather and scatter
+// ---------------------------------------------------------------------------
+
+KERNEL_TARGET("avx512f") inline __m512i LaneOffsets16(size_t stride) {
+    return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32(static_cast<int>(stride)));
+}
+
+KERNEL_TARGET("avx512f") inline void Gather16(const float* base, __m512i offsets, __m512& x, __m512& y, __m512& z) {
+    x = _mm512_i32gather_ps(offsets, base, 1);
+    y = _mm512_i32gather_ps(offsets, base + 1, 1);
+    z = _mm512_i32gather_ps(offsets, base + 2, 1);
+}
+
+KERNEL_TARGET("avx512f") inline void Scatter16(float* base, __m512i offsets, __m512 x, __m512 y, __m512 z) {
+    _mm512_i32scatter_ps(base, offsets, x, 1);
+    _mm512_i32scatter_ps(base + 1, offsets, y, 1);
+    _mm512_i32scatter_ps(base + 2, offsets, z, 1);
+}
+
+KERNEL_TARGET("avx512f") inline void Normalize16(__m512& x, __m512& y, __m512& z) {
+    __m512 lenSq = _mm512_fmadd_ps(z, z, _mm512_fmadd_ps(y, y, _mm512_mul_ps(x, x)));
+    __mmask16 valid = _mm512_cmp_ps_mask(lenSq, _mm512_setzero_ps(), _CMP_GT_OQ);
+    __m512 len = _mm512_sqrt_ps(lenSq);
+    x = _mm512_mask_div_ps(x, valid, x, len);
+    y = _mm512_mask_div_ps(y, valid, y, len);
+    z = _mm512_mask_div_ps(z, valid, z, len);
+}
+
+KERNEL_TARGET("avx512f") void TransformPointsAVX512(Float3Span p, const DirectX::XMFLOAT4X4& m) {
+    size_t i = 0;
+    if (FitsGather(p, 16)) {
+        const __m512i offsets = LaneOffsets16(p.stride);
+        __m512 m00 = _mm512_set1_ps(m.m[0][0]), m01 = _mm512_set1_ps(m.m[0][1]), m02 = _mm512_set1_ps(m.m[0][2]);
+        __m512 m10 = _mm512_set1_ps(m.m[1][0]), m11 = _mm512_set1_ps(m.m[1][1]), m12 = _mm512_set1_ps(m.m[1][2]);
+        __m512 m20 = _mm512_set1_ps(m.m[2][0]), m21 = _mm512_set1_ps(m.m[2][1]), m22 = _mm512_set1_ps(m.m[2][2]);
+        __m512 m30 = _mm512_set1_ps(m.m[3][0]), m31 = _mm512_set1_ps(m.m[3][1]), m32 = _mm512_set1_ps(m.m[3][2]);
+        for (; i + 16 <= p.count; i += 16) {
+            float* base = p.At(i);
+            __m512 x, y, z;
+            Gather16(base, offsets, x, y, z);
+            __m512 rx = _mm512_fmadd_ps(z, m20, _mm512_fmadd_ps(y, m10, _mm512_fmadd_ps(x, m00, m30)));
+            __m512 ry = _mm512_fmadd_ps(z, m21, _mm512_fmadd_ps(y, m11, _mm512_fmadd_ps(x, m01, m31)));
+            __m512 rz = _mm512_fmadd_ps(z, m22, _mm512_fmadd_ps(y, m12, _mm512_fmadd_ps(x, m02, m32)));
+            Scatter16(base, offsets, rx, ry, rz);
+        }
+    }
+    TransformPointsAVX2(p.Subspan(i), m);
+}
+
+KERNEL_TARGET("avx512f") void TransformNormalsAVX512(Float3Span n, const DirectX::XMFLOAT4X4& m) {
+    size_t i = 0;
+    if (FitsGather(n, 16)) {
+        const __m512i offsets = LaneOffsets16(n.stride);
+        __m512 m00 = _mm512_set1_ps(m.m[0][0]), m01 = _mm512_set1_ps(m.m[0][1]), m02 = _mm512_set1_ps(m.m[0][2]);
+        __m512 m10 = _mm512_set1_ps(m.m[1][0]), m11 = _mm512_set1_ps(m.m[1][1]), m12 = _mm512_set1_ps(m.m[1][2]);
+        __m512 m20 = _mm512_set1_ps(m.m[2][0]), m21 = _mm512_set1_ps(m.m[2][1]), m22 = _mm512_set1_ps(m.m[2][2]);
+        for (; i + 16 <= n.count; i += 16) {
+            float* base = n.At(i);
+            __m512 x, y, z;
+            Gather16(base, offsets, x, y, z);
+            __m512 rx = _mm512_fmadd_ps(z, m20, _mm512_fmadd_ps(y, m10, _mm512_mul_ps(x, m00)));
+            __m512 ry = _mm512_fmadd_ps(z, m21, _mm512_fmadd_ps(y, m11, _mm512_mul_ps(x, m01)));
+            __m512 rz = _mm512_fmadd_ps(z, m22, _mm512_fmadd_ps(y, m12, _mm512_mul_ps(x, m02)));
+            Normalize16(rx, ry, rz);
+            Scatter16(base, offsets, rx, ry, rz);
+        }
+    }
+    TransformNormalsAVX2(n.Subspan(i), m);
+}
+
+KERNEL_TARGET("avx512f") void ComputeBoundsAVX512(Float3Span p, DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax) {
+    size_t i = 0;
+    __m512 mnX = _mm512_set1_ps(FLT_MAX), mnY = mnX, mnZ = mnX;
+    __m512 mxX = _mm512_set1_ps(-FLT_MAX), mxY = mxX, mxZ = mxX;
+    if (FitsGather(p, 16)) {
+        const __m512i offsets = LaneOffsets16(p.stride);
+        for (; i + 16 <= p.count; i += 16) {
+            __m512 x, y, z;
+            Gather16(p.At(i), offsets, x, y, z);
+            mnX = _mm512_min_ps(mnX, x); mxX = _mm512_max_ps(mxX, x);
+            mnY = _mm512_min_ps(mnY, y); mxY = _mm512_max_ps(mxY, y);
+            mnZ = _mm512_min_ps(mnZ, z); mxZ = _mm512_max_ps(mxZ, z);
+        }
+    }
+    DirectX::XMFLOAT3 tailMin, tailMax;
+    ComputeBoundsAVX2(p.Subspan(i), tailMin, tailMax);
+    outMin = { std::min(_mm512_reduce_min_ps(mnX), tailMin.x), std::min(_mm512_reduce_min_ps(mnY), tailMin.y), std::min(_mm512_reduce_min_ps(mnZ), tailMin.z) };
+    outMax = { std::max(_mm512_reduce_max_ps(mxX), tailMax.x), std::max(_mm512_reduce_max_ps(mxY), tailMax.y), std::max(_mm512_reduce_max_ps(mxZ), tailMax.z) };
+}
+
+KERNEL_TARGET("avx512f") void ScaleTranslateAVX512(Float3Span p, const DirectX::XMFLOAT3& s, const DirectX::XMFLOAT3& o) {
+    size_t i = 0;
+    if (FitsGather(p, 16)) {
+        const __m512i offsets = LaneOffsets16(p.stride);
+        __m512 sx = _mm512_set1_ps(s.x), sy = _mm512_set1_ps(s.y), sz = _mm512_set1_ps(s.z);
+        __m512 ox = _mm512_set1_ps(o.x), oy = _mm512_set1_ps(o.y), oz = _mm512_set1_ps(o.z);
+        for (; i + 16 <= p.count; i += 16) {
+            float* base = p.At(i);
+            __m512 x, y, z;
+            Gather16(base, offsets, x, y, z);
+            Scatter16(base, offsets, _mm512_fmadd_ps(x, sx, ox), _mm512_fmadd_ps(y, sy, oy), _mm512_fmadd_ps(z, sz, oz));
+        }
+    }
+    ScaleTranslateAVX2(p.Subspan(i), s, o);
+}
+
+KERNEL_TARGET("avx512f") void AccumulateFaceNormalsAVX512(Float3Span positions, const unsigned int* indices, size_t indexCount, Float3Span normals) {
+    size_t t = 0;
+    if (FitsGather(positions, positions.count)) {
+        const __m512i triOffsets = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45);
+        const __m512i stride = _mm512_set1_epi32(static_cast<int>(positions.stride));
+        const float* base = positions.data;
+        alignas(64) float cx[16], cy[16], cz[16];
+        for (; t + 48 <= indexCount; t += 48) {
+            const int* tri = reinterpret_cast<const int*>(indices + t);
+            __m512i o0 = _mm512_mullo_epi32(_mm512_i32gather_epi32(triOffsets, tri, 4), stride);
+            __m512i o1 = _mm512_mullo_epi32(_mm512_i32gather_epi32(triOffsets, tri + 1, 4), stride);
+            __m512i o2 = _mm512_mullo_epi32(_mm512_i32gather_epi32(triOffsets, tri + 2, 4), stride);
+            __m512 p0x, p0y, p0z, p1x, p1y, p1z, p2x, p2y, p2z;
+            Gather16(base, o0, p0x, p0y, p0z);
+            Gather16(base, o1, p1x, p1y, p1z);
+            Gather16(base, o2, p2x, p2y, p2z);
+            __m512 e1x = _mm512_sub_ps(p1x, p0x), e1y = _mm512_sub_ps(p1y, p0y), e1z = _mm512_sub_ps(p1z, p0z);
+            __m512 e2x = _mm512_sub_ps(p2x, p0x), e2y = _mm512_sub_ps(p2y, p0y), e2z = _mm512_sub_ps(p2z, p0z);
+            _mm512_store_ps(cx, _mm512_fmsub_ps(e1y, e2z, _mm512_mul_ps(e1z, e2y)));
+            _mm512_store_ps(cy, _mm512_fmsub_ps(e1z, e2x, _mm512_mul_ps(e1x, e2z)));
+            _mm512_store_ps(cz, _mm512_fmsub_ps(e1x, e2y, _mm512_mul_ps(e1y, e2x)));
+
+            // Corners of different triangles can share a vertex, so the scatter-add stays serial
+            for (int k = 0; k < 16; ++k) {
+                for (int c = 0; c < 3; ++c) {
+                    AddCorner(normals, indices[t + k * 3 + c], cx[k], cy[k], cz[k]);
+                }
+            }
+        }
+    }
+    AccumulateFaceNormalsAVX2(positions, indices + t, indexCount - t, normals);
+}
+
+KERNEL_TARGET("avx512f") void NormalizeAVX512(Float3Span v) {
+    size_t i = 0;
+    if (FitsGather(v, 16)) {
+        const __m512i offsets = LaneOffsets16(v.stride);
+        for (; i + 16 <= v.count; i += 16) {
+            float* base = v.At(i);
+            __m512 x, y, z;
+            Gather16(base, offsets, x, y, z);
+            Normalize16(x, y, z);
+            Scatter16(base, offsets, x, y, z);
+        }
+    }
+    NormalizeAVX2(v.Subspan(i));
+}
+
+// Hit indices are written with a compress store, no per bit loop
+KERNEL_TARGET("avx512f") size_t OverlapBoxesAVX512(const BoxSoA& b, const DirectX::XMFLOAT3& qMin, const DirectX::XMFLOAT3& qMax, unsigned int* out) {
+    const __m512 loX = _mm512_set1_ps(qMin.x), loY = _mm512_set1_ps(qMin.y), loZ = _mm512_set1_ps(qMin.z);
+    const __m512 hiX = _mm512_set1_ps(qMax.x), hiY = _mm512_set1_ps(qMax.y), hiZ = _mm512_set1_ps(qMax.z);
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 16 <= b.count; i += 16) {
+        __mmask16 overlap = _mm512_cmp_ps_mask(_mm512_loadu_ps(b.minX + i), hiX, _CMP_LE_OQ);
+        overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(b.maxX + i), loX, _CMP_GE_OQ);
+        overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(b.minY + i), hiY, _CMP_LE_OQ);
+        overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(b.maxY + i), loY, _CMP_GE_OQ);
+        overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(b.minZ + i), hiZ, _CMP_LE_OQ);
+        overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(b.maxZ + i), loZ, _CMP_GE_OQ);
+        __m512i index = _mm512_add_epi32(lane, _mm512_set1_epi32(static_cast<int>(i)));
+        _mm512_mask_compressstoreu_epi32(out + hits, overlap, index);
+        hits += std::popcount(static_cast<unsigned int>(overlap));
+    }
+    size_t tail = OverlapBoxesAVX2(SubBoxes(b, i), qMin, qMax, out + hits);
+    for (size_t k = hits; k < hits + tail; ++k) out[k] += static_cast<unsigned int>(i);
+    return hits + tail;
+}
+
+KERNEL_TARGET("avx512f") size_t CullBoxesAVX512(const BoxSoA& b, const DirectX::XMFLOAT4* planes, size_t planeCount, unsigned int* out) {
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 16 <= b.count; i += 16) {
+        __mmask16 inside = 0xFFFF;
+        for (size_t p = 0; p < planeCount && inside; ++p) {
+            const DirectX::XMFLOAT4& plane = planes[p];
+            PositiveCorner c(b, plane);
+            __m512 d = _mm512_fmadd_ps(_mm512_set1_ps(plane.x), _mm512_loadu_ps(c.x + i), _mm512_set1_ps(plane.w));
+            d = _mm512_fmadd_ps(_mm512_set1_ps(plane.y), _mm512_loadu_ps(c.y + i), d);
+            d = _mm512_fmadd_ps(_mm512_set1_ps(plane.z), _mm512_loadu_ps(c.z + i), d);
+            inside = _mm512_mask_cmp_ps_mask(inside, d, _mm512_setzero_ps(), _CMP_GE_OQ);
+        }
+        __m512i index = _mm512_add_epi32(lane, _mm512_set1_epi32(static_cast<int>(i)));
+        _mm512_mask_compressstoreu_epi32(out + hits, inside, index);
+        hits += std::popcount(static_cast<unsigned int>(inside));
+    }
+    size_t tail = CullBoxesAVX2(SubBoxes(b, i), planes, planeCount, out + hits);
+    for (size_t k = hits; k < hits + tail; ++k) out[k] += static_cast<unsigned int>(i);
+    return hits + tail;
+}
+
+// The whole matrix in one register
+KERNEL_TARGET("avx512f") void MultiplyMatricesAVX512(const DirectX::XMFLOAT4X4* a, const DirectX::XMFLOAT4X4* b, DirectX::XMFLOAT4X4* out, size_t count) {
+    for (size_t n = 0; n < count; ++n) {
+        const __m512 rows = _mm512_loadu_ps(a[n].m[0]);
+        const __m512 b0 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[n].m[0]));
+        const __m512 b1 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[n].m[1]));
+        const __m512 b2 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[n].m[2]));
+        const __m512 b3 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[n].m[3]));
+        __m512 v = _mm512_mul_ps(_mm512_permute_ps(rows, 0x00), b0);
+        v = _mm512_fmadd_ps(_mm512_permute_ps(rows, 0x55), b1, v);
+        v = _mm512_fmadd_ps(_mm512_permute_ps(rows, 0xAA), b2, v);
+        v = _mm512_fmadd_ps(_mm512_permute_ps(rows, 0xFF), b3, v);
+        _mm512_storeu_ps(out[n].m[0], v);
+    }
+}
+
+const KernelTable avx512Table = {
+    TransformPointsAVX512, TransformNormalsAVX512, ComputeBoundsAVX512,
+    ScaleTranslateAVX512, AccumulateFaceNormalsAVX512, NormalizeAVX512,
+    OverlapBoxesAVX512,
+    CullBoxesAVX512,
+    MultiplyMatricesAVX512
+};
+
+KERNEL_TARGET("xsave") GeometryKernels::Isa DetectIsa() {
+    int info[4] = {};
+#if defined(_MSC_VER)
+    __cpuid(info, 0);
+#else
+    __cpuid_count(0, 0, info[0], info[1], info[2], info[3]);
+#endif
+    int maxLeaf = info[0];
+
+#if defined(_MSC_VER)
+    __cpuid(info, 1);
+#else
+    __cpuid_count(1, 0, info[0], info[1], info[2], info[3]);
+#endif
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    // The OS must save the YMM (and for AVX-512 the opmask/ZMM) state on context switches
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool osAvx = (xcr0 & 0x6) == 0x6;
+    bool osAvx512 = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false;
+    bool avx512f = false;
+    if (maxLeaf >= 7) {
+#if defined(_MSC_VER)
+        __cpuidex(info, 7, 0);
+#else
+        __cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512f = (info[1] & (1 << 16)) != 0;
+    }
+
+    if (avx512f && osAvx512) return GeometryKernels::Isa::AVX512;
+    if (avx2 && fma && avx && osAvx) return GeometryKernels::Isa::AVX2;
+    if (sse41) return GeometryKernels::Isa::SSE41;
+    return GeometryKernels::Isa::Scalar;
+}
+
+#else
+
+GeometryKernels::Isa DetectIsa() {
+    return GeometryKernels::Isa::Scalar;
+}
+
+#endif
+
+const KernelTable* TableFor(GeometryKernels::Isa isa) {
+#ifdef GEOMETRY_KERNELS_X86
+    switch (isa) {
+    case GeometryKernels::Isa::AVX512: return &avx512Table;
+    case GeometryKernels::Isa::AVX2: return &avx2Table;
+    case GeometryKernels::Isa::SSE41: return &sse41Table;
+    default: break;
+    }
+#endif
+    return &scalarTable;
+}
+
+const GeometryKernels::Isa supportedIsa = DetectIsa();
+GeometryKernels::Isa activeIsa = supportedIsa;
+const KernelTable* active = TableFor(activeIsa);
+
+}
+
+namespace GeometryKernels {
+
+Isa GetSupportedIsa() {
+    return supportedIsa;
+}
+
+Isa GetIsa() {
+    return activeIsa;
+}
+
+void SetIsa(Isa isa) {
+    activeIsa = std::min(isa, supportedIsa);
+    active = TableFor(activeIsa);
+}
+
+const char* GetIsaName(Isa isa) {
+    switch (isa) {
+    case Isa::SSE41: return "SSE4.1";
+    case Isa::AVX2: return "AVX2";
+    case Isa::AVX512: return "AVX-512";
+    default: return "Scalar";
+    }
+}
+
+void TransformPoints(Float3Span points, const DirectX::XMFLOAT4X4& matrix) {
+    active->transformPoints(points, matrix);
+}
+
+void TransformNormals(Float3Span normals, const DirectX::XMFLOAT4X4& matrix) {
+    active->transformNormals(normals, matrix);
+}
+
+void ComputeBounds(Float3Span points, DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax) {
+    active->computeBounds(points, outMin, outMax);
+}
+
+void ScaleTranslate(Float3Span points, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT3& offset) {
+    active->scaleTranslate(points, scale, offset);
+}
+
+void AccumulateFaceNormals(Float3Span positions, const unsigned int* indices, size_t indexCount, Float3Span normals) {
+    active->accumulateFaceNormals(positions, indices, indexCount, normals);
+}
+
+void Normalize(Float3Span vectors) {
+    active->normalize(vectors);
+}
+
+size_t OverlapBoxes(const BoxSoA& boxes, const DirectX::XMFLOAT3& queryMin, const DirectX::XMFLOAT3& queryMax, unsigned int* outIndices) {
+    return active->overlapBoxes(boxes, queryMin, queryMax, outIndices);
+}
+
+size_t CullBoxes(const BoxSoA& boxes, const DirectX::XMFLOAT4* planes, size_t planeCount, unsigned int* outIndices) {
+    return active->cullBoxes(boxes, planes, planeCount, outIndices);
+}
+
+void MultiplyMatrices(const DirectX::XMFLOAT4X4* a, const DirectX::XMFLOAT4X4* b, DirectX::XMFLOAT4X4* out, size_t count) {
+    active->multiplyMatrices(a, b, out, count);
+}
+
+}
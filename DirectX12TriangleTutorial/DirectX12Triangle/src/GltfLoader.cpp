@@ -0,0 +1,615 @@
+#include "Model.h"
+#include "File.h"
+#include "Json.h"
+#include "GeometryKernels.h"
+#include <iostream>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <limits>
+#include <algorithm>
+#include <charconv>
+
+namespace {
+
+static_assert(sizeof(Vertex) == 32, "the bulk copy path assumes the packed position/uv/normal layout");
+
+constexpr uint32_t GlbMagic = 0x46546C67;     // "glTF"
+constexpr uint32_t GlbChunkJson = 0x4E4F534A; // "JSON"
+constexpr uint32_t GlbChunkBin = 0x004E4942;  // "BIN\0"
+
+enum ComponentType {
+    Byte = 5120,
+    UnsignedByte = 5121,
+    Short = 5122,
+    UnsignedShort = 5123,
+    UnsignedInt = 5125,
+    Float = 5126
+};
+
+enum PrimitiveMode {
+    Triangles = 4
+};
+
+struct ByteSpan {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+// Backing storage of the glTF buffers: the GLB BIN chunk, mapped .bin files or decoded data: URIs
+struct GltfBuffers {
+    std::vector<ByteSpan> spans;
+    std::vector<std::unique_ptr<MappedFile>> mappedFiles;
+    std::vector<std::vector<unsigned char>> decoded;
+};
+
+// Element layout of one accessor, resolved down to a pointer into the buffer
+struct AccessorView {
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+    bool tight = false; // no padding between elements
+};
+
+uint32_t ReadU32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+int ComponentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+size_t ComponentSize(int componentType) {
+    switch (componentType) {
+    case Byte:
+    case UnsignedByte: return 1;
+    case Short:
+    case UnsignedShort: return 2;
+    case UnsignedInt:
+    case Float: return 4;
+    default: return 0;
+    }
+}
+
+bool DecodeBase64(const std::string& text, size_t start, std::vector<unsigned char>& out) {
+    auto value = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        return -1;
+    };
+
+    out.clear();
+    out.reserve((text.size() - start) / 4 * 3);
+    unsigned int bits = 0;
+    int bitCount = 0;
+    for (size_t i = start; i < text.size() && text[i] != '='; ++i) {
+        int v = value(text[i]);
+        if (v < 0) return false;
+        bits = (bits << 6) | static_cast<unsigned int>(v);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            out.push_back(static_cast<unsigned char>((bits >> bitCount) & 0xFF));
+        }
+    }
+    return true;
+}
+
+// "textures/wood%20planks.png" -> "wood planks.png", assets are looked up by file name.
+// False for a malformed escape, a % not followed by two hex digits.
+bool UriFileName(const std::string& uri, std::string& out) {
+    std::string name = uri.substr(uri.find_last_of("/\\") + 1);
+    out.clear();
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] != '%') {
+            out += name[i];
+            continue;
+        }
+        unsigned int code = 0;
+        const char* digits = name.data() + i + 1;
+        if (i + 2 >= name.size() || std::from_chars(digits, digits + 2, code, 16).ptr != digits + 2) {
+            return false;
+        }
+        out += static_cast<char>(code);
+        i += 2;
+    }
+    return true;
+}
+
+// Smooth normals for the primitive that was read last, its vertices and indices start at
+// baseVertex and baseIndex. The authored normals of the primitives before it stay as they are.
+// Creases may split vertices, the new ones are appended after the primitive's.
+void GeneratePrimitiveNormals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t baseVertex, size_t baseIndex) {
+    std::vector<Vertex> primitiveVertices(vertices.begin() + baseVertex, vertices.end());
+    std::vector<unsigned int> primitiveIndices(indices.begin() + baseIndex, indices.end());
+    const unsigned int offset = static_cast<unsigned int>(baseVertex);
+    for (unsigned int& index : primitiveIndices) index -= offset;
+
+    GenerateNormals(primitiveVertices, primitiveIndices, {});
+
+    vertices.resize(baseVertex);
+    vertices.insert(vertices.end(), primitiveVertices.begin(), primitiveVertices.end());
+    for (size_t i = 0; i < primitiveIndices.size(); ++i) {
+        indices[baseIndex + i] = primitiveIndices[i] + offset;
+    }
+}
+
+// Decodes a data: URI into storage and returns its bytes
+bool ResolveDataUri(const std::string& uri, std::vector<unsigned char>& storage) {
+    size_t comma = uri.find(',');
+    if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) return false;
+    return DecodeBase64(uri, comma + 1, storage);
+}
+
+bool GetBufferView(const JsonValue& gltf, const GltfBuffers& buffers, size_t index, ByteSpan& out, size_t* stride = nullptr) {
+    const JsonValue& view = gltf["bufferViews"][index];
+    size_t buffer = view["buffer"].AsSize(SIZE_MAX);
+    if (!view.IsObject() || buffer >= buffers.spans.size()) return false;
+
+    const ByteSpan& bytes = buffers.spans[buffer];
+    size_t offset = view["byteOffset"].AsSize();
+    size_t length = view["byteLength"].AsSize();
+    if (bytes.data == nullptr || offset > bytes.size || length > bytes.size - offset) return false;
+
+    out = { bytes.data + offset, length };
+    if (stride) *stride = view["byteStride"].AsSize();
+    return true;
+}
+
+bool GetAccessor(const JsonValue& gltf, const GltfBuffers& buffers, size_t index, AccessorView& out) {
+    const JsonValue& accessor = gltf["accessors"][index];
+    if (!accessor.IsObject() || !accessor.Has("bufferView")) return false;
+
+    out.count = accessor["count"].AsSize();
+    out.componentType = accessor["componentType"].AsInt();
+    out.components = ComponentCount(accessor["type"].AsString());
+    out.normalized = accessor["normalized"].AsBool();
+    const size_t elementSize = ComponentSize(out.componentType) * out.components;
+    if (elementSize == 0) return false;
+    if (accessor.Has("sparse")) {
+        std::cerr << "glTF: sparse accessors are not supported, using the dense values" << std::endl;
+    }
+
+    ByteSpan view;
+    size_t stride = 0;
+    if (!GetBufferView(gltf, buffers, accessor["bufferView"].AsSize(), view, &stride)) return false;
+    out.stride = stride != 0 ? stride : elementSize;
+    out.tight = out.stride == elementSize;
+
+    size_t offset = accessor["byteOffset"].AsSize();
+    if (out.count > 0) {
+        size_t last = offset + (out.count - 1) * out.stride + elementSize;
+        if (last > view.size || last < offset) return false;
+    }
+    out.data = view.data + offset;
+    return true;
+}
+
+float ReadComponent(const unsigned char* p, int componentType, bool normalized) {
+    switch (componentType) {
+    case Float: {
+        float value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    case UnsignedByte: return normalized ? *p / 255.0f : *p;
+    case Byte: {
+        float value = static_cast<float>(static_cast<int8_t>(*p));
+        return normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case UnsignedShort: {
+        uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return normalized ? value / 65535.0f : value;
+    }
+    case Short: {
+        int16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    case UnsignedInt: return static_cast<float>(ReadU32(p));
+    default: return 0.0f;
+    }
+}
+
+unsigned int ReadIndex(const unsigned char* p, int componentType) {
+    switch (componentType) {
+    case UnsignedByte: return *p;
+    case UnsignedShort: {
+        uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    default: return ReadU32(p);
+    }
+}
+
+// Strided copy of one attribute into a member of consecutive vertices
+void CopyAttribute(const AccessorView& accessor, int components, Vertex* dst, size_t memberOffset) {
+    const size_t componentSize = ComponentSize(accessor.componentType);
+    for (size_t i = 0; i < accessor.count; ++i) {
+        const unsigned char* src = accessor.data + i * accessor.stride;
+        float* out = reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(dst + i) + memberOffset);
+        if (accessor.componentType == Float) {
+            std::memcpy(out, src, components * sizeof(float));
+        }
+        else {
+            for (int k = 0; k < components; ++k) {
+                out[k] = ReadComponent(src + k * componentSize, accessor.componentType, accessor.normalized);
+            }
+        }
+    }
+}
+
+DirectX::XMMATRIX NodeMatrix(const JsonValue& node) {
+    const JsonValue& matrix = node["matrix"];
+    if (matrix.Size() == 16) {
+        // glTF stores column vectors column-major, which is the same memory layout as
+        // a row-major matrix for row vectors
+        DirectX::XMFLOAT4X4 m;
+        for (int i = 0; i < 16; ++i) {
+            m.m[i / 4][i % 4] = matrix[i].AsFloat();
+        }
+        return DirectX::XMLoadFloat4x4(&m);
+    }
+
+    const JsonValue& t = node["translation"];
+    const JsonValue& r = node["rotation"];
+    const JsonValue& s = node["scale"];
+    DirectX::XMMATRIX S = DirectX::XMMatrixScaling(s[0].AsFloat(1.0f), s[1].AsFloat(1.0f), s[2].AsFloat(1.0f));
+    DirectX::XMMATRIX R = DirectX::XMMatrixRotationQuaternion(DirectX::XMVectorSet(r[0].AsFloat(), r[1].AsFloat(), r[2].AsFloat(), r[3].AsFloat(1.0f)));
+    DirectX::XMMATRIX T = DirectX::XMMatrixTranslation(t[0].AsFloat(), t[1].AsFloat(), t[2].AsFloat());
+    return S * R * T;
+}
+
+}
+
+bool Model::LoadFromGltf(const std::string& filename) {
+    MappedFile file;
+    if (!MapAssetFile(filename, file)) {
+        return false;
+    }
+
+    // A .glb is a 12 byte header followed by a JSON chunk and an optional BIN chunk, a .gltf is the JSON
+    const unsigned char* jsonData = file.Data();
+    size_t jsonSize = file.Size();
+    ByteSpan glbBin;
+    if (file.Size() >= 12 && ReadU32(file.Data()) == GlbMagic) {
+        if (ReadU32(file.Data() + 4) != 2) {
+            std::cerr << "Unsupported GLB version in " << filename << std::endl;
+            return false;
+        }
+        jsonData = nullptr;
+        size_t offset = 12;
+        while (offset + 8 <= file.Size()) {
+            uint32_t chunkLength = ReadU32(file.Data() + offset);
+            uint32_t chunkType = ReadU32(file.Data() + offset + 4);
+            if (chunkLength > file.Size() - offset - 8) break;
+            if (chunkType == GlbChunkJson && jsonData == nullptr) {
+                jsonData = file.Data() + offset + 8;
+                jsonSize = chunkLength;
+            }
+            else if (chunkType == GlbChunkBin && glbBin.data == nullptr) {
+                glbBin = { file.Data() + offset + 8, chunkLength };
+            }
+            offset += 8 + ((static_cast<size_t>(chunkLength) + 3) & ~size_t(3));
+        }
+        if (jsonData == nullptr) {
+            std::cerr << "GLB file without a JSON chunk: " << filename << std::endl;
+            return false;
+        }
+    }
+
+    JsonValue gltf;
+    std::string error;
+    if (!JsonValue::Parse(reinterpret_cast<const char*>(jsonData), jsonSize, gltf, &error)) {
+        std::cerr << "Failed to parse glTF " << filename << ": " << error << std::endl;
+        return false;
+    }
+
+    // Buffers stay where they are, only the accessors that don't match the Vertex layout are converted
+    GltfBuffers buffers;
+    for (const JsonValue& buffer : gltf["buffers"].Elements()) {
+        const std::string& uri = buffer["uri"].AsString();
+        ByteSpan span;
+        if (uri.empty()) {
+            span = glbBin;
+        }
+        else if (uri.compare(0, 5, "data:") == 0) {
+            buffers.decoded.emplace_back();
+            if (ResolveDataUri(uri, buffers.decoded.back())) {
+                span = { buffers.decoded.back().data(), buffers.decoded.back().size() };
+            }
+        }
+        else {
+            std::string fileName;
+            if (!UriFileName(uri, fileName)) {
+                std::cerr << "glTF buffer " << buffers.spans.size() << " of " << filename << " has a malformed URI: " << uri << std::endl;
+                return false;
+            }
+            auto mapped = std::make_unique<MappedFile>();
+            if (MapAssetFile(fileName, *mapped)) {
+                span = { mapped->Data(), mapped->Size() };
+            }
+            buffers.mappedFiles.push_back(std::move(mapped));
+        }
+        if (span.data == nullptr) {
+            std::cerr << "glTF buffer " << buffers.spans.size() << " of " << filename << " could not be loaded" << std::endl;
+        }
+        buffers.spans.push_back(span);
+    }
+
+    // Materials, the Phong terms the renderer uses are approximated from metallic-roughness
+    const unsigned int materialBase = static_cast<unsigned int>(materials.size());
+    const JsonValue& gltfMaterials = gltf["materials"];
+    for (size_t i = 0; i < gltfMaterials.Size(); ++i) {
+        const JsonValue& source = gltfMaterials[i];
+        const JsonValue& pbr = source["pbrMetallicRoughness"];
+        const JsonValue& color = pbr["baseColorFactor"];
+        const JsonValue& emissive = source["emissiveFactor"];
+
+        Material material;
+        material.initialized = true;
+        material.baseColor = { color[0].AsFloat(1.0f), color[1].AsFloat(1.0f), color[2].AsFloat(1.0f), color[3].AsFloat(1.0f) };
+        material.metallic = pbr["metallicFactor"].AsFloat(1.0f);
+        material.roughness = pbr["roughnessFactor"].AsFloat(1.0f);
+        material.emissive = { emissive[0].AsFloat(), emissive[1].AsFloat(), emissive[2].AsFloat() };
+        const std::string& alphaMode = source["alphaMode"].AsString();
+        material.alphaTested = alphaMode == "MASK" || alphaMode == "BLEND";
+
+        const DirectX::XMFLOAT4& c = material.baseColor;
+        material.diffuse = { c.x, c.y, c.z };
+        material.ambient = { 0.2f * c.x, 0.2f * c.y, 0.2f * c.z };
+        float specular = 0.04f + (1.0f - 0.04f) * material.metallic;
+        float gloss = 1.0f - material.roughness;
+        material.specular = {
+            (specular + (c.x - specular) * material.metallic) * gloss,
+            (specular + (c.y - specular) * material.metallic) * gloss,
+            (specular + (c.z - specular) * material.metallic) * gloss };
+        float alpha = std::max(material.roughness * material.roughness, 0.01f);
+        material.shininess = std::clamp(2.0f / (alpha * alpha) - 2.0f, 1.0f, 256.0f);
+
+        int texture = pbr["baseColorTexture"]["index"].AsInt(-1);
+        if (texture >= 0) {
+            size_t imageIndex = gltf["textures"][texture]["source"].AsSize(SIZE_MAX);
+            const JsonValue& image = gltf["images"][imageIndex];
+            const std::string& uri = image["uri"].AsString();
+            std::string embeddedName = filename + "#image" + std::to_string(imageIndex);
+            if (image.Has("bufferView")) {
+                ByteSpan bytes;
+                if (GetBufferView(gltf, buffers, image["bufferView"].AsSize(), bytes) && material.textureImage.LoadFromMemory(bytes.data, bytes.size)) {
+                    material.diffuseMap = embeddedName;
+                    material.embeddedTexture = true;
+                }
+            }
+            else if (uri.compare(0, 5, "data:") == 0) {
+                std::vector<unsigned char> bytes;
+                if (ResolveDataUri(uri, bytes) && material.textureImage.LoadFromMemory(bytes.data(), bytes.size())) {
+                    material.diffuseMap = embeddedName;
+                    material.embeddedTexture = true;
+                }
+            }
+            else if (!uri.empty()) {
+                std::string fileName;
+                if (!UriFileName(uri, fileName)) {
+                    std::cerr << "glTF image " << imageIndex << " of " << filename << " has a malformed URI: " << uri << std::endl;
+                    return false;
+                }
+                material.diffuseMap = fileName;
+                material.textureImage.LoadFromImage(material.diffuseMap);
+            }
+        }
+
+        std::string name = source["name"].AsString();
+        if (name.empty()) name = filename + "#material" + std::to_string(i);
+        materials.push_back(std::move(material));
+        materialNames.push_back(name);
+        materialMap[name] = static_cast<unsigned int>(materials.size() - 1);
+    }
+    unsigned int defaultMaterial = std::numeric_limits<unsigned int>::max();
+
+    // Walk the scene graph from the roots, collecting every node that references a mesh
+    const JsonValue& nodes = gltf["nodes"];
+    std::vector<std::pair<size_t, DirectX::XMFLOAT4X4>> meshNodes;
+    {
+        std::vector<size_t> roots;
+        const JsonValue& scene = gltf["scenes"][gltf["scene"].AsSize()];
+        if (scene.Has("nodes")) {
+            for (const JsonValue& root : scene["nodes"].Elements()) roots.push_back(root.AsSize());
+        }
+        else {
+            // No scene, every node that is nobody's child is a root
+            std::vector<bool> isChild(nodes.Size(), false);
+            for (const JsonValue& node : nodes.Elements()) {
+                for (const JsonValue& child : node["children"].Elements()) {
+                    if (child.AsSize() < isChild.size()) isChild[child.AsSize()] = true;
+                }
+            }
+            for (size_t i = 0; i < nodes.Size(); ++i) {
+                if (!isChild[i]) roots.push_back(i);
+            }
+        }
+
+        std::vector<bool> visited(nodes.Size(), false);
+        std::vector<std::pair<size_t, DirectX::XMFLOAT4X4>> stack;
+        DirectX::XMFLOAT4X4 identity;
+        DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+        for (auto it = roots.rbegin(); it != roots.rend(); ++it) stack.push_back({ *it, identity });
+        while (!stack.empty()) {
+            auto [index, parent] = stack.back();
+            stack.pop_back();
+            if (index >= nodes.Size() || visited[index]) continue;
+            visited[index] = true;
+
+            const JsonValue& node = nodes[index];
+            DirectX::XMFLOAT4X4 world;
+            DirectX::XMStoreFloat4x4(&world, NodeMatrix(node) * DirectX::XMLoadFloat4x4(&parent));
+            if (node.Has("mesh")) meshNodes.push_back({ index, world });
+
+            const JsonValue& children = node["children"];
+            for (size_t c = children.Size(); c-- > 0;) stack.push_back({ children[c].AsSize(), world });
+        }
+    }
+
+    for (const auto& [nodeIndex, world] : meshNodes) {
+        const JsonValue& node = nodes[nodeIndex];
+        const JsonValue& mesh = gltf["meshes"][node["mesh"].AsSize()];
+
+        // Every mesh instance becomes its own group, named after the node
+        std::string groupName = node["name"].AsString();
+        if (groupName.empty()) groupName = mesh["name"].AsString();
+        if (groupName.empty()) groupName = "node" + std::to_string(nodeIndex);
+        const unsigned int group = static_cast<unsigned int>(groupNames.size());
+        groupNames.push_back(groupName);
+
+        DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&world);
+        const bool isIdentity = DirectX::XMMatrixIsIdentity(worldMatrix);
+        const bool mirrored = DirectX::XMVectorGetX(DirectX::XMMatrixDeterminant(worldMatrix)) < 0.0f;
+
+        for (const JsonValue& primitive : mesh["primitives"].Elements()) {
+            if (primitive["mode"].AsInt(Triangles) != Triangles) {
+                std::cerr << "glTF: skipping a non triangle primitive in " << filename << std::endl;
+                continue;
+            }
+
+            const JsonValue& attributes = primitive["attributes"];
+            AccessorView position;
+            if (!GetAccessor(gltf, buffers, attributes["POSITION"].AsSize(SIZE_MAX), position) ||
+                position.componentType != Float || position.components != 3 || position.count == 0) {
+                std::cerr << "glTF: primitive without usable positions in " << filename << std::endl;
+                continue;
+            }
+            AccessorView normal, uv;
+            bool hasNormals = attributes.Has("NORMAL") && GetAccessor(gltf, buffers, attributes["NORMAL"].AsSize(), normal) &&
+                normal.components == 3 && normal.count == position.count;
+            bool hasUVs = attributes.Has("TEXCOORD_0") && GetAccessor(gltf, buffers, attributes["TEXCOORD_0"].AsSize(), uv) &&
+                uv.components == 2 && uv.count == position.count;
+
+            // Vertices. When the buffer view is interleaved exactly like Vertex, the whole range is
+            // copied in one go straight out of the mapped file.
+            const size_t baseVertex = vertices.size();
+            vertices.resize(baseVertex + position.count);
+            Vertex* dst = vertices.data() + baseVertex;
+            const bool sameLayout = hasNormals && hasUVs &&
+                normal.componentType == Float && uv.componentType == Float &&
+                position.stride == sizeof(Vertex) && normal.stride == sizeof(Vertex) && uv.stride == sizeof(Vertex) &&
+                uv.data == position.data + offsetof(Vertex, uv) && normal.data == position.data + offsetof(Vertex, normal);
+            if (sameLayout) {
+                std::memcpy(dst, position.data, position.count * sizeof(Vertex));
+            }
+            else {
+                CopyAttribute(position, 3, dst, offsetof(Vertex, position));
+                if (hasUVs) CopyAttribute(uv, 2, dst, offsetof(Vertex, uv));
+                if (hasNormals) CopyAttribute(normal, 3, dst, offsetof(Vertex, normal));
+            }
+
+            if (!isIdentity) {
+                DirectX::XMFLOAT4X4 normalMatrix;
+                DirectX::XMVECTOR det;
+                DirectX::XMStoreFloat4x4(&normalMatrix, DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, worldMatrix)));
+                GeometryKernels::TransformPoints({ &dst->position.x, position.count, sizeof(Vertex) }, world);
+                if (hasNormals) {
+                    GeometryKernels::TransformNormals({ &dst->normal.x, position.count, sizeof(Vertex) }, normalMatrix);
+                }
+            }
+
+            // Indices, 32 bit tightly packed ones for the first primitive can be copied as is
+            const size_t baseIndex = indices.size();
+            bool validIndices = true;
+            if (primitive.Has("indices")) {
+                AccessorView source;
+                if (!GetAccessor(gltf, buffers, primitive["indices"].AsSize(), source) || source.components != 1 || source.componentType == Float) {
+                    validIndices = false;
+                }
+                else {
+                    const size_t count = source.count - source.count % 3;
+                    indices.resize(baseIndex + count);
+                    if (source.componentType == UnsignedInt && source.tight && baseVertex == 0) {
+                        std::memcpy(indices.data() + baseIndex, source.data, count * sizeof(unsigned int));
+                    }
+                    else {
+                        const unsigned int offset = static_cast<unsigned int>(baseVertex);
+                        for (size_t i = 0; i < count; ++i) {
+                            indices[baseIndex + i] = offset + ReadIndex(source.data + i * source.stride, source.componentType);
+                        }
+                    }
+                    const size_t end = baseVertex + position.count;
+                    for (size_t i = baseIndex; i < indices.size() && validIndices; ++i) {
+                        validIndices = indices[i] >= baseVertex && indices[i] < end;
+                    }
+                }
+            }
+            else {
+                const size_t count = position.count - position.count % 3;
+                indices.resize(baseIndex + count);
+                for (size_t i = 0; i < count; ++i) {
+                    indices[baseIndex + i] = static_cast<unsigned int>(baseVertex + i);
+                }
+            }
+            if (!validIndices) {
+                std::cerr << "glTF: primitive with invalid indices in " << filename << std::endl;
+                vertices.resize(baseVertex);
+                indices.resize(baseIndex);
+                continue;
+            }
+
+            // A mirroring transform flips the winding
+            if (mirrored) {
+                for (size_t i = baseIndex; i + 2 < indices.size(); i += 3) {
+                    std::swap(indices[i + 1], indices[i + 2]);
+                }
+            }
+
+            // Generated from the transformed positions and the final winding
+            if (!hasNormals) {
+                GeneratePrimitiveNormals(vertices, indices, baseVertex, baseIndex);
+            }
+
+            unsigned int material;
+            int sourceMaterial = primitive["material"].AsInt(-1);
+            if (sourceMaterial >= 0 && static_cast<size_t>(sourceMaterial) < gltfMaterials.Size()) {
+                material = materialBase + sourceMaterial;
+            }
+            else {
+                if (defaultMaterial == std::numeric_limits<unsigned int>::max()) {
+                    Material fallback;
+                    fallback.initialized = true;
+                    materials.push_back(fallback);
+                    materialNames.push_back(filename + "#default");
+                    defaultMaterial = static_cast<unsigned int>(materials.size() - 1);
+                }
+                material = defaultMaterial;
+            }
+            const size_t faces = (indices.size() - baseIndex) / 3;
+            materialIndices.insert(materialIndices.end(), faces, material);
+            groupIndices.insert(groupIndices.end(), faces, group);
+        }
+    }
+
+    if (indices.empty()) {
+        std::cerr << "No triangles found in " << filename << std::endl;
+        return false;
+    }
+
+    ComputeBoundingBox();
+    SortByMaterial();
+
+    return true;
+}
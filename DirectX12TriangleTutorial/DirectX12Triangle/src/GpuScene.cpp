@@ -0,0 +1,64 @@
+#include "GpuScene.h"
+
+void GpuScene::ApplyChanges(const EntityStore& entities, const EntityChanges& changes) {
+    stats = SceneUploadStats();
+    stats.moved = static_cast<unsigned int>(changes.moved.size());
+
+    // Destroyed first, a created entity may reuse the slot of a destroyed one
+    for (EntityHandle entity : changes.destroyed) {
+        if (entity.index < entityMeshes.size() && entityMeshes[entity.index].handle == entity
+            && entityMeshes[entity.index].mesh != NoMesh) {
+            ReleaseEntity(entity.index);
+            ++stats.destroyed;
+        }
+    }
+
+    for (EntityHandle entity : changes.created) {
+        const Model* instance = entities.GetModel(entity);
+        if (!instance) continue; // destroyed again before it was drawn
+        const Model* model = &instance->GetMesh();
+
+        if (entity.index >= entityMeshes.size()) entityMeshes.resize(entity.index + 1);
+        if (entityMeshes[entity.index].mesh != NoMesh) ReleaseEntity(entity.index);
+
+        uint32_t mesh;
+        const auto found = meshOfModel.find(model);
+        if (found != meshOfModel.end()) {
+            mesh = found->second;
+        }
+        else {
+            if (!freeMeshes.empty()) {
+                mesh = freeMeshes.back();
+                freeMeshes.pop_back();
+            }
+            else {
+                mesh = static_cast<uint32_t>(meshes.size());
+                meshes.emplace_back();
+            }
+            meshes[mesh].model = model;
+            meshOfModel.emplace(model, mesh);
+            allocator.CreateMesh(mesh, *model, stats);
+            ++stats.meshesCreated;
+        }
+        ++meshes[mesh].users;
+        entityMeshes[entity.index] = { entity, mesh };
+        ++stats.created;
+    }
+}
+
+uint32_t GpuScene::GetMesh(EntityHandle entity) const {
+    if (entity.index >= entityMeshes.size() || entityMeshes[entity.index].handle != entity) return NoMesh;
+    return entityMeshes[entity.index].mesh;
+}
+
+void GpuScene::ReleaseEntity(uint32_t index) {
+    const uint32_t mesh = entityMeshes[index].mesh;
+    entityMeshes[index].mesh = NoMesh;
+    if (--meshes[mesh].users > 0) return;
+
+    meshOfModel.erase(meshes[mesh].model);
+    meshes[mesh] = MeshSlot();
+    freeMeshes.push_back(mesh);
+    allocator.ReleaseMesh(mesh);
+    ++stats.meshesReleased;
+}
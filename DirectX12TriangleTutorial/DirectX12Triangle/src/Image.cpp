@@ -56,6 +56,15 @@ void Image::LoadFromImage(const std::string& filename) {
 	this->raw_data = stbi_load(fullPath.c_str(), &width, &height, &channels, 4);
 }
 
+bool Image::LoadFromMemory(const unsigned char* encoded, size_t size) {
+	this->raw_data = stbi_load_from_memory(encoded, static_cast<int>(size), &width, &height, &channels, 4);
+	if (!this->raw_data) {
+		std::cerr << "Failed to decode image: " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	return true;
+}
+
 void Image::Clear(const Pixel& color) {
 	std::fill(pixels.begin(), pixels.end(), color);
 }
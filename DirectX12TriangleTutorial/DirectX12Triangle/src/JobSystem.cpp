@@ -0,0 +1,341 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+struct Job {
+    std::function<void()> function;
+    JobCounter* counter = nullptr;
+    bool mainThread = false;
+};
+
+namespace {
+    // Which deque the calling thread owns, per system so benchmarks can run several
+    thread_local const JobSystem* threadSystem = nullptr;
+    thread_local int threadIndex = -1;
+
+    // Victim choice for stealing, one generator per thread
+    thread_local uint32_t stealSeed = 0x9E3779B9u;
+
+    uint32_t NextRandom() {
+        stealSeed ^= stealSeed << 13;
+        stealSeed ^= stealSeed >> 17;
+        stealSeed ^= stealSeed << 5;
+        return stealSeed;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Chase-Lev deque, memory orders as in the C11 version of the paper
+// ---------------------------------------------------------------------------
+
+WorkStealingDeque::WorkStealingDeque() {
+    rings.push_back(std::make_unique<Ring>(256));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+WorkStealingDeque::~WorkStealingDeque() = default;
+
+void WorkStealingDeque::Push(Job* job) {
+    const int64_t b = bottom.load(std::memory_order_relaxed);
+    const int64_t t = top.load(std::memory_order_acquire);
+    Ring* r = ring.load(std::memory_order_relaxed);
+    if (b - t > r->capacity - 1) {
+        // Full, copy the live range into a ring twice the size
+        auto grown = std::make_unique<Ring>(r->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            grown->At(i).store(r->At(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        r = grown.get();
+        rings.push_back(std::move(grown));
+        ring.store(r, std::memory_order_release);
+    }
+    r->At(b).store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Job* WorkStealingDeque::Pop() {
+    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring* r = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    Job* job = nullptr;
+    if (t <= b) {
+        job = r->At(b).load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last one, a thief may be after it too
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+    }
+    else {
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* WorkStealingDeque::Steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Ring* r = ring.load(std::memory_order_acquire);
+    Job* job = r->At(t).load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+bool WorkStealingDeque::IsEmpty() const {
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+// JobSystem
+// ---------------------------------------------------------------------------
+
+JobSystem::JobSystem(unsigned int workerCount) : mainThread(std::this_thread::get_id()) {
+    deques.reserve(workerCount + 1);
+    for (unsigned int i = 0; i <= workerCount; ++i) {
+        deques.push_back(std::make_unique<WorkStealingDeque>());
+    }
+    outerSystem = threadSystem;
+    outerIndex = threadIndex;
+    threadSystem = this;
+    threadIndex = 0;
+
+    workers.reserve(workerCount);
+    for (unsigned int i = 1; i <= workerCount; ++i) {
+        workers.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (threadSystem == this) {
+        threadSystem = outerSystem;
+        threadIndex = outerIndex;
+    }
+}
+
+JobSystem& JobSystem::Get() {
+    static JobSystem system;
+    return system;
+}
+
+unsigned int JobSystem::DefaultWorkerCount() {
+    const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+int JobSystem::ThreadIndex() const {
+    return threadSystem == this ? threadIndex : -1;
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter* counter, JobCounter* dependency) {
+    Job* job = new Job{ std::move(function), counter, false };
+    if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (dependency && !dependency->IsDone()) {
+        // Checked again under the lock, the last job of the dependency takes the waiters under it
+        std::lock_guard<std::mutex> lock(dependency->waitersMutex);
+        if (!dependency->IsDone()) {
+            dependency->waiters.push_back(job);
+            return;
+        }
+    }
+    Schedule(job);
+}
+
+void JobSystem::RunOnMainThread(std::function<void()> function, JobCounter* counter, JobCounter* dependency) {
+    Job* job = new Job{ std::move(function), counter, true };
+    if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (dependency && !dependency->IsDone()) {
+        std::lock_guard<std::mutex> lock(dependency->waitersMutex);
+        if (!dependency->IsDone()) {
+            dependency->waiters.push_back(job);
+            return;
+        }
+    }
+    Schedule(job);
+}
+
+void JobSystem::Schedule(Job* job) {
+    if (job->mainThread) {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainJobs.push_back(job);
+        return;
+    }
+    Enqueue(job);
+}
+
+void JobSystem::Enqueue(Job* job) {
+    // Counted before it can be found, so a worker that saw no jobs is woken
+    queued.fetch_add(1);
+    const int index = ThreadIndex();
+    if (index >= 0) {
+        deques[index]->Push(job);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected.push_back(job);
+    }
+
+    if (sleeping.load() > 0) {
+        // Taking the lock orders this with a worker about to sleep
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+Job* JobSystem::FindJob() {
+    const int index = ThreadIndex();
+    Job* job = index >= 0 ? deques[index]->Pop() : nullptr;
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        if (!injected.empty()) {
+            job = injected.back();
+            injected.pop_back();
+        }
+    }
+
+    // One round over the other deques from a random start
+    const size_t count = deques.size();
+    const size_t start = count > 1 ? NextRandom() % count : 0;
+    for (size_t k = 0; k < count && !job; ++k) {
+        const size_t victim = (start + k) % count;
+        if (static_cast<int>(victim) != index) job = deques[victim]->Steal();
+    }
+
+    if (job) queued.fetch_sub(1);
+    return job;
+}
+
+Job* JobSystem::TakeMainThreadJob() {
+    std::lock_guard<std::mutex> lock(mainMutex);
+    if (mainJobs.empty()) return nullptr;
+    Job* job = mainJobs.front();
+    mainJobs.erase(mainJobs.begin());
+    return job;
+}
+
+void JobSystem::Execute(Job* job) {
+    job->function();
+
+    JobCounter* counter = job->counter;
+    delete job;
+    if (!counter) return;
+
+    uint32_t pending = counter->pending.load(std::memory_order_relaxed);
+    while (pending > 1) {
+        if (counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) return;
+    }
+
+    // The last one reaches zero under the lock, together with taking the jobs that depend on
+    // the counter. Wait takes the lock too before it returns, so the counter isn't touched here
+    // once its owner may destroy it.
+    std::vector<Job*> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->waitersMutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter->waiters);
+    }
+    for (Job* waiter : ready) {
+        Schedule(waiter);
+    }
+}
+
+void JobSystem::WorkerLoop(unsigned int index) {
+    threadSystem = this;
+    threadIndex = static_cast<int>(index);
+    stealSeed ^= index * 0x85EBCA6Bu;
+
+    while (!stopping.load()) {
+        if (Job* job = FindJob()) {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1);
+        wake.wait(lock, [this]() { return queued.load() > 0 || stopping.load(); });
+        sleeping.fetch_sub(1);
+    }
+}
+
+void JobSystem::Wait(const JobCounter& counter) {
+    const bool onMainThread = IsMainThread();
+    while (!counter.IsDone()) {
+        Job* job = onMainThread ? TakeMainThreadJob() : nullptr;
+        if (!job) job = FindJob();
+        if (job) {
+            Execute(job);
+        }
+        else {
+            // What is left runs on other threads
+            std::this_thread::yield();
+        }
+    }
+    // The thread that finished the last job may still hold the lock
+    std::lock_guard<std::mutex> lock(counter.waitersMutex);
+}
+
+void JobSystem::PumpMainThread() {
+    if (!IsMainThread()) return;
+
+    // Only what was queued so far, jobs queued by these run next frame
+    std::vector<Job*> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        jobs.swap(mainJobs);
+    }
+    for (Job* job : jobs) {
+        Execute(job);
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, const std::function<void(size_t, size_t)>& body, size_t minGrain) {
+    if (count == 0) return;
+
+    // Small enough that checking for idle threads between chunks is cheap, large enough that
+    // a chunk outweighs that check
+    const size_t grain = std::max<size_t>({ minGrain, count / (32 * GetThreadCount()), size_t(1) });
+    if (count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    ParallelForRange(0, count, grain, body, counter);
+    Wait(counter);
+}
+
+void JobSystem::ParallelForRange(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body, JobCounter& counter) {
+    const int index = ThreadIndex();
+    while (begin < end) {
+        // An empty deque means thieves took what this thread handed out, so someone is idle
+        const bool othersIdle = index >= 0 ? deques[index]->IsEmpty() : queued.load(std::memory_order_relaxed) == 0;
+        if (end - begin > grain && othersIdle) {
+            const size_t middle = begin + (end - begin) / 2;
+            Run([this, middle, end, grain, &body, &counter]() { ParallelForRange(middle, end, grain, body, counter); }, &counter);
+            end = middle;
+            continue;
+        }
+        const size_t chunkEnd = std::min(end, begin + grain);
+        body(begin, chunkEnd);
+        begin = chunkEnd;
+    }
+}
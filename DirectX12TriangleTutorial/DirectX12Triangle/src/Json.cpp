@@ -0,0 +1,257 @@
+#include "Json.h"
+#include <charconv>
+
+namespace {
+
+const JsonValue nullValue;
+const std::string emptyString;
+
+void AppendUtf8(std::string& out, unsigned int codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+}
+
+// Recursive descent over the raw buffer, the input does not need to be null terminated
+class JsonParser {
+public:
+    JsonParser(const char* text, size_t length) : pos(text), end(text + length) {}
+
+    bool ParseDocument(JsonValue& out) {
+        SkipWhitespace();
+        if (!ParseValue(out, 0)) return false;
+        SkipWhitespace();
+        return pos == end || Fail("trailing characters after the document");
+    }
+
+    std::string error;
+
+private:
+    static constexpr int MaxDepth = 256;
+
+    const char* pos;
+    const char* end;
+
+    bool Fail(const char* message) {
+        if (error.empty()) error = message;
+        return false;
+    }
+
+    void SkipWhitespace() {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) ++pos;
+    }
+
+    bool Consume(const char* literal) {
+        const char* p = pos;
+        for (; *literal; ++literal, ++p) {
+            if (p == end || *p != *literal) return false;
+        }
+        pos = p;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& out, int depth) {
+        if (depth > MaxDepth) return Fail("nesting too deep");
+        if (pos == end) return Fail("unexpected end of input");
+
+        switch (*pos) {
+        case '{': return ParseObject(out, depth);
+        case '[': return ParseArray(out, depth);
+        case '"':
+            out.type = JsonValue::Type::String;
+            return ParseString(out.string);
+        case 't':
+            if (!Consume("true")) return Fail("invalid literal");
+            out.type = JsonValue::Type::Bool;
+            out.boolean = true;
+            return true;
+        case 'f':
+            if (!Consume("false")) return Fail("invalid literal");
+            out.type = JsonValue::Type::Bool;
+            out.boolean = false;
+            return true;
+        case 'n':
+            if (!Consume("null")) return Fail("invalid literal");
+            out.type = JsonValue::Type::Null;
+            return true;
+        default:
+            return ParseNumber(out);
+        }
+    }
+
+    bool ParseNumber(JsonValue& out) {
+        // from_chars does not accept a leading '+', which JSON does not allow either
+        auto result = std::from_chars(pos, end, out.number);
+        if (result.ec != std::errc() || result.ptr == pos) return Fail("invalid number");
+        pos = result.ptr;
+        out.type = JsonValue::Type::Number;
+        return true;
+    }
+
+    bool ParseHex4(unsigned int& out) {
+        if (end - pos < 4) return Fail("truncated \\u escape");
+        out = 0;
+        for (int i = 0; i < 4; ++i, ++pos) {
+            char c = *pos;
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= c - '0';
+            else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+            else return Fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    bool ParseString(std::string& out) {
+        ++pos; // opening quote
+        out.clear();
+        while (pos < end) {
+            // Copy the run up to the next quote or escape in one go
+            const char* runStart = pos;
+            while (pos < end && *pos != '"' && *pos != '\\') ++pos;
+            out.append(runStart, pos);
+            if (pos == end) break;
+
+            if (*pos == '"') {
+                ++pos;
+                return true;
+            }
+
+            ++pos; // backslash
+            if (pos == end) break;
+            char c = *pos++;
+            switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned int codePoint;
+                if (!ParseHex4(codePoint)) return false;
+                // Surrogate pair
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && end - pos >= 6 && pos[0] == '\\' && pos[1] == 'u') {
+                    pos += 2;
+                    unsigned int low;
+                    if (!ParseHex4(low)) return false;
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return Fail("invalid escape");
+            }
+        }
+        return Fail("unterminated string");
+    }
+
+    bool ParseArray(JsonValue& out, int depth) {
+        ++pos;
+        out.type = JsonValue::Type::Array;
+        SkipWhitespace();
+        if (pos < end && *pos == ']') {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            out.array.emplace_back();
+            SkipWhitespace();
+            if (!ParseValue(out.array.back(), depth + 1)) return false;
+            SkipWhitespace();
+            if (pos == end) return Fail("unterminated array");
+            if (*pos == ',') {
+                ++pos;
+                continue;
+            }
+            if (*pos == ']') {
+                ++pos;
+                return true;
+            }
+            return Fail("expected ',' or ']'");
+        }
+    }
+
+    bool ParseObject(JsonValue& out, int depth) {
+        ++pos;
+        out.type = JsonValue::Type::Object;
+        SkipWhitespace();
+        if (pos < end && *pos == '}') {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            SkipWhitespace();
+            if (pos == end || *pos != '"') return Fail("expected a key");
+            out.members.emplace_back();
+            if (!ParseString(out.members.back().first)) return false;
+            SkipWhitespace();
+            if (pos == end || *pos != ':') return Fail("expected ':'");
+            ++pos;
+            SkipWhitespace();
+            if (!ParseValue(out.members.back().second, depth + 1)) return false;
+            SkipWhitespace();
+            if (pos == end) return Fail("unterminated object");
+            if (*pos == ',') {
+                ++pos;
+                continue;
+            }
+            if (*pos == '}') {
+                ++pos;
+                return true;
+            }
+            return Fail("expected ',' or '}'");
+        }
+    }
+};
+
+bool JsonValue::Parse(const char* text, size_t length, JsonValue& out, std::string* error) {
+    out = JsonValue();
+    JsonParser parser(text, length);
+    if (!parser.ParseDocument(out)) {
+        if (error) *error = parser.error;
+        return false;
+    }
+    return true;
+}
+
+const JsonValue* JsonValue::Find(const std::string& key) const {
+    if (type != Type::Object) return nullptr;
+    for (const auto& member : members) {
+        if (member.first == key) return &member.second;
+    }
+    return nullptr;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+    const JsonValue* value = Find(key);
+    return value ? *value : nullValue;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    return type == Type::Array && index < array.size() ? array[index] : nullValue;
+}
+
+const std::string& JsonValue::AsString() const {
+    return type == Type::String ? string : emptyString;
+}
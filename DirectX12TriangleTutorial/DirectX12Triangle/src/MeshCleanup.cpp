@@ -0,0 +1,191 @@
+#include "MeshCleanup.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+struct TriangleHash {
+    size_t operator()(const std::array<unsigned int, 3>& t) const {
+        uint64_t h = t[0];
+        h = h * 0x9E3779B97F4A7C15ull ^ t[1];
+        h = h * 0x9E3779B97F4A7C15ull ^ t[2];
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+// 21 bits per axis, wrapping is harmless because candidates are always compared exactly
+uint64_t CellKey(int64_t x, int64_t y, int64_t z) {
+    return (static_cast<uint64_t>(x & 0x1FFFFF) << 42) | (static_cast<uint64_t>(y & 0x1FFFFF) << 21) | static_cast<uint64_t>(z & 0x1FFFFF);
+}
+
+uint64_t ExactKey(const DirectX::XMFLOAT3& p) {
+    // + 0.0f folds -0 into +0
+    float f[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+    uint32_t bits[3];
+    std::memcpy(bits, f, sizeof(bits));
+    return (static_cast<uint64_t>(bits[0]) * 0x9E3779B97F4A7C15ull) ^ (static_cast<uint64_t>(bits[1]) << 21) ^ bits[2];
+}
+
+bool CanWeld(const Vertex& a, const Vertex& b, const MeshCleanupOptions& options) {
+    float dx = a.position.x - b.position.x;
+    float dy = a.position.y - b.position.y;
+    float dz = a.position.z - b.position.z;
+    if (dx * dx + dy * dy + dz * dz > options.weldTolerance * options.weldTolerance) return false;
+
+    if (fabsf(a.uv.x - b.uv.x) > options.uvTolerance || fabsf(a.uv.y - b.uv.y) > options.uvTolerance) return false;
+
+    float lengths = sqrtf((a.normal.x * a.normal.x + a.normal.y * a.normal.y + a.normal.z * a.normal.z) *
+        (b.normal.x * b.normal.x + b.normal.y * b.normal.y + b.normal.z * b.normal.z));
+    if (lengths == 0.0f) {
+        // Only merge if both are missing a normal
+        return a.normal.x == b.normal.x && a.normal.y == b.normal.y && a.normal.z == b.normal.z;
+    }
+    float cosAngle = (a.normal.x * b.normal.x + a.normal.y * b.normal.y + a.normal.z * b.normal.z) / lengths;
+    return 1.0f - cosAngle <= options.normalTolerance;
+}
+
+}
+
+MeshCleanupStats CleanupMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    const std::vector<std::vector<unsigned int>*>& faceAttributes, const MeshCleanupOptions& options) {
+    MeshCleanupStats stats;
+    const size_t numVertices = vertices.size();
+    const size_t numFaces = indices.size() / 3;
+    if (numVertices == 0) return stats;
+
+    // Weld: every vertex either maps onto an earlier representative within tolerance, or becomes
+    // one itself. Representatives are chained per grid cell, so a lookup only visits the
+    // neighbouring cells instead of the whole mesh.
+    std::vector<unsigned int> remap(numVertices);
+    {
+        std::unordered_map<uint64_t, unsigned int> cellHead;
+        cellHead.reserve(numVertices);
+        std::vector<unsigned int> next(numVertices, UINT_MAX);
+
+        const bool exact = options.weldTolerance <= 0.0f;
+        const double inverseCell = exact ? 0.0 : 1.0 / options.weldTolerance;
+        for (size_t v = 0; v < numVertices; ++v) {
+            const DirectX::XMFLOAT3& p = vertices[v].position;
+            unsigned int match = UINT_MAX;
+            uint64_t ownCell;
+            if (exact) {
+                ownCell = ExactKey(p);
+                auto it = cellHead.find(ownCell);
+                for (unsigned int r = it != cellHead.end() ? it->second : UINT_MAX; r != UINT_MAX && match == UINT_MAX; r = next[r]) {
+                    if (CanWeld(vertices[r], vertices[v], options)) match = r;
+                }
+            }
+            else {
+                // Cells are one tolerance wide, so any vertex within tolerance is in the 3x3x3 block
+                int64_t cx = static_cast<int64_t>(floor(p.x * inverseCell));
+                int64_t cy = static_cast<int64_t>(floor(p.y * inverseCell));
+                int64_t cz = static_cast<int64_t>(floor(p.z * inverseCell));
+                ownCell = CellKey(cx, cy, cz);
+                for (int64_t x = cx - 1; x <= cx + 1 && match == UINT_MAX; ++x) {
+                    for (int64_t y = cy - 1; y <= cy + 1 && match == UINT_MAX; ++y) {
+                        for (int64_t z = cz - 1; z <= cz + 1 && match == UINT_MAX; ++z) {
+                            auto it = cellHead.find(CellKey(x, y, z));
+                            if (it == cellHead.end()) continue;
+                            for (unsigned int r = it->second; r != UINT_MAX; r = next[r]) {
+                                if (CanWeld(vertices[r], vertices[v], options)) {
+                                    match = r;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (match != UINT_MAX) {
+                remap[v] = match;
+                stats.weldedVertices++;
+            }
+            else {
+                remap[v] = static_cast<unsigned int>(v);
+                auto [it, inserted] = cellHead.try_emplace(ownCell, static_cast<unsigned int>(v));
+                if (!inserted) {
+                    next[v] = it->second;
+                    it->second = static_cast<unsigned int>(v);
+                }
+            }
+        }
+    }
+
+    // Filter the triangles in place, keeping the order of the survivors
+    std::unordered_set<std::array<unsigned int, 3>, TriangleHash> seenTriangles;
+    if (options.removeDuplicateTriangles) {
+        seenTriangles.reserve(numFaces);
+    }
+    const float areaEpsilon = options.weldTolerance * options.weldTolerance * options.weldTolerance * options.weldTolerance;
+    std::vector<bool> keepFace(numFaces, true);
+    size_t keptFaces = 0;
+    for (size_t f = 0; f < numFaces; ++f) {
+        unsigned int i0 = remap[indices[f * 3]];
+        unsigned int i1 = remap[indices[f * 3 + 1]];
+        unsigned int i2 = remap[indices[f * 3 + 2]];
+
+        if (options.removeDegenerateTriangles) {
+            bool degenerate = i0 == i1 || i1 == i2 || i0 == i2;
+            if (!degenerate) {
+                DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[i0].position);
+                DirectX::XMVECTOR e1 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertices[i1].position), p0);
+                DirectX::XMVECTOR e2 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertices[i2].position), p0);
+                degenerate = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVector3Cross(e1, e2))) <= areaEpsilon;
+            }
+            if (degenerate) {
+                keepFace[f] = false;
+                stats.degenerateTriangles++;
+                continue;
+            }
+        }
+
+        if (options.removeDuplicateTriangles) {
+            // Rotate the smallest index to the front, the winding is kept so back to back faces survive
+            std::array<unsigned int, 3> key = { i0, i1, i2 };
+            if (i1 < i0 && i1 < i2) key = { i1, i2, i0 };
+            else if (i2 < i0 && i2 < i1) key = { i2, i0, i1 };
+            if (!seenTriangles.insert(key).second) {
+                keepFace[f] = false;
+                stats.duplicateTriangles++;
+                continue;
+            }
+        }
+
+        indices[keptFaces * 3] = i0;
+        indices[keptFaces * 3 + 1] = i1;
+        indices[keptFaces * 3 + 2] = i2;
+        keptFaces++;
+    }
+    indices.resize(keptFaces * 3);
+
+    for (std::vector<unsigned int>* attribute : faceAttributes) {
+        if (attribute == nullptr || attribute->size() != numFaces) continue;
+        size_t dst = 0;
+        for (size_t f = 0; f < numFaces; ++f) {
+            if (keepFace[f]) (*attribute)[dst++] = (*attribute)[f];
+        }
+        attribute->resize(dst);
+    }
+
+    // Compact to the referenced vertices, numbered in first use order
+    std::vector<unsigned int> newIndex(numVertices, UINT_MAX);
+    std::vector<Vertex> compacted;
+    compacted.reserve(numVertices - stats.weldedVertices);
+    for (unsigned int& index : indices) {
+        if (newIndex[index] == UINT_MAX) {
+            newIndex[index] = static_cast<unsigned int>(compacted.size());
+            compacted.push_back(vertices[index]);
+        }
+        index = newIndex[index];
+    }
+    stats.unusedVertices = static_cast<unsigned int>(numVertices - stats.weldedVertices - compacted.size());
+    vertices.swap(compacted);
+
+    return stats;
+}
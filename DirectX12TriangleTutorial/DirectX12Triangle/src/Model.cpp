@@ -5,7 +5,15 @@
 #include <sstream>
 #include <map>
 #include <limits>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cctype>
+#include <charconv>
 #include "File.h"
+#include "GeometryKernels.h"
+#include "JobSystem.h"
+#include "Collision.h"
 
 #ifdef max
 #undef max
@@ -15,15 +23,45 @@ using namespace std;
 #undef min
 #endif
 
+std::unique_ptr<Model> Model::CreateInstance(std::shared_ptr<Model> source) {
+	// An instance of an instance shares the same mesh
+	if (source->meshSource) source = source->meshSource;
+	auto instance = std::make_unique<Model>();
+	instance->position = source->position;
+	instance->rotation = source->rotation;
+	instance->scale = source->scale;
+	instance->localBounds = source->localBounds;
+	instance->meshSource = std::move(source);
+	instance->UpdateWorldTransform();
+	return instance;
+}
+
 void Model::UpdateTextures() {
+	if (meshSource) {
+		meshSource->UpdateTextures();
+		return;
+	}
 	for (auto& mat : materials) {
-		if (!mat.diffuseMap.empty()) {
+		// Embedded textures have no file to reload from
+		if (!mat.diffuseMap.empty() && !mat.embeddedTexture) {
 			mat.textureImage.LoadFromImage(mat.diffuseMap);
 			mat.initialized = true;
 		}
 	}
 }
 
+bool Model::LoadFromFile(const std::string& filename) {
+	std::string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension == "gltf" || extension == "glb") {
+		return LoadFromGltf(filename);
+	}
+	if (extension == "3ds") {
+		return LoadFrom3ds(filename);
+	}
+	return LoadFromObj(filename);
+}
+
 bool Model::LoadFromObj(const std::string& filename) {
 	// Open the file
 	std::ifstream file = OpenAssetFile(filename);
@@ -31,17 +69,36 @@ bool Model::LoadFromObj(const std::string& filename) {
 		std::cerr << "Failed to open OBJ file: " << filename << std::endl;
 		return false;
 	}
+	return LoadFromObj(file, [this](const std::string& mtlFile) { LoadMTL(mtlFile); });
+}
 
+bool Model::LoadFromObj(std::istream& file, const std::function<void(const std::string&)>& loadMaterials) {
 	// Temporary storage for parsing
 	std::string line;
 	std::vector<DirectX::XMFLOAT3> temp_vertices;
 	std::vector<DirectX::XMFLOAT2> temp_uvs;
 	std::vector<DirectX::XMFLOAT3> temp_normals;
 	std::vector<unsigned int> temp_materialIndices;
+	std::vector<unsigned int> temp_smoothingGroups;
 	std::vector<std::string> mtl_files;
 
 	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
 	unsigned int currentMaterialIndex = -1;
+	unsigned int currentSmoothingGroup = 0;
+	bool hasSmoothingGroups = false;
+
+	// "o" starts an object, "g" a group inside it. Faces before either go to a "default" group.
+	std::vector<unsigned int> temp_groupIndices;
+	std::map<std::string, unsigned int> groupMap;
+	std::string currentObject, currentGroupName;
+	unsigned int currentGroup = std::numeric_limits<unsigned int>::max();
+	auto selectGroup = [&]() {
+		std::string name = currentGroupName.empty() ? currentObject : currentObject.empty() ? currentGroupName : currentObject + "/" + currentGroupName;
+		if (name.empty()) name = "default";
+		auto [it, inserted] = groupMap.try_emplace(name, static_cast<unsigned int>(groupNames.size()));
+		if (inserted) groupNames.push_back(name);
+		currentGroup = it->second;
+	};
 
 	while (std::getline(file, line)) {
 		std::istringstream iss(line);
@@ -111,6 +168,7 @@ bool Model::LoadFromObj(const std::string& filename) {
 			}
 
 			if (faceVerts.size() < 3) continue; // not a valid face
+			if (currentGroup == std::numeric_limits<unsigned int>::max()) selectGroup();
 			
 			// Convert OBJ indices (1-based) to 0-based, handling negative indices
 			auto convertIndex = [](int idx, size_t count) -> unsigned int {
@@ -165,15 +223,15 @@ bool Model::LoadFromObj(const std::string& filename) {
 				
 				// Store material index for this face
 				temp_materialIndices.push_back(currentMaterialIndex);
-				temp_materialIndices.push_back(currentMaterialIndex);
-				temp_materialIndices.push_back(currentMaterialIndex);
+				temp_smoothingGroups.push_back(currentSmoothingGroup);
+				temp_groupIndices.push_back(currentGroup);
 			}
 		}
 		else if (prefix == "mtllib") {
 			std::string mtlFile;
 			iss >> mtlFile;
 			if (!mtlFile.empty()) {
-				LoadMTL(mtlFile);
+				loadMaterials(mtlFile);
 				mtl_files.push_back(mtlFile);
 			}
 		}
@@ -189,6 +247,36 @@ bool Model::LoadFromObj(const std::string& filename) {
 			}
 
 		}
+		else if (prefix == "o" || prefix == "g") {
+			// Names may contain spaces, take the rest of the line
+			std::string name;
+			std::getline(iss >> std::ws, name);
+			while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) name.pop_back();
+			if (prefix == "o") {
+				currentObject = name;
+				currentGroupName.clear();
+			}
+			else {
+				currentGroupName = name;
+			}
+			// Resolved on the next face, so groups without faces never show up
+			currentGroup = std::numeric_limits<unsigned int>::max();
+		}
+		else if (prefix == "s") {
+			// "s off" and "s 0" turn smoothing off for the following faces, "s on" is group 1.
+			// Anything else that isn't a number is treated as off rather than failing the load.
+			std::string group;
+			iss >> group;
+			unsigned int number = 0; // left alone by from_chars when it fails
+			if (group == "on") {
+				number = 1;
+			}
+			else {
+				std::from_chars(group.data(), group.data() + group.size(), number);
+			}
+			currentSmoothingGroup = number;
+			hasSmoothingGroups = true;
+		}
 	}
 
 	// Now create the final vertex list
@@ -198,7 +286,6 @@ bool Model::LoadFromObj(const std::string& filename) {
 		unsigned int vIdx = vertexIndices[i];
 		unsigned int uvIdx = uvIndices[i];
 		unsigned int nIdx = normalIndices[i];
-		unsigned int mIdx = temp_materialIndices[i];
 		auto key = std::make_tuple(vIdx, uvIdx, nIdx);  
 		if (uniqueVertexMap.find(key) == uniqueVertexMap.end()) {
 			Vertex vert;
@@ -220,22 +307,28 @@ bool Model::LoadFromObj(const std::string& filename) {
 			unsigned int newIndex = static_cast<unsigned int>(vertices.size() - 1);
 			uniqueVertexMap[key] = newIndex;
 			indices.push_back(newIndex);
-			// Store material per face (every 3 indices = 1 face)
-			if (i % 3 == 0) {  // Only store once per face
-				materialIndices.push_back(mIdx);
-			}
 		}
 		else {
 			indices.push_back(uniqueVertexMap[key]);
 		}
+		// Store material per face (every 3 indices = 1 face)
+		if (i % 3 == 0) {
+			materialIndices.push_back(temp_materialIndices[i / 3]);
+		}
 	}
 
-	// If any normals were missing, compute flat normals.
+	if (hasSmoothingGroups) {
+		smoothingGroups.swap(temp_smoothingGroups);
+	}
+	groupIndices.swap(temp_groupIndices);
+
+	// If any normals were missing, generate them from the faces and smoothing groups
 	if (missingNormals) {
 		ComputeNormals();
 	}
 
-	file.close();
+	ComputeBoundingBox();
+	SortByMaterial();
 
 	return true;
 }
@@ -247,6 +340,29 @@ void Model::LoadMTL(const std::string& path) {
 		return;
 	}
 
+	MaterialLibrary library;
+	library.Parse(file);
+	for (Material& material : library.materials) {
+		if (!material.diffuseMap.empty()) material.textureImage.LoadFromImage(material.diffuseMap);
+	}
+	AddMaterials(library);
+}
+
+void Model::AddMaterials(const MaterialLibrary& library) {
+	for (size_t i = 0; i < library.materials.size(); ++i) {
+		materials.push_back(library.materials[i]);
+		materialNames.push_back(library.names[i]);
+		materialMap[library.names[i]] = static_cast<unsigned int>(materials.size() - 1);
+	}
+}
+
+void Model::AssignTexture(const std::string& diffuseMap, const Image& image) {
+	for (Material& material : materials) {
+		if (material.diffuseMap == diffuseMap && !material.embeddedTexture) material.textureImage = image;
+	}
+}
+
+void MaterialLibrary::Parse(std::istream& file) {
 	// Read and parse MTL file as needed
 	std::string line;
 	Material currentMaterial;
@@ -263,11 +379,10 @@ void Model::LoadMTL(const std::string& path) {
 			if (currentMaterial.initialized) {
 				// Store the previous material before starting a new one
 				materials.push_back(currentMaterial);
-				materialMap[materialNames.back()] = static_cast<unsigned int>(materials.size() - 1);
 			}
 			currentMaterial = Material();
 			currentMaterial.initialized = true;
-			materialNames.push_back(materialName);
+			names.push_back(materialName);
 		}
 		else if (prefix == "Kd") {
 			float r, g, b;
@@ -296,164 +411,532 @@ void Model::LoadMTL(const std::string& path) {
 		else if (prefix == "map_Kd") {
 			std::string texturePath;
 			iss >> texturePath;
-			// Handle texture map
+			// Handle texture map, decoded by whoever loads the library
 			currentMaterial.diffuseMap = texturePath;
-			currentMaterial.textureImage.LoadFromImage(texturePath);
+		}
+		else if (prefix == "map_d") {
+			// The shader discards the transparent texels
+			currentMaterial.alphaTested = true;
 		}
 	}
 
 	if(currentMaterial.initialized) {
 		// Store the last material
 		materials.push_back(currentMaterial);
-		materialMap[materialNames.back()] = static_cast<unsigned int>(materials.size() - 1);
 	}
-
-	file.close();
 }
 
 void Model::MinMax(float& minX, float& minY, float& minZ, float& maxX, float& maxY, float& maxZ) {
 	if (vertices.empty()) return;
-	minX = maxX = vertices[0].position.x;
-	minY = maxY = vertices[0].position.y;
-	minZ = maxZ = vertices[0].position.z;
-	for (const auto& v : vertices) {
-		if (v.position.x < minX) minX = v.position.x;
-		if (v.position.x > maxX) maxX = v.position.x;
-		if (v.position.y < minY) minY = v.position.y;
-		if (v.position.y > maxY) maxY = v.position.y;
-		if (v.position.z < minZ) minZ = v.position.z;
-		if (v.position.z > maxZ) maxZ = v.position.z;
-	}
+	DirectX::XMFLOAT3 mn, mx;
+	GeometryKernels::ComputeBounds(PositionSpan(), mn, mx);
+	minX = mn.x; minY = mn.y; minZ = mn.z;
+	maxX = mx.x; maxY = mx.y; maxZ = mx.z;
 }
 void Model::Clear() {
 	vertices.clear();
 	indices.clear();
+	materialIndices.clear();
+	smoothingGroups.clear();
+	groupIndices.clear();
+	groupNames.clear();
+	groups.clear();
+	subMeshes.clear();
+	meshlets.clear();
+	bvh.Clear();
+	occluderIndices.clear();
 }
 
 void Model::GetPositions(std::vector<DirectX::XMFLOAT3>& outPositions) const {
-	for (const auto& v : vertices) {
+	for (const auto& v : GetVertices()) {
 		outPositions.push_back(v.position);
 	}
 }
 void Model::GetUVs(std::vector<DirectX::XMFLOAT2>& outUVs) const {
-	for (const auto& v : vertices) {
+	for (const auto& v : GetVertices()) {
 		outUVs.push_back(v.uv);
 	}
 }
 void Model::GetNormals(std::vector<DirectX::XMFLOAT3>& outNormals) const {
-	for (const auto& v : vertices) {
+	for (const auto& v : GetVertices()) {
 		outNormals.push_back(v.normal);
 	}
 }
 
 unsigned int Model::GetNumFaces() const {
-	return static_cast<unsigned int>(indices.size() / 3);
+	return static_cast<unsigned int>(GetIndices().size() / 3);
 }
 unsigned int Model::GetNumVertices() const {
-	return static_cast<unsigned int>(vertices.size());
+	return static_cast<unsigned int>(GetVertices().size());
 }
 unsigned int Model::GetNumIndices() const {
-	return static_cast<unsigned int>(indices.size());
+	return static_cast<unsigned int>(GetIndices().size());
 }
 
-void Model::ComputeNormals() {
-	for (size_t i = 0; i < indices.size(); i += 3) {
-		unsigned int idx0 = indices[i];
-		unsigned int idx1 = indices[i + 1];
-		unsigned int idx2 = indices[i + 2];
-		DirectX::XMVECTOR v0 = DirectX::XMLoadFloat3(&vertices[idx0].position);
-		DirectX::XMVECTOR v1 = DirectX::XMLoadFloat3(&vertices[idx1].position);
-		DirectX::XMVECTOR v2 = DirectX::XMLoadFloat3(&vertices[idx2].position);
-		DirectX::XMVECTOR edge1 = DirectX::XMVectorSubtract(v1, v0);
-		DirectX::XMVECTOR edge2 = DirectX::XMVectorSubtract(v2, v0);
-		DirectX::XMVECTOR faceNormal = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(edge1, edge2));
-		DirectX::XMStoreFloat3(&vertices[idx0].normal, DirectX::XMVector3Normalize(faceNormal));
-		DirectX::XMStoreFloat3(&vertices[idx1].normal, DirectX::XMVector3Normalize(faceNormal));
-		DirectX::XMStoreFloat3(&vertices[idx2].normal, DirectX::XMVector3Normalize(faceNormal));
+void Model::ComputeNormals(const NormalGeneratorOptions& options) {
+	// May split vertices along creases, which the meshlets have to know about
+	GenerateNormals(vertices, indices, smoothingGroups, options);
+	if (!meshlets.empty()) {
+		BuildMeshlets();
 	}
 }
 
+MeshCleanupStats Model::Cleanup(const MeshCleanupOptions& options) {
+	MeshCleanupStats stats = CleanupMesh(vertices, indices, { &materialIndices, &smoothingGroups, &groupIndices }, options);
+
+	// Bounds, sub-meshes and meshlets refer to the old buffers
+	ComputeBoundingBox();
+	SortByMaterial();
+	return stats;
+}
+
+ConvexDecompositionStats Model::BuildCollisionHulls(const std::string& cacheName, const ConvexDecompositionOptions& options) {
+	// FNV-1a over everything the decomposition depends on, so edited meshes or options rebuild
+	uint64_t key = 0xCBF29CE484222325ull;
+	auto hashBytes = [&key](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) key = (key ^ bytes[i]) * 0x100000001B3ull;
+	};
+	for (const Vertex& v : vertices) hashBytes(&v.position, sizeof(v.position));
+	hashBytes(indices.data(), indices.size() * sizeof(unsigned int));
+	const float optionValues[] = { static_cast<float>(options.resolution), options.concavityThreshold, static_cast<float>(options.maxDepth),
+		static_cast<float>(options.maxHulls), static_cast<float>(options.planesPerAxis), options.fillInterior ? 1.0f : 0.0f };
+	hashBytes(optionValues, sizeof(optionValues));
+
+	ConvexDecompositionStats stats;
+	std::filesystem::path cachePath;
+	if (!cacheName.empty()) {
+		cachePath = std::filesystem::path(GetExecutablePath()) / "cache" / cacheName;
+		if (LoadConvexHulls(cachePath.string(), key, collisionHulls)) {
+			stats.hulls = static_cast<unsigned int>(collisionHulls.size());
+			stats.loadedFromCache = true;
+			return stats;
+		}
+	}
+
+	collisionHulls = DecomposeConvex(vertices, indices, options, &stats);
+
+	if (!cachePath.empty()) {
+		std::error_code error;
+		std::filesystem::create_directories(cachePath.parent_path(), error);
+		if (!SaveConvexHulls(cachePath.string(), key, collisionHulls)) {
+			std::cerr << "Failed to write collision cache: " << cachePath.string() << std::endl;
+		}
+	}
+	return stats;
+}
+
+bool Model::CollidesWithSphere(const DirectX::XMFLOAT3& center, float radius) const {
+	DirectX::XMMATRIX world = GetModelMatrix();
+	for (const ConvexHull& hull : GetCollisionHulls()) {
+		// World box of the hull first, GJK only runs for the few that can touch
+		BoundingBox local;
+		local.SetBbox(hull.boundsMin.x, hull.boundsMax.x, hull.boundsMin.z, hull.boundsMax.z, hull.boundsMin.y, hull.boundsMax.y);
+		BoundingBox box = TransformBounds(local);
+		if (center.x + radius < box.minX || center.x - radius > box.maxX ||
+			center.y + radius < box.minY || center.y - radius > box.maxY ||
+			center.z + radius < box.minZ || center.z - radius > box.maxZ) {
+			continue;
+		}
+		if (SphereIntersectsHull(hull, world, center, radius)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void Model::Scale(float scaleFactor) {
-	for (auto& vertex : vertices) {
-		vertex.position.x *= scaleFactor;
-		vertex.position.y *= scaleFactor;
-		vertex.position.z *= scaleFactor;
+	GeometryKernels::ScaleTranslate(PositionSpan(), { scaleFactor, scaleFactor, scaleFactor }, { 0.0f, 0.0f, 0.0f });
+	for (ConvexHull& hull : collisionHulls) {
+		for (DirectX::XMFLOAT3& p : hull.points) {
+			p = { p.x * scaleFactor, p.y * scaleFactor, p.z * scaleFactor };
+		}
+		ComputeConvexHull(std::vector<DirectX::XMFLOAT3>(hull.points), hull);
 	}
+
+	// Bounds, sub-meshes and meshlets live in model space, which was just rewritten
+	ComputeBoundingBox();
+	SortByMaterial();
 }
 
-void Model::ApplyTransformation() {
-    DirectX::XMMATRIX transformMatrix = GetModelMatrix();
-    
-	float minX = 999999.0f;
-	float minZ = 999999.0f;
-	float maxX = -999999.0f;
-	float maxZ = -999999.0f;
-	float minY = 999999.0f;
-	float maxY = -999999.0f;
-
-    for (auto& vertex : vertices) {
-        // Transform position
-        DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&vertex.position);
-        pos = DirectX::XMVector3Transform(pos, transformMatrix);
-        DirectX::XMStoreFloat3(&vertex.position, pos);
-        
-        // Transform normal (use inverse transpose for correct normal transformation)
-        DirectX::XMVECTOR det;
-        DirectX::XMMATRIX normalMatrix = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, transformMatrix));
-        DirectX::XMVECTOR norm = DirectX::XMLoadFloat3(&vertex.normal);
-        norm = DirectX::XMVector3TransformNormal(norm, normalMatrix);
-        norm = DirectX::XMVector3Normalize(norm);
-        DirectX::XMStoreFloat3(&vertex.normal, norm);
-
-		minX = std::min(minX, vertex.position.x);
-		minZ = std::min(minZ, vertex.position.z);
-		maxX = std::max(maxX, vertex.position.x);
-		maxZ = std::max(maxZ, vertex.position.z);
-		minY = std::min(minY, vertex.position.y);
-		maxY = std::max(maxY, vertex.position.y);
-    }
-
-	b.SetBbox(minX, maxX, minZ, maxZ, minY, maxY);
-    
-    // Reset transformation after applying
-    position = { 0.0f, 0.0f, 0.0f };
-    rotation = { 0.0f, 0.0f, 0.0f };
-    scale = { 1.0f, 1.0f, 1.0f };
+void Model::UpdateWorldTransform() {
+	DirectX::XMMATRIX S = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
+	DirectX::XMMATRIX R = DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
+	DirectX::XMMATRIX T = DirectX::XMMatrixTranslation(position.x, position.y, position.z);
+	DirectX::XMMATRIX local = S * R * T;
+	DirectX::XMStoreFloat4x4(&localMatrix, local);
+	DirectX::XMStoreFloat4x4(&worldMatrix, local * DirectX::XMLoadFloat4x4(&parentMatrix));
+
+	b = TransformBounds(localBounds);
+}
 
+void Model::SetWorldMatrix(const DirectX::XMFLOAT4X4& parentWorld, const DirectX::XMFLOAT4X4& world) {
+	parentMatrix = parentWorld;
+	worldMatrix = world;
+	b = TransformBounds(localBounds);
 }
 
-// Add this method to Model class
+BoundingBox Model::TransformBounds(const BoundingBox& local) const {
+	// Arvo's method: each world axis extent is the translation plus, per local axis,
+	// the smaller/larger of the two projected slab ends
+	const float localMin[3] = { local.minX, local.minY, local.minZ };
+	const float localMax[3] = { local.maxX, local.maxY, local.maxZ };
+	float worldMin[3];
+	float worldMax[3];
+	for (int i = 0; i < 3; ++i) {
+		worldMin[i] = worldMax[i] = worldMatrix.m[3][i];
+		for (int j = 0; j < 3; ++j) {
+			float a = worldMatrix.m[j][i] * localMin[j];
+			float c = worldMatrix.m[j][i] * localMax[j];
+			worldMin[i] += std::min(a, c);
+			worldMax[i] += std::max(a, c);
+		}
+	}
+	BoundingBox world;
+	world.SetBbox(worldMin[0], worldMax[0], worldMin[2], worldMax[2], worldMin[1], worldMax[1]);
+	return world;
+}
+
+void Model::BakeTransformation() {
+	// Only the model's own transform, a parent keeps placing the baked mesh
+	DirectX::XMMATRIX transformMatrix = DirectX::XMLoadFloat4x4(&localMatrix);
+
+	// Normals use the inverse transpose, computed once for the whole mesh
+	DirectX::XMVECTOR det;
+	DirectX::XMFLOAT4X4 normalMatrix;
+	DirectX::XMStoreFloat4x4(&normalMatrix, DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, transformMatrix)));
+
+	// SIMD kernels over the interleaved vertices, split into chunks across cores
+	JobSystem::Get().ParallelFor(vertices.size(), [&](size_t begin, size_t end) {
+		GeometryKernels::TransformPoints({ &vertices[begin].position.x, end - begin, sizeof(Vertex) }, localMatrix);
+		GeometryKernels::TransformNormals({ &vertices[begin].normal.x, end - begin, sizeof(Vertex) }, normalMatrix);
+	}, 16384);
+
+	// Hulls are rebuilt on demand, the rest pose they were made for is gone
+	collisionHulls.clear();
+
+	// Reset transformation after applying
+	position = { 0.0f, 0.0f, 0.0f };
+	rotation = { 0.0f, 0.0f, 0.0f };
+	scale = { 1.0f, 1.0f, 1.0f };
+
+	// Bounds, sub-meshes and meshlets live in model space, which was just rewritten
+	ComputeBoundingBox();
+	SortByMaterial();
+}
+
+// Two stable counting sorts of the faces, by material and then by group, O(faces + groups + materials).
+// Produces one contiguous index range per group and, inside it, one per material,
+// with the matching MeshGroup and SubMesh tables.
 void Model::SortByMaterial() {
-	if (materials.empty()) return;
-
-	// Create new sorted arrays
-	std::vector<Vertex> sortedVertices;
-	std::vector<unsigned int> sortedIndices;
-	std::vector<unsigned int> sortedMaterialIndices;
-
-	// Group indices by material
-	for (unsigned int matIdx = 0; matIdx < materials.size(); ++matIdx) {
-		for (size_t i = 0; i < materialIndices.size(); i += 3) {
-			if (materialIndices[i] == matIdx) {
-				// Add these three indices
-				sortedIndices.push_back(indices[i]);
-				sortedIndices.push_back(indices[i + 1]);
-				sortedIndices.push_back(indices[i + 2]);
-
-				sortedMaterialIndices.push_back(matIdx);
-				sortedMaterialIndices.push_back(matIdx);
-				sortedMaterialIndices.push_back(matIdx);
+	subMeshes.clear();
+	groups.clear();
+	bvh.Clear();
+	occluderIndices.clear();
+	const unsigned int numFaces = GetNumFaces();
+	if (numFaces == 0) return;
+
+	// Faces without a valid material (e.g. before the first usemtl) fall back to material 0,
+	// faces without a group to group 0
+	const unsigned int numMaterials = std::max(1u, static_cast<unsigned int>(materials.size()));
+	const unsigned int numGroups = std::max(1u, static_cast<unsigned int>(groupNames.size()));
+	auto faceMaterial = [&](unsigned int face) {
+		unsigned int m = face < materialIndices.size() ? materialIndices[face] : 0u;
+		return m < numMaterials ? m : 0u;
+	};
+	auto faceGroup = [&](unsigned int face) {
+		unsigned int g = face < groupIndices.size() ? groupIndices[face] : 0u;
+		return g < numGroups ? g : 0u;
+	};
+
+	// Histogram, exclusive prefix sum into the first face of every key, then scatter in order.
+	// order holds the faces as they are visited, the result the faces in their new order.
+	auto countingSort = [numFaces](unsigned int numKeys, const std::vector<unsigned int>& order,
+		std::vector<unsigned int>& result, std::vector<unsigned int>& start, auto key) {
+		start.assign(numKeys + 1, 0);
+		for (unsigned int i = 0; i < numFaces; ++i) {
+			start[key(order[i]) + 1]++;
+		}
+		for (unsigned int k = 0; k < numKeys; ++k) {
+			start[k + 1] += start[k];
+		}
+		std::vector<unsigned int> cursor(start.begin(), start.end() - 1);
+		result.resize(numFaces);
+		for (unsigned int i = 0; i < numFaces; ++i) {
+			result[cursor[key(order[i])]++] = order[i];
+		}
+	};
+	std::vector<unsigned int> faces(numFaces);
+	for (unsigned int face = 0; face < numFaces; ++face) {
+		faces[face] = face;
+	}
+	std::vector<unsigned int> byMaterial;
+	std::vector<unsigned int> groupStart;
+	countingSort(numMaterials, faces, byMaterial, groupStart, faceMaterial);
+	// Stable, so the faces of a group stay sorted by material
+	countingSort(numGroups, byMaterial, faces, groupStart, faceGroup);
+
+	std::vector<unsigned int> sortedIndices(indices.size());
+	std::vector<unsigned int> sortedMaterialIndices(numFaces);
+	std::vector<unsigned int> sortedGroupIndices(numFaces);
+	const bool hasSmoothingGroups = smoothingGroups.size() == numFaces;
+	std::vector<unsigned int> sortedSmoothingGroups(hasSmoothingGroups ? numFaces : 0);
+	for (unsigned int dst = 0; dst < numFaces; ++dst) {
+		const unsigned int face = faces[dst];
+		sortedMaterialIndices[dst] = faceMaterial(face);
+		sortedGroupIndices[dst] = faceGroup(face);
+		if (hasSmoothingGroups) {
+			sortedSmoothingGroups[dst] = smoothingGroups[face];
+		}
+		for (unsigned int k = 0; k < 3; ++k) {
+			sortedIndices[dst * 3 + k] = indices[face * 3 + k];
+		}
+	}
+
+	indices.swap(sortedIndices);
+	materialIndices.swap(sortedMaterialIndices);
+	groupIndices.swap(sortedGroupIndices);
+	if (hasSmoothingGroups) {
+		smoothingGroups.swap(sortedSmoothingGroups);
+	}
+
+	const float big = std::numeric_limits<float>::max();
+	for (unsigned int g = 0; g < numGroups; ++g) {
+		MeshGroup group = {};
+		group.name = g < groupNames.size() ? groupNames[g] : std::string();
+		group.startIndex = groupStart[g] * 3;
+		group.indexCount = groupStart[g + 1] * 3 - group.startIndex;
+		group.firstSubMesh = static_cast<unsigned int>(subMeshes.size());
+		group.bounds.SetBbox(big, -big, big, -big, big, -big);
+
+		// Every run of one material is a sub-mesh, its bounds grow as the run is walked
+		for (unsigned int first = groupStart[g]; first < groupStart[g + 1];) {
+			const unsigned int m = materialIndices[first];
+			BoundingBox bounds;
+			bounds.SetBbox(big, -big, big, -big, big, -big);
+			unsigned int end = first;
+			for (; end < groupStart[g + 1] && materialIndices[end] == m; ++end) {
+				for (unsigned int k = 0; k < 3; ++k) {
+					const DirectX::XMFLOAT3& p = vertices[indices[end * 3 + k]].position;
+					bounds.minX = std::min(bounds.minX, p.x);
+					bounds.maxX = std::max(bounds.maxX, p.x);
+					bounds.minY = std::min(bounds.minY, p.y);
+					bounds.maxY = std::max(bounds.maxY, p.y);
+					bounds.minZ = std::min(bounds.minZ, p.z);
+					bounds.maxZ = std::max(bounds.maxZ, p.z);
+				}
 			}
+			subMeshes.push_back({ first * 3, (end - first) * 3, m, g, bounds });
+			group.bounds.SetBbox(std::min(group.bounds.minX, bounds.minX), std::max(group.bounds.maxX, bounds.maxX),
+				std::min(group.bounds.minZ, bounds.minZ), std::max(group.bounds.maxZ, bounds.maxZ),
+				std::min(group.bounds.minY, bounds.minY), std::max(group.bounds.maxY, bounds.maxY));
+			first = end;
+		}
+		group.subMeshCount = static_cast<unsigned int>(subMeshes.size()) - group.firstSubMesh;
+
+		// Sphere around the box center, the radius is the farthest vertex rather than the box corner
+		group.center = { (group.bounds.minX + group.bounds.maxX) * 0.5f,
+			(group.bounds.minY + group.bounds.maxY) * 0.5f,
+			(group.bounds.minZ + group.bounds.maxZ) * 0.5f };
+		DirectX::XMVECTOR center = DirectX::XMLoadFloat3(&group.center);
+		float radiusSq = 0.0f;
+		for (unsigned int i = group.startIndex; i < group.startIndex + group.indexCount; ++i) {
+			DirectX::XMVECTOR d = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertices[indices[i]].position), center);
+			radiusSq = std::max(radiusSq, DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(d)));
 		}
+		group.radius = sqrtf(radiusSq);
+		groups.push_back(group);
 	}
 
-	indices = sortedIndices;
-	materialIndices = sortedMaterialIndices;
+	BuildMeshlets();
 }
 
 void Model::ComputeBoundingBox() {
-	float minX, minY, minZ, maxX, maxY, maxZ;
+	float minX = 0.0f, minY = 0.0f, minZ = 0.0f, maxX = 0.0f, maxY = 0.0f, maxZ = 0.0f;
 	Model::MinMax(minX, minY, minZ, maxX, maxY, maxZ);
 
-	b.SetBbox(minX, maxX, minZ, maxZ, minY, maxY);
-}
\ No newline at end of file
+	localBounds.SetBbox(minX, maxX, minZ, maxZ, minY, maxY);
+	UpdateWorldTransform();
+}
+void Model::BuildMeshlets(unsigned int maxVertices, unsigned int maxTriangles) {
+	meshlets.clear();
+	if (indices.size() < 3 || maxVertices < 3 || maxTriangles == 0) return;
+
+	// Stamp of the meshlet that last referenced each vertex, so membership is O(1) without a set per meshlet
+	std::vector<unsigned int> vertexStamp(vertices.size(), std::numeric_limits<unsigned int>::max());
+	std::vector<unsigned int> meshletVertices;
+	std::vector<DirectX::XMFLOAT3> faceNormals;
+	meshletVertices.reserve(maxVertices);
+	faceNormals.reserve(maxTriangles);
+
+	const unsigned int numFaces = GetNumFaces();
+	unsigned int faceStart = 0;
+
+	auto faceMaterial = [&](unsigned int face) {
+		return face < materialIndices.size() ? materialIndices[face] : 0u;
+	};
+	auto faceGroup = [&](unsigned int face) {
+		return face < groupIndices.size() ? groupIndices[face] : 0u;
+	};
+
+	auto emitMeshlet = [&](unsigned int faceEnd) {
+		Meshlet m = {};
+		m.startIndex = faceStart * 3;
+		m.indexCount = (faceEnd - faceStart) * 3;
+		m.vertexCount = static_cast<unsigned int>(meshletVertices.size());
+		m.materialIndex = faceMaterial(faceStart);
+
+		// Bounding sphere around the AABB center of the referenced vertices
+		DirectX::XMVECTOR vMin = DirectX::XMLoadFloat3(&vertices[meshletVertices[0]].position);
+		DirectX::XMVECTOR vMax = vMin;
+		for (unsigned int v : meshletVertices) {
+			DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&vertices[v].position);
+			vMin = DirectX::XMVectorMin(vMin, p);
+			vMax = DirectX::XMVectorMax(vMax, p);
+		}
+		DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(vMin, vMax), 0.5f);
+		float radiusSq = 0.0f;
+		for (unsigned int v : meshletVertices) {
+			DirectX::XMVECTOR d = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertices[v].position), center);
+			radiusSq = std::max(radiusSq, DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(d)));
+		}
+		DirectX::XMStoreFloat3(&m.center, center);
+		m.radius = sqrtf(radiusSq);
+
+		// Normal cone from the geometric face normals, degenerate faces are ignored
+		faceNormals.clear();
+		DirectX::XMVECTOR axis = DirectX::XMVectorZero();
+		for (unsigned int face = faceStart; face < faceEnd; ++face) {
+			DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[indices[face * 3]].position);
+			DirectX::XMVECTOR p1 = DirectX::XMLoadFloat3(&vertices[indices[face * 3 + 1]].position);
+			DirectX::XMVECTOR p2 = DirectX::XMLoadFloat3(&vertices[indices[face * 3 + 2]].position);
+			DirectX::XMVECTOR n = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+			if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(n)) <= 0.0f) {
+				faceNormals.push_back({ 0.0f, 0.0f, 0.0f });
+				continue;
+			}
+			n = DirectX::XMVector3Normalize(n);
+			axis = DirectX::XMVectorAdd(axis, n);
+			DirectX::XMFLOAT3 stored;
+			DirectX::XMStoreFloat3(&stored, n);
+			faceNormals.push_back(stored);
+		}
+
+		m.coneApex = m.center;
+		m.coneAxis = { 0.0f, 0.0f, 0.0f };
+		m.coneCutoff = 1.0f;
+		if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(axis)) > 0.0f) {
+			axis = DirectX::XMVector3Normalize(axis);
+			DirectX::XMStoreFloat3(&m.coneAxis, axis);
+
+			float minDot = 1.0f;
+			for (const auto& n : faceNormals) {
+				if (n.x == 0.0f && n.y == 0.0f && n.z == 0.0f) continue;
+				minDot = std::min(minDot, DirectX::XMVectorGetX(DirectX::XMVector3Dot(axis, DirectX::XMLoadFloat3(&n))));
+			}
+
+			// Cones wider than ~84 degrees almost never cull, leave the cutoff disabled
+			if (minDot > 0.1f) {
+				// Move the apex back along the axis until it lies behind every face plane
+				float maxT = 0.0f;
+				for (unsigned int face = faceStart; face < faceEnd; ++face) {
+					const DirectX::XMFLOAT3& n = faceNormals[face - faceStart];
+					if (n.x == 0.0f && n.y == 0.0f && n.z == 0.0f) continue;
+					DirectX::XMVECTOR nv = DirectX::XMLoadFloat3(&n);
+					DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[indices[face * 3]].position);
+					float dc = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVectorSubtract(center, p0), nv));
+					float dn = DirectX::XMVectorGetX(DirectX::XMVector3Dot(axis, nv));
+					maxT = std::max(maxT, dc / dn);
+				}
+				DirectX::XMStoreFloat3(&m.coneApex, DirectX::XMVectorSubtract(center, DirectX::XMVectorScale(axis, maxT)));
+				m.coneCutoff = sqrtf(1.0f - minDot * minDot);
+			}
+		}
+
+		meshlets.push_back(m);
+		meshletVertices.clear();
+		faceStart = faceEnd;
+	};
+
+	for (unsigned int face = 0; face < numFaces; ++face) {
+		unsigned int stamp = static_cast<unsigned int>(meshlets.size());
+		unsigned int newVertices = 0;
+		for (unsigned int k = 0; k < 3; ++k) {
+			if (vertexStamp[indices[face * 3 + k]] != stamp) newVertices++;
+		}
+
+		bool full = meshletVertices.size() + newVertices > maxVertices || face - faceStart >= maxTriangles;
+		bool materialChanged = face > faceStart && faceMaterial(face) != faceMaterial(faceStart);
+		bool groupChanged = face > faceStart && faceGroup(face) != faceGroup(faceStart);
+		if (face > faceStart && (full || materialChanged || groupChanged)) {
+			emitMeshlet(face);
+			stamp = static_cast<unsigned int>(meshlets.size());
+		}
+
+		for (unsigned int k = 0; k < 3; ++k) {
+			unsigned int v = indices[face * 3 + k];
+			if (vertexStamp[v] != stamp) {
+				vertexStamp[v] = stamp;
+				meshletVertices.push_back(v);
+			}
+		}
+	}
+	if (faceStart < numFaces) {
+		emitMeshlet(numFaces);
+	}
+
+	// Meshlets never straddle a group, so every group owns a contiguous meshlet range
+	for (auto& group : groups) {
+		group.firstMeshlet = 0;
+		group.meshletCount = 0;
+	}
+	for (unsigned int i = 0; i < meshlets.size(); ++i) {
+		unsigned int g = faceGroup(meshlets[i].startIndex / 3);
+		if (g >= groups.size()) continue;
+		if (groups[g].meshletCount == 0) groups[g].firstMeshlet = i;
+		groups[g].meshletCount++;
+	}
+}
+
+void Model::BuildOccluder(float alphaCutoff) {
+	occluderIndices.clear();
+	const unsigned char cutoff = static_cast<unsigned char>(std::clamp(alphaCutoff, 0.0f, 1.0f) * 255.0f);
+
+	// True when every texel of the UV rectangle around the face is opaque. Texture coordinates
+	// wrap like the sampler, faces that span the whole texture check all of it.
+	auto isOpaque = [&](const Image& texture, unsigned int face) {
+		const unsigned char* texels = texture.data();
+		const int width = texture.GetWidth(), height = texture.GetHeight();
+		if (texels == nullptr || width <= 0 || height <= 0) return false;
+
+		float minU = FLT_MAX, minV = FLT_MAX, maxU = -FLT_MAX, maxV = -FLT_MAX;
+		for (unsigned int k = 0; k < 3; ++k) {
+			const DirectX::XMFLOAT2& uv = vertices[indices[face * 3 + k]].uv;
+			minU = std::min(minU, uv.x);
+			maxU = std::max(maxU, uv.x);
+			minV = std::min(minV, uv.y);
+			maxV = std::max(maxV, uv.y);
+		}
+		// Texel rectangle, a hair inside so faces on texel boundaries don't pick up the neighbours
+		const int x0 = static_cast<int>(std::floor(minU * width + 0.01f));
+		const int y0 = static_cast<int>(std::floor(minV * height + 0.01f));
+		const int x1 = std::max(x0, static_cast<int>(std::ceil(maxU * width - 0.01f)) - 1);
+		const int y1 = std::max(y0, static_cast<int>(std::ceil(maxV * height - 0.01f)) - 1);
+		const int spanX = std::min(x1 - x0, width - 1), spanY = std::min(y1 - y0, height - 1);
+		for (int dy = 0; dy <= spanY; ++dy) {
+			const int y = ((y0 + dy) % height + height) % height;
+			for (int dx = 0; dx <= spanX; ++dx) {
+				const int x = ((x0 + dx) % width + width) % width;
+				if (texels[(static_cast<size_t>(y) * width + x) * 4 + 3] < cutoff) return false;
+			}
+		}
+		return true;
+	};
+
+	const unsigned int numFaces = GetNumFaces();
+	for (unsigned int face = 0; face < numFaces; ++face) {
+		unsigned int m = face < materialIndices.size() ? materialIndices[face] : 0u;
+		if (m < materials.size() && materials[m].alphaTested && !isOpaque(materials[m].textureImage, face)) continue;
+		occluderIndices.insert(occluderIndices.end(), indices.begin() + face * 3, indices.begin() + face * 3 + 3);
+	}
+}
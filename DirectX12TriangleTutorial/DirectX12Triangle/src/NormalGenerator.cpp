@@ -0,0 +1,264 @@
+#include "NormalGenerator.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <execution>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+// Runs fn(begin, end) over [0, count) in chunks of at least chunkSize spread across cores.
+// Every chunk writes only to data it owns, so no atomics or locks are needed.
+template <typename Fn>
+void ParallelFor(size_t count, size_t chunkSize, Fn&& fn) {
+    JobSystem::Get().ParallelFor(count, fn, chunkSize);
+}
+
+struct PositionKey {
+    std::array<uint32_t, 3> bits;
+    unsigned int vertex;
+
+    bool operator<(const PositionKey& other) const { return bits < other.bits; }
+};
+
+// Assigns the same id to every vertex with a bit identical position, returns the number of ids
+unsigned int WeldPositions(const std::vector<Vertex>& vertices, std::vector<unsigned int>& positionIds) {
+    std::vector<PositionKey> keys(vertices.size());
+    ParallelFor(vertices.size(), 16384, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            // + 0.0f folds -0 into +0 so both weld together
+            const DirectX::XMFLOAT3& p = vertices[v].position;
+            float f[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+            std::memcpy(keys[v].bits.data(), f, sizeof(f));
+            keys[v].vertex = static_cast<unsigned int>(v);
+        }
+    });
+    std::sort(std::execution::par, keys.begin(), keys.end());
+
+    // Point every vertex at the lowest vertex of its run of equal keys
+    positionIds.resize(vertices.size());
+    for (size_t runStart = 0; runStart < keys.size();) {
+        size_t runEnd = runStart + 1;
+        unsigned int first = keys[runStart].vertex;
+        for (; runEnd < keys.size() && keys[runEnd].bits == keys[runStart].bits; ++runEnd) {
+            first = std::min(first, keys[runEnd].vertex);
+        }
+        for (size_t i = runStart; i < runEnd; ++i) {
+            positionIds[keys[i].vertex] = first;
+        }
+        runStart = runEnd;
+    }
+
+    // Number the positions in vertex order rather than sort order, so neighbouring ids
+    // keep the locality of the mesh and the passes below stay cache friendly
+    unsigned int count = 0;
+    for (size_t v = 0; v < positionIds.size(); ++v) {
+        positionIds[v] = positionIds[v] == v ? count++ : positionIds[positionIds[v]];
+    }
+    return count;
+}
+
+unsigned int FindRoot(std::vector<unsigned int>& parent, unsigned int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+}
+
+NormalGeneratorStats GenerateNormals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    const std::vector<unsigned int>& faceSmoothingGroups, const NormalGeneratorOptions& options) {
+    NormalGeneratorStats stats;
+    const size_t numFaces = indices.size() / 3;
+    const size_t numCorners = numFaces * 3;
+    if (numFaces == 0 || vertices.empty()) return stats;
+
+    std::vector<unsigned int> positionIds;
+    const unsigned int numPositions = WeldPositions(vertices, positionIds);
+    stats.uniquePositions = numPositions;
+
+    // Unit face normal in xyz, twice the face area in w
+    std::vector<DirectX::XMFLOAT4> faceNormals(numFaces);
+    ParallelFor(numFaces, 16384, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[indices[f * 3]].position);
+            DirectX::XMVECTOR p1 = DirectX::XMLoadFloat3(&vertices[indices[f * 3 + 1]].position);
+            DirectX::XMVECTOR p2 = DirectX::XMLoadFloat3(&vertices[indices[f * 3 + 2]].position);
+            DirectX::XMVECTOR n = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+            float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(n));
+            DirectX::XMStoreFloat4(&faceNormals[f], length > 0.0f ? DirectX::XMVectorScale(n, 1.0f / length) : DirectX::XMVectorZero());
+            faceNormals[f].w = length;
+        }
+    });
+
+    auto cornerWeight = [&](size_t corner) {
+        size_t face = corner / 3;
+        const DirectX::XMFLOAT4& n = faceNormals[face];
+        float weight = n.w;
+        if (options.weighting == NormalGeneratorOptions::Weighting::Angle) {
+            size_t k = corner % 3;
+            DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&vertices[indices[corner]].position);
+            DirectX::XMVECTOR e1 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertices[indices[face * 3 + (k + 1) % 3]].position), p);
+            DirectX::XMVECTOR e2 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertices[indices[face * 3 + (k + 2) % 3]].position), p);
+            float lengths = sqrtf(DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(e1)) * DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(e2)));
+            float cosAngle = lengths > 0.0f ? DirectX::XMVectorGetX(DirectX::XMVector3Dot(e1, e2)) / lengths : 1.0f;
+            weight = n.w > 0.0f ? acosf(std::clamp(cosAngle, -1.0f, 1.0f)) : 0.0f;
+        }
+        return DirectX::XMVectorScale(DirectX::XMVectorSet(n.x, n.y, n.z, 0.0f), weight);
+    };
+
+    auto storeNormal = [](DirectX::XMVECTOR sum, DirectX::XMFLOAT3& out) {
+        float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(sum));
+        out = length > 0.0f ? DirectX::XMFLOAT3(DirectX::XMVectorGetX(sum) / length, DirectX::XMVectorGetY(sum) / length, DirectX::XMVectorGetZ(sum) / length)
+            : DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+    };
+
+    const bool useGroups = options.useSmoothingGroups && faceSmoothingGroups.size() == numFaces;
+    const bool useCrease = options.creaseAngle < DirectX::XM_PI;
+
+    if (!useGroups && !useCrease) {
+        // Everything sharing a position is smoothed. Each partition of the faces scatters into its
+        // own partial buffer, the buffers are then summed per position.
+        const size_t partitions = std::clamp<size_t>(JobSystem::Get().GetThreadCount(), 1, 8);
+        const size_t facesPerPartition = (numFaces + partitions - 1) / partitions;
+        std::vector<std::vector<DirectX::XMFLOAT3>> partials(partitions);
+        ParallelFor(partitions, 1, [&](size_t begin, size_t end) {
+            for (size_t part = begin; part < end; ++part) {
+                std::vector<DirectX::XMFLOAT3>& sums = partials[part];
+                sums.assign(numPositions, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+                const size_t lastCorner = std::min(numFaces, (part + 1) * facesPerPartition) * 3;
+                for (size_t c = part * facesPerPartition * 3; c < lastCorner; ++c) {
+                    DirectX::XMFLOAT3& sum = sums[positionIds[indices[c]]];
+                    DirectX::XMStoreFloat3(&sum, DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&sum), cornerWeight(c)));
+                }
+            }
+        });
+        ParallelFor(numPositions, 16384, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                DirectX::XMVECTOR sum = DirectX::XMLoadFloat3(&partials[0][p]);
+                for (size_t part = 1; part < partitions; ++part) {
+                    sum = DirectX::XMVectorAdd(sum, DirectX::XMLoadFloat3(&partials[part][p]));
+                }
+                storeNormal(sum, partials[0][p]);
+            }
+        });
+        ParallelFor(vertices.size(), 16384, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                vertices[v].normal = partials[0][positionIds[v]];
+            }
+        });
+        return stats;
+    }
+
+    // Bin the corners by welded position (counting sort). Each bin is then owned by one task,
+    // which makes the accumulation below free of atomics.
+    std::vector<unsigned int> cornerPositions(numCorners);
+    ParallelFor(numCorners, 16384, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            cornerPositions[c] = positionIds[indices[c]];
+        }
+    });
+    std::vector<unsigned int> cornerStart(numPositions + 1, 0);
+    for (size_t c = 0; c < numCorners; ++c) {
+        cornerStart[cornerPositions[c] + 1]++;
+    }
+    for (unsigned int p = 0; p < numPositions; ++p) {
+        cornerStart[p + 1] += cornerStart[p];
+    }
+    std::vector<unsigned int> cornerList(numCorners);
+    {
+        std::vector<unsigned int> cursor(cornerStart.begin(), cornerStart.end() - 1);
+        for (size_t c = 0; c < numCorners; ++c) {
+            cornerList[cursor[cornerPositions[c]]++] = static_cast<unsigned int>(c);
+        }
+    }
+
+    const float cosCrease = cosf(options.creaseAngle);
+    auto smoothTogether = [&](size_t faceA, size_t faceB) {
+        if (useGroups) {
+            unsigned int a = faceSmoothingGroups[faceA];
+            unsigned int b = faceSmoothingGroups[faceB];
+            if (options.smoothingGroupMasks ? (a & b) == 0 : (a == 0 || a != b)) return false;
+        }
+        if (useCrease) {
+            const DirectX::XMFLOAT4& a = faceNormals[faceA];
+            const DirectX::XMFLOAT4& b = faceNormals[faceB];
+            if (a.x * b.x + a.y * b.y + a.z * b.z < cosCrease) return false;
+        }
+        return true;
+    };
+
+    // Cluster the corners around every position into smoothing fans. A cluster is identified by
+    // the cornerList slot of its root, which makes the ids unique across positions.
+    std::vector<unsigned int> cornerCluster(numCorners);
+    std::vector<DirectX::XMFLOAT3> clusterNormals(numCorners);
+    ParallelFor(numPositions, 4096, [&](size_t begin, size_t end) {
+        std::vector<unsigned int> parent;
+        std::vector<DirectX::XMVECTOR> sums;
+        for (size_t p = begin; p < end; ++p) {
+            const unsigned int start = cornerStart[p];
+            const unsigned int count = cornerStart[p + 1] - start;
+            parent.resize(count);
+            std::iota(parent.begin(), parent.end(), 0u);
+
+            // Degenerate faces have no direction to compare, they join the first real cluster
+            unsigned int firstValid = UINT_MAX;
+            for (unsigned int i = 0; i < count; ++i) {
+                size_t faceI = cornerList[start + i] / 3;
+                if (faceNormals[faceI].w <= 0.0f) continue;
+                if (firstValid == UINT_MAX) firstValid = i;
+                for (unsigned int j = 0; j < i; ++j) {
+                    size_t faceJ = cornerList[start + j] / 3;
+                    if (faceNormals[faceJ].w > 0.0f && smoothTogether(faceI, faceJ)) {
+                        parent[FindRoot(parent, i)] = FindRoot(parent, j);
+                    }
+                }
+            }
+            if (firstValid != UINT_MAX) {
+                for (unsigned int i = 0; i < count; ++i) {
+                    if (faceNormals[cornerList[start + i] / 3].w <= 0.0f) parent[i] = FindRoot(parent, firstValid);
+                }
+            }
+
+            sums.assign(count, DirectX::XMVectorZero());
+            for (unsigned int i = 0; i < count; ++i) {
+                unsigned int root = FindRoot(parent, i);
+                sums[root] = DirectX::XMVectorAdd(sums[root], cornerWeight(cornerList[start + i]));
+                cornerCluster[cornerList[start + i]] = start + root;
+            }
+            for (unsigned int i = 0; i < count; ++i) {
+                if (parent[i] == i) storeNormal(sums[i], clusterNormals[start + i]);
+            }
+        }
+    });
+
+    // The first cluster that reaches a vertex keeps it, any other cluster gets a copy
+    std::vector<unsigned int> vertexCluster(vertices.size(), UINT_MAX);
+    std::unordered_map<uint64_t, unsigned int> splits;
+    for (size_t c = 0; c < numCorners; ++c) {
+        unsigned int v = indices[c];
+        unsigned int cluster = cornerCluster[c];
+        if (vertexCluster[v] == UINT_MAX) {
+            vertexCluster[v] = cluster;
+            vertices[v].normal = clusterNormals[cluster];
+        }
+        else if (vertexCluster[v] != cluster) {
+            auto [it, inserted] = splits.try_emplace((static_cast<uint64_t>(v) << 32) | cluster, static_cast<unsigned int>(vertices.size()));
+            if (inserted) {
+                Vertex copy = vertices[v];
+                copy.normal = clusterNormals[cluster];
+                vertices.push_back(copy);
+            }
+            indices[c] = it->second;
+        }
+    }
+    stats.splitVertices = static_cast<unsigned int>(splits.size());
+    return stats;
+}
@@ -0,0 +1,372 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "GeometryKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCCLUSION_CULLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define KERNEL_TARGET(isa)
+#else
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace {
+
+constexpr unsigned int SubtileWidth = 8;
+constexpr unsigned int SubtileHeight = 4;
+
+// Squared distance from a point to a box, 0 inside
+float DistanceSq(const DirectX::XMFLOAT3& p, const BoundingBox& b) {
+    float dx = std::max({ b.minX - p.x, 0.0f, p.x - b.maxX });
+    float dy = std::max({ b.minY - p.y, 0.0f, p.y - b.maxY });
+    float dz = std::max({ b.minZ - p.z, 0.0f, p.z - b.maxZ });
+    return dx * dx + dy * dy + dz * dz;
+}
+
+DirectX::XMFLOAT4 LerpClip(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, float t) {
+    return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+}
+
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height) {
+    SetResolution(width, height);
+}
+
+bool OcclusionCuller::IsSupported() {
+#ifdef OCCLUSION_CULLER_X86
+    return GeometryKernels::GetIsa() >= GeometryKernels::Isa::AVX2;
+#else
+    return false;
+#endif
+}
+
+void OcclusionCuller::SetResolution(unsigned int width, unsigned int height) {
+    tilesX = std::max(1u, (width + TileWidth - 1) / TileWidth);
+    tilesY = std::max(1u, (height + TileHeight - 1) / TileHeight);
+    this->width = tilesX * TileWidth;
+    this->height = tilesY * TileHeight;
+    tiles.assign(static_cast<size_t>(tilesX) * tilesY, Tile());
+    rowBins.assign(tilesY, {});
+}
+
+void OcclusionCuller::BeginFrame(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos) {
+    DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(view, proj));
+    this->cameraPos = cameraPos;
+    occluders.clear();
+    triangles.clear();
+    for (std::vector<unsigned int>& bin : rowBins) {
+        bin.clear();
+    }
+    // Nothing covered, every subtile is as far away as it gets
+    std::fill(tiles.begin(), tiles.end(), Tile());
+    stats = OcclusionCullStats();
+}
+
+void OcclusionCuller::AddOccluder(const Model& model) {
+    if (!model.GetOccluderIndices().empty()) occluders.push_back(&model);
+}
+
+void OcclusionCuller::SetupTriangle(const DirectX::XMFLOAT4& c0, const DirectX::XMFLOAT4& c1, const DirectX::XMFLOAT4& c2) {
+    const DirectX::XMFLOAT4* clip[3] = { &c0, &c1, &c2 };
+    float x[3], y[3], z[3];
+    for (int i = 0; i < 3; ++i) {
+        z[i] = 1.0f / clip[i]->w;
+        x[i] = (clip[i]->x * z[i] * 0.5f + 0.5f) * static_cast<float>(width);
+        y[i] = (0.5f - clip[i]->y * z[i] * 0.5f) * static_cast<float>(height);
+    }
+
+    // Clockwise on screen is the front face, the same as the pipeline's rasterizer state
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.0f)) return;
+
+    // Pixels whose centers can be inside
+    int pixelMinX = std::max(0, static_cast<int>(std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f)));
+    int pixelMaxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f)));
+    int pixelMinY = std::max(0, static_cast<int>(std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f)));
+    int pixelMaxY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f)));
+    if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) return;
+
+    ScreenTriangle t;
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        // E(x, y) = a * x + b * y + c, positive inside for a clockwise triangle
+        float a = y[i] - y[j];
+        float b = x[j] - x[i];
+        float c = -(a * x[i] + b * y[i]);
+        if (std::abs(a) < 1e-12f) {
+            t.side[i] = EdgeHorizontal;
+            t.k[i] = b;
+            t.m[i] = c;
+        }
+        else {
+            t.side[i] = a > 0.0f ? EdgeLeft : EdgeRight;
+            t.k[i] = -b / a;
+            t.m[i] = -c / a;
+        }
+    }
+
+    t.zx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    t.zy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    t.z0 = z[0] - t.zx * x[0] - t.zy * y[0];
+    t.zFarthest = std::min({ z[0], z[1], z[2] });
+
+    t.tileMinX = pixelMinX / static_cast<int>(TileWidth);
+    t.tileMaxX = pixelMaxX / static_cast<int>(TileWidth);
+    t.tileMinY = pixelMinY / static_cast<int>(TileHeight);
+    t.tileMaxY = pixelMaxY / static_cast<int>(TileHeight);
+
+    const unsigned int index = static_cast<unsigned int>(triangles.size());
+    triangles.push_back(t);
+    for (int row = t.tileMinY; row <= t.tileMaxY; ++row) {
+        rowBins[row].push_back(index);
+    }
+}
+
+void OcclusionCuller::ClipAndSetup(const DirectX::XMFLOAT4& c0, const DirectX::XMFLOAT4& c1, const DirectX::XMFLOAT4& c2) {
+    // Entirely outside one of the side planes
+    if ((c0.x > c0.w && c1.x > c1.w && c2.x > c2.w) || (c0.x < -c0.w && c1.x < -c1.w && c2.x < -c2.w) ||
+        (c0.y > c0.w && c1.y > c1.w && c2.y > c2.w) || (c0.y < -c0.w && c1.y < -c1.w && c2.y < -c2.w)) {
+        return;
+    }
+
+    // Only the near plane (z = 0) is clipped, the rest is left to the screen bounds
+    const DirectX::XMFLOAT4 in[3] = { c0, c1, c2 };
+    int behind = (c0.z < 0.0f) + (c1.z < 0.0f) + (c2.z < 0.0f);
+    if (behind == 3) return;
+    if (behind == 0) {
+        SetupTriangle(c0, c1, c2);
+        return;
+    }
+
+    DirectX::XMFLOAT4 polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const DirectX::XMFLOAT4& a = in[i];
+        const DirectX::XMFLOAT4& b = in[(i + 1) % 3];
+        if (a.z >= 0.0f) polygon[count++] = a;
+        if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+            polygon[count++] = LerpClip(a, b, a.z / (a.z - b.z));
+        }
+    }
+    for (int i = 1; i + 1 < count; ++i) {
+        SetupTriangle(polygon[0], polygon[i], polygon[i + 1]);
+    }
+}
+
+void OcclusionCuller::Rasterize() {
+    // Nearest first, they cover the most screen and make later triangles fail the depth test
+    std::sort(occluders.begin(), occluders.end(), [&](const Model* a, const Model* b) {
+        return DistanceSq(cameraPos, a->b) < DistanceSq(cameraPos, b->b);
+    });
+    if (occluders.size() > maxOccluders) occluders.resize(maxOccluders);
+    stats.occluders = static_cast<unsigned int>(occluders.size());
+    if (!IsSupported()) return;
+
+    const DirectX::XMMATRIX toClipBase = DirectX::XMLoadFloat4x4(&viewProj);
+    for (const Model* model : occluders) {
+        const std::vector<Vertex>& vertices = model->GetVertices();
+        const std::vector<unsigned int>& indices = model->GetOccluderIndices();
+        const DirectX::XMMATRIX toClip = DirectX::XMMatrixMultiply(model->GetModelMatrix(), toClipBase);
+
+        clipVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            DirectX::XMStoreFloat4(&clipVertices[i], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&vertices[i].position), toClip));
+        }
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            ClipAndSetup(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]]);
+        }
+    }
+    stats.triangles = static_cast<unsigned int>(triangles.size());
+
+    // Every tile row only writes its own tiles
+    JobSystem::Get().ParallelFor(tilesY, [&](size_t begin, size_t end) {
+        for (unsigned int row = static_cast<unsigned int>(begin); row < end; ++row) {
+            if (!rowBins[row].empty()) RasterizeTileRow(row);
+        }
+    });
+}
+
+bool OcclusionCuller::ProjectBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, float rect[4], float& zNearest) const {
+    const DirectX::XMMATRIX toClip = DirectX::XMLoadFloat4x4(&viewProj);
+    rect[0] = rect[1] = FLT_MAX;
+    rect[2] = rect[3] = -FLT_MAX;
+    zNearest = 0.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        DirectX::XMVECTOR p = DirectX::XMVectorSet(
+            corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z, 1.0f);
+        DirectX::XMFLOAT4 clip;
+        DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(p, toClip));
+        // Crossing the near plane, the box can cover anything
+        if (clip.z < 0.0f) return false;
+        float z = 1.0f / clip.w;
+        float x = (clip.x * z * 0.5f + 0.5f) * static_cast<float>(width);
+        float y = (0.5f - clip.y * z * 0.5f) * static_cast<float>(height);
+        rect[0] = std::min(rect[0], x);
+        rect[1] = std::min(rect[1], y);
+        rect[2] = std::max(rect[2], x);
+        rect[3] = std::max(rect[3], y);
+        zNearest = std::max(zNearest, z);
+    }
+    return true;
+}
+
+bool OcclusionCuller::IsOccluded(const BoundingBox& box) const {
+    float rect[4], zNearest;
+    if (!ProjectBox({ box.minX, box.minY, box.minZ }, { box.maxX, box.maxY, box.maxZ }, rect, zNearest)) return false;
+    return IsRectOccluded(rect, zNearest);
+}
+
+bool OcclusionCuller::IsOccluded(const DirectX::XMFLOAT3& center, float radius) const {
+    float rect[4], zNearest;
+    if (!ProjectBox({ center.x - radius, center.y - radius, center.z - radius },
+        { center.x + radius, center.y + radius, center.z + radius }, rect, zNearest)) {
+        return false;
+    }
+    return IsRectOccluded(rect, zNearest);
+}
+
+void OcclusionCuller::Cull(const std::vector<Model*>& models, std::vector<unsigned int>& visible) {
+    stats.tested += static_cast<unsigned int>(visible.size());
+    if (stats.triangles == 0) return;
+    auto hidden = std::remove_if(visible.begin(), visible.end(), [&](unsigned int index) {
+        return IsOccluded(models[index]->b);
+    });
+    stats.occluded += static_cast<unsigned int>(visible.end() - hidden);
+    visible.erase(hidden, visible.end());
+}
+
+#ifdef OCCLUSION_CULLER_X86
+
+// One lane per subtile: columns 0, 8, 16, 24 of the upper and then the lower half of the tile
+KERNEL_TARGET("avx2,fma") void OcclusionCuller::RasterizeTileRow(unsigned int row) {
+    const __m256 laneX = _mm256_setr_ps(0.0f, 8.0f, 16.0f, 24.0f, 0.0f, 8.0f, 16.0f, 24.0f);
+    const __m256 laneY = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 4.0f, 4.0f, 4.0f, 4.0f);
+    const __m256 subtileTop = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(row * TileHeight)), laneY);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i zeroI = _mm256_setzero_si256();
+    const __m256i eight = _mm256_set1_epi32(static_cast<int>(SubtileWidth));
+    const __m256 lowest = _mm256_set1_ps(-1.0f), highest = _mm256_set1_ps(static_cast<float>(SubtileWidth) + 1.0f);
+
+    for (unsigned int index : rowBins[row]) {
+        const ScreenTriangle& t = triangles[index];
+
+        for (int tileX = t.tileMinX; tileX <= t.tileMaxX; ++tileX) {
+            const __m256 subtileLeft = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(tileX * TileWidth)), laneX);
+            // Pixel centers relative to the subtile are 0.5 .. 7.5
+            const __m256 spanOrigin = _mm256_add_ps(subtileLeft, _mm256_set1_ps(0.5f));
+
+            __m256i coverage = zeroI;
+            for (unsigned int r = 0; r < SubtileHeight; ++r) {
+                const __m256 y = _mm256_add_ps(subtileTop, _mm256_set1_ps(static_cast<float>(r) + 0.5f));
+                __m256 left = _mm256_set1_ps(-FLT_MAX), right = _mm256_set1_ps(FLT_MAX);
+                __m256 empty = _mm256_setzero_ps();
+                for (int e = 0; e < 3; ++e) {
+                    __m256 bound = _mm256_fmadd_ps(_mm256_set1_ps(t.k[e]), y, _mm256_set1_ps(t.m[e]));
+                    // NaN bounds from near horizontal edges keep the previous limit
+                    switch (t.side[e]) {
+                    case EdgeLeft: left = _mm256_max_ps(bound, left); break;
+                    case EdgeRight: right = _mm256_min_ps(bound, right); break;
+                    default: empty = _mm256_or_ps(empty, _mm256_cmp_ps(bound, _mm256_setzero_ps(), _CMP_LT_OQ)); break;
+                    }
+                }
+                // Covered pixels i of the row are start <= i < end
+                __m256 first = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(left, spanOrigin), lowest), highest);
+                __m256 last = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(right, spanOrigin), lowest), highest);
+                __m256i start = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_ceil_ps(first)), zeroI);
+                __m256i end = _mm256_min_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(last)), one), eight);
+                __m256i bits = _mm256_andnot_si256(_mm256_sub_epi32(_mm256_sllv_epi32(one, start), one),
+                    _mm256_sub_epi32(_mm256_sllv_epi32(one, end), one));
+                bits = _mm256_andnot_si256(_mm256_castps_si256(empty), bits);
+                coverage = _mm256_or_si256(coverage, _mm256_sll_epi32(bits, _mm_cvtsi32_si128(static_cast<int>(r * SubtileWidth))));
+            }
+            const __m256i covered = _mm256_xor_si256(_mm256_cmpeq_epi32(coverage, zeroI), _mm256_set1_epi32(-1));
+            if (_mm256_testz_si256(covered, covered)) continue;
+
+            // Farthest depth of the triangle within each subtile: the plane at the farthest
+            // subtile corner, but never beyond the farthest triangle corner
+            __m256 cornerX = t.zx < 0.0f ? _mm256_add_ps(subtileLeft, _mm256_set1_ps(static_cast<float>(SubtileWidth))) : subtileLeft;
+            __m256 cornerY = t.zy < 0.0f ? _mm256_add_ps(subtileTop, _mm256_set1_ps(static_cast<float>(SubtileHeight))) : subtileTop;
+            __m256 zTri = _mm256_fmadd_ps(_mm256_set1_ps(t.zx), cornerX, _mm256_fmadd_ps(_mm256_set1_ps(t.zy), cornerY, _mm256_set1_ps(t.z0)));
+            zTri = _mm256_max_ps(zTri, _mm256_set1_ps(t.zFarthest));
+
+            Tile& tile = tiles[static_cast<size_t>(row) * tilesX + tileX];
+            __m256 zMin0 = _mm256_loadu_ps(tile.zMin[0]);
+            __m256 zMin1 = _mm256_loadu_ps(tile.zMin[1]);
+            __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tile.mask));
+
+            // Only what is in front of the reference layer adds anything
+            __m256 accept = _mm256_and_ps(_mm256_castsi256_ps(covered), _mm256_cmp_ps(zTri, zMin0, _CMP_GT_OQ));
+            if (_mm256_testz_ps(accept, accept)) continue;
+
+            // The working layer is replaced when it is empty or when the triangle is farther behind
+            // it than the reference layer is, otherwise both merge at the farther of their depths
+            __m256 dist1t = _mm256_sub_ps(zMin1, zTri);
+            __m256 dist01 = _mm256_sub_ps(zMin1, zMin0);
+            __m256 reset = _mm256_or_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(mask, zeroI)), _mm256_cmp_ps(dist1t, dist01, _CMP_GT_OQ));
+            __m256i newMask = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_or_si256(mask, coverage)), _mm256_castsi256_ps(coverage), reset));
+            __m256 newZ1 = _mm256_blendv_ps(_mm256_min_ps(zMin1, zTri), zTri, reset);
+
+            // A fully covered working layer becomes the new reference
+            __m256 full = _mm256_castsi256_ps(_mm256_cmpeq_epi32(newMask, _mm256_set1_epi32(-1)));
+            __m256 newZ0 = _mm256_blendv_ps(zMin0, newZ1, full);
+            newMask = _mm256_andnot_si256(_mm256_castps_si256(full), newMask);
+            newZ1 = _mm256_andnot_ps(full, newZ1);
+
+            _mm256_storeu_ps(tile.zMin[0], _mm256_blendv_ps(zMin0, newZ0, accept));
+            _mm256_storeu_ps(tile.zMin[1], _mm256_blendv_ps(zMin1, newZ1, accept));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(tile.mask),
+                _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(mask), _mm256_castsi256_ps(newMask), accept)));
+        }
+    }
+}
+
+KERNEL_TARGET("avx2,fma") bool OcclusionCuller::IsRectOccluded(const float rect[4], float zNearest) const {
+    if (stats.triangles == 0 || !IsSupported()) return false;
+
+    // Every pixel the rectangle touches, [x0, x1) x [y0, y1)
+    const float w = static_cast<float>(width), h = static_cast<float>(height);
+    const int x0 = static_cast<int>(std::clamp(std::floor(rect[0]), 0.0f, w));
+    const int y0 = static_cast<int>(std::clamp(std::floor(rect[1]), 0.0f, h));
+    const int x1 = static_cast<int>(std::clamp(std::ceil(rect[2]), 0.0f, w));
+    const int y1 = static_cast<int>(std::clamp(std::ceil(rect[3]), 0.0f, h));
+    if (x0 >= x1 || y0 >= y1) return false;
+
+    const __m256i laneX = _mm256_setr_epi32(0, 8, 16, 24, 0, 8, 16, 24);
+    const __m256i laneY = _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4);
+    const __m256i rectX0 = _mm256_set1_epi32(x0 - static_cast<int>(SubtileWidth)), rectX1 = _mm256_set1_epi32(x1);
+    const __m256i rectY0 = _mm256_set1_epi32(y0 - static_cast<int>(SubtileHeight)), rectY1 = _mm256_set1_epi32(y1);
+    const __m256 z = _mm256_set1_ps(zNearest);
+
+    for (int tileY = y0 / static_cast<int>(TileHeight); tileY <= (y1 - 1) / static_cast<int>(TileHeight); ++tileY) {
+        const __m256i subtileY = _mm256_add_epi32(_mm256_set1_epi32(tileY * static_cast<int>(TileHeight)), laneY);
+        const __m256i inY = _mm256_and_si256(_mm256_cmpgt_epi32(subtileY, rectY0), _mm256_cmpgt_epi32(rectY1, subtileY));
+        for (int tileX = x0 / static_cast<int>(TileWidth); tileX <= (x1 - 1) / static_cast<int>(TileWidth); ++tileX) {
+            const __m256i subtileX = _mm256_add_epi32(_mm256_set1_epi32(tileX * static_cast<int>(TileWidth)), laneX);
+            const __m256i inX = _mm256_and_si256(_mm256_cmpgt_epi32(subtileX, rectX0), _mm256_cmpgt_epi32(rectX1, subtileX));
+            const __m256 overlap = _mm256_castsi256_ps(_mm256_and_si256(inX, inY));
+
+            // Visible as soon as the box is not behind the reference depth of one subtile
+            const Tile& tile = tiles[static_cast<size_t>(tileY) * tilesX + tileX];
+            __m256 visible = _mm256_and_ps(overlap, _mm256_cmp_ps(z, _mm256_loadu_ps(tile.zMin[0]), _CMP_GE_OQ));
+            if (!_mm256_testz_ps(visible, visible)) return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+void OcclusionCuller::RasterizeTileRow(unsigned int) {
+}
+
+bool OcclusionCuller::IsRectOccluded(const float*, float) const {
+    return false;
+}
+
+#endif
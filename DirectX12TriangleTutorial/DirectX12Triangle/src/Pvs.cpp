@@ -0,0 +1,277 @@
+#include "Pvs.h"
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+#include "Culling.h"
+#include "GeometryKernels.h"
+#include "File.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <bit>
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t PvsCacheMagic = 0x20535650; // "PVS "
+constexpr uint32_t PvsCacheVersion = 1;
+
+// Cube map faces, view direction and up
+const DirectX::XMFLOAT3 FaceDirections[6][2] = {
+    { {  1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f } },
+    { { -1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f } },
+    { {  0.0f,  1.0f,  0.0f }, { 0.0f, 0.0f, -1.0f } },
+    { {  0.0f, -1.0f,  0.0f }, { 0.0f, 0.0f,  1.0f } },
+    { {  0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f,  0.0f } },
+    { {  0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f,  0.0f } },
+};
+
+// Evenly spread over [from, to], both ends included, the middle for a single sample
+float SamplePosition(float from, float to, unsigned int sample, unsigned int samples) {
+    if (samples <= 1) return 0.5f * (from + to);
+    return from + (to - from) * static_cast<float>(sample) / static_cast<float>(samples - 1);
+}
+
+}
+
+PvsStats PotentiallyVisibleSet::Build(const std::vector<Model*>& models, float minX, float minZ, float maxX, float maxZ,
+    const std::string& cacheName, const PvsOptions& options)
+{
+    Clear();
+    this->minX = std::min(minX, maxX);
+    this->minZ = std::min(minZ, maxZ);
+    cellSize = std::max(options.cellSize, 1e-3f);
+    cellsX = std::max(1, static_cast<int>(std::ceil((std::max(minX, maxX) - this->minX) / cellSize)));
+    cellsZ = std::max(1, static_cast<int>(std::ceil((std::max(minZ, maxZ) - this->minZ) / cellSize)));
+    objectCount = static_cast<unsigned int>(models.size());
+    wordsPerRow = (objectCount + 63) / 64;
+    for (unsigned int i = 0; i < objectCount; ++i) {
+        if (models[i]) models[i]->pvsIndex = i;
+    }
+
+    // FNV-1a over the layout and the options, a moved tree or another seed bakes again
+    uint64_t key = 0xCBF29CE484222325ull;
+    auto hashBytes = [&key](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) key = (key ^ bytes[i]) * 0x100000001B3ull;
+    };
+    for (const Model* model : models) {
+        const float bounds[] = { model ? model->b.minX : 0.0f, model ? model->b.maxX : 0.0f, model ? model->b.minY : 0.0f,
+            model ? model->b.maxY : 0.0f, model ? model->b.minZ : 0.0f, model ? model->b.maxZ : 0.0f,
+            model ? static_cast<float>(model->GetOccluderIndices().size()) : 0.0f };
+        hashBytes(bounds, sizeof(bounds));
+    }
+    const float layout[] = { this->minX, this->minZ, cellSize, static_cast<float>(cellsX), static_cast<float>(cellsZ),
+        static_cast<float>(options.samplesPerAxis), options.minEyeY, options.maxEyeY,
+        static_cast<float>(options.heightSamples), static_cast<float>(options.resolution) };
+    hashBytes(layout, sizeof(layout));
+
+    std::filesystem::path cachePath;
+    if (!cacheName.empty()) {
+        cachePath = std::filesystem::path(GetExecutablePath()) / "cache" / cacheName;
+        if (Load(cachePath.string(), key)) {
+            PvsStats stats = GetStats();
+            stats.loadedFromCache = true;
+            return stats;
+        }
+    }
+
+    // Without the rasterizer nothing would be hidden, an empty set rejects nothing either
+    if (!OcclusionCuller::IsSupported()) {
+        Clear();
+        for (Model* model : models) {
+            if (model) model->pvsIndex = NoIndex;
+        }
+        return PvsStats();
+    }
+
+    Bake(models, options);
+
+    if (!cachePath.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(cachePath.parent_path(), error);
+        if (!Save(cachePath.string(), key)) {
+            std::cerr << "Failed to write PVS cache: " << cachePath.string() << std::endl;
+        }
+    }
+    return GetStats();
+}
+
+void PotentiallyVisibleSet::Bake(const std::vector<Model*>& models, const PvsOptions& options)
+{
+    // An object is seen from the eye positions between the samples through gaps about as wide as
+    // the spacing, padding its box by half of it catches those
+    const unsigned int samples = std::max(1u, options.samplesPerAxis);
+    const unsigned int heightSamples = std::max(1u, options.heightSamples);
+    const float spacing = samples > 1 ? cellSize / static_cast<float>(samples - 1) : cellSize;
+    const float padding = 0.5f * spacing;
+
+    std::vector<float> boxMinX(objectCount), boxMinY(objectCount), boxMinZ(objectCount);
+    std::vector<float> boxMaxX(objectCount), boxMaxY(objectCount), boxMaxZ(objectCount);
+    std::vector<BoundingBox> padded(objectCount);
+    std::vector<const Model*> occluders;
+    BoundingBox world;
+    world.SetBbox(minX, minX + cellsX * cellSize, minZ, minZ + cellsZ * cellSize, options.minEyeY, options.maxEyeY);
+    for (unsigned int i = 0; i < objectCount; ++i) {
+        if (models[i]) {
+            const BoundingBox& b = models[i]->b;
+            padded[i].SetBbox(b.minX - padding, b.maxX + padding, b.minZ - padding, b.maxZ + padding, b.minY - padding, b.maxY + padding);
+            world.SetBbox(std::min(world.minX, b.minX), std::max(world.maxX, b.maxX), std::min(world.minZ, b.minZ),
+                std::max(world.maxZ, b.maxZ), std::min(world.minY, b.minY), std::max(world.maxY, b.maxY));
+            if (!models[i]->GetOccluderIndices().empty()) occluders.push_back(models[i]);
+        }
+        boxMinX[i] = padded[i].minX; boxMaxX[i] = padded[i].maxX;
+        boxMinY[i] = padded[i].minY; boxMaxY[i] = padded[i].maxY;
+        boxMinZ[i] = padded[i].minZ; boxMaxZ[i] = padded[i].maxZ;
+    }
+    const BoxSoA boxes = { boxMinX.data(), boxMinY.data(), boxMinZ.data(), boxMaxX.data(), boxMaxY.data(), boxMaxZ.data(), objectCount };
+    // Far enough that everything fits in every face
+    const float dx = world.maxX - world.minX, dy = world.maxY - world.minY, dz = world.maxZ - world.minZ;
+    const float farZ = 2.0f * sqrtf(dx * dx + dy * dy + dz * dz) + 1.0f;
+    const DirectX::XMMATRIX proj = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1.0f, 0.1f, farZ);
+
+    const size_t cellCount = static_cast<size_t>(cellsX) * cellsZ;
+    std::vector<uint64_t> cellBits(cellCount * wordsPerRow, 0);
+    JobSystem::Get().ParallelFor(cellCount, [&](size_t begin, size_t end) {
+        for (unsigned int cell = static_cast<unsigned int>(begin); cell < end; ++cell) {
+            uint64_t* bits = cellBits.data() + static_cast<size_t>(cell) * wordsPerRow;
+            unsigned int seen = 0;
+            auto markSeen = [&](unsigned int object) {
+                uint64_t bit = 1ull << (object & 63);
+                if (bits[object >> 6] & bit) return;
+                bits[object >> 6] |= bit;
+                ++seen;
+            };
+
+            OcclusionCuller culler(options.resolution, options.resolution);
+            culler.maxOccluders = static_cast<unsigned int>(occluders.size());
+            std::vector<unsigned int> inFrustum(objectCount);
+            const float cellX = minX + static_cast<float>(cell % cellsX) * cellSize;
+            const float cellZ = minZ + static_cast<float>(cell / cellsX) * cellSize;
+
+            for (unsigned int sample = 0; sample < samples * samples * heightSamples && seen < objectCount; ++sample) {
+                const DirectX::XMFLOAT3 eye = {
+                    SamplePosition(cellX, cellX + cellSize, sample % samples, samples),
+                    SamplePosition(options.minEyeY, options.maxEyeY, sample / (samples * samples), heightSamples),
+                    SamplePosition(cellZ, cellZ + cellSize, (sample / samples) % samples, samples) };
+
+                for (int face = 0; face < 6 && seen < objectCount; ++face) {
+                    const DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(DirectX::XMLoadFloat3(&eye),
+                        DirectX::XMLoadFloat3(&FaceDirections[face][0]), DirectX::XMLoadFloat3(&FaceDirections[face][1]));
+                    Frustum frustum;
+                    frustum.ExtractPlanes(DirectX::XMMatrixMultiply(view, proj));
+                    size_t count = GeometryKernels::CullBoxes(boxes, frustum.planes, Frustum::Count, inFrustum.data());
+
+                    culler.BeginFrame(view, proj, eye);
+                    for (const Model* occluder : occluders) {
+                        culler.AddOccluder(*occluder);
+                    }
+                    culler.Rasterize();
+                    for (size_t i = 0; i < count; ++i) {
+                        const unsigned int object = inFrustum[i];
+                        if (models[object] && !(bits[object >> 6] & (1ull << (object & 63))) && !culler.IsOccluded(padded[object])) {
+                            markSeen(object);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // Neighbouring cells mostly see the same objects, every distinct bitset is kept once
+    std::map<std::vector<uint64_t>, uint32_t> unique;
+    cellRows.resize(cellCount);
+    std::vector<uint64_t> row(wordsPerRow);
+    for (size_t cell = 0; cell < cellCount; ++cell) {
+        std::copy_n(cellBits.begin() + cell * wordsPerRow, wordsPerRow, row.begin());
+        auto inserted = unique.emplace(row, static_cast<uint32_t>(unique.size()));
+        if (inserted.second) rows.insert(rows.end(), row.begin(), row.end());
+        cellRows[cell] = inserted.first->second;
+    }
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+    cellsX = cellsZ = 0;
+    objectCount = wordsPerRow = 0;
+    rows.clear();
+    cellRows.clear();
+}
+
+int PotentiallyVisibleSet::GetCell(const DirectX::XMFLOAT3& p) const
+{
+    if (cellRows.empty()) return -1;
+    const float x = std::floor((p.x - minX) / cellSize);
+    const float z = std::floor((p.z - minZ) / cellSize);
+    if (!(x >= 0.0f && x < static_cast<float>(cellsX) && z >= 0.0f && z < static_cast<float>(cellsZ))) return -1;
+    return static_cast<int>(z) * cellsX + static_cast<int>(x);
+}
+
+bool PotentiallyVisibleSet::IsVisible(int cell, unsigned int pvsIndex) const
+{
+    if (cell < 0 || static_cast<size_t>(cell) >= cellRows.size() || pvsIndex >= objectCount) return true;
+    const uint64_t word = rows[static_cast<size_t>(cellRows[cell]) * wordsPerRow + (pvsIndex >> 6)];
+    return (word >> (pvsIndex & 63)) & 1;
+}
+
+PvsStats PotentiallyVisibleSet::GetStats() const
+{
+    PvsStats stats;
+    stats.cells = static_cast<unsigned int>(cellRows.size());
+    stats.objects = objectCount;
+    stats.uniqueRows = wordsPerRow > 0 ? static_cast<unsigned int>(rows.size() / wordsPerRow) : 0;
+    size_t visible = 0;
+    for (uint32_t row : cellRows) {
+        for (unsigned int w = 0; w < wordsPerRow; ++w) {
+            visible += std::popcount(rows[static_cast<size_t>(row) * wordsPerRow + w]);
+        }
+    }
+    stats.averageVisible = stats.cells > 0 ? static_cast<float>(visible) / static_cast<float>(stats.cells) : 0.0f;
+    return stats;
+}
+
+bool PotentiallyVisibleSet::Save(const std::string& path, uint64_t key) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    // The grid itself is part of the key, only the bitsets are stored
+    uint32_t header[2] = { PvsCacheMagic, PvsCacheVersion };
+    uint32_t counts[3] = { objectCount, static_cast<uint32_t>(rows.size()), static_cast<uint32_t>(cellRows.size()) };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    file.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(cellRows.data()), cellRows.size() * sizeof(uint32_t));
+    return file.good();
+}
+
+bool PotentiallyVisibleSet::Load(const std::string& path, uint64_t key)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    uint32_t header[2] = {};
+    uint64_t fileKey = 0;
+    uint32_t counts[3] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+    file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+    if (!file || header[0] != PvsCacheMagic || header[1] != PvsCacheVersion || fileKey != key) return false;
+    const size_t cellCount = static_cast<size_t>(cellsX) * cellsZ;
+    if (counts[0] != objectCount || counts[2] != cellCount || wordsPerRow == 0 || counts[1] % wordsPerRow != 0) return false;
+
+    std::vector<uint64_t> loadedRows(counts[1]);
+    std::vector<uint32_t> loadedCells(counts[2]);
+    file.read(reinterpret_cast<char*>(loadedRows.data()), loadedRows.size() * sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(loadedCells.data()), loadedCells.size() * sizeof(uint32_t));
+    if (!file) return false;
+    const uint32_t rowCount = counts[1] / wordsPerRow;
+    for (uint32_t row : loadedCells) {
+        if (row >= rowCount) return false;
+    }
+    rows.swap(loadedRows);
+    cellRows.swap(loadedCells);
+    return true;
+}
@@ -1,16 +1,44 @@
 #include "Renderer.h"
 //#include "ShaderCompiler.h"
 #include <stdexcept>
+#include <algorithm>
 #include <iostream>  // for debug output
 #include "directx/d3dx12.h"
 #include "File.h"
 
+namespace {
+    D3D12_HEAP_PROPERTIES HeapProperties(D3D12_HEAP_TYPE type) {
+        D3D12_HEAP_PROPERTIES heap_properties = {};
+        heap_properties.Type = type;
+        heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        heap_properties.CreationNodeMask = 1;
+        heap_properties.VisibleNodeMask = 1;
+        return heap_properties;
+    }
+
+    D3D12_RESOURCE_DESC BufferDesc(UINT64 width) {
+        D3D12_RESOURCE_DESC desc = {};
+        desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        desc.Alignment = 0;
+        desc.Width = width;
+        desc.Height = 1;
+        desc.DepthOrArraySize = 1;
+        desc.MipLevels = 1;
+        desc.Format = DXGI_FORMAT_UNKNOWN;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        return desc;
+    }
+}
+
 Renderer::Renderer(HWND hwnd, int width, int height)
     : hwnd(hwnd), width(width), height(height), 
       fence_event(nullptr), fence_value(0), frameIndex(0),
       rtvDescriptorSize(0), constantBuffer(nullptr), materialBuffer(nullptr),
-      mappedCB(nullptr), mappedMat(nullptr) {
-    this->models = std::vector<Model*>();
+      mappedCB(nullptr), mappedMat(nullptr), gpuScene(*this) {
     this->c = Camera();
     
     // Initialize arrays
@@ -29,8 +57,11 @@ Renderer::~Renderer() {}
 void Renderer::Init() {
     InitD3D();
     CreatePipeline();
-    CreateAssets();
-    CreateTextureResources();
+
+    // Meshes get their buffers and texture views through ApplyChanges
+    srvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    GrowTextureHeap(256);
+    CreateDefaultTexture();
     
     // Initialize viewport and scissor rect
     viewport.TopLeftX = 0;
@@ -44,15 +75,33 @@ void Renderer::Init() {
     scissorRect.top = 0;
     scissorRect.right = static_cast<LONG>(width);
     scissorRect.bottom = static_cast<LONG>(height);
+
+    // Coarse depth buffer 256 pixels wide with the window's aspect ratio. Meshlets of the models
+    // that pass are tested against it too.
+    occlusionCuller.SetResolution(256, width > 0 ? 256 * height / width : 256);
+    clusterCuller.occlusionTest = [this](const DirectX::XMFLOAT3& center, float radius) {
+        return occlusionCuller.IsOccluded(center, radius);
+    };
 }
 
 void Renderer::UpdateTextures() {
 	std::string flagPath = GetAssetPath("UpdateTexture.txt");
-    if (std::filesystem::exists(flagPath)) {
-        for (auto& model : models) {
-            model->UpdateTextures();
+    if (entities && std::filesystem::exists(flagPath)) {
+        // Render waited for the last frame, the old textures can go right away. Every mesh is
+        // reloaded once, however many entities draw it.
+        const std::vector<Model*>& models = entities->GetModels();
+        const std::vector<EntityHandle>& handles = entities->GetHandles();
+        std::vector<bool> reloaded(gpuMeshes.size(), false);
+        SceneUploadStats stats; // reloads are not part of the upload stats
+        for (size_t i = 0; i < models.size(); ++i) {
+            const uint32_t slot = gpuScene.GetMesh(handles[i]);
+            if (slot == GpuScene::NoMesh || reloaded[slot]) continue;
+            reloaded[slot] = true;
+            models[i]->UpdateTextures();
+            ReleaseMeshTextures(gpuMeshes[slot]);
+            CreateMeshTextures(gpuMeshes[slot], models[i]->GetMesh(), stats);
+            QueueUpload(slot);
         }
-        CreateTextureResources();
 		std::filesystem::remove(flagPath);
     }
 }
@@ -319,33 +368,22 @@ void Renderer::CreateRootSignature()
 // gotta alloc space & bind
 void Renderer::CreateConstBuffer()
 {
+    EnsureInstanceCapacity(0);
+
     D3D12_HEAP_PROPERTIES heapProps = {};
     heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
 
     D3D12_RESOURCE_DESC bufferDesc = {};
     bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufferDesc.Width = (sizeof(MVPConstants) + 255) & ~255; // must be 256-byte aligned
+    bufferDesc.Width = (sizeof(MaterialConstants) + 255) & ~255; // must be 256-byte aligned
     bufferDesc.Height = 1;
     bufferDesc.DepthOrArraySize = 1;
     bufferDesc.MipLevels = 1;
     bufferDesc.SampleDesc.Count = 1;
     bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 
-    HRESULT hr = device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &bufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&constantBuffer)
-    );
-
-    // Map once, keep pointer around
-    hr = constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedCB));
-
     // Material Buffer
-    bufferDesc.Width = (sizeof(MaterialConstants) + 255) & ~255;
-    hr = device->CreateCommittedResource(
+    HRESULT hr = device->CreateCommittedResource(
         &heapProps,
         D3D12_HEAP_FLAG_NONE,
         &bufferDesc,
@@ -442,192 +480,276 @@ void Renderer::CreatePipeline() {
     pixelShader = nullptr;
 }
 
-void Renderer::CreateAssets() {
-    HRESULT hr;
-    if (models.empty()) {
-        throw std::runtime_error("No models bound to renderer");
-    }
+void Renderer::ApplyChanges(const EntityChanges& changes) {
+    if (!entities) return;
+    // Render waited for the last frame, nothing the GPU still reads is released here
+    gpuScene.ApplyChanges(*entities, changes);
+    EnsureInstanceCapacity(gpuScene.GetEntitySlotCount());
+}
 
-    // Resize buffer vectors to match number of models
-    vertex_buffers.resize(models.size());
-    vertex_buffers_upload.resize(models.size());
-    index_buffers.resize(models.size());
-    index_buffers_upload.resize(models.size());
+void Renderer::CreateMesh(uint32_t slot, const Model& model, SceneUploadStats& stats) {
+    if (slot >= gpuMeshes.size()) gpuMeshes.resize(slot + 1);
+    GpuMesh& gpu = gpuMeshes[slot];
+    CreateMeshBuffers(gpu, model, stats);
+    CreateMeshTextures(gpu, model, stats);
+    QueueUpload(slot);
+}
 
-    // Create buffers for each model
-    for (size_t i = 0; i < models.size(); ++i) {
-        if (models[i] == nullptr) continue;
-        
-        Model* currentModel = models[i];
-        
-        // Heap properties
-        D3D12_HEAP_PROPERTIES heap_properties = {};
-        heap_properties.Type = D3D12_HEAP_TYPE_DEFAULT;
-        heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        heap_properties.CreationNodeMask = 1;
-        heap_properties.VisibleNodeMask = 1;
+void Renderer::ReleaseMesh(uint32_t slot) {
+    GpuMesh& gpu = gpuMeshes[slot];
+    if (gpu.textureRange.count > 0) freeTextureRanges.push_back(gpu.textureRange);
+    gpu = GpuMesh();
+}
 
-        D3D12_HEAP_PROPERTIES heap_properties_upload = heap_properties;
-        heap_properties_upload.Type = D3D12_HEAP_TYPE_UPLOAD;
-
-        // Vertex buffer
-        D3D12_RESOURCE_DESC vertex_desc = {};
-        vertex_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        vertex_desc.Alignment = 0;
-        vertex_desc.Width = sizeof(Vertex) * currentModel->GetNumVertices();
-        vertex_desc.Height = 1;
-        vertex_desc.DepthOrArraySize = 1;
-        vertex_desc.MipLevels = 1;
-        vertex_desc.Format = DXGI_FORMAT_UNKNOWN;
-        vertex_desc.SampleDesc.Count = 1;
-        vertex_desc.SampleDesc.Quality = 0;
-        vertex_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        vertex_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        hr = device->CreateCommittedResource(
-            &heap_properties,
-            D3D12_HEAP_FLAG_NONE,
-            &vertex_desc,
-            D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(&vertex_buffers[i])
-        );
-
-        hr = device->CreateCommittedResource(
-            &heap_properties_upload,
-            D3D12_HEAP_FLAG_NONE,
-            &vertex_desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&vertex_buffers_upload[i])
-        );
-
-        // Index buffer
-        D3D12_RESOURCE_DESC index_desc = {};
-        index_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        index_desc.Alignment = 0;
-        index_desc.Width = sizeof(unsigned int) * currentModel->GetNumIndices();
-        index_desc.Height = 1;
-        index_desc.DepthOrArraySize = 1;
-        index_desc.MipLevels = 1;
-        index_desc.Format = DXGI_FORMAT_UNKNOWN;
-        index_desc.SampleDesc.Count = 1;
-        index_desc.SampleDesc.Quality = 0;
-        index_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        index_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        hr = device->CreateCommittedResource(
-            &heap_properties,
-            D3D12_HEAP_FLAG_NONE,
-            &index_desc,
-            D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(&index_buffers[i])
-        );
-
-        hr = device->CreateCommittedResource(
-            &heap_properties_upload,
-            D3D12_HEAP_FLAG_NONE,
-            &index_desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&index_buffers_upload[i])
-        );
-
-        // Copy data to upload buffers
-        const std::vector<Vertex>& model_vertices = currentModel->GetVertices();
-        const std::vector<unsigned int>& model_indices = currentModel->GetIndices();
-        
-        void* vertex_mapped_data = nullptr;
-        vertex_buffers_upload[i]->Map(0, nullptr, &vertex_mapped_data);
-        memcpy(vertex_mapped_data, model_vertices.data(), sizeof(Vertex) * model_vertices.size());
-        vertex_buffers_upload[i]->Unmap(0, nullptr);
-
-        void* index_mapped_data = nullptr;
-        index_buffers_upload[i]->Map(0, nullptr, &index_mapped_data);
-        memcpy(index_mapped_data, model_indices.data(), sizeof(unsigned int) * model_indices.size());
-        index_buffers_upload[i]->Unmap(0, nullptr);
+bool Renderer::HasGpuData(EntityHandle entity) const {
+    // Entities created since the last ApplyChanges have no mesh yet
+    const uint32_t mesh = gpuScene.GetMesh(entity);
+    return mesh != GpuScene::NoMesh && gpuMeshes[mesh].vertexBuffer;
+}
+
+void Renderer::CreateMeshBuffers(GpuMesh& gpu, const Model& model, SceneUploadStats& stats) {
+    const std::vector<Vertex>& vertices = model.GetVertices();
+    const std::vector<unsigned int>& indices = model.GetIndices();
+    if (vertices.empty() || indices.empty()) return;
+
+    const D3D12_HEAP_PROPERTIES defaultHeap = HeapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    const D3D12_HEAP_PROPERTIES uploadHeap = HeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const UINT64 vertexBytes = sizeof(Vertex) * vertices.size();
+    const UINT64 indexBytes = sizeof(unsigned int) * indices.size();
+
+    D3D12_RESOURCE_DESC desc = BufferDesc(vertexBytes);
+    device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &desc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&gpu.vertexBuffer));
+    device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&gpu.vertexUpload));
+
+    desc = BufferDesc(indexBytes);
+    device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &desc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&gpu.indexBuffer));
+    device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&gpu.indexUpload));
+
+    void* mapped = nullptr;
+    gpu.vertexUpload->Map(0, nullptr, &mapped);
+    memcpy(mapped, vertices.data(), vertexBytes);
+    gpu.vertexUpload->Unmap(0, nullptr);
+
+    gpu.indexUpload->Map(0, nullptr, &mapped);
+    memcpy(mapped, indices.data(), indexBytes);
+    gpu.indexUpload->Unmap(0, nullptr);
+
+    gpu.vertexCount = static_cast<UINT>(vertices.size());
+    gpu.indexCount = static_cast<UINT>(indices.size());
+    stats.bufferBytes += vertexBytes + indexBytes;
+}
+
+void Renderer::CreateMeshTextures(GpuMesh& gpu, const Model& model, SceneUploadStats& stats) {
+    // One view per material, a model without any still gets the default texture
+    const std::vector<Material>& materials = model.GetMaterials();
+    const UINT count = std::max<UINT>(1u, static_cast<UINT>(materials.size()));
+    gpu.textures.assign(count, nullptr);
+    gpu.textureUploads.assign(count, nullptr);
+    gpu.textureFootprints.assign(count, D3D12_PLACED_SUBRESOURCE_FOOTPRINT());
+
+    const D3D12_HEAP_PROPERTIES defaultHeap = HeapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    const D3D12_HEAP_PROPERTIES uploadHeap = HeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    for (size_t m = 0; m < materials.size(); ++m) {
+        const Material& mat = materials[m];
+        const unsigned char* imageData = mat.textureImage.data();
+        if (mat.diffuseMap.empty() || mat.textureImage.GetWidth() <= 0 || !imageData) continue;
+
+        const UINT texWidth = static_cast<UINT>(mat.textureImage.GetWidth());
+        const UINT texHeight = static_cast<UINT>(mat.textureImage.GetHeight());
+        D3D12_RESOURCE_DESC textureDesc = {};
+        textureDesc.MipLevels = 1;
+        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        textureDesc.Width = texWidth;
+        textureDesc.Height = texHeight;
+        textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        textureDesc.DepthOrArraySize = 1;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.SampleDesc.Quality = 0;
+        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &textureDesc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&gpu.textures[m]));
+
+        UINT64 uploadBytes = 0;
+        device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &gpu.textureFootprints[m], nullptr, nullptr, &uploadBytes);
+        const D3D12_RESOURCE_DESC uploadDesc = BufferDesc(uploadBytes);
+        device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &uploadDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&gpu.textureUploads[m]));
+
+        // Rows are staged at the pitch the copy expects, the copy itself is recorded by the next frame
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = gpu.textureFootprints[m];
+        const UINT rowBytes = texWidth * 4; // RGBA
+        unsigned char* mapped = nullptr;
+        gpu.textureUploads[m]->Map(0, nullptr, reinterpret_cast<void**>(&mapped));
+        for (UINT y = 0; y < texHeight; ++y) {
+            memcpy(mapped + footprint.Offset + static_cast<UINT64>(y) * footprint.Footprint.RowPitch, imageData + static_cast<size_t>(y) * rowBytes, rowBytes);
+        }
+        gpu.textureUploads[m]->Unmap(0, nullptr);
+        stats.textureBytes += uploadBytes;
     }
-    
-    // Upload all buffers in one command list execution
-    commandAllocator->Reset();
-    commandList->Reset(commandAllocator, nullptr);
 
-    for (size_t i = 0; i < models.size(); ++i) {
-        if (models[i] == nullptr) continue;
-        
-        D3D12_RESOURCE_BARRIER barriers[2] = {};
-        barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        barriers[0].Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        barriers[0].Transition.pResource = vertex_buffers[i];
-        barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
-        barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-        barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-        barriers[1].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        barriers[1].Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        barriers[1].Transition.pResource = index_buffers[i];
-        barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
-        barriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-        barriers[1].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-        commandList->ResourceBarrier(2, barriers);
-        
-        commandList->CopyResource(vertex_buffers[i], vertex_buffers_upload[i]);
-        commandList->CopyResource(index_buffers[i], index_buffers_upload[i]);
+    gpu.textureRange = AllocateTextureRange(count);
+    WriteTextureViews(gpu);
+}
+
+void Renderer::ReleaseMeshTextures(GpuMesh& gpu) {
+    if (gpu.textureRange.count > 0) freeTextureRanges.push_back(gpu.textureRange);
+    gpu.textureRange = { 0, 0 };
+    gpu.textures.clear();
+    gpu.textureUploads.clear();
+    gpu.textureFootprints.clear();
+}
 
-        barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
-        barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        barriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+void Renderer::QueueUpload(uint32_t slot) {
+    GpuMesh& gpu = gpuMeshes[slot];
+    if (gpu.uploadQueued) return;
+    gpu.uploadQueued = true;
+    pendingUploads.push_back(slot);
+}
+
+void Renderer::RecordUploads() {
+    for (uint32_t slot : pendingUploads) {
+        GpuMesh& gpu = gpuMeshes[slot];
+        if (!gpu.uploadQueued) continue; // released before it got here
+        gpu.uploadQueued = false;
+
+        if (gpu.vertexUpload && gpu.indexUpload) {
+            D3D12_RESOURCE_BARRIER barriers[2] = {};
+            barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barriers[0].Transition.pResource = gpu.vertexBuffer.Get();
+            barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
+            barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+            barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            barriers[1] = barriers[0];
+            barriers[1].Transition.pResource = gpu.indexBuffer.Get();
+            commandList->ResourceBarrier(2, barriers);
+
+            commandList->CopyResource(gpu.vertexBuffer.Get(), gpu.vertexUpload.Get());
+            commandList->CopyResource(gpu.indexBuffer.Get(), gpu.indexUpload.Get());
+
+            barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+            barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+            barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+            barriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+            commandList->ResourceBarrier(2, barriers);
+        }
 
-        commandList->ResourceBarrier(2, barriers);
+        for (size_t m = 0; m < gpu.textureUploads.size(); ++m) {
+            if (!gpu.textureUploads[m]) continue;
+
+            D3D12_TEXTURE_COPY_LOCATION srcLocation = {};
+            srcLocation.pResource = gpu.textureUploads[m].Get();
+            srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+            srcLocation.PlacedFootprint = gpu.textureFootprints[m];
+
+            D3D12_TEXTURE_COPY_LOCATION dstLocation = {};
+            dstLocation.pResource = gpu.textures[m].Get();
+            dstLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            dstLocation.SubresourceIndex = 0;
+            commandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, nullptr);
+
+            D3D12_RESOURCE_BARRIER barrier = {};
+            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barrier.Transition.pResource = gpu.textures[m].Get();
+            barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+            barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            commandList->ResourceBarrier(1, &barrier);
+        }
+        uploadsInFlight.push_back(slot);
     }
+    pendingUploads.clear();
+}
 
-    commandList->Close();
-    ID3D12CommandList* command_lists[] = { commandList };
-    commandQueue->ExecuteCommandLists(1, command_lists);
-
-    // Wait for GPU to finish
-    const UINT64 current_fence_value = ++fence_value;
-    commandQueue->Signal(fence, current_fence_value);
-    if (fence->GetCompletedValue() < current_fence_value) {
-        fence->SetEventOnCompletion(current_fence_value, fence_event);
-        WaitForSingleObject(fence_event, INFINITE);
+void Renderer::ReleaseFinishedUploads() {
+    for (uint32_t slot : uploadsInFlight) {
+        GpuMesh& gpu = gpuMeshes[slot];
+        gpu.vertexUpload.Reset();
+        gpu.indexUpload.Reset();
+        for (ComPtr<ID3D12Resource>& upload : gpu.textureUploads) {
+            upload.Reset();
+        }
     }
+    uploadsInFlight.clear();
+}
 
-    // Build draw ranges for first model only (if using materials)
-    // You may want to extend this for per-model materials later
-    if (!models.empty() && models[0] != nullptr) {
-        drawRanges.clear();
-        const auto& materialsRef = models[0]->GetMaterials();
-        const auto& faceMaterialIndices = models[0]->GetFaceMaterialIndices();
-        size_t totalIndices = models[0]->GetNumIndices();
-        
-        if (!faceMaterialIndices.empty() && totalIndices % 3 == 0 && !materialsRef.empty()) {
-            DrawRange current {0, 0, faceMaterialIndices[0]};
-            
-            for (UINT tri = 0; tri < totalIndices/3; ++tri) {
-                UINT base = tri * 3;
-                UINT faceMaterial = (tri < faceMaterialIndices.size()) ? faceMaterialIndices[tri] : 0;
-                
-                if (faceMaterial != current.materialIndex) {
-                    if (current.indexCount > 0) {
-                        drawRanges.push_back(current);
-                    }
-                    current.startIndex = base;
-                    current.indexCount = 0;
-                    current.materialIndex = faceMaterial;
-                }
-                current.indexCount += 3;
-            }
-            if (current.indexCount > 0) drawRanges.push_back(current);
-        } else {
-            DrawRange dr {0, static_cast<UINT>(totalIndices), 0};
-            drawRanges.push_back(dr);
+Renderer::ModelMaterialRange Renderer::AllocateTextureRange(UINT count) {
+    // First fit among the ranges of removed models, else the end of the heap
+    for (ModelMaterialRange& range : freeTextureRanges) {
+        if (range.count < count) continue;
+        ModelMaterialRange allocated = { range.startIndex, count };
+        range.startIndex += count;
+        range.count -= count;
+        if (range.count == 0) {
+            range = freeTextureRanges.back();
+            freeTextureRanges.pop_back();
         }
+        return allocated;
     }
+    if (srvUsed + count > srvCapacity) {
+        GrowTextureHeap(std::max<UINT>(srvCapacity * 2, srvUsed + count));
+    }
+    ModelMaterialRange allocated = { srvUsed, count };
+    srvUsed += count;
+    return allocated;
+}
+
+void Renderer::GrowTextureHeap(UINT capacity) {
+    ID3D12DescriptorHeap* heap = nullptr;
+    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+    srvHeapDesc.NumDescriptors = capacity;
+    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&heap));
+
+    // Only called between frames, the old heap is no longer in use
+    if (srvHeap) srvHeap->Release();
+    srvHeap = heap;
+    srvCapacity = capacity;
+
+    // A shader visible heap can't be copied from, the views are written again
+    for (const GpuMesh& gpu : gpuMeshes) {
+        if (gpu.textureRange.count > 0) WriteTextureViews(gpu);
+    }
+}
+
+void Renderer::WriteTextureViews(const GpuMesh& gpu) {
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = srvHeap->GetCPUDescriptorHandleForHeapStart();
+    handle.ptr += static_cast<SIZE_T>(gpu.textureRange.startIndex) * srvDescriptorSize;
+    for (UINT m = 0; m < gpu.textureRange.count; ++m) {
+        // Materials without a texture sample the white default one
+        ID3D12Resource* texture = m < gpu.textures.size() && gpu.textures[m] ? gpu.textures[m].Get() : defaultTexture.Get();
+        device->CreateShaderResourceView(texture, &srvDesc, handle);
+        handle.ptr += srvDescriptorSize;
+    }
+}
+
+void Renderer::EnsureInstanceCapacity(size_t slots) {
+    if (constantBuffer && slots <= instanceCapacity) return;
+
+    if (constantBuffer) {
+        constantBuffer->Unmap(0, nullptr);
+        constantBuffer->Release();
+        constantBuffer = nullptr;
+    }
+    instanceCapacity = std::max<size_t>({ slots, instanceCapacity * 2, 64 });
+
+    const D3D12_HEAP_PROPERTIES heapProps = HeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const D3D12_RESOURCE_DESC bufferDesc = BufferDesc(instanceCapacity * InstanceConstantsSize);
+    device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&constantBuffer));
+
+    // Map once, keep pointer around
+    constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedCB));
 }
 
 void Renderer::HandleForward(float dir)
@@ -650,12 +772,15 @@ void Renderer::Update() {
 	UpdateTextures();
 }
 
-void Renderer::Render() {
+void Renderer::Render(float alpha, double time) {
     UINT frameIndex = swapChain->GetCurrentBackBufferIndex();
     
     // Reset command allocator and list
     commandAllocator->Reset();
     commandList->Reset(commandAllocator, pipelineState);
+
+    // Copies for entities created since the last frame go ahead of the draws
+    RecordUploads();
     
     // Set necessary state
     commandList->SetGraphicsRootSignature(rootSignature);
@@ -690,10 +815,12 @@ void Renderer::Render() {
     // Set topology
     commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     
-    // Calculate view and projection matrices
-    DirectX::XMVECTOR camPos = DirectX::XMLoadFloat3(&c.cameraPos);
-    DirectX::XMVECTOR camForward = DirectX::XMLoadFloat3(&c.cameraForward);
-    DirectX::XMVECTOR camUp = DirectX::XMLoadFloat3(&c.cameraUp);
+    // Calculate view and projection matrices, between the last two simulation steps so motion
+    // stays smooth when the display runs faster or slower than the simulation
+    const CameraView eye = c.GetView(alpha);
+    DirectX::XMVECTOR camPos = DirectX::XMLoadFloat3(&eye.position);
+    DirectX::XMVECTOR camForward = DirectX::XMLoadFloat3(&eye.forward);
+    DirectX::XMVECTOR camUp = DirectX::XMLoadFloat3(&eye.up);
     DirectX::XMVECTOR camTarget = DirectX::XMVectorAdd(camPos, camForward);
     
     DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(camPos, camTarget, camUp);
@@ -704,69 +831,94 @@ void Renderer::Render() {
     );
     
     // Update flashlight to follow camera
-    matData.flashlightPos = c.cameraPos;
-    matData.flashlightDir = c.cameraForward;
+    matData.flashlightPos = eye.position;
+    matData.flashlightDir = eye.forward;
     
-    // Optional: Add slight flashlight bobbing for realism
-    static float time = 0.0f;
-    time += 0.016f; // ~60 FPS
-    matData.flashlightPos.y += sin(time * 3.0f) * 0.02f; // Subtle bob
+    // Optional: Add slight flashlight bobbing for realism, at the same pace whatever the frame rate
+    matData.flashlightPos.y += static_cast<float>(sin(time * 3.0)) * 0.02f; // Subtle bob
     
     // Optional: Flickering flashlight for horror effect
-    float flicker = 1.0f + sin(time * 30.0f) * 0.05f + sin(time * 73.0f) * 0.03f;
+    float flicker = 1.0f + static_cast<float>(sin(time * 30.0) * 0.05 + sin(time * 73.0) * 0.03);
     matData.flashlightIntensity = 2.5f * flicker;
     
     *mappedMat = matData;
+
+    // What the camera's cell can't see was baked into the PVS, a lookup drops it up front
+    const int cell = pvs ? pvs->GetCell(eye.position) : -1;
+    const std::vector<Model*>& models = entities->GetModels();
+    const std::vector<EntityHandle>& handles = entities->GetHandles();
+    candidateModels.clear();
+    for (unsigned int i = 0; i < models.size(); ++i) {
+        if (HasGpuData(handles[i]) && (!pvs || pvs->IsVisible(cell, models[i]->pvsIndex))) candidateModels.push_back(i);
+    }
+    // Models outside the frustum are dropped before any of their meshlets are looked at.
+    // The boxes are refreshed every frame, Herobrine teleports and diamonds get picked up.
+    sceneCuller.UpdateBounds(entities->GetBounds(), candidateModels);
+    sceneCuller.Cull(view, proj, eye.position, eye.forward, visibleModels);
+    // The nearest occluders among them (the cabin and tree trunks) hide what stands behind them
+    occlusionCuller.BeginFrame(view, proj, eye.position);
+    for (unsigned int i : visibleModels) {
+        occlusionCuller.AddOccluder(*models[i]);
+    }
+    occlusionCuller.Rasterize();
+    occlusionCuller.Cull(models, visibleModels);
+    clusterCuller.BeginFrame(view, proj, eye.position);
     
-    // Render each model
-    for (size_t i = 0; i < models.size(); ++i) {
-        if (models[i] == nullptr) continue;
-        
+    // Render each visible model
+    for (unsigned int i : visibleModels) {
         // Get model transformation
-        DirectX::XMMATRIX modelMatrix = models[i]->GetModelMatrix();
+        DirectX::XMMATRIX modelMatrix = DirectX::XMLoadFloat4x4(&entities->GetWorlds()[i]);
+
+        // Only the meshlets that survive culling are submitted
+        clusterCuller.Cull(*models[i], modelMatrix, visibleRanges);
+        if (visibleRanges.empty()) continue;
         
         // Update MVP constants
         cbData.mvp = DirectX::XMMatrixTranspose(modelMatrix * view * proj);
         cbData.model = DirectX::XMMatrixTranspose(modelMatrix);
-        
-        DirectX::XMVECTOR det;
-        DirectX::XMMATRIX invModel = DirectX::XMMatrixInverse(&det, modelMatrix);
-        cbData.normalMatrix = DirectX::XMMatrixTranspose(invModel);
-        cbData.viewPos = c.cameraPos;
+        // Inverse transpose cached by the transform graph, only recomputed when the model moves
+        cbData.normalMatrix = DirectX::XMLoadFloat4x4(&entities->GetNormalMatrices()[i]);
+        cbData.viewPos = eye.position;
         cbData._padView = 0.0f;
         
-        *mappedCB = cbData;  // Copy to mapped buffer
+        // Each entity slot has its own entry, the GPU reads them all after the list was closed.
+        // Entities with the same model draw the same buffers and textures.
+        const uint32_t slot = handles[i].index;
+        const GpuMesh& gpu = gpuMeshes[gpuScene.GetMesh(handles[i])];
+        *reinterpret_cast<MVPConstants*>(reinterpret_cast<unsigned char*>(mappedCB) + slot * InstanceConstantsSize) = cbData;
         
         // Set constant buffers
-        commandList->SetGraphicsRootConstantBufferView(0, constantBuffer->GetGPUVirtualAddress());
+        commandList->SetGraphicsRootConstantBufferView(0, constantBuffer->GetGPUVirtualAddress() + slot * InstanceConstantsSize);
         commandList->SetGraphicsRootConstantBufferView(1, materialBuffer->GetGPUVirtualAddress());
         
         // Set vertex and index buffers
         D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
-        vertexBufferView.BufferLocation = vertex_buffers[i]->GetGPUVirtualAddress();
+        vertexBufferView.BufferLocation = gpu.vertexBuffer->GetGPUVirtualAddress();
         vertexBufferView.StrideInBytes = sizeof(Vertex);
-        vertexBufferView.SizeInBytes = models[i]->GetNumVertices() * sizeof(Vertex);
+        vertexBufferView.SizeInBytes = gpu.vertexCount * sizeof(Vertex);
         
         D3D12_INDEX_BUFFER_VIEW indexBufferView;
-        indexBufferView.BufferLocation = index_buffers[i]->GetGPUVirtualAddress();
-        indexBufferView.SizeInBytes = models[i]->GetNumIndices() * sizeof(unsigned int);
+        indexBufferView.BufferLocation = gpu.indexBuffer->GetGPUVirtualAddress();
+        indexBufferView.SizeInBytes = gpu.indexCount * sizeof(unsigned int);
         indexBufferView.Format = DXGI_FORMAT_R32_UINT;
         
         commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
         commandList->IASetIndexBuffer(&indexBufferView);
 
-        UINT textureIndex = 0;
-        if (i < modelMaterialRanges.size()) {
-            textureIndex = modelMaterialRanges[i].startIndex; // Get the starting texture index for this model
-        }
+        const ModelMaterialRange textureRange = gpu.textureRange; // Textures of this model's materials
         
-        // Set texture for this model
-        D3D12_GPU_DESCRIPTOR_HANDLE srvHandle = srvHeap->GetGPUDescriptorHandleForHeapStart();
-        srvHandle.ptr += textureIndex * device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-        commandList->SetGraphicsRootDescriptorTable(2, srvHandle);
-        
-        // Draw the model
-        commandList->DrawIndexedInstanced(models[i]->GetNumIndices(), 1, 0, 0, 0);
+        // Draw the visible parts of the model, switching texture only when the material changes
+        UINT boundTexture = UINT_MAX;
+        for (const DrawRange& range : visibleRanges) {
+            UINT textureIndex = textureRange.startIndex + std::min<UINT>(range.materialIndex, textureRange.count - 1);
+            if (textureIndex != boundTexture) {
+                D3D12_GPU_DESCRIPTOR_HANDLE srvHandle = srvHeap->GetGPUDescriptorHandleForHeapStart();
+                srvHandle.ptr += textureIndex * srvDescriptorSize;
+                commandList->SetGraphicsRootDescriptorTable(2, srvHandle);
+                boundTexture = textureIndex;
+            }
+            commandList->DrawIndexedInstanced(range.indexCount, 1, range.startIndex, 0, 0);
+        }
     }
     
     // Transition render target from render target to present state
@@ -789,56 +941,14 @@ void Renderer::Render() {
         fence->SetEventOnCompletion(currentFenceValue, fence_event);
         WaitForSingleObject(fence_event, INFINITE);
     }
+    ReleaseFinishedUploads();
 }
 
-void Renderer::BindModels(const std::vector<Model*>& modelList) {
-    this->models = modelList;
+void Renderer::BindEntities(const EntityStore& entityStore) {
+    this->entities = &entityStore;
 }
 
-void Renderer::CreateTextureResources() {
-    // Count total materials across all models
-    std::cout << "Creating texture resources for " << models.size() << " models" << std::endl;
-
-    UINT totalMaterialCount = 0;
-    for (const auto& model : models) {
-        if (model) {
-            totalMaterialCount += static_cast<UINT>(model->GetMaterials().size());
-            if (model->GetMaterials().empty()) {
-                totalMaterialCount++; // Add one for default texture
-            }
-            std::cout << "Model has " << model->GetMaterials().size() << " materials" << std::endl;
-        }
-    }
-    
-    // Ensure at least one descriptor for default texture
-    if (totalMaterialCount == 0) totalMaterialCount = 1;
-    
-    // Track material ranges for each model
-    modelMaterialRanges.clear();
-    UINT currentStartIndex = 0;
-    for (const auto& model : models) {
-        ModelMaterialRange range;
-        range.startIndex = currentStartIndex;
-        if (model) {
-            range.count = static_cast<UINT>(model->GetMaterials().size());
-            if (range.count == 0) range.count = 1; // At least one default
-        } else {
-            range.count = 1;
-        }
-        modelMaterialRanges.push_back(range);
-        currentStartIndex += range.count;
-    }
-    
-    // Create descriptor heap for all textures
-    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = totalMaterialCount;
-    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&srvHeap));
-
-    materialTextures.resize(totalMaterialCount);
-    materialUploadHeaps.resize(totalMaterialCount);
-    
+void Renderer::CreateDefaultTexture() {
     // Create default white texture
     UINT32 whitePixel = 0xFFFFFFFF;
     D3D12_RESOURCE_DESC textureDesc = {};
@@ -919,157 +1029,4 @@ void Renderer::CreateTextureResources() {
         fence->SetEventOnCompletion(fence_value_for_signal, fence_event);
         WaitForSingleObject(fence_event, INFINITE);
     }
-
-    // Now create SRVs for each material
-    UINT descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    D3D12_CPU_DESCRIPTOR_HANDLE currentHandle = srvHeap->GetCPUDescriptorHandleForHeapStart();
-    
-    UINT globalMaterialIndex = 0;
-
-    // Reset command list for texture uploads
-    commandAllocator->Reset();
-    commandList->Reset(commandAllocator, nullptr);
-    
-    for (size_t modelIdx = 0; modelIdx < models.size(); ++modelIdx) {
-        if (!models[modelIdx]) {
-            // Null model - just use default texture
-            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-            srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-            srvDesc.Texture2D.MipLevels = 1;
-            device->CreateShaderResourceView(defaultTexture.Get(), &srvDesc, currentHandle);
-            currentHandle.ptr += descriptorSize;
-            globalMaterialIndex++;
-            continue;
-        }
-        
-        const auto& materials = models[modelIdx]->GetMaterials();
-        
-        if (materials.empty()) {
-            // Model has no materials - create one default SRV
-            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-            srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-            srvDesc.Texture2D.MipLevels = 1;
-            device->CreateShaderResourceView(defaultTexture.Get(), &srvDesc, currentHandle);
-            currentHandle.ptr += descriptorSize;
-            globalMaterialIndex++;
-        } else {
-            // Process each material for this model
-            for (size_t matIdx = 0; matIdx < materials.size(); ++matIdx) {
-                const Material& mat = materials[matIdx];
-                
-                // Check if material has a diffuse texture
-                if (!mat.diffuseMap.empty() && mat.textureImage.GetWidth() > 0) {
-                    // Load actual texture from material
-                    int texWidth = mat.textureImage.GetWidth();
-                    int texHeight = mat.textureImage.GetHeight();
-                    const unsigned char* imageData = mat.textureImage.data();
-                    
-                    if (imageData) {
-                        // Create texture resource
-                        D3D12_RESOURCE_DESC textureDesc = {};
-                        textureDesc.MipLevels = 1;
-                        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-                        textureDesc.Width = texWidth;
-                        textureDesc.Height = texHeight;
-                        textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-                        textureDesc.DepthOrArraySize = 1;
-                        textureDesc.SampleDesc.Count = 1;
-                        textureDesc.SampleDesc.Quality = 0;
-                        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-                        
-                        D3D12_HEAP_PROPERTIES heapProps = {};
-                        heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-                        
-                        ComPtr<ID3D12Resource> texture;
-                        device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &textureDesc,
-                            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&texture));
-                        
-                        // Create upload buffer
-                        UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, 1);
-                        heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-                        
-                        D3D12_RESOURCE_DESC bufferDesc = {};
-                        bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-                        bufferDesc.Width = uploadBufferSize;
-                        bufferDesc.Height = 1;
-                        bufferDesc.DepthOrArraySize = 1;
-                        bufferDesc.MipLevels = 1;
-                        bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
-                        bufferDesc.SampleDesc.Count = 1;
-                        bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-                        bufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-                        
-                        ComPtr<ID3D12Resource> uploadBuffer;
-                        device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
-                            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadBuffer));
-                        
-                        // Copy image data to upload buffer
-                        D3D12_SUBRESOURCE_DATA subresourceData = {};
-                        subresourceData.pData = imageData;
-                        subresourceData.RowPitch = texWidth * 4; // 4 bytes per pixel (RGBA)
-                        subresourceData.SlicePitch = subresourceData.RowPitch * texHeight;
-                        
-                        UpdateSubresources(commandList, texture.Get(), uploadBuffer.Get(), 0, 0, 1, &subresourceData);
-                        
-                        // Transition to shader resource
-                        D3D12_RESOURCE_BARRIER barrier = {};
-                        barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-                        barrier.Transition.pResource = texture.Get();
-                        barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-                        barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
-                        barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-                        commandList->ResourceBarrier(1, &barrier);
-                        
-                        // Store the texture
-                        materialTextures[globalMaterialIndex] = texture;
-                        materialUploadHeaps[globalMaterialIndex] = uploadBuffer;
-                        
-                        // Create SRV for this texture
-                        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-                        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-                        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-                        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-                        srvDesc.Texture2D.MipLevels = 1;
-                        device->CreateShaderResourceView(texture.Get(), &srvDesc, currentHandle);
-                    } else {
-                        // Use default white texture
-                        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-                        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-                        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-                        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-                        srvDesc.Texture2D.MipLevels = 1;
-                        device->CreateShaderResourceView(defaultTexture.Get(), &srvDesc, currentHandle);
-                    }
-                } else {
-                    // Use default white texture
-                    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-                    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-                    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-                    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-                    srvDesc.Texture2D.MipLevels = 1;
-                    device->CreateShaderResourceView(defaultTexture.Get(), &srvDesc, currentHandle);
-                }
-                
-                currentHandle.ptr += descriptorSize;
-                globalMaterialIndex++;
-            }
-        }
-    }
-    // Execute all texture uploads at once
-    commandList->Close();
-    ID3D12CommandList* ppTextureCommandLists[] = { commandList };  // Use different name
-    commandQueue->ExecuteCommandLists(1, ppTextureCommandLists);
-    
-    // Wait for uploads to complete
-    const UINT64 fence_value_for_textures = ++fence_value;
-    commandQueue->Signal(fence, fence_value_for_textures);
-    if (fence->GetCompletedValue() < fence_value_for_textures) {
-        fence->SetEventOnCompletion(fence_value_for_textures, fence_event);
-        WaitForSingleObject(fence_event, INFINITE);
-    }
-
 }
@@ -0,0 +1,221 @@
+#include "Scatter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Candidates tried around an active point before it is retired. They sit evenly spaced on the
+// circle at minDistance, which packs denser and retires points sooner than Bridson's random
+// annulus samples (the variant from Roberts, "An improved version of Bridson's algorithm").
+constexpr int CandidatesPerPoint = 16;
+constexpr float StepCos = 0.92387953f; // cos(2 pi / 16)
+constexpr float StepSin = 0.38268343f; // sin(2 pi / 16)
+// Random probes for a new front once the current one died, e.g. behind an obstacle
+constexpr int RestartProbes = 30;
+constexpr size_t MaxGridCells = 1u << 22;
+
+// PCG32. Only integer math and exactly rounded float operations are used on its output, so
+// a seed means the same layout everywhere, which the std distributions don't guarantee.
+struct Random {
+    uint64_t state = 0;
+    uint64_t increment;
+
+    Random(uint64_t seed, uint64_t stream) : increment((stream << 1u) | 1u) {
+        Next();
+        state += seed;
+        Next();
+    }
+
+    uint32_t Next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + increment;
+        uint32_t shifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rotation = static_cast<uint32_t>(old >> 59u);
+        return (shifted >> rotation) | (shifted << ((32u - rotation) & 31u));
+    }
+
+    // [0, 1)
+    float Uniform() { return static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f); }
+    // [0, n)
+    unsigned int Below(unsigned int n) { return static_cast<unsigned int>((static_cast<uint64_t>(Next()) * n) >> 32); }
+};
+
+}
+
+PoissonScatter::PoissonScatter(float minX, float minZ, float maxX, float maxZ, uint32_t seed)
+    : minX(std::min(minX, maxX)), minZ(std::min(minZ, maxZ)), maxX(std::max(minX, maxX)), maxZ(std::max(minZ, maxZ)), seed(seed) {
+}
+
+float PoissonScatter::FootprintRadius(const Model& model) {
+    // Model origins are often off center (a tree at the foot of its trunk), the farthest corner counts
+    const DirectX::XMFLOAT3 origin = model.GetPosition();
+    float dx = std::max(std::abs(model.b.minX - origin.x), std::abs(model.b.maxX - origin.x));
+    float dz = std::max(std::abs(model.b.minZ - origin.z), std::abs(model.b.maxZ - origin.z));
+    return sqrtf(dx * dx + dz * dz);
+}
+
+float PoissonScatter::SpacingForCount(unsigned int count) const {
+    // A maximal fill at spacing d holds about 0.84 * area / d^2 points
+    float area = (maxX - minX) * (maxZ - minZ);
+    return count > 0 ? sqrtf(0.42f * area / static_cast<float>(count)) : 0.0f;
+}
+
+void PoissonScatter::AddObstacle(const BoundingBox& bounds) {
+    obstacles.push_back({ bounds.minX, bounds.minZ, bounds.maxX, bounds.maxZ });
+}
+
+void PoissonScatter::Clear() {
+    discs.clear();
+    obstacles.clear();
+    maxRadius = 0.0f;
+    layerCount = 0;
+    cellHeads.clear();
+    next.clear();
+}
+
+void PoissonScatter::RebuildGrid(float size) {
+    const float width = maxX - minX, depth = maxZ - minZ;
+    // Coarser than asked when the region would need too many cells
+    cellSize = std::max({ size, sqrtf(width * depth / static_cast<float>(MaxGridCells)), 1e-3f });
+    inverseCellSize = 1.0f / cellSize;
+    cellsX = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+    cellsZ = std::max(1, static_cast<int>(std::ceil(depth / cellSize)));
+    cellHeads.assign(static_cast<size_t>(cellsX) * cellsZ, -1);
+    next.assign(discs.size(), -1);
+    next.reserve(discs.size() * 2);
+    for (unsigned int i = 0; i < discs.size(); ++i) {
+        Link(i);
+    }
+}
+
+void PoissonScatter::Link(unsigned int disc) {
+    int cx = std::clamp(static_cast<int>((discs[disc].x - minX) * inverseCellSize), 0, cellsX - 1);
+    int cz = std::clamp(static_cast<int>((discs[disc].z - minZ) * inverseCellSize), 0, cellsZ - 1);
+    int& head = cellHeads[static_cast<size_t>(cz) * cellsX + cx];
+    if (next.size() <= disc) next.push_back(-1);
+    next[disc] = head;
+    head = static_cast<int>(disc);
+}
+
+bool PoissonScatter::IsFree(float x, float z, float radius, float minDistance, unsigned int layer, float reach) const {
+    if (x < minX || x > maxX || z < minZ || z > maxZ) return false;
+
+    for (const Obstacle& obstacle : obstacles) {
+        float dx = std::max({ obstacle.minX - x, 0.0f, x - obstacle.maxX });
+        float dz = std::max({ obstacle.minZ - z, 0.0f, z - obstacle.maxZ });
+        if (dx * dx + dz * dz < radius * radius) return false;
+    }
+
+    auto conflicts = [&](int cell) {
+        for (int i = cellHeads[cell]; i >= 0; i = next[i]) {
+            const Disc& disc = discs[i];
+            float dx = disc.x - x, dz = disc.z - z;
+            // Instances of one layer keep its spacing, everything else only keeps the footprints apart
+            float limit = disc.layer == layer ? minDistance : radius + disc.radius;
+            if (dx * dx + dz * dz < limit * limit) return true;
+        }
+        return false;
+    };
+
+    // The candidate's own cell rejects most of them, so it goes first
+    const int cx = std::min(cellsX - 1, static_cast<int>((x - minX) * inverseCellSize));
+    const int cz = std::min(cellsZ - 1, static_cast<int>((z - minZ) * inverseCellSize));
+    if (conflicts(cz * cellsX + cx)) return false;
+
+    const int x0 = std::max(0, static_cast<int>((x - reach - minX) * inverseCellSize));
+    const int x1 = std::min(cellsX - 1, static_cast<int>((x + reach - minX) * inverseCellSize));
+    const int z0 = std::max(0, static_cast<int>((z - reach - minZ) * inverseCellSize));
+    const int z1 = std::min(cellsZ - 1, static_cast<int>((z + reach - minZ) * inverseCellSize));
+    for (int gz = z0; gz <= z1; ++gz) {
+        for (int gx = x0; gx <= x1; ++gx) {
+            if ((gx != cx || gz != cz) && conflicts(gz * cellsX + gx)) return false;
+        }
+    }
+    return true;
+}
+
+void PoissonScatter::Scatter(const ScatterLayer& layer, std::vector<ScatterPoint>& outPoints) {
+    const unsigned int layerId = layerCount++;
+    Random random(seed, layerId);
+    const float radius = std::max(layer.radius, 0.0f);
+    const float minDistance = std::max(layer.minDistance, 2.0f * radius);
+    if (minDistance <= 0.0f || layer.maxCount == 0) return;
+
+    // With cells of minDistance / sqrt(2) every cell holds at most one instance of this layer
+    RebuildGrid(minDistance * 0.70710678f);
+    const float reach = std::max(minDistance, radius + maxRadius);
+    const unsigned int first = static_cast<unsigned int>(discs.size());
+
+    auto tryAdd = [&](float x, float z) {
+        if (!IsFree(x, z, radius, minDistance, layerId, reach)) return false;
+        discs.push_back({ x, z, radius, layerId });
+        Link(static_cast<unsigned int>(discs.size() - 1));
+        return true;
+    };
+
+    std::vector<unsigned int> active;
+    for (;;) {
+        // Start a front anywhere free, again after every front that ran out of room
+        bool started = false;
+        for (int probe = 0; probe < RestartProbes && !started; ++probe) {
+            started = tryAdd(minX + random.Uniform() * (maxX - minX), minZ + random.Uniform() * (maxZ - minZ));
+        }
+        if (!started) break;
+        active.push_back(static_cast<unsigned int>(discs.size() - 1));
+
+        while (!active.empty()) {
+            const unsigned int slot = random.Below(static_cast<unsigned int>(active.size()));
+            const Disc origin = discs[active[slot]];
+            // Random start on the unit circle, by rejection so no trig is involved
+            float u, v, lengthSq;
+            do {
+                u = random.Uniform() * 2.0f - 1.0f;
+                v = random.Uniform() * 2.0f - 1.0f;
+                lengthSq = u * u + v * v;
+            } while (lengthSq < 0.0625f || lengthSq > 1.0f);
+            // Just past minDistance, so rounding never puts the two closer than that
+            const float scale = minDistance * 1.0001f / sqrtf(lengthSq);
+            u *= scale;
+            v *= scale;
+
+            bool found = false;
+            for (int candidate = 0; candidate < CandidatesPerPoint && !found; ++candidate) {
+                found = tryAdd(origin.x + u, origin.z + v);
+                const float rotated = u * StepCos - v * StepSin;
+                v = u * StepSin + v * StepCos;
+                u = rotated;
+            }
+            if (found) {
+                active.push_back(static_cast<unsigned int>(discs.size() - 1));
+            }
+            else {
+                active[slot] = active.back();
+                active.pop_back();
+            }
+        }
+    }
+
+    // Thin the full fill by the density mask and then down to maxCount. Every instance draws
+    // its number whether there is a mask or not, so adding one doesn't reshuffle the rest.
+    std::vector<unsigned int> kept;
+    for (unsigned int i = first; i < discs.size(); ++i) {
+        float chance = random.Uniform();
+        if (!layer.density || chance < layer.density(discs[i].x, discs[i].z)) {
+            kept.push_back(i);
+        }
+    }
+    if (kept.size() > layer.maxCount) {
+        for (unsigned int i = 0; i < layer.maxCount; ++i) {
+            std::swap(kept[i], kept[i + random.Below(static_cast<unsigned int>(kept.size()) - i)]);
+        }
+        kept.resize(layer.maxCount);
+        std::sort(kept.begin(), kept.end());
+    }
+
+    for (unsigned int i = 0; i < kept.size(); ++i) {
+        discs[first + i] = discs[kept[i]];
+        outPoints.push_back({ discs[first + i].x, discs[first + i].z });
+    }
+    discs.resize(first + kept.size());
+    maxRadius = std::max(maxRadius, radius);
+}
@@ -0,0 +1,261 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Cell coordinates are packed into 21 bits per axis
+constexpr int CoordBias = 1 << 20;
+
+int CellCoord(float v, float inverseCellSize) {
+    float c = std::floor(v * inverseCellSize);
+    return static_cast<int>(std::clamp(c, static_cast<float>(-CoordBias), static_cast<float>(CoordBias - 1)));
+}
+
+}
+
+bool SpatialHash::CellRange::operator==(const CellRange& other) const {
+    return std::equal(lo, lo + 3, other.lo) && std::equal(hi, hi + 3, other.hi);
+}
+
+uint64_t SpatialHash::CellRange::CellCount() const {
+    return static_cast<uint64_t>(hi[0] - lo[0] + 1) * static_cast<uint64_t>(hi[1] - lo[1] + 1) * static_cast<uint64_t>(hi[2] - lo[2] + 1);
+}
+
+void SpatialHash::Cell::Add(unsigned int proxy, const BoundingBox& box) {
+    minX.push_back(box.minX);
+    minY.push_back(box.minY);
+    minZ.push_back(box.minZ);
+    maxX.push_back(box.maxX);
+    maxY.push_back(box.maxY);
+    maxZ.push_back(box.maxZ);
+    proxies.push_back(proxy);
+}
+
+void SpatialHash::Cell::Set(size_t slot, const BoundingBox& box) {
+    minX[slot] = box.minX;
+    minY[slot] = box.minY;
+    minZ[slot] = box.minZ;
+    maxX[slot] = box.maxX;
+    maxY[slot] = box.maxY;
+    maxZ[slot] = box.maxZ;
+}
+
+void SpatialHash::Cell::RemoveAt(size_t slot) {
+    for (std::vector<float>* column : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+        (*column)[slot] = column->back();
+        column->pop_back();
+    }
+    proxies[slot] = proxies.back();
+    proxies.pop_back();
+}
+
+size_t SpatialHash::Cell::Find(unsigned int proxy) const {
+    return std::find(proxies.begin(), proxies.end(), proxy) - proxies.begin();
+}
+
+SpatialHash::SpatialHash(float cellSize, unsigned int maxCellsPerProxy)
+    : inverseCellSize(1.0f / cellSize), maxCellsPerProxy(std::max(1u, maxCellsPerProxy)) {
+}
+
+SpatialHash::CellRange SpatialHash::RangeOf(const BoundingBox& box) const {
+    CellRange range;
+    range.lo[0] = CellCoord(box.minX, inverseCellSize);
+    range.lo[1] = CellCoord(box.minY, inverseCellSize);
+    range.lo[2] = CellCoord(box.minZ, inverseCellSize);
+    range.hi[0] = std::max(range.lo[0], CellCoord(box.maxX, inverseCellSize));
+    range.hi[1] = std::max(range.lo[1], CellCoord(box.maxY, inverseCellSize));
+    range.hi[2] = std::max(range.lo[2], CellCoord(box.maxZ, inverseCellSize));
+    return range;
+}
+
+uint64_t SpatialHash::Key(int x, int y, int z) {
+    return (static_cast<uint64_t>(x + CoordBias) << 42) | (static_cast<uint64_t>(y + CoordBias) << 21) | static_cast<uint64_t>(z + CoordBias);
+}
+
+SpatialHash::Cell* SpatialHash::FindCell(int x, int y, int z) {
+    auto found = cellLookup.find(Key(x, y, z));
+    return found == cellLookup.end() ? nullptr : &cells[found->second];
+}
+
+void SpatialHash::Link(unsigned int proxy) {
+    const Proxy& p = proxies[proxy];
+    if (p.large) {
+        largeProxies.Add(proxy, p.box);
+        return;
+    }
+    for (int x = p.range.lo[0]; x <= p.range.hi[0]; ++x) {
+        for (int y = p.range.lo[1]; y <= p.range.hi[1]; ++y) {
+            for (int z = p.range.lo[2]; z <= p.range.hi[2]; ++z) {
+                auto inserted = cellLookup.try_emplace(Key(x, y, z), 0u);
+                if (inserted.second) {
+                    if (freeCells.empty()) {
+                        inserted.first->second = static_cast<unsigned int>(cells.size());
+                        cells.emplace_back();
+                    }
+                    else {
+                        inserted.first->second = freeCells.back();
+                        freeCells.pop_back();
+                    }
+                }
+                cells[inserted.first->second].Add(proxy, p.box);
+            }
+        }
+    }
+}
+
+void SpatialHash::Unlink(unsigned int proxy) {
+    const Proxy& p = proxies[proxy];
+    if (p.large) {
+        largeProxies.RemoveAt(largeProxies.Find(proxy));
+        return;
+    }
+    for (int x = p.range.lo[0]; x <= p.range.hi[0]; ++x) {
+        for (int y = p.range.lo[1]; y <= p.range.hi[1]; ++y) {
+            for (int z = p.range.lo[2]; z <= p.range.hi[2]; ++z) {
+                auto found = cellLookup.find(Key(x, y, z));
+                if (found == cellLookup.end()) continue;
+                Cell& cell = cells[found->second];
+                cell.RemoveAt(cell.Find(proxy));
+                // Empty cells go back to the pool with their capacity, so moving objects don't allocate
+                if (cell.proxies.empty()) {
+                    freeCells.push_back(found->second);
+                    cellLookup.erase(found);
+                }
+            }
+        }
+    }
+}
+
+unsigned int SpatialHash::Insert(const BoundingBox& box, Model* model) {
+    unsigned int proxy;
+    if (freeProxies.empty()) {
+        proxy = static_cast<unsigned int>(proxies.size());
+        proxies.emplace_back();
+        queryStamps.push_back(0);
+    }
+    else {
+        proxy = freeProxies.back();
+        freeProxies.pop_back();
+    }
+
+    Proxy& p = proxies[proxy];
+    p.box = box;
+    p.model = model;
+    p.range = RangeOf(box);
+    p.large = p.range.CellCount() > maxCellsPerProxy;
+    p.alive = true;
+    Link(proxy);
+    return proxy;
+}
+
+void SpatialHash::Remove(unsigned int proxy) {
+    if (proxy >= proxies.size() || !proxies[proxy].alive) return;
+    Unlink(proxy);
+    proxies[proxy].alive = false;
+    proxies[proxy].model = nullptr;
+    freeProxies.push_back(proxy);
+}
+
+void SpatialHash::Move(unsigned int proxy, const BoundingBox& box) {
+    if (proxy >= proxies.size() || !proxies[proxy].alive) return;
+    Proxy& p = proxies[proxy];
+    CellRange range = RangeOf(box);
+    bool large = range.CellCount() > maxCellsPerProxy;
+
+    if (large == p.large && (large || range == p.range)) {
+        p.box = box;
+        if (large) {
+            largeProxies.Set(largeProxies.Find(proxy), box);
+            return;
+        }
+        for (int x = range.lo[0]; x <= range.hi[0]; ++x) {
+            for (int y = range.lo[1]; y <= range.hi[1]; ++y) {
+                for (int z = range.lo[2]; z <= range.hi[2]; ++z) {
+                    Cell* cell = FindCell(x, y, z);
+                    cell->Set(cell->Find(proxy), box);
+                }
+            }
+        }
+        return;
+    }
+
+    Unlink(proxy);
+    p.box = box;
+    p.range = range;
+    p.large = large;
+    Link(proxy);
+}
+
+void SpatialHash::Clear() {
+    cellLookup.clear();
+    cells.clear();
+    freeCells.clear();
+    largeProxies = Cell();
+    proxies.clear();
+    freeProxies.clear();
+    queryStamps.clear();
+    queryStamp = 0;
+}
+
+template <typename Visit>
+void SpatialHash::ForEachCell(const CellRange& range, Visit&& visit) {
+    // A query box larger than the occupied space walks the live cells instead of the empty grid
+    if (range.CellCount() > cellLookup.size()) {
+        for (const auto& entry : cellLookup) {
+            if (!visit(cells[entry.second])) return;
+        }
+        return;
+    }
+    for (int x = range.lo[0]; x <= range.hi[0]; ++x) {
+        for (int y = range.lo[1]; y <= range.hi[1]; ++y) {
+            for (int z = range.lo[2]; z <= range.hi[2]; ++z) {
+                if (const Cell* cell = FindCell(x, y, z)) {
+                    if (!visit(*cell)) return;
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::QueryCell(const Cell& cell, const BoundingBox& box, std::vector<unsigned int>& outProxies) {
+    if (cell.proxies.empty()) return;
+    if (hits.size() < cell.proxies.size()) hits.resize(cell.proxies.size());
+    size_t count = GeometryKernels::OverlapBoxes(cell.View(), { box.minX, box.minY, box.minZ }, { box.maxX, box.maxY, box.maxZ }, hits.data());
+    for (size_t i = 0; i < count; ++i) {
+        unsigned int proxy = cell.proxies[hits[i]];
+        if (queryStamps[proxy] != queryStamp) {
+            queryStamps[proxy] = queryStamp;
+            outProxies.push_back(proxy);
+        }
+    }
+}
+
+void SpatialHash::Query(const BoundingBox& box, std::vector<unsigned int>& outProxies) {
+    if (++queryStamp == 0) {
+        std::fill(queryStamps.begin(), queryStamps.end(), 0u);
+        queryStamp = 1;
+    }
+    QueryCell(largeProxies, box, outProxies);
+    ForEachCell(RangeOf(box), [&](const Cell& cell) {
+        QueryCell(cell, box, outProxies);
+        return true;
+    });
+}
+
+bool SpatialHash::Overlaps(const BoundingBox& box) {
+    const DirectX::XMFLOAT3 queryMin = { box.minX, box.minY, box.minZ };
+    const DirectX::XMFLOAT3 queryMax = { box.maxX, box.maxY, box.maxZ };
+    auto anyHit = [&](const Cell& cell) {
+        if (cell.proxies.empty()) return false;
+        if (hits.size() < cell.proxies.size()) hits.resize(cell.proxies.size());
+        return GeometryKernels::OverlapBoxes(cell.View(), queryMin, queryMax, hits.data()) > 0;
+    };
+    if (anyHit(largeProxies)) return true;
+    bool found = false;
+    ForEachCell(RangeOf(box), [&](const Cell& cell) {
+        found = anyHit(cell);
+        return !found;
+    });
+    return found;
+}
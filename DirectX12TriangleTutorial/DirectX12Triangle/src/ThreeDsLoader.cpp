@@ -0,0 +1,330 @@
+#include "Model.h"
+#include "File.h"
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+// Chunk ids of the parts of the 3DS format the loader understands, everything else is skipped by length
+enum Chunk3ds : uint16_t {
+    ColorF = 0x0010,
+    Color24 = 0x0011,
+    LinColor24 = 0x0012,
+    LinColorF = 0x0013,
+    PercentInt = 0x0030,
+    PercentFloat = 0x0031,
+    Main = 0x4D4D,
+    Editor = 0x3D3D,
+    Object = 0x4000,
+    TriMesh = 0x4100,
+    VertexList = 0x4110,
+    FaceList = 0x4120,
+    FaceMaterial = 0x4130,
+    UVList = 0x4140,
+    SmoothingGroups = 0x4150,
+    MaterialBlock = 0xAFFF,
+    MaterialName = 0xA000,
+    AmbientColor = 0xA010,
+    DiffuseColor = 0xA020,
+    SpecularColor = 0xA030,
+    Shininess = 0xA040,
+    TextureMap = 0xA200,
+    MapFileName = 0xA300
+};
+
+constexpr size_t ChunkHeaderSize = 6;
+
+uint16_t ReadU16(const unsigned char* p) {
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t ReadU32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+float ReadF32(const unsigned char* p) {
+    float value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Null terminated string inside [p, end), returns the first byte after it
+const unsigned char* ReadString(const unsigned char* p, const unsigned char* end, std::string& out) {
+    const unsigned char* terminator = std::find(p, end, '\0');
+    out.assign(reinterpret_cast<const char*>(p), terminator - p);
+    return terminator < end ? terminator + 1 : end;
+}
+
+}
+
+bool Model::LoadFrom3ds(const std::string& filename) {
+    MappedFile file;
+    if (!MapAssetFile(filename, file)) {
+        return false;
+    }
+    const unsigned char* const fileEnd = file.Data() + file.Size();
+    if (file.Size() < ChunkHeaderSize || ReadU16(file.Data()) != Main) {
+        std::cerr << "Not a 3DS file: " << filename << std::endl;
+        return false;
+    }
+
+    // The 3DS material block has no texture paths when exported from Blender, the .mtl written
+    // next to it does. Materials found there take precedence over the ones in the file.
+    std::string mtlFile = filename.substr(0, filename.find_last_of('.')) + ".mtl";
+    if (!GetAssetPath(mtlFile).empty()) {
+        LoadMTL(mtlFile);
+    }
+
+    // Single pass over the chunk stream. Containers are entered in place and remembered on a
+    // stack until the cursor passes their end, leaf chunks are decoded and skipped by length.
+    struct OpenChunk {
+        uint16_t id;
+        const unsigned char* end;
+    };
+    std::vector<OpenChunk> open;
+
+    // State of the mesh being decoded, all offsets are into the Model arrays
+    size_t meshBaseVertex = 0;
+    size_t meshVertexCount = 0;
+    size_t meshBaseFace = 0;
+    size_t meshFaceCount = 0;
+    std::string objectName;
+    unsigned int currentGroup = std::numeric_limits<unsigned int>::max();
+    bool hasSmoothingGroups = false;
+    bool valid = true;
+
+    // Material being parsed, committed when its block closes
+    Material material;
+    std::string materialName;
+
+    auto closeChunk = [&](const OpenChunk& chunk) {
+        if (chunk.id == TriMesh) {
+            // Faces may precede the vertex list, so indices are validated once the mesh is complete
+            const size_t end = meshBaseVertex + meshVertexCount;
+            for (size_t i = meshBaseFace * 3; i < (meshBaseFace + meshFaceCount) * 3; ++i) {
+                valid &= indices[i] < end;
+            }
+        }
+        else if (chunk.id == MaterialBlock && !materialName.empty() && materialMap.find(materialName) == materialMap.end()) {
+            materials.push_back(material);
+            materialNames.push_back(materialName);
+            materialMap[materialName] = static_cast<unsigned int>(materials.size() - 1);
+        }
+    };
+
+    const unsigned char* p = file.Data();
+    while (valid) {
+        while (!open.empty() && p >= open.back().end) {
+            closeChunk(open.back());
+            open.pop_back();
+        }
+        const unsigned char* limit = open.empty() ? fileEnd : open.back().end;
+        if (static_cast<size_t>(limit - p) < ChunkHeaderSize) break;
+
+        const uint16_t id = ReadU16(p);
+        const uint32_t length = ReadU32(p + 2);
+        if (length < ChunkHeaderSize || length > static_cast<size_t>(limit - p)) {
+            valid = false;
+            break;
+        }
+        const unsigned char* body = p + ChunkHeaderSize;
+        const unsigned char* chunkEnd = p + length;
+        const size_t bodySize = chunkEnd - body;
+        const uint16_t parent = open.empty() ? 0 : open.back().id;
+
+        switch (id) {
+        case Main:
+        case Editor:
+        case TriMesh:
+        case AmbientColor:
+        case DiffuseColor:
+        case SpecularColor:
+        case Shininess:
+        case TextureMap:
+            if (id == TriMesh) {
+                meshBaseVertex = vertices.size();
+                meshVertexCount = 0;
+                meshBaseFace = indices.size() / 3;
+                meshFaceCount = 0;
+            }
+            open.push_back({ id, chunkEnd });
+            p = body;
+            continue;
+
+        case MaterialBlock:
+            material = Material();
+            material.initialized = true;
+            materialName.clear();
+            open.push_back({ id, chunkEnd });
+            p = body;
+            continue;
+
+        case Object: {
+            // Every named object becomes a group, created with its first faces so cameras and
+            // lights don't leave empty groups behind
+            p = ReadString(body, chunkEnd, objectName);
+            currentGroup = std::numeric_limits<unsigned int>::max();
+            open.push_back({ id, chunkEnd });
+            continue;
+        }
+
+        case VertexList:
+        case UVList: {
+            if (bodySize < 2) break;
+            const size_t count = std::min<size_t>(ReadU16(body), (bodySize - 2) / (id == VertexList ? 12 : 8));
+            meshVertexCount = std::max(meshVertexCount, count);
+            if (vertices.size() < meshBaseVertex + count) {
+                vertices.resize(meshBaseVertex + count);
+            }
+            const unsigned char* src = body + 2;
+            Vertex* dst = vertices.data() + meshBaseVertex;
+            if (id == VertexList) {
+                // 3DS is Z up, rotate into the Y up frame the OBJ exports use: (x, y, z) -> (x, z, -y)
+                for (size_t i = 0; i < count; ++i, src += 12) {
+                    dst[i].position = { ReadF32(src), ReadF32(src + 8), -ReadF32(src + 4) };
+                }
+            }
+            else {
+                // V points up like in OBJ, DirectX expects it pointing down
+                for (size_t i = 0; i < count; ++i, src += 8) {
+                    dst[i].uv = { ReadF32(src), 1.0f - ReadF32(src + 4) };
+                }
+            }
+            break;
+        }
+
+        case FaceList: {
+            if (bodySize < 2) break;
+            const size_t count = std::min<size_t>(ReadU16(body), (bodySize - 2) / 8);
+            meshFaceCount = count;
+            if (currentGroup == std::numeric_limits<unsigned int>::max()) {
+                currentGroup = static_cast<unsigned int>(groupNames.size());
+                groupNames.push_back(objectName.empty() ? "default" : objectName);
+            }
+            indices.resize((meshBaseFace + count) * 3);
+            materialIndices.resize(meshBaseFace + count, std::numeric_limits<unsigned int>::max());
+            groupIndices.resize(meshBaseFace + count, currentGroup);
+            const unsigned char* src = body + 2;
+            unsigned int* dst = indices.data() + meshBaseFace * 3;
+            const unsigned int base = static_cast<unsigned int>(meshBaseVertex);
+            for (size_t i = 0; i < count; ++i, src += 8) {
+                // a, b, c, edge visibility flags
+                dst[i * 3] = base + ReadU16(src);
+                dst[i * 3 + 1] = base + ReadU16(src + 2);
+                dst[i * 3 + 2] = base + ReadU16(src + 4);
+            }
+            // Material and smoothing chunks follow the face records
+            open.push_back({ id, chunkEnd });
+            p = body + 2 + count * 8;
+            continue;
+        }
+
+        case FaceMaterial: {
+            if (parent != FaceList) break;
+            std::string name;
+            const unsigned char* src = ReadString(body, chunkEnd, name);
+            if (chunkEnd - src < 2) break;
+            const size_t count = std::min<size_t>(ReadU16(src), (chunkEnd - src - 2) / 2);
+            src += 2;
+            auto found = materialMap.find(name);
+            if (found == materialMap.end()) {
+                std::cerr << "Warning: Material " << name << " not found in material map." << std::endl;
+                break;
+            }
+            for (size_t i = 0; i < count; ++i, src += 2) {
+                const size_t face = ReadU16(src);
+                if (face < meshFaceCount) materialIndices[meshBaseFace + face] = found->second;
+            }
+            break;
+        }
+
+        case SmoothingGroups: {
+            if (parent != FaceList) break;
+            // Meshes without the chunk keep group 0, flat shaded
+            hasSmoothingGroups = true;
+            smoothingGroups.resize(meshBaseFace + meshFaceCount, 0);
+            const size_t count = std::min(meshFaceCount, bodySize / 4);
+            for (size_t i = 0; i < count; ++i) {
+                smoothingGroups[meshBaseFace + i] = ReadU32(body + i * 4);
+            }
+            break;
+        }
+
+        case MaterialName:
+            if (parent == MaterialBlock) ReadString(body, chunkEnd, materialName);
+            break;
+
+        case MapFileName:
+            if (parent == TextureMap) {
+                ReadString(body, chunkEnd, material.diffuseMap);
+                material.textureImage.LoadFromImage(material.diffuseMap);
+            }
+            break;
+
+        case ColorF:
+        case LinColorF:
+        case Color24:
+        case LinColor24: {
+            DirectX::XMFLOAT3 color;
+            if (id == ColorF || id == LinColorF) {
+                if (bodySize < 12) break;
+                color = { ReadF32(body), ReadF32(body + 4), ReadF32(body + 8) };
+            }
+            else {
+                if (bodySize < 3) break;
+                color = { body[0] / 255.0f, body[1] / 255.0f, body[2] / 255.0f };
+            }
+            if (parent == AmbientColor) material.ambient = color;
+            else if (parent == DiffuseColor) material.diffuse = color;
+            else if (parent == SpecularColor) material.specular = color;
+            break;
+        }
+
+        case PercentInt:
+        case PercentFloat:
+            if (parent == Shininess) {
+                float percent = id == PercentInt ? (bodySize >= 2 ? ReadU16(body) : 0.0f) : (bodySize >= 4 ? ReadF32(body) : 0.0f);
+                // Same 0..128 range as the Phong exponent in the OBJ exports
+                material.shininess = std::max(1.0f, percent * 1.28f);
+            }
+            break;
+
+        default:
+            break;
+        }
+        p = chunkEnd;
+    }
+    while (valid && !open.empty()) {
+        closeChunk(open.back());
+        open.pop_back();
+    }
+
+    if (!valid) {
+        std::cerr << "Corrupt 3DS file: " << filename << std::endl;
+        Clear();
+        return false;
+    }
+    if (indices.empty()) {
+        std::cerr << "No triangles found in " << filename << std::endl;
+        return false;
+    }
+    if (hasSmoothingGroups) {
+        smoothingGroups.resize(indices.size() / 3, 0);
+    }
+
+    // 3DS carries no normals. Its smoothing groups are bitmasks, faces sharing a group smooth.
+    NormalGeneratorOptions normalOptions;
+    normalOptions.smoothingGroupMasks = true;
+    ComputeNormals(normalOptions);
+    ComputeBoundingBox();
+    SortByMaterial();
+
+    return true;
+}
@@ -0,0 +1,223 @@
+#include "TransformGraph.h"
+#include "JobSystem.h"
+#include "GeometryKernels.h"
+#include <algorithm>
+
+uint32_t TransformGraph::Add(const DirectX::XMFLOAT4X4& local, uint32_t parent) {
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else {
+        id = static_cast<uint32_t>(denseOf.size());
+        denseOf.push_back(NoNode);
+        firstChild.push_back(NoNode);
+        nextSibling.push_back(NoNode);
+        previousSibling.push_back(NoNode);
+    }
+
+    const uint32_t parentDense = IsAlive(parent) ? denseOf[parent] : NoNode;
+    DirectX::XMFLOAT4X4 world = local;
+    if (parentDense != NoNode) {
+        DirectX::XMStoreFloat4x4(&world, DirectX::XMLoadFloat4x4(&local) * DirectX::XMLoadFloat4x4(&worlds[parentDense]));
+
+        // First in the parent's list of children
+        nextSibling[id] = firstChild[parent];
+        if (firstChild[parent] != NoNode) previousSibling[firstChild[parent]] = id;
+        firstChild[parent] = id;
+    }
+
+    // Appending keeps parents ahead of their children, the levels are sorted out by Update
+    denseOf[id] = static_cast<uint32_t>(ids.size());
+    ids.push_back(id);
+    parents.push_back(parentDense);
+    locals.push_back(local);
+    worlds.push_back(world);
+    normals.push_back(NormalMatrix(world));
+    dirty.push_back(parentDense != NoNode ? dirty[parentDense] : 0);
+    dead.push_back(0);
+    orderDirty = true;
+    return id;
+}
+
+void TransformGraph::Remove(uint32_t node, std::vector<uint32_t>* removed) {
+    if (!IsAlive(node)) return;
+
+    // Out of the parent's list of children
+    const uint32_t parent = GetParent(node);
+    if (previousSibling[node] != NoNode) nextSibling[previousSibling[node]] = nextSibling[node];
+    else if (parent != NoNode) firstChild[parent] = nextSibling[node];
+    if (nextSibling[node] != NoNode) previousSibling[nextSibling[node]] = previousSibling[node];
+
+    // Only the subtree is visited, parents before their children. The dense entries stay
+    // behind as tombstones until the next Reorder.
+    pending.clear();
+    pending.push_back(node);
+    for (size_t next = 0; next < pending.size(); ++next) {
+        const uint32_t id = pending[next];
+        for (uint32_t child = firstChild[id]; child != NoNode; child = nextSibling[child]) {
+            pending.push_back(child);
+        }
+        dead[denseOf[id]] = 1;
+        denseOf[id] = NoNode;
+        firstChild[id] = NoNode;
+        nextSibling[id] = NoNode;
+        previousSibling[id] = NoNode;
+        freeIds.push_back(id);
+        if (removed) removed->push_back(id);
+    }
+    deadCount += pending.size();
+    orderDirty = true;
+}
+
+void TransformGraph::Clear() {
+    ids.clear();
+    parents.clear();
+    locals.clear();
+    worlds.clear();
+    normals.clear();
+    dirty.clear();
+    dead.clear();
+    levelStarts.clear();
+    denseOf.clear();
+    freeIds.clear();
+    firstChild.clear();
+    nextSibling.clear();
+    previousSibling.clear();
+    updated.clear();
+    orderDirty = false;
+    deadCount = 0;
+    stats = TransformGraphStats();
+}
+
+void TransformGraph::SetLocal(uint32_t node, const DirectX::XMFLOAT4X4& local) {
+    if (!IsAlive(node)) return;
+    locals[denseOf[node]] = local;
+    dirty[denseOf[node]] = 1;
+}
+
+uint32_t TransformGraph::GetParent(uint32_t node) const {
+    if (!IsAlive(node)) return NoNode;
+    const uint32_t parent = parents[denseOf[node]];
+    return parent != NoNode ? ids[parent] : NoNode;
+}
+
+void TransformGraph::Update() {
+    if (orderDirty) Reorder();
+
+    // Dense indices first, a parent's flag is still set while its children are looked at
+    batch.clear();
+    size_t levelBegin = 0;
+    for (size_t level = 0; level + 1 < levelStarts.size(); ++level) {
+        const uint32_t begin = levelStarts[level];
+        const uint32_t end = levelStarts[level + 1];
+        levelBegin = batch.size();
+        for (uint32_t i = begin; i < end; ++i) {
+            if (dirty[i] || (parents[i] != NoNode && dirty[parents[i]])) {
+                dirty[i] = 1;
+                batch.push_back(i);
+            }
+        }
+        const size_t count = batch.size() - levelBegin;
+        if (count == 0) continue;
+
+        if (level == 0) {
+            for (size_t k = levelBegin; k < batch.size(); ++k) {
+                worlds[batch[k]] = locals[batch[k]];
+            }
+            continue;
+        }
+
+        // The parents are done, the whole level is one batch
+        batchLocals.resize(count);
+        batchParents.resize(count);
+        for (size_t k = 0; k < count; ++k) {
+            const uint32_t i = batch[levelBegin + k];
+            batchLocals[k] = locals[i];
+            batchParents[k] = worlds[parents[i]];
+        }
+        GeometryKernels::MultiplyMatrices(batchLocals.data(), batchParents.data(), batchLocals.data(), count);
+        for (size_t k = 0; k < count; ++k) {
+            worlds[batch[levelBegin + k]] = batchLocals[k];
+        }
+    }
+
+    // Inverses are independent, large batches are split across cores
+    JobSystem::Get().ParallelFor(batch.size(), [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            normals[batch[k]] = NormalMatrix(worlds[batch[k]]);
+        }
+    }, 256);
+
+    updated.clear();
+    for (uint32_t i : batch) {
+        dirty[i] = 0;
+        updated.push_back(ids[i]);
+    }
+    stats.nodes = static_cast<unsigned int>(Size());
+    stats.levels = levelStarts.empty() ? 0 : static_cast<unsigned int>(levelStarts.size() - 1);
+    stats.updated = static_cast<unsigned int>(batch.size());
+}
+
+void TransformGraph::Reorder() {
+    orderDirty = false;
+
+    // Parents first, so depths come out of a single pass. Tombstones have no depth, a dead
+    // node's children are dead too.
+    const size_t live = Size();
+    std::vector<uint32_t> depths(ids.size());
+    uint32_t maxDepth = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (dead[i]) continue;
+        depths[i] = parents[i] != NoNode ? depths[parents[i]] + 1 : 0;
+        maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    // Stable counting sort by depth
+    levelStarts.assign(live == 0 ? 1 : maxDepth + 2, 0);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (!dead[i]) ++levelStarts[depths[i] + 1];
+    }
+    for (size_t level = 1; level < levelStarts.size(); ++level) levelStarts[level] += levelStarts[level - 1];
+
+    std::vector<uint32_t> cursor(levelStarts.begin(), levelStarts.end() - 1);
+    remap.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        remap[i] = dead[i] ? NoNode : cursor[depths[i]]++;
+    }
+
+    std::vector<uint32_t> newIds(live);
+    std::vector<uint32_t> newParents(live);
+    std::vector<DirectX::XMFLOAT4X4> newLocals(live);
+    std::vector<DirectX::XMFLOAT4X4> newWorlds(live);
+    std::vector<DirectX::XMFLOAT4X4> newNormals(live);
+    std::vector<uint8_t> newDirty(live);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        // The id of a tombstone may belong to a node added since
+        if (dead[i]) continue;
+        const uint32_t to = remap[i];
+        newIds[to] = ids[i];
+        newParents[to] = parents[i] != NoNode ? remap[parents[i]] : NoNode;
+        newLocals[to] = locals[i];
+        newWorlds[to] = worlds[i];
+        newNormals[to] = normals[i];
+        newDirty[to] = dirty[i];
+        denseOf[ids[i]] = to;
+    }
+    ids.swap(newIds);
+    parents.swap(newParents);
+    locals.swap(newLocals);
+    worlds.swap(newWorlds);
+    normals.swap(newNormals);
+    dirty.swap(newDirty);
+    dead.assign(live, 0);
+    deadCount = 0;
+}
+
+DirectX::XMFLOAT4X4 TransformGraph::NormalMatrix(const DirectX::XMFLOAT4X4& world) {
+    DirectX::XMVECTOR det;
+    DirectX::XMFLOAT4X4 normal;
+    DirectX::XMStoreFloat4x4(&normal, DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, DirectX::XMLoadFloat4x4(&world))));
+    return normal;
+}
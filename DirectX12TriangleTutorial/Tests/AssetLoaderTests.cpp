@@ -0,0 +1,153 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "AssetLoader.h"
+#include "Task.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+    // Keeps every worker busy until released, so the loads started meanwhile all queue up
+    // before the first of them is read. The main thread doesn't run jobs here, it only polls
+    // like a frame would.
+    class WorkerHold {
+    public:
+        WorkerHold() {
+            const unsigned int workers = JobSystem::Get().GetThreadCount() - 1;
+            for (unsigned int i = 0; i < workers; ++i) {
+                JobSystem::Get().Run([this] {
+                    ++held;
+                    while (!released) std::this_thread::yield();
+                }, &holding);
+            }
+            while (held < workers) std::this_thread::yield();
+        }
+        ~WorkerHold() {
+            Release();
+            JobSystem::Get().Wait(holding);
+        }
+
+        void Release() { released = true; }
+
+    private:
+        std::atomic<unsigned int> held{ 0 };
+        std::atomic<bool> released{ false };
+        JobCounter holding;
+    };
+
+    struct Resumed {
+        bool resumed = false;
+        bool onMainThread = false;
+        unsigned int vertices = 0;
+    };
+
+    Task<> AwaitModel(AssetTask<std::unique_ptr<Model>> load, Resumed& out) {
+        std::unique_ptr<Model> model = co_await load;
+        out.resumed = true;
+        out.onMainThread = JobSystem::Get().IsMainThread();
+        out.vertices = model ? model->GetNumVertices() : 0;
+    }
+
+    // Polls until every load is ready, false if that takes longer than any machine should need
+    bool WaitUntilReady(const std::vector<AssetTask<std::unique_ptr<Model>>>& loads, std::vector<float>* progress = nullptr) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (std::chrono::steady_clock::now() < deadline) {
+            bool ready = true;
+            for (size_t i = 0; i < loads.size(); ++i) {
+                ready = ready && loads[i].IsReady();
+                if (progress) progress->push_back(loads[i].GetProgress());
+            }
+            if (ready) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+}
+
+TEST(AssetLoaderPrioritiesAndCancellation) {
+    const char* names[] = { "loader_first.obj", "loader_low.obj", "loader_normal.obj", "loader_high.obj", "loader_cancelled.obj" };
+    const std::string directory = TestMeshes::GeneratedAssetDirectory();
+    for (const char* name : names) {
+        std::ofstream(directory + "/" + name) << TestMeshes::GridObj(64, 10.0f);
+    }
+    const unsigned int gridVertices = TestMeshes::Load(TestMeshes::GridObj(64, 10.0f))->GetNumVertices();
+
+    // A one byte budget reads the files one after the other, in priority order
+    AssetLoader loader(1);
+    std::vector<int> completed;
+    std::mutex completedMutex;
+    const auto recordAs = [&](int index) {
+        return [&, index](Model&) {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            completed.push_back(index);
+        };
+    };
+
+    std::vector<AssetTask<std::unique_ptr<Model>>> loads;
+    Resumed resumed;
+    Task<> awaiting;
+    WorkerHold hold;
+    // The first is read right away, the budget holds back the rest
+    loads.push_back(loader.LoadModelAsync(names[0], recordAs(0), AssetPriority::Normal));
+    loads.push_back(loader.LoadModelAsync(names[1], recordAs(1), AssetPriority::Low));
+    loads.push_back(loader.LoadModelAsync(names[2], recordAs(2), AssetPriority::Normal));
+    loads.push_back(loader.LoadModelAsync(names[3], recordAs(3), AssetPriority::High));
+    AssetTask<std::unique_ptr<Model>> cancelled = loader.LoadModelAsync(names[4], recordAs(4), AssetPriority::High);
+    cancelled.Cancel();
+    loads.push_back(cancelled);
+
+    awaiting = AwaitModel(loads[2], resumed);
+    CHECK(!awaiting.IsDone());
+    for (const auto& load : loads) CHECK(!load.IsReady() && load.GetProgress() == 0.0f);
+    hold.Release();
+
+    std::vector<float> progress;
+    CHECK(WaitUntilReady(loads, &progress));
+    // Earlier samples of a load never read more than later ones
+    bool monotonic = true;
+    for (size_t i = loads.size(); i < progress.size(); ++i) {
+        monotonic = monotonic && progress[i] >= progress[i - loads.size()];
+    }
+    CHECK(monotonic);
+    for (const auto& load : loads) CHECK(load.GetProgress() == 1.0f);
+
+    // High before Normal before Low, the cancelled one never gets as far as preparing
+    CHECK((completed == std::vector<int>{ 0, 3, 2, 1 }));
+    CHECK(loads[4].IsCancelled());
+    CHECK(loads[4].Take() == nullptr);
+
+    // The coroutine waits for Update even though its model arrived
+    CHECK(!resumed.resumed && !awaiting.IsDone());
+    CHECK(loader.Update() == 1);
+    CHECK(resumed.resumed && resumed.onMainThread && resumed.vertices == gridVertices);
+    CHECK(awaiting.IsDone());
+    CHECK(loader.Update() == 0);
+
+    for (int i : { 0, 1, 3 }) {
+        std::unique_ptr<Model> model = loads[i].Take();
+        CHECK(model && model->GetNumVertices() == gridVertices);
+    }
+
+    const AssetLoaderStats stats = loader.GetStats();
+    CHECK(stats.models == 5);
+    CHECK(stats.peakBytesInFlight <= std::filesystem::file_size(directory + "/" + names[0]));
+}
+
+TEST(AssetLoaderResumesFinishedLoadsRightAway) {
+    std::ofstream(TestMeshes::GeneratedAssetDirectory() + "/loader_ready.obj") << TestMeshes::BoxObj({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+    AssetLoader loader;
+    AssetTask<std::unique_ptr<Model>> load = loader.LoadModelAsync("loader_ready.obj");
+    CHECK(WaitUntilReady({ load }));
+
+    // Awaiting a load that is already in doesn't suspend, nothing is left for Update
+    Resumed resumed;
+    Task<> awaiting = AwaitModel(load, resumed);
+    CHECK(resumed.resumed && awaiting.IsDone() && resumed.vertices > 0);
+    CHECK(loader.Update() == 0);
+
+    // A file that isn't there completes empty
+    AssetTask<std::unique_ptr<Model>> missing = loader.LoadModelAsync("loader_missing.obj");
+    CHECK(WaitUntilReady({ missing }));
+    CHECK(missing.Take() == nullptr);
+}
@@ -0,0 +1,109 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "CharacterController.h"
+#include <iostream>
+#include <random>
+
+namespace {
+    // Ground grid plus crates and walls scattered over it, half of them collided through their
+    // hulls and half through their triangles
+    struct Arena {
+        std::unique_ptr<Model> ground;
+        std::vector<std::unique_ptr<Model>> obstacles;
+        SpatialHash broadphase;
+
+        Arena(unsigned int count, float halfSize) {
+            ground = TestMeshes::Load(TestMeshes::GridObj(64, halfSize * 2.0f));
+            ground->BuildBvh();
+
+            std::unique_ptr<Model> hullBox = TestMeshes::Load(TestMeshes::BoxObj({ -1.0f, 0.0f, -1.0f }, { 1.0f, 2.0f, 1.0f }));
+            hullBox->BuildCollisionHulls();
+            hullBox->BuildBvh();
+            std::unique_ptr<Model> meshBox = TestMeshes::Load(TestMeshes::BoxObj({ -1.0f, 0.0f, -1.0f }, { 1.0f, 2.0f, 1.0f }));
+            meshBox->BuildBvh();
+
+            std::mt19937 rng(11);
+            std::uniform_real_distribution<float> position(-halfSize, halfSize), size(0.5f, 6.0f), yaw(0.0f, DirectX::XM_2PI);
+            for (unsigned int i = 0; i < count; ++i) {
+                auto obstacle = std::make_unique<Model>(i % 2 ? *hullBox : *meshBox);
+                obstacle->SetScale(size(rng), size(rng) * 0.5f, size(rng));
+                obstacle->SetRotation(0.0f, yaw(rng), 0.0f);
+                obstacle->SetPosition(position(rng), 0.0f, position(rng));
+                obstacle->broadphaseProxy = broadphase.Insert(obstacle->b, obstacle.get());
+                obstacles.push_back(std::move(obstacle));
+            }
+        }
+
+        void Attach(CharacterController& controller) {
+            controller.broadphase = &broadphase;
+            controller.terrain = { ground.get() };
+        }
+    };
+}
+
+TEST(CharacterControllerStopsAtObstacles) {
+    Arena arena(0, 50.0f);
+    std::unique_ptr<Model> wall = TestMeshes::Load(TestMeshes::BoxObj({ -10.0f, 0.0f, 19.9f }, { 10.0f, 10.0f, 20.1f }));
+    wall->BuildCollisionHulls();
+    wall->broadphaseProxy = arena.broadphase.Insert(wall->b, wall.get());
+
+    CharacterController controller;
+    arena.Attach(controller);
+    controller.position = { 0.0f, 5.0f, 0.0f };
+    controller.Move({ 0.0f, -10.0f, 0.0f });
+    CHECK(controller.IsGrounded());
+    CHECK(std::abs(controller.position.y) < 0.1f);
+
+    // One step far longer than the wall is thick
+    const unsigned int flags = controller.Move({ 0.0f, 0.0f, 50.0f });
+    CHECK(flags & CollisionSides);
+    CHECK(controller.position.z + controller.radius <= 19.9f + 1e-3f);
+}
+
+BENCHMARK(CharacterControllerCrowd) {
+    // Agents wander between a thousand obstacles, each one moves once per frame
+    Arena arena(1000, 200.0f);
+    const unsigned int agents = 4000;
+    const int frames = 10;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f), step(-0.3f, 0.3f);
+
+    CharacterController controller;
+    arena.Attach(controller);
+    std::vector<DirectX::XMFLOAT3> feet(agents);
+    for (DirectX::XMFLOAT3& p : feet) {
+        controller.position = { position(rng), 3.0f, position(rng) };
+        controller.Move({ 0.0f, -5.0f, 0.0f });
+        p = controller.position;
+    }
+
+    unsigned int blocked = 0;
+    const double moveMs = Test::BestMs(3, [&] {
+        blocked = 0;
+        for (int frame = 0; frame < frames; ++frame) {
+            for (DirectX::XMFLOAT3& p : feet) {
+                controller.position = p;
+                blocked += (controller.Move({ step(rng), -0.2f, step(rng) }) & CollisionSides) != 0;
+                p = controller.position;
+            }
+        }
+    }) / frames;
+
+    // The broadphase part of it, one capsule sized query per agent
+    std::vector<unsigned int> proxies;
+    size_t candidates = 0;
+    const double queryMs = Test::BestMs(3, [&] {
+        candidates = 0;
+        for (const DirectX::XMFLOAT3& p : feet) {
+            BoundingBox box;
+            box.SetBbox(p.x - 3.0f, p.x + 3.0f, p.z - 3.0f, p.z + 3.0f, p.y, p.y + controller.height);
+            proxies.clear();
+            arena.broadphase.Query(box, proxies);
+            candidates += proxies.size();
+        }
+    });
+
+    std::cout << "  " << agents << " moves per frame: " << moveMs << " ms (" << moveMs * 1000.0 / agents << " us per move, "
+        << blocked / frames << " blocked), broadphase queries " << queryMs << " ms (" << double(candidates) / agents
+        << " candidates per query)" << std::endl;
+}
@@ -0,0 +1,162 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "ChunkStreamer.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+namespace {
+    // Same count as the streamer's budget: geometry and textures, in memory and on the GPU
+    size_t MeshBytes(const Model& model) {
+        size_t bytes = model.GetVertices().size() * sizeof(Vertex) + model.GetIndices().size() * sizeof(unsigned int);
+        for (const Material& material : model.GetMaterials()) {
+            bytes += static_cast<size_t>(material.textureImage.GetWidth()) * material.textureImage.GetHeight() * 4;
+        }
+        return 2 * bytes;
+    }
+
+    struct StreamedWorld {
+        EntityStore entities;
+        SpatialHash broadphase;
+        std::vector<Model*> terrain;
+        ChunkStreamer streamer;
+
+        StreamedWorld() {
+            streamer.entities = &entities;
+            streamer.broadphase = &broadphase;
+            streamer.terrain = &terrain;
+        }
+
+        // Updates at p until nothing is in flight any more
+        void Settle(const DirectX::XMFLOAT3& p) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+            do {
+                streamer.Update(p);
+                entities.TakeChanges();
+            } while (streamer.GetStats().loading > 0 && std::chrono::steady_clock::now() < deadline);
+        }
+    };
+}
+
+TEST(ChunkStreamerSharesLayerMeshes) {
+    std::shared_ptr<Model> tree(TestMeshes::Load(TestMeshes::SphereObj(8, 12, 2.0f)));
+    std::unique_ptr<Model> ground = TestMeshes::Load(TestMeshes::GridObj(4, 10.0f));
+    std::vector<ChunkLayer> layers(1);
+    layers[0].source = tree;
+    layers[0].perChunk = 3;
+    const long owners = tree.use_count();
+
+    StreamedWorld world;
+    ChunkStreamerOptions options;
+    options.chunkSize = 50.0f;
+    options.loadRadius = 120.0f;
+    options.unloadRadius = 160.0f;
+    world.streamer.Build(-500.0f, -500.0f, 500.0f, 500.0f, 1, layers, {}, ground.get(), "", options);
+    world.Settle({ 0.0f, 0.0f, 0.0f });
+
+    ChunkStreamerStats stats = world.streamer.GetStats();
+    CHECK(stats.resident > 1 && stats.stalls == 0);
+    CHECK(world.terrain.size() == stats.resident);
+    // Every model is an instance: the trees draw the template, the tiles one scaled ground
+    bool instances = true;
+    const Model* tileMesh = &world.terrain.front()->GetMesh();
+    for (const Model* model : world.entities.GetModels()) {
+        instances = instances && model->IsInstance() && (&model->GetMesh() == tree.get() || &model->GetMesh() == tileMesh);
+    }
+    CHECK(instances);
+    CHECK(tileMesh != ground.get() && tileMesh->GetNumVertices() == ground->GetNumVertices());
+
+    // Each mesh counts once however many chunks use it
+    CHECK(stats.meshBytes == MeshBytes(*tree) + MeshBytes(*ground));
+    CHECK(stats.residentBytes == stats.meshBytes + world.entities.Size() * (sizeof(Model) + InstanceConstantsSize));
+
+    // Far away the old chunks go, the meshes stay counted for the new ones
+    world.Settle({ 400.0f, 0.0f, 400.0f });
+    stats = world.streamer.GetStats();
+    CHECK(stats.unloads > 0 && stats.stalls == 1);
+    CHECK(stats.meshBytes == MeshBytes(*tree) + MeshBytes(*ground));
+    CHECK(stats.residentBytes == stats.meshBytes + world.entities.Size() * (sizeof(Model) + InstanceConstantsSize));
+
+    world.streamer.Clear();
+    world.entities.TakeChanges();
+    CHECK(world.entities.Size() == 0 && world.terrain.empty());
+    CHECK(world.streamer.GetStats().residentBytes == 0);
+    // The streamer and the instances let go of the template
+    CHECK(tree.use_count() == owners);
+}
+
+BENCHMARK(ChunkStreamerFlyThrough) {
+    // The game's world, trees and ground, flown over along a fixed path: across the world at
+    // walking speed, then back at ten times that, then a circle. Every frame the camera moves
+    // and the streamer updates, 4 ms of other frame work give the reads time to run.
+    std::shared_ptr<Model> tree = std::make_shared<Model>();
+    Model ground;
+    if (!tree->LoadFromObj("Mineways2Skfb.obj") || !ground.LoadFromObj("grassplane.obj")) {
+        std::cout << "  assets missing" << std::endl;
+        return;
+    }
+    tree->SetScale(30.0f, 30.0f, 30.0f);
+    std::vector<ChunkLayer> layers(1);
+    layers[0].source = tree;
+    layers[0].y = -15.0f;
+    layers[0].perChunk = 3;
+
+    const float half = 2000.0f;
+    StreamedWorld world;
+    const double buildMs = Test::BestMs(1, [&] {
+        world.streamer.Build(-half, -half, half, half, 1, layers, {}, &ground, "flythrough.chunks");
+    });
+    const ChunkStreamerStats built = world.streamer.GetStats();
+    std::cout << "  " << built.chunks << " chunks, " << built.bakedInstances << " trees, built in " << buildMs << " ms"
+        << (built.loadedFromCache ? " (cached)" : "") << std::endl;
+
+    struct Leg {
+        const char* name;
+        DirectX::XMFLOAT3 from, to;
+        float metersPerFrame;
+    };
+    const Leg legs[] = {
+        { "walk east", { -1800.0f, 5.0f, -300.0f }, { 1800.0f, 5.0f, -300.0f }, 5.0f },
+        { "fly west", { 1800.0f, 5.0f, 300.0f }, { -1800.0f, 5.0f, 300.0f }, 50.0f },
+    };
+    const auto run = [&](const char* name, int frames, auto&& position) {
+        const ChunkStreamerStats before = world.streamer.GetStats();
+        double worstMs = 0.0, totalMs = 0.0;
+        unsigned int peakResident = 0;
+        size_t peakBytes = 0;
+        for (int frame = 0; frame < frames; ++frame) {
+            const DirectX::XMFLOAT3 p = position(frame);
+            const double ms = Test::BestMs(1, [&] {
+                world.streamer.Update(p);
+                world.entities.TakeChanges();
+            });
+            worstMs = std::max(worstMs, ms);
+            totalMs += ms;
+            peakResident = std::max(peakResident, world.streamer.GetStats().resident);
+            peakBytes = std::max(peakBytes, world.streamer.GetStats().residentBytes);
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+        }
+        const ChunkStreamerStats after = world.streamer.GetStats();
+        std::cout << "  " << name << ": " << frames << " frames, Update " << totalMs / frames << " ms average, " << worstMs << " ms worst, "
+            << "at most " << peakResident << " chunks resident (" << peakBytes / 1024 << " KB, meshes " << after.meshBytes / 1024 << " KB), "
+            << after.loads - before.loads << " loads, " << after.unloads - before.unloads << " unloads, "
+            << after.stalls - before.stalls << " stalls, worst " << after.worstStallMs << " ms" << std::endl;
+    };
+
+    for (const Leg& leg : legs) {
+        const float dx = leg.to.x - leg.from.x, dz = leg.to.z - leg.from.z;
+        const int frames = static_cast<int>(std::sqrt(dx * dx + dz * dz) / leg.metersPerFrame);
+        run(leg.name, frames, [&](int frame) {
+            const float t = static_cast<float>(frame) / static_cast<float>(frames);
+            return DirectX::XMFLOAT3{ leg.from.x + dx * t, leg.from.y, leg.from.z + dz * t };
+        });
+    }
+    run("circle", 720, [](int frame) {
+        const float angle = DirectX::XM_2PI * static_cast<float>(frame) / 720.0f;
+        return DirectX::XMFLOAT3{ 1000.0f * std::cos(angle), 5.0f, 1000.0f * std::sin(angle) };
+    });
+
+    world.streamer.Clear();
+    world.entities.TakeChanges();
+}
@@ -0,0 +1,376 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "Culling.h"
+#include "OcclusionCuller.h"
+#include "Scatter.h"
+#include "Bvh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace {
+    const DirectX::XMMATRIX Projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+    DirectX::XMMATRIX LookAt(const DirectX::XMFLOAT3& eye, const DirectX::XMFLOAT3& target) {
+        return DirectX::XMMatrixLookAtLH(DirectX::XMLoadFloat3(&eye), DirectX::XMLoadFloat3(&target), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    }
+
+    // True when every front facing triangle with a corner on screen is inside one of the ranges
+    bool KeepsVisibleTriangles(const Model& model, DirectX::FXMMATRIX world, DirectX::CXMMATRIX viewProj,
+        const DirectX::XMFLOAT3& eye, const std::vector<DrawRange>& ranges)
+    {
+        std::vector<bool> drawn(model.GetNumIndices() / 3, false);
+        for (const DrawRange& range : ranges) {
+            for (unsigned int i = range.startIndex; i < range.startIndex + range.indexCount; i += 3) drawn[i / 3] = true;
+        }
+
+        const std::vector<Vertex>& vertices = model.GetVertices();
+        const std::vector<unsigned int>& indices = model.GetIndices();
+        const DirectX::XMVECTOR camera = DirectX::XMLoadFloat3(&eye);
+        for (size_t face = 0; face < drawn.size(); ++face) {
+            DirectX::XMVECTOR p[3];
+            bool onScreen = false;
+            for (int corner = 0; corner < 3; ++corner) {
+                p[corner] = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&vertices[indices[face * 3 + corner]].position), world);
+                DirectX::XMFLOAT4 clip;
+                DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(DirectX::XMVectorSetW(p[corner], 1.0f), viewProj));
+                onScreen |= clip.w > 0.0f && std::abs(clip.x) < clip.w && std::abs(clip.y) < clip.w && clip.z > 0.0f && clip.z < clip.w;
+            }
+            // Same winding as the meshlet normal cones
+            DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p[1], p[0]), DirectX::XMVectorSubtract(p[2], p[0]));
+            bool frontFacing = DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, DirectX::XMVectorSubtract(p[0], camera))) < 0.0f;
+            if (onScreen && frontFacing && !drawn[face]) return false;
+        }
+        return true;
+    }
+}
+
+TEST(ClusterCullerKeepsVisibleMeshlets) {
+    std::unique_ptr<Model> sphere = TestMeshes::Load(TestMeshes::SphereObj(64, 128, 5.0f));
+    CHECK(sphere->GetMeshlets().size() > 50);
+
+    ClusterCuller culler;
+    std::vector<DrawRange> ranges;
+    const DirectX::XMMATRIX world = DirectX::XMMatrixTranslation(2.0f, 0.0f, 0.0f);
+
+    // Facing the sphere, the far side is culled by the normal cones
+    DirectX::XMFLOAT3 eye = { 0.0f, 3.0f, -20.0f };
+    DirectX::XMMATRIX view = LookAt(eye, { 0.0f, 0.0f, 0.0f });
+    culler.BeginFrame(view, Projection, eye);
+    culler.Cull(*sphere, world, ranges);
+    const ClusterCullStats& stats = culler.GetStats();
+    CHECK(stats.tested == sphere->GetMeshlets().size());
+    CHECK(stats.backfaceCulled > 0);
+    CHECK(stats.visible > 0);
+    CHECK(stats.visible + stats.frustumCulled + stats.backfaceCulled == stats.tested);
+    CHECK(KeepsVisibleTriangles(*sphere, world, view * Projection, eye, ranges));
+
+    // Close up, most of the sphere is off screen
+    eye = { 2.0f, 0.0f, -5.5f };
+    view = LookAt(eye, { 2.0f, 0.0f, 0.0f });
+    culler.BeginFrame(view, Projection, eye);
+    culler.Cull(*sphere, world, ranges);
+    CHECK(culler.GetStats().frustumCulled > 0);
+    CHECK(KeepsVisibleTriangles(*sphere, world, view * Projection, eye, ranges));
+
+    // Looking away nothing is left
+    eye = { 0.0f, 0.0f, -20.0f };
+    view = LookAt(eye, { 0.0f, 0.0f, -40.0f });
+    culler.BeginFrame(view, Projection, eye);
+    culler.Cull(*sphere, world, ranges);
+    CHECK(culler.GetStats().visible == 0);
+    CHECK(ranges.empty());
+}
+
+TEST(SceneCullerVariantsAgree) {
+    // Boxes scattered around the camera, every 777th slot left out like a destroyed entity
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f), extent(0.0f, 20.0f);
+    std::vector<BoundingBox> bounds(100003);
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i < bounds.size(); ++i) {
+        const float x = position(rng), y = position(rng) * 0.1f, z = position(rng);
+        bounds[i].SetBbox(x, x + extent(rng), z, z + extent(rng), y, y + extent(rng));
+        if (i % 777 != 0) indices.push_back(i);
+    }
+
+    const DirectX::XMFLOAT3 eye = { 3.0f, 5.0f, -7.0f };
+    DirectX::XMFLOAT3 forward;
+    DirectX::XMStoreFloat3(&forward, DirectX::XMVector3Normalize(DirectX::XMVectorSet(0.3f, -0.1f, 1.0f, 0.0f)));
+    const DirectX::XMMATRIX view = LookAt(eye, { eye.x + forward.x, eye.y + forward.y, eye.z + forward.z });
+    const DirectX::XMMATRIX viewProj = view * Projection;
+
+    for (float fog : { 0.0f, 80.0f }) {
+        std::vector<unsigned int> reference;
+        for (GeometryKernels::Isa isa : { GeometryKernels::Isa::Scalar, GeometryKernels::Isa::SSE41, GeometryKernels::Isa::AVX2, GeometryKernels::Isa::AVX512 }) {
+            if (isa > GeometryKernels::GetSupportedIsa()) break;
+            GeometryKernels::SetIsa(isa);
+            SceneCuller culler;
+            culler.fogDistance = fog;
+            culler.UpdateBounds(bounds, indices);
+            std::vector<unsigned int> visible;
+            culler.Cull(view, Projection, eye, forward, visible);
+
+            if (isa == GeometryKernels::Isa::Scalar) {
+                reference = visible;
+                CHECK(!visible.empty() && visible.size() < indices.size());
+                CHECK(std::is_sorted(visible.begin(), visible.end()));
+            }
+            CHECK(visible == reference);
+            CHECK(culler.GetStats().tested == indices.size());
+            CHECK(culler.GetStats().visible == visible.size());
+        }
+        GeometryKernels::SetIsa(GeometryKernels::GetSupportedIsa());
+
+        // Conservative: a box with a corner on screen and inside the fog is never dropped
+        std::vector<bool> kept(bounds.size(), false);
+        for (unsigned int index : reference) kept[index] = true;
+        bool conservative = true;
+        for (unsigned int index : indices) {
+            const BoundingBox& b = bounds[index];
+            for (int corner = 0; corner < 8; ++corner) {
+                DirectX::XMVECTOR p = DirectX::XMVectorSet(corner & 1 ? b.maxX : b.minX, corner & 2 ? b.maxY : b.minY, corner & 4 ? b.maxZ : b.minZ, 1.0f);
+                DirectX::XMFLOAT4 clip;
+                DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(p, viewProj));
+                bool onScreen = clip.w > 0.0f && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w && clip.z >= 0.0f && clip.z <= clip.w;
+                if (fog > 0.0f && DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(p, DirectX::XMLoadFloat3(&eye)))) > fog) onScreen = false;
+                conservative &= !onScreen || kept[index];
+            }
+        }
+        CHECK(conservative);
+    }
+
+    // The Model overload skips null entries
+    std::vector<std::unique_ptr<Model>> owned(8);
+    std::vector<Model*> models;
+    for (size_t i = 0; i < owned.size(); ++i) {
+        owned[i] = std::make_unique<Model>();
+        owned[i]->b.SetBbox(-1.0f, 1.0f, 9.0f, 11.0f, -1.0f, 1.0f);
+        models.push_back(i % 3 == 0 ? nullptr : owned[i].get());
+    }
+    SceneCuller culler;
+    culler.UpdateBounds(models);
+    std::vector<unsigned int> visible;
+    culler.Cull(LookAt({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }), Projection, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, visible);
+    CHECK((visible == std::vector<unsigned int>{ 1, 2, 4, 5, 7 }));
+}
+
+BENCHMARK(ClusterCullerOrbit) {
+    // A ground grid and a few spheres, the camera circles them at head height
+    std::unique_ptr<Model> ground = TestMeshes::Load(TestMeshes::GridObj(256, 200.0f));
+    std::unique_ptr<Model> sphere = TestMeshes::Load(TestMeshes::SphereObj(64, 128, 5.0f));
+    const DirectX::XMMATRIX sphereWorlds[] = {
+        DirectX::XMMatrixTranslation(0.0f, 5.0f, 0.0f),
+        DirectX::XMMatrixTranslation(30.0f, 5.0f, 10.0f),
+        DirectX::XMMatrixTranslation(-25.0f, 5.0f, -20.0f),
+        DirectX::XMMatrixTranslation(10.0f, 5.0f, -40.0f),
+    };
+
+    const int frames = 360;
+    ClusterCuller culler;
+    std::vector<DrawRange> ranges;
+    ClusterCullStats total;
+    size_t meshlets = 0;
+    const double ms = Test::BestMs(3, [&] {
+        total = {};
+        meshlets = 0;
+        for (int frame = 0; frame < frames; ++frame) {
+            const float angle = DirectX::XM_2PI * frame / frames;
+            DirectX::XMFLOAT3 eye = { 60.0f * std::cos(angle), 2.0f, 60.0f * std::sin(angle) };
+            culler.BeginFrame(LookAt(eye, { 0.0f, 2.0f, 0.0f }), Projection, eye);
+            culler.Cull(*ground, DirectX::XMMatrixIdentity(), ranges);
+            meshlets += ranges.size();
+            for (const DirectX::XMMATRIX& world : sphereWorlds) {
+                culler.Cull(*sphere, world, ranges);
+                meshlets += ranges.size();
+            }
+            const ClusterCullStats& stats = culler.GetStats();
+            total.tested += stats.tested;
+            total.frustumCulled += stats.frustumCulled;
+            total.backfaceCulled += stats.backfaceCulled;
+            total.visible += stats.visible;
+        }
+    });
+
+    std::cout << "  per frame: " << total.tested / frames << " meshlets tested, " << total.frustumCulled / frames << " frustum culled, "
+        << total.backfaceCulled / frames << " backface culled, " << total.visible / frames << " visible in "
+        << meshlets / frames << " ranges, " << ms * 1000.0 / frames << " us" << std::endl;
+}
+
+TEST(OcclusionCullerHidesBoxesBehindAWall) {
+    // A 40 x 20 wall 20 in front of the camera, only its front faces are rasterized
+    std::unique_ptr<Model> wall = TestMeshes::Load(TestMeshes::BoxObj({ -20.0f, 0.0f, 20.0f }, { 20.0f, 20.0f, 21.0f }));
+    wall->BuildOccluder();
+    CHECK(wall->GetOccluderIndices().size() == 36);
+
+    const DirectX::XMFLOAT3 eye = { 0.0f, 10.0f, 0.0f };
+    const DirectX::XMMATRIX view = LookAt(eye, { 0.0f, 10.0f, 1.0f });
+    OcclusionCuller culler;
+    culler.BeginFrame(view, Projection, eye);
+    culler.AddOccluder(*wall);
+    culler.Rasterize();
+
+    BoundingBox behind, inFront, beside, overTheTop, straddling;
+    behind.SetBbox(-2.0f, 2.0f, 40.0f, 44.0f, 8.0f, 12.0f);
+    inFront.SetBbox(-2.0f, 2.0f, 10.0f, 14.0f, 8.0f, 12.0f);
+    beside.SetBbox(60.0f, 64.0f, 40.0f, 44.0f, 8.0f, 12.0f);
+    overTheTop.SetBbox(-2.0f, 2.0f, 40.0f, 44.0f, 30.0f, 34.0f);
+    straddling.SetBbox(36.0f, 48.0f, 40.0f, 44.0f, 8.0f, 12.0f);
+
+    if (!OcclusionCuller::IsSupported()) {
+        // Everything is reported visible
+        CHECK(!culler.IsOccluded(behind));
+        return;
+    }
+    CHECK(culler.GetStats().occluders == 1);
+    CHECK(culler.IsOccluded(behind));
+    CHECK(culler.IsOccluded({ 0.0f, 10.0f, 50.0f }, 3.0f));
+    CHECK(!culler.IsOccluded(inFront));
+    CHECK(!culler.IsOccluded(beside));
+    CHECK(!culler.IsOccluded(overTheTop));
+    CHECK(!culler.IsOccluded(straddling));
+    CHECK(!culler.IsOccluded({ 0.0f, 10.0f, 15.0f }, 3.0f));
+
+    // Cull drops only the hidden ones and keeps the order
+    std::vector<std::unique_ptr<Model>> owned;
+    std::vector<Model*> models;
+    for (const BoundingBox& box : { behind, inFront, beside, overTheTop, straddling }) {
+        owned.push_back(std::make_unique<Model>());
+        owned.back()->b = box;
+        models.push_back(owned.back().get());
+    }
+    std::vector<unsigned int> visible = { 0, 1, 2, 3, 4 };
+    culler.Cull(models, visible);
+    CHECK((visible == std::vector<unsigned int>{ 1, 2, 3, 4 }));
+    CHECK(culler.GetStats().occluded == 1);
+
+    // Without occluders nothing is hidden
+    culler.BeginFrame(view, Projection, eye);
+    culler.Rasterize();
+    CHECK(!culler.IsOccluded(behind));
+}
+
+BENCHMARK(OcclusionCullerOnScene) {
+    // The cabin, Herobrine, the diamonds and the trees as the game places them around the start,
+    // seen from random spots of the clearing. Every box the culler hides is checked with rays
+    // through the scene.
+    auto cabin = std::make_unique<Model>();
+    auto herobrine = std::make_unique<Model>();
+    auto tree = std::make_unique<Model>();
+    auto diamond = std::make_unique<Model>();
+    if (!cabin->LoadFromObj("cottage_obj.obj") || !herobrine->LoadFromObj("Herobrine.obj") ||
+        !tree->LoadFromObj("Mineways2Skfb.obj") || !diamond->LoadFromObj("diamond.obj")) {
+        std::cout << "  assets missing" << std::endl;
+        return;
+    }
+    cabin->Cleanup();
+    cabin->BuildOccluder();
+    cabin->SetPosition(-10.0f, 0.0f, 0.0f);
+    cabin->SetRotation(0.0f, DirectX::XM_PIDIV2, 0.0f);
+    cabin->SetScale(2.0f, 2.0f, 2.0f);
+    herobrine->SetPosition(20.0f, 0.0f, 0.0f);
+    herobrine->SetRotation(0.0f, DirectX::XM_PI, 0.0f);
+    herobrine->SetScale(2.0f, 2.0f, 2.0f);
+    tree->Cleanup();
+    tree->BuildOccluder();
+    tree->SetScale(30.0f, 30.0f, 30.0f);
+    diamond->SetScale(30.0f, 30.0f, 30.0f);
+    diamond->SetRotation(0.0f, DirectX::XM_PIDIV2, 0.0f);
+
+    std::vector<std::unique_ptr<Model>> owned;
+    PoissonScatter scatter(-200.0f, -200.0f, 200.0f, 200.0f, 1);
+    scatter.AddObstacle(cabin->b);
+    scatter.AddObstacle(herobrine->b);
+    owned.push_back(std::move(cabin));
+    owned.push_back(std::move(herobrine));
+    auto place = [&](const Model& source, unsigned int count, float y) {
+        ScatterLayer layer;
+        layer.radius = PoissonScatter::FootprintRadius(source);
+        layer.minDistance = scatter.SpacingForCount(count);
+        layer.maxCount = count;
+        std::vector<ScatterPoint> points;
+        scatter.Scatter(layer, points);
+        for (const ScatterPoint& point : points) {
+            owned.push_back(std::make_unique<Model>(source));
+            owned.back()->SetPosition(point.x, y, point.z);
+        }
+    };
+    place(*diamond, 5, 1.0f);
+    place(*tree, 50, -15.0f);
+
+    std::vector<Model*> models;
+    for (auto& model : owned) {
+        model->BuildBvh();
+        models.push_back(model.get());
+    }
+    SceneBvh rays;
+    rays.Build(models);
+
+    SceneCuller frustum;
+    frustum.UpdateBounds(models);
+    OcclusionCuller culler;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-190.0f, 190.0f), yaw(0.0f, DirectX::XM_2PI);
+    double rasterMs = 0.0, testMs = 0.0;
+    unsigned int views = 0, frustumVisible = 0, occluded = 0, falseCulls = 0;
+    while (views < 300) {
+        const DirectX::XMFLOAT3 eye = { position(rng), 5.0f, position(rng) };
+        const float angle = yaw(rng);
+        bool inside = false;
+        for (const Model* model : models) {
+            const BoundingBox& b = model->b;
+            inside |= eye.x > b.minX - 1.0f && eye.x < b.maxX + 1.0f && eye.z > b.minZ - 1.0f && eye.z < b.maxZ + 1.0f;
+        }
+        if (inside) continue;
+
+        DirectX::XMFLOAT3 forward;
+        DirectX::XMStoreFloat3(&forward, DirectX::XMVector3Normalize(DirectX::XMVectorSet(std::sin(angle), -0.05f, std::cos(angle), 0.0f)));
+        const DirectX::XMMATRIX view = LookAt(eye, { eye.x + forward.x, eye.y + forward.y, eye.z + forward.z });
+        std::vector<unsigned int> visible;
+        frustum.Cull(view, Projection, eye, forward, visible);
+        const std::vector<unsigned int> beforeOcclusion = visible;
+
+        auto start = std::chrono::steady_clock::now();
+        culler.BeginFrame(view, Projection, eye);
+        for (unsigned int index : visible) culler.AddOccluder(*models[index]);
+        culler.Rasterize();
+        auto rasterized = std::chrono::steady_clock::now();
+        culler.Cull(models, visible);
+        auto tested = std::chrono::steady_clock::now();
+        rasterMs += std::chrono::duration<double, std::milli>(rasterized - start).count();
+        testMs += std::chrono::duration<double, std::milli>(tested - rasterized).count();
+        frustumVisible += static_cast<unsigned int>(beforeOcclusion.size());
+        occluded += culler.GetStats().occluded;
+        ++views;
+
+        // A hidden model with a vertex on screen that a ray reaches unobstructed was culled wrongly
+        const DirectX::XMMATRIX viewProj = view * Projection;
+        const DirectX::XMVECTOR camera = DirectX::XMLoadFloat3(&eye);
+        for (unsigned int index : beforeOcclusion) {
+            if (std::binary_search(visible.begin(), visible.end(), index)) continue;
+            const Model* model = models[index];
+            const DirectX::XMMATRIX world = model->GetModelMatrix();
+            for (const Vertex& vertex : model->GetVertices()) {
+                DirectX::XMVECTOR p = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&vertex.position), world);
+                DirectX::XMFLOAT4 clip;
+                DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(DirectX::XMVectorSetW(p, 1.0f), viewProj));
+                if (clip.w <= 0.1f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w) continue;
+                DirectX::XMVECTOR direction = DirectX::XMVectorSubtract(p, camera);
+                const float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(direction));
+                DirectX::XMFLOAT3 unit;
+                DirectX::XMStoreFloat3(&unit, DirectX::XMVectorScale(direction, 1.0f / distance));
+                // Stop short of the vertex, its own surface doesn't count
+                if (!rays.Occluded(eye, unit, distance * 0.995f, model)) {
+                    ++falseCulls;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::cout << "  " << views << " views of " << models.size() << " models: " << double(frustumVisible) / views << " in the frustum, "
+        << double(occluded) / views << " occluded (" << 100.0 * occluded / std::max(frustumVisible, 1u) << "%), raster "
+        << rasterMs / views << " ms, test " << testMs / views << " ms, " << falseCulls << " wrongly culled" << std::endl;
+}
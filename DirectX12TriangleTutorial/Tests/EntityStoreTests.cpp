@@ -0,0 +1,52 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "EntityStore.h"
+
+namespace {
+    Model* UnitBox(float x, float y, float z) {
+        Model* model = TestMeshes::Load(TestMeshes::BoxObj({ -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f })).release();
+        model->SetPosition(x, y, z);
+        return model;
+    }
+
+    bool SameBox(const BoundingBox& a, const BoundingBox& b) {
+        return a.minX == b.minX && a.maxX == b.maxX && a.minY == b.minY && a.maxY == b.maxY && a.minZ == b.minZ && a.maxZ == b.maxZ;
+    }
+}
+
+TEST(PickupBoundsFollowTheEntity) {
+    EntityStore entities;
+    const EntityHandle plain = entities.Create(UnitBox(0.0f, 0.0f, 0.0f));
+    const EntityHandle pickup = entities.Create(UnitBox(10.0f, 1.0f, 0.0f), EntityStatic | EntityRemovable);
+    const EntityHandle other = entities.Create(UnitBox(-10.0f, 1.0f, 0.0f), EntityRemovable);
+
+    PickupExtent extent;
+    extent.horizontal = 2.0f;
+    extent.below = 1.0f;
+    extent.above = 9.0f;
+    entities.SetPickupExtent(pickup, extent);
+
+    BoundingBox expected;
+    expected.SetBbox(7.0f, 13.0f, -3.0f, 3.0f, -1.0f, 11.0f);
+    CHECK(SameBox(entities.GetPickupBounds(pickup), expected));
+    // The model's own bounds stay tight
+    CHECK(entities.GetModel(pickup)->b.maxY == 2.0f);
+    // Without an extent the pickup bounds are the world bounds
+    CHECK(SameBox(entities.GetPickupBounds(other), entities.GetModel(other)->b));
+
+    // A sync after the model changed keeps the extent
+    entities.GetModel(pickup)->SetPosition(20.0f, 1.0f, 0.0f);
+    entities.Sync(pickup);
+    expected.SetBbox(17.0f, 23.0f, -3.0f, 3.0f, -1.0f, 11.0f);
+    CHECK(SameBox(entities.GetPickupBounds(pickup), expected));
+    entities.SetPosition(pickup, { 20.0f, 5.0f, 0.0f });
+    CHECK(entities.GetPickupBounds(pickup).maxY == 15.0f);
+
+    // Destroying an earlier entity moves the component along with the rest
+    entities.Destroy(plain);
+    CHECK(entities.GetPickupBounds(pickup).maxY == 15.0f);
+    CHECK(SameBox(entities.GetPickupBounds(other), entities.GetModel(other)->b));
+
+    entities.Destroy(pickup);
+    CHECK(SameBox(entities.GetPickupBounds(pickup), BoundingBox{}));
+}
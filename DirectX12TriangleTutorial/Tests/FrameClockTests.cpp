@@ -0,0 +1,95 @@
+#include "Test.h"
+#include "FrameClock.h"
+#include "Camera.h"
+#include "Input.h"
+#include <random>
+
+namespace {
+    struct Played {
+        std::vector<uint64_t> steps;               // at every whole second
+        std::vector<DirectX::XMFLOAT3> positions;
+        std::vector<DirectX::XMFLOAT3> views;
+        bool alphaInRange = true;
+        bool alphaZeroOnTheSecond = true;
+    };
+
+    bool Same(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    // Three seconds of the game's camera at hz frames per second, the frames end at whole
+    // nanoseconds like a real clock's. Input changes on whole seconds, which every rate has a
+    // frame boundary at: W from the start, D from the first second, a turn at the second.
+    // Jittered frames last half to one and a half times as long, but still end on the seconds.
+    Played Play(int hz, bool jitter) {
+        Played played;
+        FrameClock clock;
+        Camera camera;
+        InputState input;
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int64_t> length(500000000 / hz, 1500000000 / hz);
+
+        int64_t now = 0;
+        for (int second = 0; second < 3; ++second) {
+            if (second == 0) input.KeyDown('W');
+            if (second == 1) input.KeyDown('D');
+            if (second == 2) input.MouseMove(120.0f, -30.0f);
+
+            const int64_t end = static_cast<int64_t>(second + 1) * 1000000000;
+            for (int64_t frame = 1; now < end; ++frame) {
+                const int64_t next = jitter ? std::min(now + length(rng), end) : static_cast<int64_t>(second) * 1000000000 + frame * 1000000000 / hz;
+                const unsigned int steps = clock.Advance(std::chrono::nanoseconds(next - now));
+                now = next;
+                for (unsigned int i = 0; i < steps; ++i) {
+                    camera.BeginStep();
+                    const DirectX::XMFLOAT2 mouse = input.TakeMouseDelta();
+                    if (mouse.x != 0.0f || mouse.y != 0.0f) camera.MouseMovement(mouse.x, mouse.y);
+                    const float forward = (input.IsDown('W') ? 1.0f : 0.0f) - (input.IsDown('S') ? 1.0f : 0.0f);
+                    const float right = (input.IsDown('D') ? 1.0f : 0.0f) - (input.IsDown('A') ? 1.0f : 0.0f);
+                    camera.Move(forward, right, static_cast<float>(clock.GetStep()));
+                    camera.Update(static_cast<float>(clock.GetStep()));
+                }
+                played.alphaInRange = played.alphaInRange && clock.GetAlpha() >= 0.0f && clock.GetAlpha() <= 1.0f;
+            }
+            played.steps.push_back(clock.GetStepCount());
+            played.positions.push_back(camera.cameraPos);
+            played.views.push_back(camera.GetView(clock.GetAlpha()).position);
+            played.alphaZeroOnTheSecond = played.alphaZeroOnTheSecond && clock.GetAlpha() == 0.0f;
+        }
+        return played;
+    }
+}
+
+TEST(FrameClockStepsAlikeAtAnyRate) {
+    const Played reference = Play(60, false);
+    CHECK((reference.steps == std::vector<uint64_t>{ 60, 120, 180 }));
+    // The camera did walk, the comparisons below aren't between two standstills
+    CHECK(!Same(reference.positions[0], reference.positions[2]));
+
+    for (int hz : { 30, 60, 144 }) {
+        for (bool jitter : { false, true }) {
+            const Played played = Play(hz, jitter);
+            CHECK(played.steps == reference.steps);
+            CHECK(played.alphaInRange && played.alphaZeroOnTheSecond);
+            for (size_t i = 0; i < reference.positions.size(); ++i) {
+                CHECK(Same(played.positions[i], reference.positions[i]));
+                CHECK(Same(played.views[i], reference.views[i]));
+            }
+        }
+    }
+}
+
+TEST(FrameClockDropsStepsOfLongFrames) {
+    FrameClock clock(60, 5);
+    // Half a step is carried over, the alpha rendering blends by
+    CHECK(clock.Advance(std::chrono::microseconds(8333)) == 0);
+    CHECK(clock.GetAlpha() > 0.49f && clock.GetAlpha() < 0.5f);
+    clock.TakeStats();
+
+    // A second long hitch only simulates five steps, the rest is dropped
+    CHECK(clock.Advance(std::chrono::seconds(1)) == 5);
+    const FrameClockStats stats = clock.TakeStats();
+    CHECK(stats.steps == 5 && stats.droppedSteps == 55);
+    CHECK(clock.GetStepCount() == 5);
+    CHECK(clock.GetAlpha() > 0.49f && clock.GetAlpha() < 0.5f);
+}
@@ -0,0 +1,241 @@
+#include "Test.h"
+#include "GeometryKernels.h"
+#include "Primitives.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using GeometryKernels::Isa;
+
+namespace {
+    // Element counts around every vector width, so the remainder loops run too
+    const size_t Counts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 1001 };
+
+    // Runs body once per variant the CPU supports, wider ones after the scalar reference
+    template <typename Body>
+    void ForEachIsa(Body&& body) {
+        for (Isa isa : { Isa::Scalar, Isa::SSE41, Isa::AVX2, Isa::AVX512 }) {
+            if (isa > GeometryKernels::GetSupportedIsa()) break;
+            GeometryKernels::SetIsa(isa);
+            body(isa);
+        }
+        GeometryKernels::SetIsa(GeometryKernels::GetSupportedIsa());
+    }
+
+    // Up to float rounding, the wide variants use FMA where the scalar one does not. scale is the
+    // size of the terms that were summed, cancellation leaves their rounding in a small result.
+    bool Near(float a, float b, float scale = 1.0f) {
+        return std::abs(a - b) <= 1e-5f * std::max(scale, std::max(std::abs(a), std::abs(b)));
+    }
+
+    bool Near(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, float scale = 1.0f) {
+        return Near(a.x, b.x, scale) && Near(a.y, b.y, scale) && Near(a.z, b.z, scale);
+    }
+
+    bool NearPositions(const std::vector<Vertex>& a, const std::vector<Vertex>& b) {
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (!Near(a[i].position, b[i].position)) return false;
+        }
+        return true;
+    }
+
+    bool NearNormals(const std::vector<Vertex>& a, const std::vector<Vertex>& b, float scale = 1.0f) {
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (!Near(a[i].normal, b[i].normal, scale)) return false;
+        }
+        return true;
+    }
+
+    std::vector<Vertex> RandomVertices(size_t count, unsigned int seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+        std::vector<Vertex> vertices(count);
+        for (Vertex& v : vertices) {
+            v.position = { value(rng), value(rng), value(rng) };
+            v.uv = { value(rng), value(rng) };
+            v.normal = { value(rng), value(rng), value(rng) };
+        }
+        return vertices;
+    }
+
+    Float3Span Positions(std::vector<Vertex>& vertices) {
+        return vertices.empty() ? Float3Span{} : Float3Span{ &vertices[0].position.x, vertices.size(), sizeof(Vertex) };
+    }
+
+    Float3Span Normals(std::vector<Vertex>& vertices) {
+        return vertices.empty() ? Float3Span{} : Float3Span{ &vertices[0].normal.x, vertices.size(), sizeof(Vertex) };
+    }
+
+    const DirectX::XMFLOAT4X4 Affine = {
+        0.8f, 0.1f, -0.3f, 0.0f,
+        0.2f, 1.1f, 0.4f, 0.0f,
+        -0.5f, 0.3f, 0.9f, 0.0f,
+        3.0f, 4.0f, 5.0f, 1.0f,
+    };
+
+    struct Boxes {
+        std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+        BoxSoA View() const { return { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), minX.size() }; }
+    };
+
+    Boxes RandomBoxes(size_t count, unsigned int seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f), extent(0.0f, 10.0f);
+        Boxes boxes;
+        for (size_t i = 0; i < count; ++i) {
+            const float x = position(rng), y = position(rng), z = position(rng);
+            boxes.minX.push_back(x);
+            boxes.minY.push_back(y);
+            boxes.minZ.push_back(z);
+            boxes.maxX.push_back(x + extent(rng));
+            boxes.maxY.push_back(y + extent(rng));
+            boxes.maxZ.push_back(z + extent(rng));
+        }
+        return boxes;
+    }
+}
+
+TEST(GeometryKernelsMatchScalar) {
+    for (size_t count : Counts) {
+        const std::vector<Vertex> input = RandomVertices(count, static_cast<unsigned int>(count));
+        std::vector<unsigned int> indices(count >= 3 ? (count - 2) * 3 : 0);
+        std::mt19937 rng(7);
+        for (unsigned int& index : indices) index = rng() % count;
+
+        std::vector<Vertex> transformed[5], scaled, accumulated, normalized;
+        DirectX::XMFLOAT3 boundsMin, boundsMax;
+        ForEachIsa([&](Isa isa) {
+            std::vector<Vertex> points = input, normals = input, scale = input, faces = input, unit = input;
+            GeometryKernels::TransformPoints(Positions(points), Affine);
+            GeometryKernels::TransformNormals(Normals(normals), Affine);
+            GeometryKernels::ScaleTranslate(Positions(scale), { 2.0f, 0.5f, -3.0f }, { 1.0f, -2.0f, 0.25f });
+            for (Vertex& v : faces) v.normal = { 0.0f, 0.0f, 0.0f };
+            GeometryKernels::AccumulateFaceNormals(Positions(faces), indices.data(), indices.size(), Normals(faces));
+            GeometryKernels::Normalize(Normals(unit));
+            std::vector<Vertex> unchanged = input;
+            DirectX::XMFLOAT3 min, max;
+            GeometryKernels::ComputeBounds(Positions(unchanged), min, max);
+
+            if (isa == Isa::Scalar) {
+                transformed[0] = points;
+                transformed[1] = normals;
+                scaled = scale;
+                accumulated = faces;
+                normalized = unit;
+                boundsMin = min;
+                boundsMax = max;
+                return;
+            }
+            CHECK(NearPositions(points, transformed[0]));
+            CHECK(NearNormals(normals, transformed[1]));
+            CHECK(NearPositions(scale, scaled));
+            // Cross products of coordinates up to 10 apart, a few faces per corner
+            CHECK(NearNormals(faces, accumulated, 4000.0f));
+            CHECK(NearNormals(unit, normalized));
+            // Min and max don't round, they have to be exact
+            CHECK(min.x == boundsMin.x && min.y == boundsMin.y && min.z == boundsMin.z);
+            CHECK(max.x == boundsMax.x && max.y == boundsMax.y && max.z == boundsMax.z);
+        });
+    }
+}
+
+TEST(BoxKernelsMatchScalar) {
+    // Two side planes and a near plane, boxes pass when they are not fully behind any
+    const DirectX::XMFLOAT4 planes[] = {
+        { 0.70710678f, 0.0f, 0.70710678f, 20.0f },
+        { -0.70710678f, 0.0f, 0.70710678f, 20.0f },
+        { 0.0f, 0.0f, 1.0f, 10.0f },
+    };
+    const DirectX::XMFLOAT3 queryMin = { -30.0f, -50.0f, -20.0f }, queryMax = { 40.0f, 50.0f, 35.0f };
+
+    for (size_t count : Counts) {
+        const Boxes boxes = RandomBoxes(count, static_cast<unsigned int>(count) + 1);
+        const BoxSoA view = boxes.View();
+
+        // Straightforward reference, independent of the kernel tables
+        std::vector<unsigned int> expectedOverlap, expectedCull;
+        for (unsigned int i = 0; i < count; ++i) {
+            if (boxes.minX[i] <= queryMax.x && boxes.maxX[i] >= queryMin.x && boxes.minY[i] <= queryMax.y &&
+                boxes.maxY[i] >= queryMin.y && boxes.minZ[i] <= queryMax.z && boxes.maxZ[i] >= queryMin.z) {
+                expectedOverlap.push_back(i);
+            }
+            bool inside = true;
+            for (const DirectX::XMFLOAT4& plane : planes) {
+                const float x = plane.x >= 0.0f ? boxes.maxX[i] : boxes.minX[i];
+                const float y = plane.y >= 0.0f ? boxes.maxY[i] : boxes.minY[i];
+                const float z = plane.z >= 0.0f ? boxes.maxZ[i] : boxes.minZ[i];
+                inside &= plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0f;
+            }
+            if (inside) expectedCull.push_back(i);
+        }
+
+        ForEachIsa([&](Isa) {
+            std::vector<unsigned int> overlap(count), visible(count);
+            overlap.resize(GeometryKernels::OverlapBoxes(view, queryMin, queryMax, overlap.data()));
+            visible.resize(GeometryKernels::CullBoxes(view, planes, std::size(planes), visible.data()));
+            CHECK(overlap == expectedOverlap);
+            CHECK(visible == expectedCull);
+        });
+    }
+}
+
+TEST(MultiplyMatricesMatchesDirectXMath) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+    for (size_t count : Counts) {
+        std::vector<DirectX::XMFLOAT4X4> a(count), b(count), expected(count);
+        for (size_t i = 0; i < count; ++i) {
+            for (int r = 0; r < 4; ++r) {
+                for (int c = 0; c < 4; ++c) {
+                    a[i].m[r][c] = value(rng);
+                    b[i].m[r][c] = value(rng);
+                }
+            }
+            DirectX::XMStoreFloat4x4(&expected[i], DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&a[i]), DirectX::XMLoadFloat4x4(&b[i])));
+        }
+
+        ForEachIsa([&](Isa) {
+            std::vector<DirectX::XMFLOAT4X4> out(count), inPlace = a;
+            GeometryKernels::MultiplyMatrices(a.data(), b.data(), out.data(), count);
+            GeometryKernels::MultiplyMatrices(inPlace.data(), b.data(), inPlace.data(), count);
+            bool near = true;
+            for (size_t i = 0; i < count; ++i) {
+                for (int r = 0; r < 4; ++r) {
+                    for (int c = 0; c < 4; ++c) {
+                        near &= Near(out[i].m[r][c], expected[i].m[r][c]) && inPlace[i].m[r][c] == out[i].m[r][c];
+                    }
+                }
+            }
+            CHECK(near);
+        });
+    }
+}
+
+BENCHMARK(GeometryKernelsMillionVertices) {
+    const size_t count = 1000000;
+    const std::vector<Vertex> input = RandomVertices(count, 1);
+    std::vector<unsigned int> indices(count * 2 * 3);
+    std::mt19937 rng(2);
+    for (unsigned int& index : indices) index = rng() % count;
+    const Boxes boxes = RandomBoxes(count, 3);
+    const DirectX::XMFLOAT4 planes[] = { { 0.6f, 0.0f, 0.8f, 10.0f }, { -0.6f, 0.0f, 0.8f, 10.0f }, { 0.0f, 1.0f, 0.0f, 30.0f } };
+    std::vector<unsigned int> out(count);
+    std::vector<DirectX::XMFLOAT4X4> matrices(count, Affine);
+
+    ForEachIsa([&](Isa isa) {
+        std::vector<Vertex> vertices = input;
+        DirectX::XMFLOAT3 min, max;
+        const int repeats = 5;
+        std::cout << "  " << GeometryKernels::GetIsaName(isa) << " (ms per 1M):"
+            << " TransformPoints " << Test::BestMs(repeats, [&] { GeometryKernels::TransformPoints(Positions(vertices), Affine); })
+            << ", TransformNormals " << Test::BestMs(repeats, [&] { GeometryKernels::TransformNormals(Normals(vertices), Affine); })
+            << ", ComputeBounds " << Test::BestMs(repeats, [&] { GeometryKernels::ComputeBounds(Positions(vertices), min, max); })
+            << ", ScaleTranslate " << Test::BestMs(repeats, [&] { GeometryKernels::ScaleTranslate(Positions(vertices), { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }); })
+            << ", AccumulateFaceNormals (2M faces) " << Test::BestMs(repeats, [&] { GeometryKernels::AccumulateFaceNormals(Positions(vertices), indices.data(), indices.size(), Normals(vertices)); })
+            << ", Normalize " << Test::BestMs(repeats, [&] { GeometryKernels::Normalize(Normals(vertices)); })
+            << ", OverlapBoxes " << Test::BestMs(repeats, [&] { GeometryKernels::OverlapBoxes(boxes.View(), { -20.0f, -20.0f, -20.0f }, { 20.0f, 20.0f, 20.0f }, out.data()); })
+            << ", CullBoxes " << Test::BestMs(repeats, [&] { GeometryKernels::CullBoxes(boxes.View(), planes, std::size(planes), out.data()); })
+            << ", MultiplyMatrices " << Test::BestMs(repeats, [&] { GeometryKernels::MultiplyMatrices(matrices.data(), matrices.data(), matrices.data(), count); })
+            << std::endl;
+    });
+}
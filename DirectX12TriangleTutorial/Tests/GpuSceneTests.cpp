@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "GpuScene.h"
+
+namespace {
+    uint64_t MeshBytes(const Model& model) {
+        return sizeof(Vertex) * model.GetVertices().size() + sizeof(unsigned int) * model.GetIndices().size();
+    }
+
+    // Stands in for the Renderer's device, only counts what would be staged
+    class CountingAllocator : public GpuMeshAllocator {
+    public:
+        void CreateMesh(uint32_t slot, const Model& model, SceneUploadStats& stats) override {
+            stats.bufferBytes += MeshBytes(model);
+            for (const Material& material : model.GetMaterials()) {
+                stats.textureBytes += static_cast<uint64_t>(material.textureImage.GetWidth()) * material.textureImage.GetHeight() * 4;
+            }
+            if (slot >= live.size()) live.resize(slot + 1, false);
+            CHECK(!live[slot]);
+            live[slot] = true;
+            ++creates;
+        }
+
+        void ReleaseMesh(uint32_t slot) override {
+            CHECK(slot < live.size() && live[slot]);
+            if (slot < live.size()) live[slot] = false;
+            ++releases;
+        }
+
+        std::vector<bool> live;
+        unsigned int creates = 0;
+        unsigned int releases = 0;
+    };
+
+    Model* Box(float x) {
+        Model* model = TestMeshes::Load(TestMeshes::BoxObj({ -1.0f, 0.0f, -1.0f }, { 1.0f, 2.0f, 1.0f })).release();
+        model->SetPosition(x, 0.0f, 0.0f);
+        return model;
+    }
+}
+
+TEST(GpuSceneUploadsOnlyCreatedMeshes) {
+    EntityStore entities;
+    CountingAllocator allocator;
+    GpuScene scene(allocator);
+
+    Model* sphereModel = TestMeshes::Load(TestMeshes::SphereObj(8, 12, 1.0f)).release();
+    Model* gridModel = TestMeshes::Load(TestMeshes::GridObj(4, 10.0f)).release();
+    const EntityHandle box = entities.Create(Box(0.0f));
+    const EntityHandle sphere = entities.Create(sphereModel);
+    const EntityHandle grid = entities.Create(gridModel, EntityStatic);
+    const uint64_t boxBytes = MeshBytes(*entities.GetModel(box));
+    const uint64_t sphereBytes = MeshBytes(*sphereModel);
+
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().created == 3);
+    CHECK(scene.GetStats().meshesCreated == 3);
+    CHECK(scene.GetStats().bufferBytes == boxBytes + sphereBytes + MeshBytes(*gridModel));
+    CHECK(scene.GetStats().textureBytes == 0);
+    CHECK(allocator.creates == 3);
+    const uint32_t sphereMesh = scene.GetMesh(sphere);
+    CHECK(scene.GetMesh(box) != GpuScene::NoMesh && sphereMesh != GpuScene::NoMesh && scene.GetMesh(grid) != GpuScene::NoMesh);
+    CHECK(scene.GetMesh(box) != sphereMesh && scene.GetMesh(grid) != sphereMesh);
+
+    // Moves are read from the store by the next frame, nothing is staged
+    entities.SetPosition(box, { 3.0f, 0.0f, 0.0f });
+    sphereModel->SetPosition(0.0f, 4.0f, 0.0f);
+    entities.Sync(sphere);
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().moved == 2);
+    CHECK(scene.GetStats().created == 0 && scene.GetStats().meshesCreated == 0);
+    CHECK(scene.GetStats().bufferBytes == 0 && scene.GetStats().textureBytes == 0);
+    CHECK(allocator.creates == 3);
+
+    // A destroy releases the mesh and stages nothing
+    entities.Destroy(sphere);
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().destroyed == 1 && scene.GetStats().meshesReleased == 1);
+    CHECK(scene.GetStats().bufferBytes == 0 && scene.GetStats().textureBytes == 0);
+    CHECK(allocator.releases == 1 && !allocator.live[sphereMesh]);
+    CHECK(scene.GetMesh(sphere) == GpuScene::NoMesh);
+
+    // The next mesh takes the free slot and uploads its own bytes only
+    const EntityHandle second = entities.Create(Box(-3.0f));
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().created == 1 && scene.GetStats().bufferBytes == boxBytes);
+    CHECK(scene.GetMesh(second) == sphereMesh);
+    CHECK(scene.GetMesh(sphere) == GpuScene::NoMesh);
+
+    // Gone before the scene saw it, it never reaches the device
+    const EntityHandle brief = entities.Create(Box(6.0f));
+    entities.Destroy(brief);
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().created == 0 && scene.GetStats().destroyed == 0);
+    CHECK(scene.GetStats().bufferBytes == 0);
+    CHECK(allocator.creates == 4 && allocator.releases == 1);
+
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().created == 0 && scene.GetStats().moved == 0 && scene.GetStats().bufferBytes == 0);
+
+    entities.Clear();
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().destroyed == 3 && scene.GetStats().meshesReleased == 3);
+    CHECK(allocator.releases == allocator.creates);
+    for (bool live : allocator.live) CHECK(!live);
+}
+
+TEST(GpuSceneSharesInstanceMeshes) {
+    EntityStore entities;
+    CountingAllocator allocator;
+    GpuScene scene(allocator);
+
+    // The template itself is never an entity, only its instances are
+    std::shared_ptr<Model> tree(Box(0.0f));
+    tree->SetScale(2.0f, 2.0f, 2.0f);
+    std::vector<EntityHandle> trees;
+    for (int i = 0; i < 5; ++i) {
+        Model* instance = Model::CreateInstance(tree).release();
+        instance->SetPosition(static_cast<float>(i) * 4.0f, 0.0f, 0.0f);
+        trees.push_back(entities.Create(instance, EntityStatic));
+    }
+    // An instance of an instance draws the same mesh
+    std::shared_ptr<Model> first(Model::CreateInstance(tree));
+    trees.push_back(entities.Create(Model::CreateInstance(first).release(), EntityStatic));
+
+    const Model& instance = *entities.GetModel(trees[1]);
+    CHECK(instance.IsInstance() && &instance.GetMesh() == tree.get());
+    CHECK(instance.GetNumVertices() == tree->GetNumVertices() && &instance.GetBvh() == &tree->GetBvh());
+    CHECK(instance.GetScale().x == 2.0f && instance.GetPosition().x == 4.0f);
+
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().created == 6 && scene.GetStats().meshesCreated == 1);
+    CHECK(scene.GetStats().bufferBytes == MeshBytes(*tree));
+    CHECK(allocator.creates == 1);
+    for (EntityHandle handle : trees) CHECK(scene.GetMesh(handle) == scene.GetMesh(trees[0]));
+
+    // The mesh stays until the last instance goes
+    for (size_t i = 1; i < trees.size(); ++i) entities.Destroy(trees[i]);
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().destroyed == 5 && scene.GetStats().meshesReleased == 0);
+    entities.Destroy(trees[0]);
+    scene.ApplyChanges(entities, entities.TakeChanges());
+    CHECK(scene.GetStats().meshesReleased == 1 && allocator.releases == 1);
+}
@@ -0,0 +1,96 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+
+namespace {
+    float Iterate(float x, int iterations) {
+        for (int k = 0; k < iterations; ++k) x = std::sqrt(x * 1.0001f + 1.0f);
+        return x;
+    }
+}
+
+TEST(JobSystemRunsEveryRangeOnce) {
+    JobSystem& shared = JobSystem::Get();
+    {
+        JobSystem jobs(3);
+        for (size_t count : { 0, 1, 7, 1000, 100000 }) {
+            std::vector<std::atomic<int>> hits(count);
+            jobs.ParallelFor(count, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) ++hits[i];
+            }, 3);
+            bool once = true;
+            for (const std::atomic<int>& hit : hits) once = once && hit == 1;
+            CHECK(once);
+        }
+
+        // A chain of dependencies runs in order, the last link on this thread
+        JobCounter first, second, third;
+        std::vector<int> order;
+        std::mutex orderMutex;
+        jobs.Run([&] { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(1); }, &first);
+        jobs.Run([&] { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(2); }, &second, &first);
+        jobs.RunOnMainThread([&] { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(3); }, &third, &second);
+        jobs.Wait(third);
+        CHECK((order == std::vector<int>{ 1, 2, 3 }));
+    }
+
+    // The shared system has this thread back
+    CHECK(shared.IsMainThread());
+    JobCounter counter;
+    bool ranHere = false;
+    shared.RunOnMainThread([&] { ranHere = true; }, &counter);
+    shared.PumpMainThread();
+    CHECK(ranHere && counter.IsDone());
+}
+
+BENCHMARK(JobSystemScaling) {
+    // Same work on 1 up to all hardware threads. Balanced: every element costs the same.
+    // Unbalanced: the cost grows 30 fold along the range, so an even split would leave most
+    // threads idle. Fan-out: four stages of 64 jobs, each stage starting once the last is done.
+    const size_t count = 1 << 18;
+    std::vector<float> data(count);
+    const auto balanced = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) data[i] = Iterate(data[i], 40);
+    };
+    const auto unbalanced = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) data[i] = Iterate(data[i], 2 + static_cast<int>(i * 16 / count) * 8);
+    };
+
+    const unsigned int stages = 4, jobsPerStage = 64;
+    const size_t perJob = count / jobsPerStage;
+    const auto fanOut = [&](JobSystem& jobs) {
+        std::vector<JobCounter> done(stages);
+        for (unsigned int stage = 0; stage < stages; ++stage) {
+            for (unsigned int job = 0; job < jobsPerStage; ++job) {
+                jobs.Run([&, job] { balanced(job * perJob, (job + 1) * perJob); }, &done[stage], stage > 0 ? &done[stage - 1] : nullptr);
+            }
+        }
+        jobs.Wait(done.back());
+    };
+
+    double single[3] = {};
+    const unsigned int maxThreads = JobSystem::DefaultWorkerCount() + 1;
+    for (unsigned int threads = 1; threads <= maxThreads; ++threads) {
+        JobSystem jobs(threads - 1);
+        std::iota(data.begin(), data.end(), 0.0f);
+        const double ms[3] = {
+            Test::BestMs(5, [&] { jobs.ParallelFor(count, balanced); }),
+            Test::BestMs(5, [&] { jobs.ParallelFor(count, unbalanced); }),
+            Test::BestMs(5, [&] { fanOut(jobs); }),
+        };
+        if (threads == 1) std::copy(ms, ms + 3, single);
+
+        std::cout << std::fixed << std::setprecision(2) << "  " << threads << " threads:";
+        const char* names[3] = { "balanced", "unbalanced", "fan-out" };
+        for (int i = 0; i < 3; ++i) {
+            std::cout << " " << names[i] << " " << ms[i] << " ms (x" << single[i] / ms[i] << ")";
+        }
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
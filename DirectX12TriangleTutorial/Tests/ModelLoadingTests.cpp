@@ -0,0 +1,49 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include <fstream>
+#include <iostream>
+
+TEST(ObjSmoothingGroups) {
+    // Adjacent faces are well inside the crease angle, so only the groups decide what is smooth
+    const std::string sphere = TestMeshes::SphereObj(8, 16, 1.0f, false);
+    std::unique_ptr<Model> on = TestMeshes::Load("s on\n" + sphere);
+    std::unique_ptr<Model> one = TestMeshes::Load("s 1\n" + sphere);
+    std::unique_ptr<Model> off = TestMeshes::Load("s off\n" + sphere);
+    std::unique_ptr<Model> zero = TestMeshes::Load("s 0\n" + sphere);
+    std::unique_ptr<Model> unknown = TestMeshes::Load("s smooth\n" + sphere);
+
+    const unsigned int faces = 8 * 16 * 2 - 2 * 16;
+    CHECK(on->GetNumFaces() == faces);
+    CHECK(unknown->GetNumFaces() == faces);
+
+    // Smooth corners share a vertex, flat faces split every one
+    CHECK(on->GetNumVertices() < on->GetNumIndices());
+    CHECK(one->GetNumVertices() == on->GetNumVertices());
+    CHECK(off->GetNumVertices() == off->GetNumIndices());
+    CHECK(zero->GetNumVertices() == off->GetNumVertices());
+    CHECK(unknown->GetNumVertices() == off->GetNumVertices());
+}
+
+BENCHMARK(ObjVersusGltfLoad) {
+    // The same half million vertex grid as OBJ text and as .glb with both vertex layouts
+    const std::string directory = TestMeshes::GeneratedAssetDirectory();
+    std::ofstream(directory + "/benchmark_grid.obj") << TestMeshes::GridObj(700, 70.0f);
+    Model grid;
+    grid.LoadFromObj("benchmark_grid.obj");
+    TestMeshes::WriteGlb(directory + "/benchmark_grid_interleaved.glb", grid, true);
+    TestMeshes::WriteGlb(directory + "/benchmark_grid_separate.glb", grid, false);
+
+    std::cout << "  " << grid.GetNumVertices() << " vertices, " << grid.GetNumFaces() << " faces" << std::endl;
+    for (const char* name : { "benchmark_grid.obj", "benchmark_grid_interleaved.glb", "benchmark_grid_separate.glb" }) {
+        std::unique_ptr<Model> model;
+        const double ms = Test::BestMs(3, [&] {
+            model = std::make_unique<Model>();
+            model->LoadFromFile(name);
+        });
+        std::cout << "  " << name << ": " << ms << " ms";
+        if (model->GetNumVertices() != grid.GetNumVertices() || model->GetNumFaces() != grid.GetNumFaces()) {
+            std::cout << " (loaded " << model->GetNumVertices() << " vertices, " << model->GetNumFaces() << " faces)";
+        }
+        std::cout << std::endl;
+    }
+}
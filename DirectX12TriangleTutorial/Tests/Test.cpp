@@ -0,0 +1,53 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+    unsigned int runningFailures = 0;
+}
+
+std::vector<Test::Case>& Test::Registry() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+bool Test::Register(const char* name, void (*run)(), bool benchmark) {
+    Registry().push_back({ name, run, benchmark });
+    return true;
+}
+
+void Test::Fail(const char* file, int line, const char* expression) {
+    std::cout << "  " << file << "(" << line << "): CHECK(" << expression << ") failed" << std::endl;
+    ++runningFailures;
+}
+
+int main(int argc, char** argv) {
+    bool benchmarks = false;
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench") == 0) benchmarks = true;
+        else filter = argv[i];
+    }
+
+    // Created here so this thread is the main thread, like in the engine
+    std::cout << "Job system: " << JobSystem::Get().GetThreadCount() << " threads" << std::endl;
+
+    unsigned int ran = 0, failed = 0;
+    for (const Test::Case& test : Test::Registry()) {
+        if (test.benchmark != benchmarks) continue;
+        if (filter && !std::strstr(test.name, filter)) continue;
+
+        std::cout << test.name << std::endl;
+        runningFailures = 0;
+        test.run();
+        ++ran;
+        if (runningFailures > 0) {
+            std::cout << "  FAILED" << std::endl;
+            ++failed;
+        }
+    }
+
+    std::cout << ran - failed << " of " << ran << (benchmarks ? " benchmarks" : " tests") << " passed" << std::endl;
+    return failed > 0 ? 1 : 0;
+}
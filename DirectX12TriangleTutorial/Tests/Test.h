@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Headless tests and benchmarks of the engine parts that don't need a window or a GPU.
+//
+// TEST bodies check with CHECK, a failed check fails the run but the body goes on. BENCHMARK
+// bodies print what they measured and fail nothing. Tests.exe runs the tests, Tests.exe --bench
+// the benchmarks, a further argument only runs those whose name contains it.
+namespace Test {
+    struct Case {
+        const char* name;
+        void (*run)();
+        bool benchmark;
+    };
+
+    std::vector<Case>& Registry();
+    bool Register(const char* name, void (*run)(), bool benchmark);
+    // Fails the running test
+    void Fail(const char* file, int line, const char* expression);
+
+    // Fastest of repeats runs of body, in milliseconds
+    template <typename Body>
+    double BestMs(int repeats, Body&& body) {
+        double best = 1e30;
+        for (int i = 0; i < repeats; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+}
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##Registered = Test::Register(#name, name, false); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static const bool name##Registered = Test::Register(#name, name, true); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if (!(condition)) Test::Fail(__FILE__, __LINE__, #condition); } while (false)
@@ -0,0 +1,148 @@
+#include "TestMeshes.h"
+#include "File.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+std::string TestMeshes::GridObj(unsigned int cells, float size) {
+    std::ostringstream obj;
+    const float step = size / cells;
+    for (unsigned int z = 0; z <= cells; ++z) {
+        for (unsigned int x = 0; x <= cells; ++x) {
+            obj << "v " << x * step - size * 0.5f << " 0 " << z * step - size * 0.5f << "\n";
+            obj << "vt " << float(x) / cells << " " << float(z) / cells << "\n";
+        }
+    }
+    obj << "vn 0 1 0\n";
+    for (unsigned int z = 0; z < cells; ++z) {
+        for (unsigned int x = 0; x < cells; ++x) {
+            const unsigned int a = z * (cells + 1) + x + 1;
+            const unsigned int b = a + 1, c = a + cells + 1, d = c + 1;
+            obj << "f " << a << "/" << a << "/1 " << c << "/" << c << "/1 " << d << "/" << d << "/1\n";
+            obj << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << b << "/" << b << "/1\n";
+        }
+    }
+    return obj.str();
+}
+
+std::string TestMeshes::SphereObj(unsigned int rings, unsigned int segments, float radius, bool normals) {
+    std::ostringstream obj;
+    const float pi = 3.14159265f;
+    for (unsigned int r = 0; r <= rings; ++r) {
+        const float phi = pi * r / rings;
+        for (unsigned int s = 0; s <= segments; ++s) {
+            const float theta = 2.0f * pi * s / segments;
+            const float nx = std::sin(phi) * std::cos(theta), ny = std::cos(phi), nz = std::sin(phi) * std::sin(theta);
+            obj << "v " << nx * radius << " " << ny * radius << " " << nz * radius << "\n";
+            if (normals) obj << "vn " << nx << " " << ny << " " << nz << "\n";
+        }
+    }
+    for (unsigned int r = 0; r < rings; ++r) {
+        for (unsigned int s = 0; s < segments; ++s) {
+            const unsigned int a = r * (segments + 1) + s + 1;
+            const unsigned int b = a + 1, c = a + segments + 1, d = c + 1;
+            auto corner = [&](unsigned int index) { return std::to_string(index) + (normals ? "//" + std::to_string(index) : ""); };
+            // Clockwise seen from outside, the front faces of the left handed renderer
+            if (r > 0) obj << "f " << corner(a) << " " << corner(b) << " " << corner(c) << "\n";
+            if (r + 1 < rings) obj << "f " << corner(b) << " " << corner(d) << " " << corner(c) << "\n";
+        }
+    }
+    return obj.str();
+}
+
+std::string TestMeshes::BoxObj(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) {
+    std::ostringstream obj;
+    for (unsigned int i = 0; i < 8; ++i) {
+        obj << "v " << ((i & 1) ? max.x : min.x) << " " << ((i & 2) ? max.y : min.y) << " " << ((i & 4) ? max.z : min.z) << "\n";
+    }
+    // Corners per face, clockwise seen from outside
+    static const unsigned int faces[6][4] = {
+        { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, // -z, +z
+        { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, // -x, +x
+        { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, // -y, +y
+    };
+    for (const auto& face : faces) {
+        obj << "f " << face[0] + 1 << " " << face[1] + 1 << " " << face[2] + 1 << "\n";
+        obj << "f " << face[0] + 1 << " " << face[2] + 1 << " " << face[3] + 1 << "\n";
+    }
+    return obj.str();
+}
+
+std::unique_ptr<Model> TestMeshes::Load(const std::string& obj) {
+    auto model = std::make_unique<Model>();
+    std::istringstream stream(obj);
+    model->LoadFromObj(stream, [](const std::string&) {});
+    return model;
+}
+
+void TestMeshes::WriteGlb(const std::string& path, const Model& model, bool interleaved) {
+    const std::vector<Vertex>& vertices = model.GetVertices();
+    const std::vector<unsigned int>& indices = model.GetIndices();
+    const size_t count = vertices.size();
+
+    std::string bin, views, accessors;
+    auto append = [&bin](const void* data, size_t size) { bin.append(static_cast<const char*>(data), size); };
+    auto accessor = [&accessors](int view, size_t offset, int componentType, size_t count, const char* type) {
+        accessors += std::string(accessors.empty() ? "" : ",") + "{\"bufferView\":" + std::to_string(view) + ",\"byteOffset\":" + std::to_string(offset) +
+            ",\"componentType\":" + std::to_string(componentType) + ",\"count\":" + std::to_string(count) + ",\"type\":\"" + type + "\"}";
+    };
+    auto view = [&views, &bin](size_t offset, size_t stride) {
+        views += std::string(views.empty() ? "" : ",") + "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" + std::to_string(bin.size() - offset) +
+            (stride ? ",\"byteStride\":" + std::to_string(stride) : "") + "}";
+    };
+
+    const int Float = 5126, UnsignedInt = 5125;
+    if (interleaved) {
+        append(vertices.data(), count * sizeof(Vertex));
+        view(0, sizeof(Vertex));
+        accessor(0, offsetof(Vertex, position), Float, count, "VEC3");
+        accessor(0, offsetof(Vertex, normal), Float, count, "VEC3");
+        accessor(0, offsetof(Vertex, uv), Float, count, "VEC2");
+    }
+    else {
+        size_t offset = bin.size();
+        for (const Vertex& v : vertices) append(&v.position, sizeof(v.position));
+        view(offset, 0);
+        offset = bin.size();
+        for (const Vertex& v : vertices) append(&v.normal, sizeof(v.normal));
+        view(offset, 0);
+        offset = bin.size();
+        for (const Vertex& v : vertices) append(&v.uv, sizeof(v.uv));
+        view(offset, 0);
+        accessor(0, 0, Float, count, "VEC3");
+        accessor(1, 0, Float, count, "VEC3");
+        accessor(2, 0, Float, count, "VEC2");
+    }
+    const size_t indexOffset = bin.size();
+    append(indices.data(), indices.size() * sizeof(unsigned int));
+    view(indexOffset, 0);
+    accessor(interleaved ? 1 : 3, 0, UnsignedInt, indices.size(), "SCALAR");
+    bin.resize((bin.size() + 3) & ~size_t(3), '\0');
+
+    std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3,\"material\":0}]}],"
+        "\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorFactor\":[0.5,0.5,0.5,1]}}],"
+        "\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}],\"bufferViews\":[" + views + "],\"accessors\":[" + accessors + "]}";
+    json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+    std::ofstream file(path, std::ios::binary);
+    auto write = [&file](uint32_t value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    write(0x46546C67); // "glTF"
+    write(2);
+    write(static_cast<uint32_t>(12 + 8 + json.size() + 8 + bin.size()));
+    write(static_cast<uint32_t>(json.size()));
+    write(0x4E4F534A); // "JSON"
+    file << json;
+    write(static_cast<uint32_t>(bin.size()));
+    write(0x004E4942); // "BIN"
+    file << bin;
+}
+
+std::string TestMeshes::GeneratedAssetDirectory() {
+    std::filesystem::path directory = std::filesystem::path(GetExecutablePath()) / "assets" / "generated";
+    std::filesystem::create_directories(directory);
+    return directory.string();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "Model.h"
+
+// Deterministic meshes for the tests, written as OBJ text so they go through the same loader as
+// the assets do
+namespace TestMeshes {
+    // Flat square of cells x cells quads on y = 0, centered on the origin
+    std::string GridObj(unsigned int cells, float size);
+    // UV sphere around the origin, without normals the loader generates them
+    std::string SphereObj(unsigned int rings, unsigned int segments, float radius, bool normals = true);
+    // Axis aligned box, faces wound outwards
+    std::string BoxObj(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max);
+
+    // Parses OBJ text without materials, meshlets and bounds are built like for a file
+    std::unique_ptr<Model> Load(const std::string& obj);
+
+    // Writes the vertices and indices of model as a single primitive .glb with one untextured
+    // material. Interleaved puts the vertices in one strided view laid out like Vertex,
+    // otherwise every attribute gets its own view.
+    void WriteGlb(const std::string& path, const Model& model, bool interleaved);
+
+    // assets/generated next to the executable, where the asset lookup finds files written for a
+    // test. Created on first use.
+    std::string GeneratedAssetDirectory();
+}
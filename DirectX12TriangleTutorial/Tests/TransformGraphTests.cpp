@@ -0,0 +1,155 @@
+#include "Test.h"
+#include "TransformGraph.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace {
+    DirectX::XMFLOAT4X4 Local(float x, float y, float z, float yaw) {
+        DirectX::XMFLOAT4X4 local;
+        DirectX::XMStoreFloat4x4(&local, DirectX::XMMatrixRotationY(yaw) * DirectX::XMMatrixTranslation(x, y, z));
+        return local;
+    }
+
+    bool Near(const DirectX::XMFLOAT4X4& a, const DirectX::XMFLOAT4X4& b) {
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                if (std::fabs(a.m[r][c] - b.m[r][c]) > 1e-3f) return false;
+            }
+        }
+        return true;
+    }
+
+    // The same hierarchy kept the obvious way, per id
+    struct Reference {
+        std::vector<uint32_t> parents;
+        std::vector<DirectX::XMFLOAT4X4> locals;
+        std::vector<uint8_t> alive;
+
+        void Add(uint32_t id, uint32_t parent, const DirectX::XMFLOAT4X4& local) {
+            if (id >= parents.size()) {
+                parents.resize(id + 1);
+                locals.resize(id + 1);
+                alive.resize(id + 1, 0);
+            }
+            parents[id] = parent;
+            locals[id] = local;
+            alive[id] = 1;
+        }
+
+        bool Below(uint32_t id, uint32_t ancestor) const {
+            for (; id != TransformGraph::NoNode; id = parents[id]) {
+                if (id == ancestor) return true;
+            }
+            return false;
+        }
+
+        DirectX::XMMATRIX World(uint32_t id) const {
+            const DirectX::XMMATRIX local = DirectX::XMLoadFloat4x4(&locals[id]);
+            return parents[id] != TransformGraph::NoNode ? local * World(parents[id]) : local;
+        }
+    };
+
+    bool Matches(const TransformGraph& graph, const Reference& reference) {
+        size_t live = 0;
+        for (uint32_t id = 0; id < reference.alive.size(); ++id) {
+            if (graph.IsAlive(id) != (reference.alive[id] != 0)) return false;
+            if (!reference.alive[id]) continue;
+            ++live;
+            if (graph.GetParent(id) != reference.parents[id]) return false;
+            DirectX::XMFLOAT4X4 world;
+            DirectX::XMStoreFloat4x4(&world, reference.World(id));
+            if (!Near(graph.GetWorld(id), world)) return false;
+        }
+        return graph.Size() == live;
+    }
+}
+
+TEST(TransformGraphRemovesSubtrees) {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> offset(-3.0f, 3.0f), yaw(0.0f, DirectX::XM_2PI);
+    TransformGraph graph;
+    Reference reference;
+    std::vector<uint32_t> live;
+
+    const auto add = [&](uint32_t parent) {
+        const DirectX::XMFLOAT4X4 local = Local(offset(rng), offset(rng), offset(rng), yaw(rng));
+        const uint32_t id = graph.Add(local, parent);
+        reference.Add(id, parent, local);
+        live.push_back(id);
+    };
+
+    for (int i = 0; i < 20; ++i) add(TransformGraph::NoNode);
+    for (int i = 0; i < 300; ++i) add(live[rng() % live.size()]);
+    graph.Update();
+    CHECK(Matches(graph, reference));
+
+    std::vector<uint32_t> removed;
+    for (int round = 0; round < 30; ++round) {
+        // A subtree goes, its ids come back in the order parents first
+        const uint32_t node = live[rng() % live.size()];
+        removed.clear();
+        graph.Remove(node, &removed);
+        std::vector<uint32_t> expected;
+        for (uint32_t id : live) {
+            if (reference.Below(id, node)) expected.push_back(id);
+        }
+        CHECK(removed.size() == expected.size());
+        CHECK(!removed.empty() && removed.front() == node);
+        for (size_t k = 0; k < removed.size(); ++k) {
+            CHECK(reference.Below(removed[k], node));
+            const uint32_t parent = reference.parents[removed[k]];
+            CHECK(removed[k] == node || std::find(removed.begin(), removed.begin() + k, parent) != removed.begin() + k);
+        }
+        for (uint32_t id : expected) reference.alive[id] = 0;
+        live.erase(std::remove_if(live.begin(), live.end(), [&](uint32_t id) { return !reference.alive[id]; }), live.end());
+        CHECK(!graph.IsAlive(node));
+
+        // Until the next Update the tombstones are still in the arrays. Nodes added now reuse
+        // their ids and the live nodes read correctly anyway.
+        for (int i = 0; i < 6 && !live.empty(); ++i) add(live[rng() % live.size()]);
+        add(TransformGraph::NoNode);
+        CHECK(Matches(graph, reference));
+
+        // A moved survivor takes its subtree along once the graph is compacted
+        const uint32_t moved = live[rng() % live.size()];
+        reference.locals[moved] = Local(offset(rng), offset(rng), offset(rng), yaw(rng));
+        graph.SetLocal(moved, reference.locals[moved]);
+        graph.Update();
+        CHECK(graph.GetStats().nodes == live.size());
+        CHECK(Matches(graph, reference));
+    }
+
+    graph.Remove(live.front());
+    graph.Remove(live.front()); // stale, does nothing
+    graph.Clear();
+    CHECK(graph.Size() == 0);
+}
+
+BENCHMARK(TransformGraphRemove) {
+    // A large scene that loses its props one by one, the graph is updated once per frame
+    const unsigned int roots = 20000, frames = 100, removedPerFrame = 20;
+    TransformGraph graph;
+    std::vector<uint32_t> props;
+    for (unsigned int i = 0; i < roots; ++i) {
+        const uint32_t root = graph.Add(Local(static_cast<float>(i), 0.0f, 0.0f, 0.0f));
+        props.push_back(graph.Add(Local(0.0f, 1.0f, 0.0f, 0.0f), root));
+        graph.Add(Local(0.0f, 0.5f, 0.0f, 0.0f), props.back());
+    }
+    graph.Update();
+
+    std::mt19937 rng(3);
+    std::shuffle(props.begin(), props.end(), rng);
+    double removeMs = 0.0, updateMs = 0.0;
+    size_t next = 0;
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        removeMs += Test::BestMs(1, [&] {
+            for (unsigned int i = 0; i < removedPerFrame; ++i) graph.Remove(props[next++]);
+        });
+        updateMs += Test::BestMs(1, [&] { graph.Update(); });
+    }
+    std::cout << "  " << graph.Size() << " nodes left, " << frames * removedPerFrame << " subtrees removed: "
+        << removeMs / (frames * removedPerFrame) * 1000.0 << " us per Remove, "
+        << updateMs / frames << " ms per compacting Update" << std::endl;
+}